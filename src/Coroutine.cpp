@@ -0,0 +1,632 @@
+/**
+ *@file Coroutine.cpp
+ *@author Griffin Nye
+ *@brief A small C++20 coroutine runtime for request handlers. A handler is written as a Task that
+ *       co_awaits its socket reads, socket writes, and semaphore acquires. While a CoRuntime is
+ *       running (in a worker), each of those suspends the handler instead of blocking, so one
+ *       process serves every connection it accepted with the same sequential handler code. With
+ *       no CoRuntime (a forked child server), each one simply blocks, exactly as before.
+ */
+
+
+#ifndef COROUTINE
+#define COROUTINE
+
+#include <algorithm>
+#include <cerrno>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "EventLoop.cpp"
+#include "SemaphoreSet.cpp"
+#include "TraceBuffer.cpp"
+
+using namespace std;
+
+/*! Microseconds a worker waits between retries of the semaphore acquires its handlers are suspended on. */
+#define LOCKRETRYINTERVAL 50
+
+template<class T> class Task;
+
+/**
+ *@brief The part of a Task's promise shared by every result type: tasks start suspended, and a finished
+ *       task resumes whichever coroutine awaited it.
+ */
+class TaskPromiseBase {
+	public:
+		coroutine_handle<> continuation;
+		bool awaitedInline = false;
+
+		/**
+		 *@brief Transfers control from a finished task to the coroutine awaiting it.
+		 */
+		struct FinalAwaiter {
+			bool await_ready() noexcept {
+				return false;
+			}//end await_ready
+
+			template<class Promise> coroutine_handle<> await_suspend(coroutine_handle<Promise> handle) noexcept {
+				coroutine_handle<> next = handle.promise().continuation;
+
+				//A task that never suspended returns to the awaiter's await_suspend, which carries on by itself
+				return (next && !handle.promise().awaitedInline) ? next : noop_coroutine();
+			}//end await_suspend
+
+			void await_resume() noexcept {
+			}//end await_resume
+		};
+
+		suspend_always initial_suspend() noexcept {
+			return {};
+		}//end initial_suspend
+
+		FinalAwaiter final_suspend() noexcept {
+			return {};
+		}//end final_suspend
+
+		void unhandled_exception() {
+			terminate();
+		}//end unhandled_exception
+
+};//end TaskPromiseBase
+
+/**
+ *@brief The promise of a Task that produces a value.
+ */
+template<class T> class TaskPromise : public TaskPromiseBase {
+	public:
+		T value;
+
+		Task<T> get_return_object();
+
+		void return_value(T value) {
+			this->value = move(value);
+		}//end return_value
+
+};//end TaskPromise
+
+/**
+ *@brief The promise of a Task that produces no value.
+ */
+template<> class TaskPromise<void> : public TaskPromiseBase {
+	public:
+		Task<void> get_return_object();
+
+		void return_void() {
+		}//end return_void
+
+};//end TaskPromise
+
+/**
+ *@brief A lazily started coroutine. It runs when it is co_awaited (or run()), and its result is
+ *       what the co_await evaluates to.
+ */
+template<class T = void> class Task {
+	public:
+		typedef TaskPromise<T> promise_type;
+
+	private:
+		coroutine_handle<promise_type> handle;
+
+	public:
+
+		/**
+		 *@brief Constructs the Task that owns a coroutine.
+		 *@param handle The coroutine.
+		 */
+		explicit Task(coroutine_handle<promise_type> handle) : handle(handle) {
+		}//end constructor
+
+		Task(Task &&other) noexcept : handle(exchange(other.handle, nullptr) ) {
+		}//end constructor
+
+		Task(const Task &) = delete;
+		Task & operator=(const Task &) = delete;
+
+		/**
+		 *@brief Destroys the coroutine.
+		 */
+		~Task() {
+			if(handle) {
+				handle.destroy();
+			}//end if
+		}//end destructor
+
+		bool await_ready() {
+			return false;
+		}//end await_ready
+
+		/**
+		 *@brief Starts the task, to resume the awaiting coroutine once it finishes. A task that finishes
+		 *       without suspending (every task, while no CoRuntime is running) returns straight to the
+		 *       awaiting coroutine, so long runs of such tasks never deepen the stack.
+		 *@param caller The awaiting coroutine.
+		 *@return Whether the awaiting coroutine stays suspended until the task finishes.
+		 */
+		bool await_suspend(coroutine_handle<> caller) {
+			handle.promise().continuation = caller;
+			handle.promise().awaitedInline = true;
+			handle.resume();
+
+			if(handle.done() ) {
+				return false;
+			}//end if
+
+			handle.promise().awaitedInline = false;
+
+			return true;
+		}//end await_suspend
+
+		T await_resume() {
+			if constexpr( !is_void_v<T>) {
+				return move(handle.promise().value);
+			}//end if
+		}//end await_resume
+
+		/**
+		 *@brief Runs the task to completion from ordinary code. Only valid while no CoRuntime is running,
+		 *       as every awaitable then completes without suspending.
+		 *@return The task's result.
+		 */
+		T run() {
+			handle.resume();
+
+			if( !handle.done() ) {
+				terminate();
+			}//end if
+
+			return await_resume();
+		}//end run
+
+};//end Task
+
+template<class T> Task<T> TaskPromise<T>::get_return_object() {
+	return Task<T>(coroutine_handle<TaskPromise<T> >::from_promise(*this) );
+}//end get_return_object
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+	return Task<void>(coroutine_handle<TaskPromise<void> >::from_promise(*this) );
+}//end get_return_object
+
+/**
+ *@brief Resumes the coroutines suspended on a worker's socket operations and semaphore acquires.
+ *       The worker owns the event loop and hands every event that is not its own to complete().
+ */
+class CoRuntime {
+	private:
+
+		/**
+		 *@brief A suspended coroutine, along with the trace span it was in.
+		 */
+		struct Suspended {
+			coroutine_handle<> handle;
+			int * result;
+			uint32_t span;
+		};
+
+		/**
+		 *@brief A coroutine suspended on a semaphore operation that could not be applied yet.
+		 */
+		struct LockWaiter {
+			coroutine_handle<> handle;
+			SemaphoreSet * semSet;
+			struct sembuf * ops;
+			unsigned numOps;
+			uint32_t span;
+		};
+
+		/**
+		 *@brief A coroutine suspended until a point in time.
+		 */
+		struct Sleeper {
+			coroutine_handle<> handle;
+			int64_t wakeTime;
+			uint32_t span;
+		};
+
+		/**
+		 *@brief A coroutine that is never awaited and frees itself when it finishes.
+		 */
+		struct DetachedTask {
+			struct promise_type {
+				DetachedTask get_return_object() {
+					return {};
+				}//end get_return_object
+
+				suspend_never initial_suspend() noexcept {
+					return {};
+				}//end initial_suspend
+
+				suspend_never final_suspend() noexcept {
+					return {};
+				}//end final_suspend
+
+				void return_void() {
+				}//end return_void
+
+				void unhandled_exception() {
+					terminate();
+				}//end unhandled_exception
+			};
+		};
+
+		EventLoop &loop;
+		TraceBuffer * tracer;
+		map<int, Suspended> ioWaiters;
+		vector<LockWaiter> lockWaiters;
+		vector<Sleeper> sleepers;
+
+		/**
+		 *@brief Reads the monotonic clock.
+		 *@return The current time in microseconds.
+		 */
+		static int64_t clockMicros() {
+			struct timespec ts;
+
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+
+			return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+		}//end clockMicros
+
+		/**
+		 *@brief Retrieves the trace span a coroutine is suspending in.
+		 *@return The current span (0 if untraced).
+		 */
+		uint32_t currentSpan() {
+			return (tracer == NULL) ? 0 : tracer->getSpan();
+		}//end currentSpan
+
+		/**
+		 *@brief Resumes a suspended coroutine within the trace span it suspended in.
+		 *@param handle The coroutine.
+		 *@param span The span.
+		 */
+		void resume(coroutine_handle<> handle, uint32_t span) {
+			if(tracer != NULL) {
+				tracer->setSpan(span);
+			}//end if
+
+			handle.resume();
+		}//end resume
+
+	public:
+		/*! The running CoRuntime, or NULL when awaitables should block instead of suspending. */
+		inline static CoRuntime * current = NULL;
+
+		/**
+		 *@brief Constructs the CoRuntime and makes it the running one.
+		 *@param loop The worker's event loop, which socket operations are requested from.
+		 */
+		CoRuntime(EventLoop &loop) : loop(loop) {
+			tracer = NULL;
+			current = this;
+		}//end constructor
+
+		/**
+		 *@brief Stops the CoRuntime from being the running one.
+		 */
+		~CoRuntime() {
+			current = NULL;
+		}//end destructor
+
+		/**
+		 *@brief Sets the trace whose current span is saved while a coroutine is suspended, so
+		 *       interleaved requests each keep recording into their own span.
+		 *@param tracer The process's trace, or NULL if untraced.
+		 */
+		void setTracer(TraceBuffer * tracer) {
+			this->tracer = tracer;
+		}//end setTracer
+
+		/**
+		 *@brief Starts a task that runs (and is freed) on its own, without being awaited.
+		 *@param task The task.
+		 */
+		static DetachedTask spawn(Task<> task) {
+			co_await task;
+		}//end spawn
+
+		/**
+		 *@brief Requests a receive on a coroutine's behalf.
+		 *@param handle The coroutine, resumed once the receive finishes.
+		 *@param fd The socket's file descriptor.
+		 *@param buf The buffer.
+		 *@param len The most bytes to be received.
+		 *@param result Receives the LoopEvent result of the receive.
+		 *@return Whether the receive was requested (the coroutine is not resumed otherwise).
+		 */
+		bool receive(coroutine_handle<> handle, int fd, void * buf, size_t len, int * result) {
+			if( !loop.receive(fd, buf, len) ) {
+				return false;
+			}//end if
+
+			ioWaiters[fd] = {handle, result, currentSpan()};
+
+			return true;
+		}//end receive
+
+		/**
+		 *@brief Requests a wait for a socket to become writable on a coroutine's behalf.
+		 *@param handle The coroutine, resumed once the socket is writable.
+		 *@param fd The socket's file descriptor.
+		 *@param result Receives the LoopEvent result of the wait.
+		 *@return Whether the wait was requested (the coroutine is not resumed otherwise).
+		 */
+		bool writable(coroutine_handle<> handle, int fd, int * result) {
+			if( !loop.writable(fd) ) {
+				return false;
+			}//end if
+
+			ioWaiters[fd] = {handle, result, currentSpan()};
+
+			return true;
+		}//end writable
+
+		/**
+		 *@brief Stops tracking a socket with no operation outstanding, before it is closed.
+		 *@param fd The socket's file descriptor.
+		 */
+		void forget(int fd) {
+			loop.forget(fd);
+		}//end forget
+
+		/**
+		 *@brief Suspends a coroutine until a semaphore operation can be applied.
+		 *@param handle The coroutine, resumed once the operation has been applied.
+		 *@param semSet The semaphore set.
+		 *@param ops The operations, which must remain valid until the coroutine is resumed.
+		 *@param numOps The number of operations.
+		 */
+		void waitForLock(coroutine_handle<> handle, SemaphoreSet * semSet, struct sembuf * ops, unsigned numOps) {
+			lockWaiters.push_back({handle, semSet, ops, numOps, currentSpan()});
+		}//end waitForLock
+
+		/**
+		 *@brief Suspends a coroutine for a while.
+		 *@param handle The coroutine, resumed once the time has passed.
+		 *@param micros The number of microseconds to sleep for.
+		 */
+		void sleep(coroutine_handle<> handle, long micros) {
+			sleepers.push_back({handle, clockMicros() + micros, currentSpan()});
+		}//end sleep
+
+		/**
+		 *@brief Resumes the coroutine an event from the worker's event loop belongs to.
+		 *@param event The event.
+		 *@return Whether the event belonged to a suspended coroutine.
+		 */
+		bool complete(const LoopEvent &event) {
+			map<int, Suspended>::iterator waiter = ioWaiters.find(event.fd);
+			Suspended suspended;
+
+			if(waiter == ioWaiters.end() ) {
+				return false;
+			}//end if
+
+			//The coroutine may request its next operation on the same socket as soon as it resumes
+			suspended = waiter->second;
+			ioWaiters.erase(waiter);
+			*suspended.result = event.result;
+			resume(suspended.handle, suspended.span);
+
+			return true;
+		}//end complete
+
+		/**
+		 *@brief Retries every suspended semaphore operation, in the order they were suspended, and resumes
+		 *       the coroutines whose operations were applied (or failed for good).
+		 */
+		void retryLocks() {
+			vector<LockWaiter> waiting;
+
+			waiting.swap(lockWaiters);
+
+			for(size_t i = 0; i < waiting.size(); i++) {
+				if(waiting[i].semSet->tryOperate(waiting[i].ops, waiting[i].numOps) == 0 || errno != EAGAIN) {
+					resume(waiting[i].handle, waiting[i].span);
+				} else {
+					lockWaiters.push_back(waiting[i]);
+				}//end if
+			}//end for
+
+		}//end retryLocks
+
+		/**
+		 *@brief Resumes every sleeping coroutine whose time has come.
+		 */
+		void wakeSleepers() {
+			vector<Sleeper> sleeping;
+			int64_t time = clockMicros();
+
+			sleeping.swap(sleepers);
+
+			for(size_t i = 0; i < sleeping.size(); i++) {
+				if(sleeping[i].wakeTime <= time) {
+					resume(sleeping[i].handle, sleeping[i].span);
+				} else {
+					sleepers.push_back(sleeping[i]);
+				}//end if
+			}//end for
+
+		}//end wakeSleepers
+
+		/**
+		 *@brief Retrieves how long the worker may wait for its next event.
+		 *@return LOCKRETRYINTERVAL microseconds while any coroutine is suspended on a semaphore, otherwise the time
+		 *        until the next sleeping coroutine wakes, or -1 (no limit) if none is sleeping.
+		 */
+		long getWaitTimeout() {
+			long timeout = lockWaiters.empty() ? -1 : LOCKRETRYINTERVAL;
+			int64_t time = clockMicros();
+
+			for(size_t i = 0; i < sleepers.size(); i++) {
+				long remaining = max<int64_t>(sleepers[i].wakeTime - time, 0);
+
+				if(timeout == -1 || remaining < timeout) {
+					timeout = remaining;
+				}//end if
+			}//end for
+
+			return timeout;
+		}//end getWaitTimeout
+
+};//end CoRuntime
+
+/**
+ *@brief Awaitable receive of whatever next arrives on a socket, up to a length. Evaluates to the number
+ *       of bytes received, 0 if the peer disconnected, or -errno on error.
+ */
+class SocketReceive {
+	private:
+		int fd;
+		void * buf;
+		size_t len;
+		int result;
+
+	public:
+		SocketReceive(int fd, void * buf, size_t len) : fd(fd), buf(buf), len(len), result(0) {
+		}//end constructor
+
+		bool await_ready() {
+			ssize_t numRead;
+
+			if(CoRuntime::current != NULL) {
+				return false;
+			}//end if
+
+			while( (numRead = read(fd, buf, len) ) == -1 && errno == EINTR);
+
+			result = (numRead == -1) ? -errno : (int) numRead;
+
+			return true;
+		}//end await_ready
+
+		bool await_suspend(coroutine_handle<> handle) {
+			if( !CoRuntime::current->receive(handle, fd, buf, len, &result) ) {
+				result = -errno;
+				return false;
+			}//end if
+
+			return true;
+		}//end await_suspend
+
+		int await_resume() {
+			return result;
+		}//end await_resume
+
+};//end SocketReceive
+
+/**
+ *@brief Awaitable wait for a socket to have room for more data to be sent. Evaluates to a positive value
+ *       once it does, or -errno on error. Completes at once while no CoRuntime is running.
+ */
+class SocketWritable {
+	private:
+		int fd;
+		int result;
+
+	public:
+		SocketWritable(int fd) : fd(fd), result(1) {
+		}//end constructor
+
+		bool await_ready() {
+			return CoRuntime::current == NULL;
+		}//end await_ready
+
+		bool await_suspend(coroutine_handle<> handle) {
+			if( !CoRuntime::current->writable(handle, fd, &result) ) {
+				result = -errno;
+				return false;
+			}//end if
+
+			return true;
+		}//end await_suspend
+
+		int await_resume() {
+			return result;
+		}//end await_resume
+
+};//end SocketWritable
+
+/**
+ *@brief Awaitable pause, for handlers that poll. Blocks the process while no CoRuntime is running.
+ */
+class Sleep {
+	private:
+		long micros;
+
+	public:
+		Sleep(long micros) : micros(micros) {
+		}//end constructor
+
+		bool await_ready() {
+			if(CoRuntime::current == NULL) {
+				usleep(micros);
+				return true;
+			}//end if
+
+			return false;
+		}//end await_ready
+
+		void await_suspend(coroutine_handle<> handle) {
+			CoRuntime::current->sleep(handle, micros);
+		}//end await_suspend
+
+		void await_resume() {
+		}//end await_resume
+
+};//end Sleep
+
+/*! Most operations a SemaphoreAcquire applies at once. */
+#define MAXACQUIREOPS 2
+
+/**
+ *@brief Awaitable semaphore operation. SysV semaphores cannot be waited on from an event loop, so while a
+ *       CoRuntime is running the operation is attempted with IPC_NOWAIT and, if it would block, retried by
+ *       the runtime until it is applied.
+ */
+class SemaphoreAcquire {
+	private:
+		SemaphoreSet &semSet;
+		struct sembuf ops[MAXACQUIREOPS];
+		unsigned numOps;
+
+	public:
+
+		/**
+		 *@brief Constructs the awaitable operation.
+		 *@param semSet The semaphore set.
+		 *@param ops The operations to be applied atomically (at most MAXACQUIREOPS).
+		 *@param numOps The number of operations.
+		 */
+		SemaphoreAcquire(SemaphoreSet &semSet, const struct sembuf ops[], unsigned numOps) : semSet(semSet), numOps(numOps) {
+			for(unsigned i = 0; i < numOps; i++) {
+				this->ops[i] = ops[i];
+			}//end for
+		}//end constructor
+
+		bool await_ready() {
+			if(CoRuntime::current == NULL) {
+				semSet.operate(ops, numOps);
+				return true;
+			}//end if
+
+			return semSet.tryOperate(ops, numOps) == 0 || errno != EAGAIN;
+		}//end await_ready
+
+		void await_suspend(coroutine_handle<> handle) {
+			CoRuntime::current->waitForLock(handle, &semSet, ops, numOps);
+		}//end await_suspend
+
+		void await_resume() {
+		}//end await_resume
+
+};//end SemaphoreAcquire
+#endif
@@ -0,0 +1,201 @@
+/**
+ *@file CsvRecordParser.cpp
+ *@author Griffin Nye
+ *@brief Converts csv lines into the fixed-size record slots of the binary-encoded data file.
+ *       Shared by createBin's parallel importer and the server's BLK bulk ingest command.
+ */
+
+
+#ifndef CSVRECORDPARSER
+#define CSVRECORDPARSER
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include "CsvScanner.cpp"
+#include "Money.cpp"
+#include "msgPackets.cpp"
+
+using namespace std;
+
+/*! Size of a single fixed-size record slot in the binary-encoded file. */
+#define RECORDSLOTSIZE (MAXRECORDSIZE + 1)
+/*! Number of input bytes handed to the CsvScanner at once. */
+#define SCANBLOCKSIZE (1 << 20)
+
+/**
+ *@brief Walks csv data line by line using the CsvScanner and formats each line into a record slot.
+ */
+class CsvRecordParser {
+	public:
+
+		/**
+		 *@brief Returns whether the provided character terminates a line.
+		 *@param c The character to be tested.
+		 *@return Whether c is '\n' or '\r'.
+		 */
+		static bool isLineEnd(char c) {
+			return c == '\n' || c == '\r';
+		}//end isLineEnd
+
+		/**
+		 *@brief Counts the non-empty lines of the data. Lines may be terminated by '\n', '\r', or "\r\n".
+		 *@param begin First byte of the data.
+		 *@param end One past the last byte of the data.
+		 *@return The number of records in the data.
+		 */
+		static long countRecords(const char * begin, const char * end) {
+			vector<uint32_t> offsets(SCANBLOCKSIZE);
+			const char * lineStart = begin;
+			long numRecords = 0;
+
+			//Count each line terminator that ends a non-empty line, a block of delimiters at a time
+			for(const char * block = begin; block < end; block += min<size_t>(SCANBLOCKSIZE, end - block) ) {
+				size_t numDelims = CsvScanner::scan(block, min<size_t>(SCANBLOCKSIZE, end - block), &offsets[0]);
+
+				for(size_t i = 0; i < numDelims; i++) {
+					const char * c = block + offsets[i];
+
+					if( isLineEnd(*c) ) {
+						numRecords += c > lineStart;
+						lineStart = c + 1;
+					}//end if
+
+				}//end for
+
+			}//end for
+
+			//Count a final line without a terminator
+			return numRecords + (end > lineStart);
+		}//end countRecords
+
+		/**
+		 *@brief Calls the provided callback with each non-empty line of the data and the positions of its commas.
+		 *@param begin First byte of the data.
+		 *@param end One past the last byte of the data.
+		 *@param onLine Callback taking (lineStart, lineEnd, commas[4], numCommas).
+		 */
+		template<class LineCallback> static void forEachLine(const char * begin, const char * end, LineCallback onLine) {
+			vector<uint32_t> offsets(SCANBLOCKSIZE + 1);
+			const char * lineStart = begin;
+			const char * commas[4];
+			int numCommas = 0;
+			size_t numDelims, blockLen;
+
+			//Walk the delimiters a block at a time (a final unterminated line ends at the end of the data)
+			for(const char * block = begin; ; block += blockLen) {
+				blockLen = min<size_t>(SCANBLOCKSIZE, end - block);
+				numDelims = CsvScanner::scan(block, blockLen, &offsets[0]);
+
+				if(block + blockLen == end) {
+					offsets[numDelims++] = blockLen;
+				}//end if
+
+				for(size_t i = 0; i < numDelims; i++) {
+					const char * c = block + offsets[i];
+
+					//Remember the positions of the line's commas
+					if(c < end && *c == ',') {
+
+						if(numCommas < 4) {
+							commas[numCommas] = c;
+						}//end if
+
+						numCommas++;
+						continue;
+					}//end if
+
+					//Skip empty lines
+					if(c > lineStart) {
+						onLine(lineStart, c, commas, numCommas);
+					}//end if
+
+					lineStart = c + 1;
+					numCommas = 0;
+				}//end for
+
+				if(block + blockLen == end) {
+					break;
+				}//end if
+
+			}//end for
+
+		}//end forEachLine
+
+		/**
+		 *@brief Parses a single csv line and formats it into a fixed-size record slot without allocating.
+		 *@param line First byte of the line.
+		 *@param end One past the last byte of the line.
+		 *@param commas Positions of the line's first 4 commas, as found by the CsvScanner.
+		 *@param numCommas The total number of commas found in the line.
+		 *@param slot The RECORDSLOTSIZE-byte slot to format the record into.
+		 *@return Whether the line was a well-formed record that fits in the slot.
+		 */
+		static bool formatRecord(const char * line, const char * end, const char * commas[], int numCommas, char * slot) {
+			char * out = slot;
+			char * slotEnd = slot + MAXRECORDSIZE;
+			Money val;
+
+			memset(slot, 0, RECORDSLOTSIZE);
+
+			//Records have exactly 5 fields
+			if(numCommas != 4 || commas[0] - line > MAXRECORDSIZE) {
+				return false;
+			}//end if
+
+			//Copy Month & Year
+			memcpy(out, line, commas[0] - line);
+			out += commas[0] - line;
+
+			//Parse Total, Hardware, Software, & Accessories Revenue and reformat them to 2 decimal places
+			for(int field = 0; field < 4; field++) {
+				const char * fieldEnd = (field == 3) ? end : commas[field+1];
+
+				if(out >= slotEnd) {
+					return false;
+				}//end if
+
+				*out++ = ',';
+				if( !Money::parse(string_view(commas[field] + 1, fieldEnd - commas[field] - 1), val) ) {
+					return false;
+				}//end if
+
+				out = val.format(out, slotEnd);
+
+				if(out == NULL) {
+					return false;
+				}//end if
+
+			}//end for
+
+			return true;
+		}//end formatRecord
+
+		/**
+		 *@brief Converts csv data into consecutive record slots.
+		 *@param begin First byte of the data.
+		 *@param end One past the last byte of the data.
+		 *@param slots Receives the record slots (RECORDSLOTSIZE bytes each).
+		 *@return The 1-based line of the first malformed record, or 0 if all records were well-formed.
+		 */
+		static long parseRecords(const char * begin, const char * end, vector<char> &slots) {
+			long record = 0, badRecord = 0;
+
+			slots.assign(countRecords(begin, end) * RECORDSLOTSIZE, '\0');
+
+			forEachLine(begin, end, [&](const char * line, const char * lineEnd, const char * commas[], int numCommas) {
+
+				if( !formatRecord(line, lineEnd, commas, numCommas, &slots[record * RECORDSLOTSIZE]) && badRecord == 0) {
+					badRecord = record + 1;
+				}//end if
+
+				record++;
+			});
+
+			return badRecord;
+		}//end parseRecords
+
+};//end CsvRecordParser
+#endif
@@ -0,0 +1,180 @@
+/**
+ *@file CsvScanner.cpp
+ *@author Griffin Nye
+ *@brief Vectorized scanner for locating the field and record delimiters of csv data.
+ *       Whole blocks are classified 16 (SSE2) or 32 (AVX2) bytes at a time, with a
+ *       scalar fallback for other targets and for the tail of each block.
+ */
+
+
+#ifndef CSVSCANNER
+#define CSVSCANNER
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CSVSCANNER_X86
+#endif
+
+using namespace std;
+
+/**
+ *@brief Finds the offsets of every ',', '\n', and '\r' in a block of csv data.
+ */
+class CsvScanner {
+	public:
+
+		/*! Instruction sets the scanner can use, fastest last. */
+		enum ISA {SCALAR, SSE2, AVX2};
+
+	private:
+
+		/**
+		 *@brief Returns whether the provided character is a csv delimiter.
+		 *@param c The character to be tested.
+		 *@return Whether c is ',', '\n', or '\r'.
+		 */
+		static bool isDelimiter(char c) {
+			return c == ',' || c == '\n' || c == '\r';
+		}//end isDelimiter
+
+		/**
+		 *@brief Scans a block one byte at a time.
+		 *@param buf The block to be scanned.
+		 *@param start Offset of the first byte to be scanned.
+		 *@param len Length of the block.
+		 *@param offsets Receives the offsets of the delimiters found.
+		 *@return The number of delimiters found.
+		 */
+		static size_t scanScalar(const char * buf, size_t start, size_t len, uint32_t * offsets) {
+			size_t count = 0;
+
+			for(size_t i = start; i < len; i++) {
+				offsets[count] = i;
+				count += isDelimiter(buf[i]);
+			}//end for
+
+			return count;
+		}//end scanScalar
+
+		/**
+		 *@brief Appends the offsets of the set bits of a delimiter mask.
+		 *@param mask Bit i is set when byte base+i is a delimiter.
+		 *@param base Offset of the first byte covered by the mask.
+		 *@param offsets Receives the offsets of the delimiters found.
+		 *@return The number of offsets appended.
+		 */
+		static size_t emitMask(uint32_t mask, size_t base, uint32_t * offsets) {
+			size_t count = 0;
+
+			while(mask != 0) {
+				offsets[count++] = base + __builtin_ctz(mask);
+				mask &= mask - 1;
+			}//end while
+
+			return count;
+		}//end emitMask
+
+#ifdef CSVSCANNER_X86
+		/**
+		 *@brief Scans a block 16 bytes at a time using SSE2.
+		 *@param buf The block to be scanned.
+		 *@param len Length of the block.
+		 *@param offsets Receives the offsets of the delimiters found.
+		 *@return The number of delimiters found.
+		 */
+		__attribute__((target("sse2")))
+		static size_t scanSSE2(const char * buf, size_t len, uint32_t * offsets) {
+			const __m128i COMMA = _mm_set1_epi8(','), LF = _mm_set1_epi8('\n'), CR = _mm_set1_epi8('\r');
+			size_t count = 0, i = 0;
+
+			for(; i + 16 <= len; i += 16) {
+				__m128i block = _mm_loadu_si128( (const __m128i *) (buf + i) );
+				__m128i hits = _mm_or_si128( _mm_cmpeq_epi8(block, COMMA),
+				               _mm_or_si128( _mm_cmpeq_epi8(block, LF), _mm_cmpeq_epi8(block, CR) ) );
+
+				count += emitMask( (uint32_t) _mm_movemask_epi8(hits), i, offsets + count);
+			}//end for
+
+			return count + scanScalar(buf, i, len, offsets + count);
+		}//end scanSSE2
+
+		/**
+		 *@brief Scans a block 32 bytes at a time using AVX2.
+		 *@param buf The block to be scanned.
+		 *@param len Length of the block.
+		 *@param offsets Receives the offsets of the delimiters found.
+		 *@return The number of delimiters found.
+		 */
+		__attribute__((target("avx2")))
+		static size_t scanAVX2(const char * buf, size_t len, uint32_t * offsets) {
+			const __m256i COMMA = _mm256_set1_epi8(','), LF = _mm256_set1_epi8('\n'), CR = _mm256_set1_epi8('\r');
+			size_t count = 0, i = 0;
+
+			for(; i + 32 <= len; i += 32) {
+				__m256i block = _mm256_loadu_si256( (const __m256i *) (buf + i) );
+				__m256i hits = _mm256_or_si256( _mm256_cmpeq_epi8(block, COMMA),
+				               _mm256_or_si256( _mm256_cmpeq_epi8(block, LF), _mm256_cmpeq_epi8(block, CR) ) );
+
+				count += emitMask( (uint32_t) _mm256_movemask_epi8(hits), i, offsets + count);
+			}//end for
+
+			return count + scanScalar(buf, i, len, offsets + count);
+		}//end scanAVX2
+#endif
+
+	public:
+
+		/**
+		 *@brief Returns the fastest instruction set supported by the running CPU.
+		 *@return The best available ISA.
+		 */
+		static ISA bestISA() {
+#ifdef CSVSCANNER_X86
+			__builtin_cpu_init();
+
+			if( __builtin_cpu_supports("avx2") ) {
+				return AVX2;
+			} else if( __builtin_cpu_supports("sse2") ) {
+				return SSE2;
+			}//end if
+#endif
+			return SCALAR;
+		}//end bestISA
+
+		/**
+		 *@brief Finds the offsets of every delimiter in a block using the provided instruction set.
+		 *@param buf The block to be scanned (at most 4GB).
+		 *@param len Length of the block.
+		 *@param offsets Receives the offsets of the delimiters found; must have room for len entries.
+		 *@param isa The instruction set to scan with (falls back to scalar if unsupported on this target).
+		 *@return The number of delimiters found.
+		 */
+		static size_t scan(const char * buf, size_t len, uint32_t * offsets, ISA isa) {
+#ifdef CSVSCANNER_X86
+			if(isa == AVX2) {
+				return scanAVX2(buf, len, offsets);
+			} else if(isa == SSE2) {
+				return scanSSE2(buf, len, offsets);
+			}//end if
+#endif
+			return scanScalar(buf, 0, len, offsets);
+		}//end scan
+
+		/**
+		 *@brief Finds the offsets of every delimiter in a block using the fastest available instruction set.
+		 *@param buf The block to be scanned (at most 4GB).
+		 *@param len Length of the block.
+		 *@param offsets Receives the offsets of the delimiters found; must have room for len entries.
+		 *@return The number of delimiters found.
+		 */
+		static size_t scan(const char * buf, size_t len, uint32_t * offsets) {
+			static const ISA BESTISA = bestISA();
+
+			return scan(buf, len, offsets, BESTISA);
+		}//end scan
+
+};//end CsvScanner
+#endif
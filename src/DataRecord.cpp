@@ -5,23 +5,114 @@
  */
 
 
-#include <iomanip>
+#ifndef DATARECORD
+#define DATARECORD
+
+#include <charconv>
+#include <cstring>
 #include <iostream>
-#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "Money.cpp"
 
 using namespace std;
 
+/*! Maximum length of the month & year field (e.g. "Jan '20"). */
+#define MAXMONTHYEARSIZE 15
+/*! Size of a buffer large enough for any formatted record or display row. */
+#define RECORDBUFSIZE 96
+
 /**
  * @brief Class for holding a single record of Data
  */
 class DataRecord {
   private:
-    string monthYear;
+    char monthYear[MAXMONTHYEARSIZE+1];
 		int idx;
-    float accessories;
-    float hardware;
-    float software;
-    float total;
+		int month;
+		int year;
+    Money accessories;
+    Money hardware;
+    Money software;
+    Money total;
+    
+    /**
+     *@brief Copies the month & year field and extracts its month (0-11) and 2-digit year.
+     *@param field The month & year field, e.g. "Jan '20".
+     *@return Whether the field fits in the record.
+     */
+    bool setMonthYear(string_view field) {
+			const char * MONTHS = "JanFebMarAprMayJunJulAugSepOctNovDec";
+			size_t pos = field.find('\'');
+			
+			if(field.size() > MAXMONTHYEARSIZE) {
+				return false;
+			}//end if
+			
+			memcpy(monthYear, field.data(), field.size() );
+			monthYear[field.size()] = '\0';
+			
+			//Match the 3-letter month abbreviation
+			month = -1;
+			
+			for(int i = 0; i < 12 && field.size() >= 3; i++) {
+				if(memcmp(MONTHS + 3 * i, field.data(), 3) == 0) {
+					month = i;
+				}//end if
+			}//end for
+			
+			//Read the 2-digit year following the apostrophe
+			if(pos == string_view::npos || from_chars(field.data() + pos + 1, field.data() + field.size(), year).ec != errc() ) {
+				year = -1;
+			}//end if
+			
+			return true;
+		}//end setMonthYear
+    
+    /**
+     *@brief Right-aligns text within a field of the provided width.
+     *@param out Where the field is to be written.
+     *@param end One past the last writable byte.
+     *@param text The text to be aligned.
+     *@param len The length of the text.
+     *@param width The width of the field.
+     *@return One past the last byte written, or NULL if the field did not fit.
+     */
+    static char * alignRight(char * out, char * end, const char * text, size_t len, size_t width) {
+			size_t padding = (width > len) ? width - len : 0;
+			
+			if(out == NULL || (size_t) (end - out) < padding + len) {
+				return NULL;
+			}//end if
+			
+			memset(out, ' ', padding);
+			memcpy(out + padding, text, len);
+			
+			return out + padding + len;
+		}//end alignRight
+    
+    /**
+     *@brief Writes a revenue field as "$<value> bil", right-aligned within the provided width.
+     *@param out Where the field is to be written.
+     *@param end One past the last writable byte.
+     *@param field The revenue value.
+     *@param width The width of the field.
+     *@return One past the last byte written, or NULL if the field did not fit.
+     */
+    static char * alignMoney(char * out, char * end, Money field, size_t width) {
+			char money[48] = "$";
+			char * moneyEnd = formatField(field, money + 1, money + sizeof(money) - 4);
+			
+			if(moneyEnd == NULL) {
+				return NULL;
+			}//end if
+			
+			memcpy(moneyEnd, " bil", 4);
+			
+			return alignRight(out, end, money, moneyEnd + 4 - money, width);
+		}//end alignMoney
   
   public:
   
@@ -29,6 +120,9 @@ class DataRecord {
 		 *@brief Default Constructor for the DataRecord object
 		 */
 		DataRecord() {
+			monthYear[0] = '\0';
+			idx = month = year = -1;
+			accessories = hardware = software = total = Money();
 		}//end constructor
 		
 		/**
@@ -40,8 +134,8 @@ class DataRecord {
 		 *@param total The total generated revenue
 		 *@param recIdx The index of the record, -1 by default
 		 */
-		DataRecord(string monthYear, float accessories, float hardware, float software, float total, int recIdx = -1) {
-			this -> monthYear = monthYear;
+		DataRecord(string monthYear, Money accessories, Money hardware, Money software, Money total, int recIdx = -1) {
+			setMonthYear( string_view(monthYear).substr(0, MAXMONTHYEARSIZE) );
 			this -> accessories = accessories;
 			this -> hardware = hardware;
 			this -> software = software;
@@ -54,49 +148,118 @@ class DataRecord {
      *       parsing it into the object's data members. 
      *@param record Record string read from the file.
 		 *@param recIdx Index of the DataRecord in the server bin file
+		 *@throw invalid_argument If the record is malformed.
      */
-    DataRecord(string record, int recIdx = -1)  {
-			size_t pos;
-			
-			//Parse Month & Year
-			pos = record.find(',');
-			monthYear = record.substr(0,pos);
-			record.erase(0, pos+1);
-			
-			//Parse Total Revenue
-			pos = record.find(',');
-			total = stof(record.substr(0,pos) );
-			record.erase(0,pos+1);
+    DataRecord(string_view record, int recIdx = -1)  {
+			if( !parse(record, recIdx) ) {
+				throw invalid_argument("DataRecord");
+			}//end if
+		}//end constructor
+		
+		/**
+		 *@brief Parses a record string ("Mon 'YY,total,hardware,software,accessories") into the
+		 *       object's data members without allocating or using floating point.
+		 *@param record Record string read from the file (anything after a NUL is ignored).
+		 *@param recIdx Index of the DataRecord in the server bin file
+		 *@return Whether the record was well-formed.
+		 */
+		bool parse(string_view record, int recIdx = -1) {
+			Money * fields[4] = {&total, &hardware, &software, &accessories};
+			size_t pos = record.find(',');
 			
-			//Parse Hardware Revenue
-			pos = record.find(',');
-			hardware = stof(record.substr(0,pos) );
-			record.erase(0,pos+1);
+			record = record.substr(0, record.find('\0') );
+			idx = recIdx;
 			
-			//Parse Software Revenue
-			pos = record.find(',');
-			software = stof(record.substr(0,pos) );
-			record.erase(0,pos+1);
+			//Parse Month & Year
+			if(pos == string_view::npos || !setMonthYear( record.substr(0, pos) ) ) {
+				return false;
+			}//end if
 			
-			//Parse Accessories Revenue
-			accessories = stof(record);
+			//Parse Total, Hardware, Software, & Accessories Revenue
+			for(int i = 0; i < 4; i++) {
+				const char * begin = record.data() + pos + 1;
+				
+				pos = (i == 3) ? record.size() : record.find(',', pos + 1);
+				
+				if(pos == string_view::npos) {
+					return false;
+				}//end if
+				
+				if( !Money::parse(string_view(begin, record.data() + pos - begin), *fields[i]) ) {
+					return false;
+				}//end if
+				
+			}//end for
 			
-			idx = recIdx;
-		}//end constructor
+			return true;
+		}//end parse
    
     /**
-     *@brief Converts fields of type float to their fixed precision string types.
-     *@param field Float Data field
-     *@return A fixed precision float-converted string.
+     *@brief Formats a revenue field to 2 decimal places without allocating.
+     *@param field Revenue Data field
+     *@param out Where the formatted field is to be written.
+     *@param end One past the last writable byte.
+     *@return One past the last byte written, or NULL if the field did not fit.
      */
-    string fieldToString(float field) {
-			stringstream ss;
-			
-			ss << fixed << setprecision(2) << field;
+    static char * formatField(Money field, char * out, char * end) {
+			return field.format(out, end);
+		}//end formatField
+   
+    /**
+     *@brief Converts revenue fields to their fixed precision string types.
+     *@param field Revenue Data field
+     *@return A fixed precision string.
+     */
+    string fieldToString(Money field) {
+			char buf[48];
 			
-			return ss.str();
+			return string(buf, formatField(field, buf, buf + sizeof(buf) ) - buf);
 		}//end fieldToString
 		
+		/**
+		 *@brief Formats the record as its record string into a caller-provided buffer without allocating.
+		 *@param buf The buffer receiving the NUL-terminated record string.
+		 *@param bufSize The size of the buffer.
+		 *@return The length of the record string, or 0 if it did not fit.
+		 */
+		size_t format(char * buf, size_t bufSize) {
+			Money fields[4] = {total, hardware, software, accessories};
+			char * end = buf + bufSize - 1;
+			char * out = alignRight(buf, end, monthYear, strlen(monthYear), 0);
+			
+			for(int i = 0; i < 4 && out != NULL; i++) {
+				out = alignRight(out, end, ",", 1, 0);
+				out = (out == NULL) ? NULL : formatField(fields[i], out, end);
+			}//end for
+			
+			if(out == NULL) {
+				return 0;
+			}//end if
+			
+			*out = '\0';
+			
+			return out - buf;
+		}//end format
+		
+		/**
+		 *@brief Formats the record as an aligned display row (ending in a newline) into a caller-provided buffer.
+		 *@param buf The buffer receiving the row.
+		 *@param bufSize The size of the buffer.
+		 *@return The length of the row, or 0 if it did not fit.
+		 */
+		size_t formatRow(char * buf, size_t bufSize) {
+			char * end = buf + bufSize;
+			char * out = alignRight(buf, end, monthYear, strlen(monthYear), 9);
+			
+			out = alignMoney(out, end, accessories, 13);
+			out = alignMoney(out, end, hardware, 11);
+			out = alignMoney(out, end, software, 11);
+			out = alignMoney(out, end, total, 11);
+			out = alignRight(out, end, "\n", 1, 0);
+			
+			return out == NULL ? 0 : out - buf;
+		}//end formatRow
+		
 		/**
 		 *@brief Retrieves the idx data member
 		 *@return The value of the idx member
@@ -109,18 +272,16 @@ class DataRecord {
      *@brief Prints the DataRecord object in a well-formatted manner.
      */
     void printRecord() {
-			cout << right << setw(9) << monthYear 
-			<< setw(13) << "$" + fieldToString(accessories) + " bil"
-			<< setw(11) << "$" + fieldToString(hardware) + " bil" 
-			<< setw(11) << "$" + fieldToString(software) + " bil"
-			<< setw(11) << "$" + fieldToString(total) + " bil" << endl;
+			char row[RECORDBUFSIZE];
+			
+			cout.write(row, formatRow(row, sizeof(row) ) );
 		}//end printRecord
 		
 		/**
 		 *@brief Sets the accessories data member to the provided value
 		 *@param val Value to set data member to
 		 */
-		void setAccessories(float val) {
+		void setAccessories(Money val) {
 			accessories = val;
 		}//end setAccessories
 
@@ -128,7 +289,7 @@ class DataRecord {
 		 *@brief Sets the hardware data member to the provided value
 		 *@param val Value to set data member to
 		 */
-		void setHardware(float val) {
+		void setHardware(Money val) {
 			hardware = val;
 		}//end setHardware
 
@@ -136,7 +297,7 @@ class DataRecord {
 		 *@brief Sets the Software data member to the provided value
 		 *@param val Value to set data member to
 		 */
-		void setSoftware(float val) {
+		void setSoftware(Money val) {
 			software = val;
 		}//end setSoftware
 
@@ -144,7 +305,7 @@ class DataRecord {
 		 *@brief Sets the total data member to the provided value
 		 *@param val Value to set data member to
 		 */
-		void setTotal(float val) {
+		void setTotal(Money val) {
 			total = val;
 		}//end setTotal
 		
@@ -153,14 +314,73 @@ class DataRecord {
 		 *@return The string representation of the DataRecord object
 		 */
 		string toString() {
-			return monthYear + "," + fieldToString(total) + "," + fieldToString(hardware) 
-											 + "," + fieldToString(software) + "," + fieldToString(accessories) + '\0';
+			char buf[RECORDBUFSIZE];
+			
+			//Keep the terminating NUL, as the record is sent as a C string
+			return string(buf, format(buf, sizeof(buf) ) + 1);
 		}//end DataRecord
 		
+		/**
+		 *@brief Retrieves the accessories data member
+		 *@return The value of the accessories member
+		 */
+		Money getAccessories() {
+			return accessories;
+		}//end getAccessories
+		
+		/**
+		 *@brief Retrieves the hardware data member
+		 *@return The value of the hardware member
+		 */
+		Money getHardware() {
+			return hardware;
+		}//end getHardware
+		
+		/**
+		 *@brief Retrieves the monthYear data member
+		 *@return The value of the monthYear member
+		 */
+		string_view getMonthYear() {
+			return monthYear;
+		}//end getMonthYear
+		
+		/**
+		 *@brief Retrieves the month of the monthYear data member
+		 *@return The month (0-11), or -1 if the month is not a valid 3-letter abbreviation
+		 */
+		int getMonth() {
+			return month;
+		}//end getMonth
+		
+		/**
+		 *@brief Retrieves the 2-digit year of the monthYear data member
+		 *@return The 2-digit year, or -1 if the year is missing
+		 */
+		int getYear() {
+			return year;
+		}//end getYear
+		
+		/**
+		 *@brief Retrieves the software data member
+		 *@return The value of the software member
+		 */
+		Money getSoftware() {
+			return software;
+		}//end getSoftware
+		
+		/**
+		 *@brief Retrieves the total data member
+		 *@return The value of the total member
+		 */
+		Money getTotal() {
+			return total;
+		}//end getTotal
+		
 		/**
 		 *@brief Updates the total field by summing the hardware, software, and accessories fields
 		 */
 		void updateTotal() {
 			total = accessories + software + hardware;
 		}//end updateTotal;
-};//end DataRecord 
+};//end DataRecord
+#endif
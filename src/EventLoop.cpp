@@ -0,0 +1,484 @@
+/**
+ *@file EventLoop.cpp
+ *@author Griffin Nye
+ *@brief Completion-based event loop for a pre-forked worker server, which serves many client
+ *       connections (and its own listening socket) from a single process. Receives are requested
+ *       up front and reported once data has been read into the caller's buffer. With io_uring,
+ *       the kernel performs the receives, and every wait both submits the new requests and reaps
+ *       the finished ones in a single system call. Without io_uring (old kernels, or where it is
+ *       disabled), epoll readiness followed by a non-blocking recv stands in. A socket can also be
+ *       waited on until it has room to send, and a wait can be bounded by a timeout.
+ */
+
+
+#ifndef EVENTLOOP
+#define EVENTLOOP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <map>
+#include <poll.h>
+#include <set>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+/*! Most events reported by a single wait. */
+#define MAXREADYEVENTS 64
+/*! Submission queue size of an io_uring (its completion queue is twice as large). */
+#define URINGENTRIES 1024
+
+/*! The I/O mechanisms an EventLoop can be backed by. */
+enum LOOPBACKEND {EPOLLBACKEND, URINGBACKEND};
+
+/**
+ *@brief A finished watch or receive.
+ */
+struct LoopEvent {
+	int fd;      /*!< The file descriptor the event is for. */
+	int result;  /*!< For a watched descriptor, 1 once it is readable. For a receive, the number of bytes
+	                  received, 0 if the peer disconnected, or -errno on error. For a writable wait,
+	                  1 once the socket can be sent to, or -errno on error. */
+};
+
+/**
+ *@brief Watches listening sockets for connections, receives from client sockets, and waits for client
+ *       sockets to become writable, reporting each as a LoopEvent. A client socket may have one receive
+ *       or writable wait outstanding at a time.
+ */
+class EventLoop {
+	private:
+		/*! Operation kinds, kept in the upper half of an io_uring request's user data. */
+		enum {WATCHOP = 1, RECEIVEOP = 2, WRITABLEOP = 3, TIMEOUTOP = 4};
+
+		/**
+		 *@brief A receive requested of the epoll backend, performed once the descriptor is readable.
+		 */
+		struct PendingReceive {
+			void * buf;
+			size_t len;
+		};
+
+		int backend;
+
+		//epoll backend
+		int epollfd;
+		map<int, uint32_t> interests;
+		map<int, PendingReceive> receives;
+		set<int> writables;
+
+		//io_uring backend
+		int ringfd;
+		void * sqRing,* cqRing;
+		size_t sqRingSize, cqRingSize, sqesSize;
+		struct io_uring_sqe * sqes;
+		struct io_uring_cqe * cqes;
+		unsigned * sqHead,* sqTail,* sqMask,* sqArray,* cqHead,* cqTail,* cqMask;
+		unsigned sqEntries;
+		struct __kernel_timespec timeout;
+
+		/**
+		 *@brief Creates an io_uring and maps its queues.
+		 *@return Whether the io_uring is ready for use.
+		 */
+		bool initUring() {
+			struct io_uring_params params;
+
+			memset(&params, 0, sizeof(params) );
+
+			if( (ringfd = syscall(__NR_io_uring_setup, URINGENTRIES, &params) ) == -1) {
+				return false;
+			}//end if
+
+			sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+			cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+			sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+			//Newer kernels map both rings at once
+			if(params.features & IORING_FEAT_SINGLE_MMAP) {
+				sqRingSize = cqRingSize = max(sqRingSize, cqRingSize);
+			}//end if
+
+			sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQ_RING);
+			cqRing = (params.features & IORING_FEAT_SINGLE_MMAP) ? sqRing :
+			         mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_CQ_RING);
+			sqes = (struct io_uring_sqe *) mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQES);
+
+			if(sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+				close(ringfd);
+				ringfd = -1;
+				return false;
+			}//end if
+
+			sqHead = (unsigned *) ( (char *) sqRing + params.sq_off.head);
+			sqTail = (unsigned *) ( (char *) sqRing + params.sq_off.tail);
+			sqMask = (unsigned *) ( (char *) sqRing + params.sq_off.ring_mask);
+			sqArray = (unsigned *) ( (char *) sqRing + params.sq_off.array);
+			cqHead = (unsigned *) ( (char *) cqRing + params.cq_off.head);
+			cqTail = (unsigned *) ( (char *) cqRing + params.cq_off.tail);
+			cqMask = (unsigned *) ( (char *) cqRing + params.cq_off.ring_mask);
+			cqes = (struct io_uring_cqe *) ( (char *) cqRing + params.cq_off.cqes);
+			sqEntries = params.sq_entries;
+
+			return true;
+		}//end initUring
+
+		/**
+		 *@brief Submits every queued request and optionally waits for a completion.
+		 *@param minComplete The number of completions to wait for (0 or 1).
+		 *@return The result of io_uring_enter.
+		 */
+		int enter(unsigned minComplete) {
+			int result;
+
+			//Requests the kernel has not consumed yet are resubmitted if a signal interrupts us
+			do {
+				unsigned toSubmit = *sqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+
+				result = syscall(__NR_io_uring_enter, ringfd, toSubmit, minComplete, minComplete > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+			} while(result == -1 && errno == EINTR);
+
+			return result;
+		}//end enter
+
+		/**
+		 *@brief Claims the next submission queue entry, submitting the queue first if it is full.
+		 *@param fd The file descriptor the request is for.
+		 *@param op The kind of request (WATCHOP or RECEIVEOP).
+		 *@return The cleared entry, to be filled in before the next enter.
+		 */
+		struct io_uring_sqe * nextSqe(int fd, int op) {
+			unsigned tail = *sqTail, idx;
+			struct io_uring_sqe * sqe;
+
+			if(tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) == sqEntries) {
+				enter(0);
+			}//end if
+
+			idx = tail & *sqMask;
+			sqe = &sqes[idx];
+			memset(sqe, 0, sizeof(*sqe) );
+			sqe->fd = fd;
+			sqe->user_data = ( (uint64_t) op << 32) | (uint32_t) fd;
+			sqArray[idx] = idx;
+			__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+			return sqe;
+		}//end nextSqe
+
+		/**
+		 *@brief Sets the readiness a client socket is watched for by the epoll backend, registering it if need be.
+		 *@param fd The socket's file descriptor.
+		 *@param mask The epoll events to be watched for (0 to stop watching until the next request).
+		 *@return Whether the socket is now watched for the events.
+		 */
+		bool setInterest(int fd, uint32_t mask) {
+			map<int, uint32_t>::iterator interest = interests.find(fd);
+			struct epoll_event event;
+
+			event.events = mask;
+			event.data.fd = fd;
+
+			//Sockets stay registered from their first request until forget(), and are only modified when the mask changes
+			if(interest == interests.end() ) {
+
+				if(epoll_ctl(epollfd, EPOLL_CTL_ADD, fd, &event) == -1) {
+					return false;
+				}//end if
+
+				interests[fd] = mask;
+			} else if(interest->second != mask) {
+
+				if(epoll_ctl(epollfd, EPOLL_CTL_MOD, fd, &event) == -1) {
+					return false;
+				}//end if
+
+				interest->second = mask;
+			}//end if
+
+			return true;
+		}//end setInterest
+
+		/**
+		 *@brief Waits for events using io_uring.
+		 *@param events Receives up to MAXREADYEVENTS events.
+		 *@param timeoutUsec The most microseconds to wait for, or -1 to wait until there is an event.
+		 *@return The number of events (0 if the timeout expired first), or -1 on error.
+		 */
+		int waitUring(LoopEvent events[], long timeoutUsec) {
+			unsigned head = *cqHead, tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+			int numEvents = 0;
+
+			//One system call both submits the new requests and, if nothing has finished yet, waits
+			if(head == tail) {
+
+				//A timeout is one more request, whose completion ends the wait
+				if(timeoutUsec >= 0) {
+					struct io_uring_sqe * sqe = nextSqe(-1, TIMEOUTOP);
+
+					timeout.tv_sec = timeoutUsec / 1000000;
+					timeout.tv_nsec = timeoutUsec % 1000000 * 1000;
+					sqe->opcode = IORING_OP_TIMEOUT;
+					sqe->addr = (uint64_t) &timeout;
+					sqe->len = 1;
+				}//end if
+
+				if(enter(1) == -1) {
+					return -1;
+				}//end if
+
+				tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+			} else if(*sqTail != __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) && enter(0) == -1) {
+				return -1;
+			}//end if
+
+			for(; head != tail && numEvents < MAXREADYEVENTS; head++) {
+				struct io_uring_cqe * cqe = &cqes[head & *cqMask];
+				int fd = (uint32_t) cqe->user_data;
+
+				if(cqe->user_data >> 32 == TIMEOUTOP) {
+					continue;
+				} else if(cqe->user_data >> 32 == WATCHOP) {
+
+					//A multishot poll that stops (e.g. on overflow) is simply re-armed
+					if( !(cqe->flags & IORING_CQE_F_MORE) ) {
+						watch(fd);
+					}//end if
+
+					if(cqe->res > 0) {
+						events[numEvents++] = {fd, 1};
+					}//end if
+
+				} else if(cqe->user_data >> 32 == WRITABLEOP) {
+					events[numEvents++] = {fd, cqe->res > 0 ? 1 : cqe->res};
+				} else {
+					events[numEvents++] = {fd, cqe->res};
+				}//end if
+
+			}//end for
+
+			__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+
+			return numEvents;
+		}//end waitUring
+
+		/**
+		 *@brief Waits for events using epoll, performing each requested receive once its descriptor is readable.
+		 *@param events Receives up to MAXREADYEVENTS events.
+		 *@param timeoutUsec The most microseconds to wait for, or -1 to wait until there is an event.
+		 *@return The number of events (0 if the timeout expired first), or -1 on error.
+		 */
+		int waitEpoll(LoopEvent events[], long timeoutUsec) {
+			struct epoll_event ready[MAXREADYEVENTS];
+			struct timespec limit = {timeoutUsec / 1000000, timeoutUsec % 1000000 * 1000};
+			int numReady, numEvents = 0;
+
+			//A bounded wait makes a single pass, even if every readiness turns out to be spurious
+			do {
+
+				if(timeoutUsec < 0) {
+					numReady = epoll_wait(epollfd, ready, MAXREADYEVENTS, -1);
+				} else if( (numReady = epoll_pwait2(epollfd, ready, MAXREADYEVENTS, &limit, NULL) ) == -1 && errno == ENOSYS) {
+					numReady = epoll_wait(epollfd, ready, MAXREADYEVENTS, (timeoutUsec + 999) / 1000);
+				}//end if
+
+				if(numReady == -1) {
+					if(errno == EINTR) {
+						continue;
+					}//end if
+
+					return -1;
+				}//end if
+
+				for(int i = 0; i < numReady; i++) {
+					int fd = ready[i].data.fd;
+					map<int, PendingReceive>::iterator pending = receives.find(fd);
+					ssize_t numRead;
+
+					if(interests.count(fd) == 0) {
+						events[numEvents++] = {fd, 1};
+					} else if(pending != receives.end() ) {
+
+						//Readiness can be spurious, in which case the receive stays pending
+						if( (numRead = recv(fd, pending->second.buf, pending->second.len, MSG_DONTWAIT) ) == -1 &&
+						    (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ) {
+							continue;
+						}//end if
+
+						events[numEvents++] = {fd, numRead == -1 ? -errno : (int) numRead};
+						receives.erase(pending);
+					} else if(writables.erase(fd) > 0) {
+						events[numEvents++] = {fd, 1};
+					} else {
+
+						//Nothing is requested of the socket (its request is busy elsewhere), so stop it waking us
+						setInterest(fd, 0);
+					}//end if
+
+				}//end for
+
+			} while(numEvents == 0 && timeoutUsec < 0);
+
+			return numEvents;
+		}//end waitEpoll
+
+	public:
+
+		/**
+		 *@brief Constructs the EventLoop. Nothing is watched until init() succeeds.
+		 */
+		EventLoop() {
+			backend = EPOLLBACKEND;
+			epollfd = ringfd = -1;
+		}//end constructor
+
+		/**
+		 *@brief Closes the EventLoop.
+		 */
+		~EventLoop() {
+			if(epollfd != -1) {
+				close(epollfd);
+			}//end if
+
+			if(ringfd != -1) {
+				munmap(sqes, sqesSize);
+
+				if(cqRing != sqRing) {
+					munmap(cqRing, cqRingSize);
+				}//end if
+
+				munmap(sqRing, sqRingSize);
+				close(ringfd);
+			}//end if
+		}//end destructor
+
+		/**
+		 *@brief Creates the io_uring or epoll instance.
+		 *@param useUring Whether to use io_uring if the kernel allows it (epoll is used otherwise).
+		 *@return Whether the EventLoop is ready for use.
+		 */
+		bool init(bool useUring) {
+			if(useUring && initUring() ) {
+				backend = URINGBACKEND;
+				return true;
+			}//end if
+
+			backend = EPOLLBACKEND;
+
+			return (epollfd = epoll_create1(EPOLL_CLOEXEC) ) != -1;
+		}//end init
+
+		/**
+		 *@brief Retrieves the mechanism the EventLoop was created with.
+		 *@return The LOOPBACKEND.
+		 */
+		int getBackend() {
+			return backend;
+		}//end getBackend
+
+		/**
+		 *@brief Reports an event each time a listening socket (or any descriptor) becomes readable.
+		 *@param fd The file descriptor.
+		 *@return Whether the file descriptor is now watched.
+		 */
+		bool watch(int fd) {
+			struct epoll_event event;
+
+			if(backend == URINGBACKEND) {
+				struct io_uring_sqe * sqe = nextSqe(fd, WATCHOP);
+
+				sqe->opcode = IORING_OP_POLL_ADD;
+				sqe->poll32_events = POLLIN;
+				sqe->len = IORING_POLL_ADD_MULTI;
+
+				return true;
+			}//end if
+
+			event.events = EPOLLIN;
+			event.data.fd = fd;
+
+			return epoll_ctl(epollfd, EPOLL_CTL_ADD, fd, &event) == 0;
+		}//end watch
+
+		/**
+		 *@brief Requests that whatever next arrives on a socket, up to a length, be received into a buffer.
+		 *       The buffer must remain valid until the receive's event is reported.
+		 *@param fd The socket's file descriptor.
+		 *@param buf The buffer.
+		 *@param len The most bytes to be received.
+		 *@return Whether the receive was requested.
+		 */
+		bool receive(int fd, void * buf, size_t len) {
+			if(backend == URINGBACKEND) {
+				struct io_uring_sqe * sqe = nextSqe(fd, RECEIVEOP);
+
+				sqe->opcode = IORING_OP_RECV;
+				sqe->addr = (uint64_t) buf;
+				sqe->len = len;
+
+				return true;
+			}//end if
+
+			if( !setInterest(fd, EPOLLIN | EPOLLRDHUP) ) {
+				return false;
+			}//end if
+
+			receives[fd] = {buf, len};
+
+			return true;
+		}//end receive
+
+		/**
+		 *@brief Requests an event once a socket has room for more data to be sent.
+		 *@param fd The socket's file descriptor.
+		 *@return Whether the wait was requested.
+		 */
+		bool writable(int fd) {
+			if(backend == URINGBACKEND) {
+				struct io_uring_sqe * sqe = nextSqe(fd, WRITABLEOP);
+
+				sqe->opcode = IORING_OP_POLL_ADD;
+				sqe->poll32_events = POLLOUT;
+
+				return true;
+			}//end if
+
+			if( !setInterest(fd, EPOLLOUT) ) {
+				return false;
+			}//end if
+
+			writables.insert(fd);
+
+			return true;
+		}//end writable
+
+		/**
+		 *@brief Stops tracking a socket that has no receive or writable wait outstanding, before it is closed.
+		 *@param fd The socket's file descriptor.
+		 */
+		void forget(int fd) {
+			if(backend == EPOLLBACKEND && interests.erase(fd) > 0) {
+				epoll_ctl(epollfd, EPOLL_CTL_DEL, fd, NULL);
+				receives.erase(fd);
+				writables.erase(fd);
+			}//end if
+		}//end forget
+
+		/**
+		 *@brief Waits until at least one watch, receive, or writable wait has an event.
+		 *@param events Receives up to MAXREADYEVENTS events.
+		 *@param timeoutUsec The most microseconds to wait for, or -1 (the default) to wait until there is an event.
+		 *@return The number of events (0 if the timeout expired first), or -1 on error.
+		 */
+		int wait(LoopEvent events[], long timeoutUsec = -1) {
+			return backend == URINGBACKEND ? waitUring(events, timeoutUsec) : waitEpoll(events, timeoutUsec);
+		}//end wait
+
+};//end EventLoop
+#endif
@@ -0,0 +1,122 @@
+/**
+ *@file HashRing.cpp
+ *@author Griffin Nye
+ *@brief Consistent hash ring assigning record indexes to the nodes of a cluster. Every node
+ *       is placed on the ring at many pseudo-random points (virtual nodes) and owns the
+ *       indexes hashing between its points and the points before them, so adding a node
+ *       takes over an even share of every other node's records and moves nothing else.
+ */
+
+
+#ifndef HASHRING
+#define HASHRING
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*! Number of points each node is placed at on the ring (more points spread the records more evenly). */
+#define RINGPOINTS 128
+
+/**
+ *@brief Maps record indexes onto the nodes of a cluster by consistent hashing.
+ */
+class HashRing {
+	private:
+		map<uint64_t, int> points;
+		vector<string> nodes;
+
+		/**
+		 *@brief Scrambles a 64-bit value (the splitmix64 finalizer), so neighbouring values land far apart on the ring.
+		 *@param x The value to be scrambled.
+		 *@return The scrambled value.
+		 */
+		static uint64_t mix(uint64_t x) {
+			x ^= x >> 30;
+			x *= 0xbf58476d1ce4e5b9ULL;
+			x ^= x >> 27;
+			x *= 0x94d049bb133111ebULL;
+			x ^= x >> 31;
+
+			return x;
+		}//end mix
+
+		/**
+		 *@brief Hashes a string (64-bit FNV-1a, then scrambled).
+		 *@param text The string to be hashed.
+		 *@return The string's position on the ring.
+		 */
+		static uint64_t hash(const string &text) {
+			uint64_t h = 0xcbf29ce484222325ULL;
+
+			for(size_t i = 0; i < text.size(); i++) {
+				h = (h ^ (unsigned char) text[i]) * 0x100000001b3ULL;
+			}//end for
+
+			return mix(h);
+		}//end hash
+
+	public:
+
+		/**
+		 *@brief Places a node on the ring. A node's points follow from its name alone, so every
+		 *       router given the same nodes builds the same ring, whatever order they are listed in.
+		 *@param name The node's name (its "host:port").
+		 *@return The node's number, in the order nodes were added.
+		 */
+		int addNode(string name) {
+			int node = nodes.size();
+
+			nodes.push_back(name);
+
+			for(int v = 0; v < RINGPOINTS; v++) {
+				points[ hash(name + "#" + to_string(v) ) ] = node;
+			}//end for
+
+			return node;
+		}//end addNode
+
+		/**
+		 *@brief Retrieves the node owning a record: the node of the first point at or after the record's hash.
+		 *@param idx The record's 1-based index.
+		 *@return The owning node's number, or -1 if the ring is empty.
+		 */
+		int ownerOf(int idx) {
+			map<uint64_t, int>::iterator point;
+
+			if(points.empty() ) {
+				return -1;
+			}//end if
+
+			point = points.lower_bound( mix( (uint64_t) idx) );
+
+			//The ring wraps around past its last point
+			if(point == points.end() ) {
+				point = points.begin();
+			}//end if
+
+			return point->second;
+		}//end ownerOf
+
+		/**
+		 *@brief Retrieves the number of nodes on the ring.
+		 *@return The number of nodes.
+		 */
+		int getNumNodes() {
+			return nodes.size();
+		}//end getNumNodes
+
+		/**
+		 *@brief Retrieves a node's name.
+		 *@param node The node's number.
+		 *@return The node's name.
+		 */
+		string getNode(int node) {
+			return nodes[node];
+		}//end getNode
+
+};//end HashRing
+#endif
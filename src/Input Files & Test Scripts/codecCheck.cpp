@@ -0,0 +1,231 @@
+/**
+ * @file codecCheck.cpp
+ * @author Griffin Nye
+ * @brief Regression checks for LzCodec: blocks that must survive a round trip (empty, short,
+ *        incompressible, overlapping matches, long lengths, matches at the edge of the window,
+ *        and record traffic), and truncated or corrupt blocks that must be rejected without
+ *        writing past the output buffer. Each failing check is printed, and the program exits
+ *        with EXIT_FAILURE if any failed.
+ *        USAGE: ./codecCheck
+ */
+
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../LzCodec.cpp"
+#include "../msgPackets.cpp"
+
+using namespace std;
+
+/*! Bytes past the end of every output buffer that decompress must leave untouched. */
+#define GUARDSIZE 64
+/*! Value the guard bytes are filled with. */
+#define GUARDBYTE 0x5A
+/*! Number of random single-byte corruptions tried on each round-tripped block. */
+#define CORRUPTIONS 2000
+
+/*! Number of checks run so far. */
+int numChecks = 0;
+/*! Number of checks that failed. */
+int numFailed = 0;
+
+/**
+ *@brief Counts a check, printing it if it failed.
+ *@param passed Whether the check passed.
+ *@param name The name of the check.
+ *@param detail What was checked.
+ */
+void check(bool passed, const string &name, const char * detail);
+
+/**
+ *@brief Decompresses a block into a buffer followed by guard bytes.
+ *@param packed The compressed block.
+ *@param packedSize The size of the compressed block.
+ *@param rawSize The size the block is expected to decompress to.
+ *@param out Receives the decompressed block.
+ *@param guardIntact Set to whether the guard bytes were left untouched.
+ *@return Whether decompress accepted the block.
+ */
+bool guardedDecompress(const char packed[], int packedSize, int rawSize, vector<char> &out, bool &guardIntact);
+
+/**
+ *@brief Fills a block with bytes that do not repeat.
+ *@param size The size of the block.
+ *@param rng The random generator.
+ *@return The block.
+ */
+vector<char> randomBlock(int size, mt19937 &rng);
+
+/**
+ *@brief Round-trips a block, then checks that every truncation and random corruptions of it are handled.
+ *@param name The name of the block.
+ *@param raw The block.
+ *@param rng The random generator.
+ */
+void roundTrip(const string &name, const vector<char> &raw, mt19937 &rng);
+
+/**
+ *@brief Runs every codec check.
+ *@return EXIT_SUCCESS if every check passed, else EXIT_FAILURE.
+ */
+int main() {
+	mt19937 rng(552);
+	vector<char> raw;
+
+	//Blocks too short to hold a match
+	roundTrip("empty", vector<char>(), rng);
+	roundTrip("one byte", vector<char>(1, 'x'), rng);
+	roundTrip("below minimum match", vector<char>(LZMINMATCH + LZENDLITERALS - 1, 'x'), rng);
+
+	//Incompressible data may only grow by the documented bound
+	roundTrip("random 1 KB", randomBlock(1024, rng), rng);
+	roundTrip("random frame", randomBlock(COMPRESSFRAMESIZE, rng), rng);
+
+	//Matches overlapping the bytes they produce (offsets shorter than the match)
+	roundTrip("run of one byte", vector<char>(100000, 'a'), rng);
+	raw.clear();
+
+	for(int i = 0; i < 100000; i++) {
+		raw.push_back("abc"[i % 3]);
+	}//end for
+
+	roundTrip("period 3", raw, rng);
+
+	//Literal and match lengths that need continuation bytes (15, 15 + 255, and beyond)
+	for(int literals : {14, 15, 16, 269, 270, 271, 1000}) {
+		vector<char> literalRun = randomBlock(literals, rng);
+
+		raw = literalRun;
+		raw.insert(raw.end(), 300, 'z');
+		raw.insert(raw.end(), literalRun.begin(), literalRun.end() );
+		roundTrip("literals " + to_string(literals), raw, rng);
+	}//end for
+
+	//Repeats exactly at, and just past, the largest offset a match can reach
+	for(int distance : {LZMAXOFFSET, LZMAXOFFSET + 1}) {
+		raw = randomBlock(distance, rng);
+		raw.resize(distance + 64);
+		copy(raw.begin(), raw.begin() + 64, raw.begin() + distance);
+		roundTrip("repeat at offset " + to_string(distance), raw, rng);
+	}//end for
+
+	//Record traffic, as the server sends it
+	raw.clear();
+
+	for(int i = 0; i < 2000; i++) {
+		char record[MAXRECORDSIZE + 1];
+
+		snprintf(record, sizeof(record), "Jul '%02i,%i.%02i,1.20,2.43,0.13", i % 100, i % 7, i % 100);
+		recMsgPacket packet(10000 + i, "GET", record);
+		raw.insert(raw.end(), (char *) &packet, (char *) &packet + sizeof(packet) );
+	}//end for
+
+	roundTrip("record packets", raw, rng);
+
+	//Hand-made blocks that are malformed
+	{
+		const char LONGRUNOFF[] = {(char) 0xF0, (char) 255, (char) 255};
+		const char NOOFFSET[] = {0x40, 'a', 'b', 'c', 'd', 0};
+		const char ZEROOFFSET[] = {0x40, 'a', 'b', 'c', 'd', 0, 0};
+		const char FAROFFSET[] = {0x40, 'a', 'b', 'c', 'd', 5, 0};
+		const char LONGMATCH[] = {0x4F, 'a', 'b', 'c', 'd', 1, 0, 100};
+		vector<char> out;
+		bool guardIntact;
+
+		check(!guardedDecompress(LONGRUNOFF, sizeof(LONGRUNOFF), 1000, out, guardIntact) && guardIntact, "corrupt", "literal length past the end");
+		check(!guardedDecompress(NOOFFSET, sizeof(NOOFFSET), 8, out, guardIntact) && guardIntact, "corrupt", "half an offset");
+		check(!guardedDecompress(ZEROOFFSET, sizeof(ZEROOFFSET), 8, out, guardIntact) && guardIntact, "corrupt", "offset of zero");
+		check(!guardedDecompress(FAROFFSET, sizeof(FAROFFSET), 8, out, guardIntact) && guardIntact, "corrupt", "offset before the block");
+		check(!guardedDecompress(LONGMATCH, sizeof(LONGMATCH), 64, out, guardIntact) && guardIntact, "corrupt", "match past rawSize");
+		check(guardedDecompress(LONGMATCH, sizeof(LONGMATCH), 4 + 115 + LZMINMATCH, out, guardIntact) && guardIntact &&
+		      out[3 + 115 + LZMINMATCH] == 'd', "corrupt", "same match within rawSize");
+	}
+
+	printf("%i of %i codec checks passed\n", numChecks - numFailed, numChecks);
+
+	return (numFailed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}//end main
+
+//Counts a check, printing it if it failed.
+void check(bool passed, const string &name, const char * detail) {
+	numChecks++;
+
+	if(!passed) {
+		printf("FAILED %s: %s\n", name.c_str(), detail);
+		numFailed++;
+	}//end if
+
+}//end check
+
+//Decompresses a block into a buffer followed by guard bytes.
+bool guardedDecompress(const char packed[], int packedSize, int rawSize, vector<char> &out, bool &guardIntact) {
+	bool accepted;
+
+	out.assign(rawSize + GUARDSIZE, GUARDBYTE);
+	accepted = LzCodec::decompress(packed, packedSize, &out[0], rawSize);
+	guardIntact = true;
+
+	for(int i = rawSize; i < rawSize + GUARDSIZE; i++) {
+		guardIntact = guardIntact && out[i] == GUARDBYTE;
+	}//end for
+
+	out.resize(rawSize);
+
+	return accepted;
+}//end guardedDecompress
+
+//Fills a block with bytes that do not repeat.
+vector<char> randomBlock(int size, mt19937 &rng) {
+	vector<char> block(size);
+
+	for(int i = 0; i < size; i++) {
+		block[i] = (char) rng();
+	}//end for
+
+	return block;
+}//end randomBlock
+
+//Round-trips a block, then checks that every truncation and random corruptions of it are handled.
+void roundTrip(const string &name, const vector<char> &raw, mt19937 &rng) {
+	int rawSize = raw.size();
+	vector<char> packed(LzCodec::maxPackedSize(rawSize) + GUARDSIZE, GUARDBYTE), out;
+	int packedSize = LzCodec::compress(raw.empty() ? "" : raw.data(), rawSize, &packed[0]);
+	bool guardIntact, allRejected = true, allGuarded = true;
+
+	check(packedSize <= LzCodec::maxPackedSize(rawSize) && packed[LzCodec::maxPackedSize(rawSize)] == (char) GUARDBYTE,
+	      name, "compressed within maxPackedSize");
+	check(guardedDecompress(&packed[0], packedSize, rawSize, out, guardIntact) && guardIntact && out == raw,
+	      name, "round trip");
+
+	if(rawSize > 0) {
+		check(!guardedDecompress(&packed[0], packedSize, rawSize - 1, out, guardIntact) && guardIntact, name, "rawSize too small");
+	}//end if
+
+	check(!guardedDecompress(&packed[0], packedSize, rawSize + 1, out, guardIntact) && guardIntact, name, "rawSize too large");
+
+	//Every truncation loses output, so none may be accepted (long blocks are cut at a sample of lengths)
+	for(int cut = packedSize - 1; rawSize > 0 && cut >= 0; cut -= (packedSize > 4096) ? 1 + cut / 64 : 1) {
+		allRejected = allRejected && !guardedDecompress(&packed[0], cut, rawSize, out, guardIntact);
+		allGuarded = allGuarded && guardIntact;
+	}//end for
+
+	check(allRejected && allGuarded, name, "truncations rejected");
+	allGuarded = true;
+
+	//A corrupt block may decode to other bytes, but never past the output buffer
+	for(int i = 0; i < CORRUPTIONS && packedSize > 0; i++) {
+		vector<char> corrupt(packed.begin(), packed.begin() + packedSize);
+
+		corrupt[ uniform_int_distribution<int>(0, packedSize - 1)(rng) ] ^= (char) (1 + rng() % 255);
+		guardedDecompress(corrupt.data(), packedSize, rawSize, out, guardIntact);
+		allGuarded = allGuarded && guardIntact;
+	}//end for
+
+	check(allGuarded, name, "corruptions stay within the block");
+}//end roundTrip
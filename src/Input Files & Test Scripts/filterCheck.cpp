@@ -0,0 +1,125 @@
+/**
+ * @file filterCheck.cpp
+ * @author Griffin Nye
+ * @brief Regression checks for RecordFilter: operator precedence, expressions that must be
+ *        rejected, and exact comparisons of revenue amounts at their boundaries. Each failing
+ *        check is printed, and the program exits with EXIT_FAILURE if any failed.
+ *        USAGE: ./filterCheck
+ */
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "../RecordFilter.cpp"
+
+using namespace std;
+
+/*! Record every match check is run against (index 7 of the dataset). */
+#define CHECKRECORD "Jul '19,3.76,1.20,2.43,0.13"
+/*! Index of the checked record. */
+#define CHECKINDEX 7
+
+/**
+ *@brief A filter expression and what compiling it, then matching it against CHECKRECORD, should give.
+ */
+struct filterCase {
+	const char * expr;
+	bool compiles;
+	bool matches;
+};
+
+/**
+ *@brief Compiles each case's expression and matches it against the provided record.
+ *@param cases The cases to be checked.
+ *@param numCases The number of cases.
+ *@param record The record the compiled expressions are matched against.
+ *@return The number of cases that failed.
+ */
+int checkCases(const filterCase cases[], int numCases, DataRecord &record);
+
+/**
+ *@brief Runs every filter check.
+ *@return EXIT_SUCCESS if every check passed, else EXIT_FAILURE.
+ */
+int main() {
+	const filterCase CASES[] = {
+		//AND binds tighter than OR, NOT tighter than both, and parentheses override either
+		{"total > 3 OR hardware > 5 AND software > 5", true, true},
+		{"(total > 3 OR hardware > 5) AND software > 5", true, false},
+		{"total > 3 || hardware > 5 && software > 5", true, true},
+		{"NOT year = 19 OR total > 3", true, true},
+		{"NOT (year = 19 OR total > 3)", true, false},
+		{"! ! year = 19", true, true},
+		{"month = jul AND year = 2019 AND index = 7", true, true},
+		{"month = 7 && year == '19", true, true},
+		{"month = Aug OR index <> 7", true, false},
+
+		//Malformed expressions compile to nothing
+		{"", false, false},
+		{"total >", false, false},
+		{"total > 3 AND", false, false},
+		{"(total > 3", false, false},
+		{"total > 3)", false, false},
+		{"total >> 3", false, false},
+		{"total > 3 3", false, false},
+		{"revenue = 3", false, false},
+		{"total = abc", false, false},
+		{"total = 3.7.6", false, false},
+		{"month = Foo", false, false},
+		{"index = 7x", false, false},
+		{"NOT", false, false},
+		{"()", false, false},
+
+		//Amounts are exact to the cent, with extra digits rounded half away from zero
+		{"total = 3.76", true, true},
+		{"total = 3.760", true, true},
+		{"total = 3.755", true, true},
+		{"total = 3.7549", true, false},
+		{"total = 3.7649", true, true},
+		{"total = 3.765", true, false},
+		{"total > 3.76", true, false},
+		{"total >= 3.76", true, true},
+		{"total < 3.76", true, false},
+		{"total <= 3.76", true, true},
+		{"total != 3.76", true, false},
+		{"total > 3.75 AND total < 3.77", true, true},
+		{"accessories = .13", true, true},
+		{"software = 2.43 AND hardware = 1.2", true, true},
+		{"hardware > -1.20", true, true}
+	};
+	const int NUMCASES = sizeof(CASES) / sizeof(CASES[0]);
+	DataRecord record;
+	int failed;
+
+	if( !record.parse(CHECKRECORD, CHECKINDEX) ) {
+		printf("Could not parse the checked record \"%s\"\n", CHECKRECORD);
+		return EXIT_FAILURE;
+	}//end if
+
+	failed = checkCases(CASES, NUMCASES, record);
+	printf("%i of %i filter checks passed\n", NUMCASES - failed, NUMCASES);
+
+	return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}//end main
+
+//Compiles each case's expression and matches it against the provided record.
+int checkCases(const filterCase cases[], int numCases, DataRecord &record) {
+	int failed = 0;
+
+	for(int i = 0; i < numCases; i++) {
+		RecordFilter filter;
+		bool compiled = filter.compile(cases[i].expr);
+		bool matched = filter.matches(record, CHECKINDEX);
+
+		if(compiled != cases[i].compiles || matched != cases[i].matches) {
+			printf("FAILED \"%s\": compiled %i (expected %i), matched %i (expected %i) %s\n", cases[i].expr,
+			       compiled, cases[i].compiles, matched, cases[i].matches, filter.getError().c_str() );
+			failed++;
+		}//end if
+
+	}//end for
+
+	return failed;
+}//end checkCases
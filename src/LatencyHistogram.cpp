@@ -0,0 +1,216 @@
+/**
+ *@file LatencyHistogram.cpp
+ *@author Griffin Nye
+ *@brief Fixed-size log-linear (HDR-style) histogram of latencies. Each power of two is
+ *       split into equal sub-buckets, so every recorded value keeps ~1% precision from
+ *       nanoseconds up to minutes while recording stays O(1) with no allocation.
+ */
+
+
+#ifndef LATENCYHISTOGRAM
+#define LATENCYHISTOGRAM
+
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+/*! Number of bits of precision kept for every value (128 sub-buckets per power of two). */
+#define HISTSUBBITS 7
+/*! Largest power of two that can be recorded; larger values are clamped. */
+#define HISTMAXBITS 40
+/*! Number of buckets needed to cover values up to 2^HISTMAXBITS. */
+#define HISTNUMBUCKETS ( (HISTMAXBITS - HISTSUBBITS + 2) << (HISTSUBBITS - 1) )
+
+/**
+ *@brief Records values (e.g. nanoseconds) into log-linear buckets and reports percentiles.
+ *
+ * The histogram holds no pointers, so it may be placed in shared memory or copied as a whole.
+ */
+class LatencyHistogram {
+	private:
+		uint64_t counts[HISTNUMBUCKETS];
+		uint64_t totalCount;
+		uint64_t maxValue;
+		uint64_t sum;
+
+		/**
+		 *@brief Finds the bucket of a value.
+		 *@param value The value to be bucketed.
+		 *@return The index of the value's bucket.
+		 */
+		static int bucketOf(uint64_t value) {
+			int shift;
+
+			if(value < (1ULL << HISTSUBBITS) ) {
+				return value;
+			}//end if
+
+			if(value >= (1ULL << HISTMAXBITS) ) {
+				value = (1ULL << HISTMAXBITS) - 1;
+			}//end if
+
+			//Keep the top HISTSUBBITS bits of the value
+			shift = (63 - __builtin_clzll(value) ) - (HISTSUBBITS - 1);
+
+			return (shift << (HISTSUBBITS - 1) ) + (value >> shift);
+		}//end bucketOf
+
+		/**
+		 *@brief Finds the largest value that falls into a bucket.
+		 *@param bucket The index of the bucket.
+		 *@return The bucket's highest value.
+		 */
+		static uint64_t highestValueOf(int bucket) {
+			int shift;
+
+			if(bucket < (1 << HISTSUBBITS) ) {
+				return bucket;
+			}//end if
+
+			shift = (bucket >> (HISTSUBBITS - 1) ) - 1;
+
+			return ( (uint64_t) (bucket - (shift << (HISTSUBBITS - 1) ) ) << shift) + (1ULL << shift) - 1;
+		}//end highestValueOf
+
+	public:
+
+		/**
+		 *@brief Constructs an empty histogram.
+		 */
+		LatencyHistogram() {
+			reset();
+		}//end constructor
+
+		/**
+		 *@brief Empties the histogram.
+		 */
+		void reset() {
+			memset(this, 0, sizeof(*this) );
+		}//end reset
+
+		/**
+		 *@brief Records a single value.
+		 *@param value The value to be recorded.
+		 */
+		void record(uint64_t value) {
+			counts[bucketOf(value)]++;
+			totalCount++;
+			sum += value;
+
+			if(value > maxValue) {
+				maxValue = value;
+			}//end if
+
+		}//end record
+
+		/**
+		 *@brief Records a single value with atomic updates, so a histogram in shared memory may be
+		 *       recorded into by many processes at once without a lock.
+		 *@param value The value to be recorded.
+		 */
+		void recordShared(uint64_t value) {
+			uint64_t seenMax = __atomic_load_n(&maxValue, __ATOMIC_RELAXED);
+
+			__atomic_fetch_add(&counts[bucketOf(value)], 1, __ATOMIC_RELAXED);
+			__atomic_fetch_add(&totalCount, 1, __ATOMIC_RELAXED);
+			__atomic_fetch_add(&sum, value, __ATOMIC_RELAXED);
+
+			//Raise the maximum unless another process has already raised it further
+			while(value > seenMax && !__atomic_compare_exchange_n(&maxValue, &seenMax, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED) ) {
+			}//end while
+
+		}//end recordShared
+
+		/**
+		 *@brief Adds every value recorded by another histogram to this one.
+		 *@param other The histogram to be merged in.
+		 */
+		void merge(const LatencyHistogram &other) {
+			for(int i = 0; i < HISTNUMBUCKETS; i++) {
+				counts[i] += other.counts[i];
+			}//end for
+
+			totalCount += other.totalCount;
+			sum += other.sum;
+
+			if(other.maxValue > maxValue) {
+				maxValue = other.maxValue;
+			}//end if
+
+		}//end merge
+
+		/**
+		 *@brief Retrieves the number of values recorded.
+		 *@return The number of values recorded.
+		 */
+		uint64_t getCount() const {
+			return totalCount;
+		}//end getCount
+
+		/**
+		 *@brief Retrieves the largest value recorded.
+		 *@return The largest value recorded.
+		 */
+		uint64_t getMax() const {
+			return maxValue;
+		}//end getMax
+
+		/**
+		 *@brief Retrieves the sum of the values recorded.
+		 *@return The sum of the values recorded.
+		 */
+		uint64_t getSum() const {
+			return sum;
+		}//end getSum
+
+		/**
+		 *@brief Retrieves the number of values recorded at or below a bound (to within the bucket precision).
+		 *@param bound The upper bound.
+		 *@return The number of values in buckets no higher than the bound's bucket.
+		 */
+		uint64_t getCountAtOrBelow(uint64_t bound) const {
+			uint64_t seen = 0;
+			int last = bucketOf(bound);
+
+			for(int i = 0; i <= last; i++) {
+				seen += counts[i];
+			}//end for
+
+			return seen;
+		}//end getCountAtOrBelow
+
+		/**
+		 *@brief Retrieves the mean of the values recorded.
+		 *@return The mean value, or 0 if no values were recorded.
+		 */
+		double getMean() const {
+			return totalCount == 0 ? 0 : (double) sum / totalCount;
+		}//end getMean
+
+		/**
+		 *@brief Retrieves the value at or below which the provided percentage of values fall.
+		 *@param percentile The percentile (0-100).
+		 *@return The percentile's value (to within the bucket precision), or 0 if no values were recorded.
+		 */
+		uint64_t getPercentile(double percentile) const {
+			uint64_t target = (uint64_t) (percentile / 100.0 * totalCount + 0.5), seen = 0;
+
+			if(target == 0) {
+				target = 1;
+			}//end if
+
+			for(int i = 0; i < HISTNUMBUCKETS; i++) {
+				seen += counts[i];
+
+				if(seen >= target) {
+					return highestValueOf(i) < maxValue ? highestValueOf(i) : maxValue;
+				}//end if
+
+			}//end for
+
+			return maxValue;
+		}//end getPercentile
+
+};//end LatencyHistogram
+#endif
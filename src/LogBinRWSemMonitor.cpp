@@ -4,13 +4,17 @@
  *@brief Implementation of a Monitors for the Readers-Writers problem using semaphores 
          Uses strong writers preference while allowing concurrent reader access 
 				 for the bin file and weak readers preference while allowing concurrent 
-				 reader access for the log file.
+				 reader access for the log file. Every operation that may wait is a Task,
+				 which suspends the calling handler rather than blocking inside a worker.
  */
 
 #ifndef LOGBINRWSEMMONITOR	
 #define LOGBINRWSEMMONITOR
 
+#include "Coroutine.cpp"
 #include "SemaphoreSet.cpp"
+#include "ServerStats.cpp"
+#include "TraceBuffer.cpp"
 #include <unistd.h>
 
 using namespace std;
@@ -24,6 +28,47 @@ class LogBinRWSemMonitor {
 		          BINWRITERCOUNTMUTEX = 4, BINWRITERMUTEX = 5, NOBINREADERS = 6, 
 							NOBINWRITERS = 7, NUMBINREADERS = 8, NUMBINWRITERS = 9;
 		SemaphoreSet semSet; 
+		ServerStats * stats;
+		TraceBuffer * tracer;
+		
+		/**
+		 *@brief Marks the start of a wait to acquire a monitor.
+		 *@param wait The acquire's STATWAIT.
+		 *@return The time the wait began, to be passed to waitGranted.
+		 */
+		uint64_t waitBegun(int wait) {
+			if(tracer != NULL) {
+				tracer->begin(TRACEWAIT, wait);
+			}//end if
+			
+			return (stats == NULL) ? 0 : stats->now();
+		}//end waitBegun
+		
+		/**
+		 *@brief Marks the end of a wait to acquire a monitor.
+		 *@param wait The acquire's STATWAIT.
+		 *@param start The time the wait began, as returned by waitBegun.
+		 */
+		void waitGranted(int wait, uint64_t start) {
+			if(stats != NULL) {
+				stats->recordWait(wait, start);
+			}//end if
+			
+			if(tracer != NULL) {
+				tracer->end(TRACEWAIT, wait);
+			}//end if
+		}//end waitGranted
+		
+		/**
+		 *@brief Builds an awaitable wait on a single semaphore.
+		 *@param semNum The semaphore to wait on.
+		 *@return The awaitable wait.
+		 */
+		SemaphoreAcquire acquire(unsigned short semNum) {
+			struct sembuf op = {semNum, -1, 0};
+			
+			return SemaphoreAcquire(semSet, &op, 1);
+		}//end acquire
 		
 	public:
 		
@@ -33,8 +78,26 @@ class LogBinRWSemMonitor {
 		 */
 		LogBinRWSemMonitor(int semKey) {
 			semSet = SemaphoreSet(semKey, 10, IPC_CREAT | 0777);
+			stats = NULL;
+			tracer = NULL;
 		}//end LogBinMonitor
 		
+		/**
+		 *@brief Sets where the time spent waiting in each acquire is recorded.
+		 *@param stats The server statistics, or NULL to stop recording.
+		 */
+		void setStats(ServerStats * stats) {
+			this->stats = stats;
+		}//end setStats
+		
+		/**
+		 *@brief Sets where the start and end of the wait in each acquire is traced.
+		 *@param tracer The process's trace, or NULL to stop tracing.
+		 */
+		void setTracer(TraceBuffer * tracer) {
+			this->tracer = tracer;
+		}//end setTracer
+		
 		/**
 		 *@brief Initializes all semaphores in semSet to their default values.
 		 */
@@ -52,110 +115,58 @@ class LogBinRWSemMonitor {
 		/**
 		 *@brief Performs the necessary synchronization to add a bin Reader and prepare it for reading from a critical section.
 		 */
-		void addBinReader() {
-			//cout << "Reader Arrived" << endl;
-			
-			//Wait until previous reader is done updating numReaders
-			semSet.wait(BINREADERCOUNTMUTEX);	
-
-				//Wait for all writers to finish 
-				if(semSet.get(NUMBINWRITERS) > 0) {
-					cout << "READERS WAITING FOR WRITER(S) TO COMPLETE" << endl;
-					semSet.wait(NOBINWRITERS);
-					cout << "READERS GAINED ACCESS:" << endl;
-					semSet.print();
-				}//end if
-				
-				//Don't trigger wait on noReaders until all writers are done				
-				semSet.signal(NUMBINREADERS); //NUMREADERS++
-				cout << "Reader Added: " << semSet.get(NUMBINREADERS) << endl;
-				
-			//Signal next reader to update numReaders
-			semSet.signal(BINREADERCOUNTMUTEX);
+		Task<> addBinReader() {
+			//Wait for all writers to finish and count this reader in a single atomic operation
+			struct sembuf ops[2] = { { (unsigned short) NUMBINWRITERS, 0, 0}, { (unsigned short) NUMBINREADERS, 1, 0} };
+			uint64_t start = waitBegun(BINREADWAIT);
 			
-			cout << "Reader " << getpid() << " entering CS." << endl;
+			co_await SemaphoreAcquire(semSet, ops, 2);
 			
+			waitGranted(BINREADWAIT, start);
 		}//end addReader
 		
 		/**
 		 *@brief Performs the necessary synchronization to remove a Reader after it reads from a critical section.
 		 */
 		void remBinReader() {
-			//TEST PRINTS
-			cout << "Reader " << getpid() << " exiting CS." << endl;
-			
-			//Wait until previous reader is done updating numReaders
-			semSet.wait(BINREADERCOUNTMUTEX);
-			
-				semSet.wait(NUMBINREADERS); //NUMBINREADERS--
-				cout << "Reader Removed: " << semSet.get(NUMBINREADERS) << endl;
-				
-				//Wake up processes waiting on noReaders when last reader exits
-				if(semSet.get(NUMBINREADERS) == 0 && semSet.getWaitCount(NOBINREADERS) > 0) {
-					semSet.signal(NOBINREADERS);
-				}//end if
-			
-			//Signal next reader to update numReaders
-			semSet.signal(BINREADERCOUNTMUTEX);
-			
+			//NUMBINREADERS-- (writers wait for it to reach zero)
+			semSet.wait(NUMBINREADERS);
 		}//end remReader 
 		
 		/**
 		 *@brief Performs the necessary synchronization to add a Writer and prepare it for writing to a critical section.
 		 */
-    void addBinWriter() {
-			//cout << "WRITER ARRIVED:" << endl;
+    Task<> addBinWriter() {
+			struct sembuf ops[2] = { { (unsigned short) NUMBINREADERS, 0, 0}, { (unsigned short) BINWRITERMUTEX, -1, 0} };
+			uint64_t start = waitBegun(BINWRITEWAIT);
 			
-			//Wait until previous writer is done updating numWriters
-	    semSet.wait(BINWRITERCOUNTMUTEX);
+			//Announce the writer so no new readers enter
+			semSet.signal(NUMBINWRITERS); //NUMBINWRITERS++
 			
-				semSet.signal(NUMBINWRITERS); //NUMBINWRITERS++
-				cout << "Writer Added: " << semSet.get(NUMBINWRITERS) << endl;
+			//Wait for current readers to finish and the previous writer to be done in a single atomic operation
+			co_await SemaphoreAcquire(semSet, ops, 2);
 			
-			  //Wait for readers currently reading to finish
-			  if(semSet.get(NUMBINREADERS) > 0) {	
-			    cout << "WRITER WAITING FOR CURRENT READERS TO FINISH" << endl;
-			    semSet.wait(NOBINREADERS);
-			    cout << "WRITERS GAINED ACCESS:" << endl;
-			    semSet.print();
-			  }//end if
-			
-			//Signal next writer to update numWriters
-			semSet.signal(BINWRITERCOUNTMUTEX);
-			//Wait until previous writer is done writing
-			semSet.wait(BINWRITERMUTEX);
-			
-			cout << "WRITER " << getpid() << " entering CS." << endl;
+			waitGranted(BINWRITEWAIT, start);
     }//end addWriter
 		
 		/**
 		 *@brief Performs the necessary synchronization to remove a Writer after it writes to a critical section.
 		 */
 		void remBinWriter() {
-			cout << "WRITER " << getpid() << " exiting CS." << endl;
-			//Signal next writer to write
-			semSet.signal(BINWRITERMUTEX);
-			//Wait until previous writer is done updating numWriters
-			semSet.wait(BINWRITERCOUNTMUTEX);
-			
-				semSet.wait(NUMBINWRITERS); //NUMBINWRITERS--
-				cout << "Writer Removed: " << semSet.get(NUMBINWRITERS) << endl;
-				
-				//Wake up processes waiting on noBinWriters when last writer exits		
-				if(semSet.get(NUMBINWRITERS) == 0 && semSet.getWaitCount(NOBINWRITERS) > 0) {
-					semSet.signal(NOBINWRITERS);
-				}//end if
+			//Signal next writer to write and NUMBINWRITERS-- together, so readers wake once the last writer exits
+			struct sembuf ops[2] = { { (unsigned short) BINWRITERMUTEX, 1, 0}, { (unsigned short) NUMBINWRITERS, -1, 0} };
 			
-			//Signal next writer to update numWriters
-			semSet.signal(BINWRITERCOUNTMUTEX);
+			semSet.operate(ops, 2);
 		}//end remWriter
-	
+		
 		/**
 		 *@brief Performs the necessary synchronization to add a Reader and prepare it for reading from a critical section.
 		 */
-		void addLogReader() {
+		Task<> addLogReader() {
+			uint64_t start = waitBegun(LOGREADWAIT);
+			
 			//Wait until previous reader is done updating numReaders
-			semSet.wait(LOGREADERCOUNT);	
+			co_await acquire(LOGREADERCOUNT);	
 			
 				//Increment numReaders
 				semSet.signal(NUMLOGREADERS);
@@ -165,23 +176,24 @@ class LogBinRWSemMonitor {
 				
 				//Wait for current writers to finish 
 			  if(semSet.get(NUMLOGREADERS) == 1) {
-					semSet.wait(LOGMUTEX);
+					co_await acquire(LOGMUTEX);
 					//cout << "Readers gained access" << endl;
 				}//end if
 				
 			//Signal next reader to update numReaders
 			semSet.signal(LOGREADERCOUNT);
-			//cout << "Reader entered" << endl;
+			
+			waitGranted(LOGREADWAIT, start);
 		}//end addReader
 		
 		/**
 		 *@brief Performs the necessary synchronization to remove a Reader after it reads from a critical section.
 		 */
-		void remLogReader() {
+		Task<> remLogReader() {
 			//cout << "Reader exited" << endl;
 			
 			//Wait until previous reader is done updating numReaders
-			semSet.wait(LOGREADERCOUNT);
+			co_await acquire(LOGREADERCOUNT);
 			
 				//Decrement numReaders
 				semSet.wait(NUMLOGREADERS);
@@ -200,10 +212,13 @@ class LogBinRWSemMonitor {
 		/**
 		 *@brief Performs the necessary synchronization to add a Writer and prepare it for writing to a critical section.
 		 */
-    void addLogWriter() {
+    Task<> addLogWriter() {
+			uint64_t start = waitBegun(LOGWRITEWAIT);
+			
 			//Wait for previous writer to finish or readers to give back access
-			semSet.wait(LOGMUTEX);
-			//cout << "Writer entered" << endl;
+			co_await acquire(LOGMUTEX);
+			
+			waitGranted(LOGWRITEWAIT, start);
     }//end addWriter
 		
 		/**
@@ -0,0 +1,249 @@
+/**
+ *@file LzCodec.cpp
+ *@author Griffin Nye
+ *@brief Fast LZ77 compression of bulk transfers, in the LZ4 block format. A block is a run of
+ *       sequences, each a token (the literal count and match length, 4 bits apiece, longer ones
+ *       continued in bytes of 255), the literals, and a 2-byte offset back to the match. Matches
+ *       are found through a hash table holding the last position of each 4-byte prefix, so a block
+ *       is compressed in one pass with no entropy coding, trading some ratio for speed.
+ */
+
+
+#ifndef LZCODEC
+#define LZCODEC
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+/*! log2 of the number of entries in the compressor's hash table. */
+#define LZHASHBITS 14
+/*! Shortest match encoded (shorter repeats cost less as literals). */
+#define LZMINMATCH 4
+/*! Farthest back a match may start (offsets are 16-bit). */
+#define LZMAXOFFSET 65535
+/*! Number of bytes at the end of a block that are always sent as literals, so matches never read past it. */
+#define LZENDLITERALS 5
+/*! Number of misses after which the compressor skips ahead faster through data that does not repeat. */
+#define LZSKIPTRIGGER 6
+
+/**
+ *@brief Compresses and decompresses blocks of bytes.
+ */
+class LzCodec {
+	private:
+
+		/**
+		 *@brief Reads 4 bytes in any alignment.
+		 *@param p The bytes.
+		 *@return The bytes as an integer.
+		 */
+		static uint32_t read32(const uint8_t *p) {
+			uint32_t value;
+
+			memcpy(&value, p, sizeof(value) );
+
+			return value;
+		}//end read32
+
+		/**
+		 *@brief Hashes a 4-byte prefix into the hash table (Knuth's multiplicative hash).
+		 *@param prefix The prefix.
+		 *@return The prefix's hash table entry.
+		 */
+		static uint32_t hash(uint32_t prefix) {
+			return (prefix * 2654435761U) >> (32 - LZHASHBITS);
+		}//end hash
+
+		/**
+		 *@brief Writes the part of a length that does not fit in its token nibble.
+		 *@param out The compressed block.
+		 *@param op The position in the compressed block; advanced past the length.
+		 *@param len The length, less the 15 held by the nibble.
+		 */
+		static void writeLength(uint8_t *out, int &op, int len) {
+			for(; len >= 255; len -= 255) {
+				out[op++] = 255;
+			}//end for
+
+			out[op++] = len;
+		}//end writeLength
+
+		/**
+		 *@brief Reads the part of a length that did not fit in its token nibble.
+		 *@param in The compressed block.
+		 *@param ip The position in the compressed block; advanced past the length.
+		 *@param inSize The size of the compressed block.
+		 *@param len The length held by the nibble; receives the whole length.
+		 *@return Whether the length ended within the block.
+		 */
+		static bool readLength(const uint8_t *in, int &ip, int inSize, int &len) {
+			uint8_t next;
+
+			do {
+				if(ip >= inSize) {
+					return false;
+				}//end if
+
+				next = in[ip++];
+				len += next;
+			} while(next == 255);
+
+			return true;
+		}//end readLength
+
+		/**
+		 *@brief Writes a sequence: its token, literals, and (unless it ends the block) match.
+		 *@param out The compressed block.
+		 *@param op The position in the compressed block; advanced past the sequence.
+		 *@param literals The literals.
+		 *@param numLiterals The number of literals.
+		 *@param offset How far back the match starts (0 for the literals ending the block).
+		 *@param matchLen The length of the match.
+		 */
+		static void writeSequence(uint8_t *out, int &op, const uint8_t *literals, int numLiterals, int offset, int matchLen) {
+			uint8_t &token = out[op++];
+
+			token = (numLiterals < 15 ? numLiterals : 15) << 4;
+
+			if(numLiterals >= 15) {
+				writeLength(out, op, numLiterals - 15);
+			}//end if
+
+			memcpy(out + op, literals, numLiterals);
+			op += numLiterals;
+
+			if(offset == 0) {
+				return;
+			}//end if
+
+			out[op++] = offset & 0xff;
+			out[op++] = offset >> 8;
+			matchLen -= LZMINMATCH;
+			token |= (matchLen < 15 ? matchLen : 15);
+
+			if(matchLen >= 15) {
+				writeLength(out, op, matchLen - 15);
+			}//end if
+
+		}//end writeSequence
+
+	public:
+
+		/**
+		 *@brief Retrieves the most bytes a block can take once compressed (data that does not repeat grows slightly).
+		 *@param rawSize The size of the block.
+		 *@return The size of the buffer to compress the block into.
+		 */
+		static int maxPackedSize(int rawSize) {
+			return rawSize + rawSize / 255 + 16;
+		}//end maxPackedSize
+
+		/**
+		 *@brief Compresses a block.
+		 *@param src The block.
+		 *@param rawSize The size of the block.
+		 *@param dst Receives the compressed block (at least maxPackedSize(rawSize) bytes).
+		 *@return The size of the compressed block.
+		 */
+		static int compress(const char src[], int rawSize, char dst[]) {
+			vector<int32_t> table(1 << LZHASHBITS, -1);
+			const uint8_t *in = (const uint8_t *) src;
+			uint8_t *out = (uint8_t *) dst;
+			int pos = 0, anchor = 0, op = 0, misses = 0, limit = rawSize - LZENDLITERALS;
+
+			while(pos + LZMINMATCH <= limit) {
+				uint32_t prefix = read32(in + pos);
+				int32_t &entry = table[ hash(prefix) ];
+				int candidate = entry, matchLen = LZMINMATCH;
+
+				entry = pos;
+
+				//Step further between checks the longer nothing repeats
+				if(candidate < 0 || pos - candidate > LZMAXOFFSET || read32(in + candidate) != prefix) {
+					pos += 1 + (misses++ >> LZSKIPTRIGGER);
+					continue;
+				}//end if
+
+				while(pos + matchLen < limit && in[candidate + matchLen] == in[pos + matchLen]) {
+					matchLen++;
+				}//end while
+
+				writeSequence(out, op, in + anchor, pos - anchor, pos - candidate, matchLen);
+				pos += matchLen;
+				anchor = pos;
+				misses = 0;
+			}//end while
+
+			//The rest of the block ends it as literals
+			writeSequence(out, op, in + anchor, rawSize - anchor, 0, 0);
+
+			return op;
+		}//end compress
+
+		/**
+		 *@brief Decompresses a block, checking every length and offset against the buffers.
+		 *@param src The compressed block.
+		 *@param packedSize The size of the compressed block.
+		 *@param dst Receives the block.
+		 *@param rawSize The size of the block.
+		 *@return Whether the compressed block was well formed and held exactly rawSize bytes.
+		 */
+		static bool decompress(const char src[], int packedSize, char dst[], int rawSize) {
+			const uint8_t *in = (const uint8_t *) src;
+			uint8_t *out = (uint8_t *) dst;
+			int ip = 0, op = 0;
+
+			while(ip < packedSize) {
+				uint8_t token = in[ip++];
+				int numLiterals = token >> 4, matchLen = token & 15, offset;
+
+				if(numLiterals == 15 && !readLength(in, ip, packedSize, numLiterals) ) {
+					return false;
+				} else if(numLiterals > packedSize - ip || numLiterals > rawSize - op) {
+					return false;
+				}//end if
+
+				memcpy(out + op, in + ip, numLiterals);
+				ip += numLiterals;
+				op += numLiterals;
+
+				//The last sequence has no match
+				if(ip == packedSize) {
+					break;
+				} else if(packedSize - ip < 2) {
+					return false;
+				}//end if
+
+				offset = in[ip] | (in[ip + 1] << 8);
+				ip += 2;
+
+				if(matchLen == 15 && !readLength(in, ip, packedSize, matchLen) ) {
+					return false;
+				}//end if
+
+				matchLen += LZMINMATCH;
+
+				if(offset == 0 || offset > op || matchLen > rawSize - op) {
+					return false;
+				}//end if
+
+				//A match may overlap the bytes it produces, repeating them
+				if(offset >= matchLen) {
+					memcpy(out + op, out + op - offset, matchLen);
+				} else {
+					for(int i = 0; i < matchLen; i++) {
+						out[op + i] = out[op + i - offset];
+					}//end for
+				}//end if
+
+				op += matchLen;
+			}//end while
+
+			return op == rawSize;
+		}//end decompress
+
+};//end LzCodec
+#endif
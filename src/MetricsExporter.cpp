@@ -0,0 +1,291 @@
+/**
+ *@file MetricsExporter.cpp
+ *@author Griffin Nye
+ *@brief Serves the server statistics as Prometheus text metrics over HTTP on a separate local
+ *       port. Every scrape reads the shared statistics and aggregates without locking and stats
+ *       the bin and log files directly, so scrapes never contend with request handling.
+ */
+
+
+#ifndef METRICSEXPORTER
+#define METRICSEXPORTER
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "msgPackets.cpp"
+#include "ServerStats.cpp"
+#include "ShardedDataset.cpp"
+
+using namespace std;
+
+/*! Largest HTTP request header read from a scraper. */
+#define MAXSCRAPEREQUESTSIZE 4096
+/*! Seconds a scraper has to send its request before it is dropped. */
+#define SCRAPETIMEOUT 2
+
+/**
+ *@brief Listens for HTTP scrapes and answers each with a snapshot of the server statistics.
+ */
+class MetricsExporter {
+	private:
+		ServerStats &stats;
+		ShardedDataset &dataset;
+		FILE * logPtr;
+		int listenfd;
+
+		/**
+		 *@brief Appends a metric family's HELP and TYPE lines.
+		 *@param out The exposition being built.
+		 *@param name The name of the metric.
+		 *@param type The metric type (counter, gauge, or histogram).
+		 *@param help Description of the metric.
+		 */
+		static void appendHeader(string &out, const char * name, const char * type, const char * help) {
+			out += string("# HELP ") + name + " " + help + "\n";
+			out += string("# TYPE ") + name + " " + type + "\n";
+		}//end appendHeader
+
+		/**
+		 *@brief Appends a single sample.
+		 *@param out The exposition being built.
+		 *@param name The name of the metric.
+		 *@param labels The sample's labels (e.g. cmd="GET"), or an empty string.
+		 *@param value The sample's value.
+		 */
+		static void appendSample(string &out, string name, string labels, double value) {
+			char num[32];
+
+			snprintf(num, sizeof(num), "%.9g", value);
+			out += name + (labels.empty() ? "" : "{" + labels + "}") + " " + num + "\n";
+		}//end appendSample
+
+		/**
+		 *@brief Appends a histogram of nanosecond values as cumulative buckets in seconds.
+		 *@param out The exposition being built.
+		 *@param name The name of the metric.
+		 *@param labels The histogram's labels (e.g. cmd="GET").
+		 *@param histogram The histogram (a copy, so it cannot change while being read).
+		 */
+		static void appendHistogram(string &out, const char * name, string labels, const LatencyHistogram &histogram) {
+			const double BOUNDS[] = {10e-6, 25e-6, 50e-6, 100e-6, 250e-6, 500e-6, 1e-3, 2.5e-3, 5e-3, 10e-3, 25e-3, 50e-3, 100e-3, 250e-3, 500e-3, 1, 2.5};
+			uint64_t count = histogram.getCountAtOrBelow(UINT64_MAX);
+			char le[32];
+
+			for(double bound : BOUNDS) {
+				snprintf(le, sizeof(le), "%g", bound);
+				appendSample(out, string(name) + "_bucket", labels + ",le=\"" + le + "\"", histogram.getCountAtOrBelow(bound * 1e9) );
+			}//end for
+
+			appendSample(out, string(name) + "_bucket", labels + ",le=\"+Inf\"", count);
+			appendSample(out, string(name) + "_sum", labels, histogram.getSum() / 1e9);
+			appendSample(out, string(name) + "_count", labels, count);
+		}//end appendHistogram
+
+		/**
+		 *@brief Retrieves the size of an open file.
+		 *@param filePtr The file.
+		 *@return The file's size in bytes, or 0 if it could not be determined.
+		 */
+		static long fileSize(FILE * filePtr) {
+			struct stat fileStat;
+
+			return fstat(fileno(filePtr), &fileStat) == -1 ? 0 : fileStat.st_size;
+		}//end fileSize
+
+		/**
+		 *@brief Renders every metric in the Prometheus text exposition format.
+		 *@return The exposition.
+		 */
+		string render() {
+			long binSize = 0;
+			string out;
+
+			for(int i = 0; i < dataset.getNumShards(); i++) {
+				binSize += fileSize(dataset.getShard(i).binPtr);
+			}//end for
+
+			appendHeader(out, "shellsim_requests_total", "counter", "Requests handled, by command.");
+
+			for(int i = 0; i < NUMSTATCMDS; i++) {
+				appendSample(out, "shellsim_requests_total", string("cmd=\"") + ServerStats::commandName(i) + "\"", stats.getCommand(i).getCount() );
+			}//end for
+
+			appendHeader(out, "shellsim_request_duration_seconds", "histogram", "Time to handle a request, by command.");
+
+			for(int i = 0; i < NUMSTATCMDS; i++) {
+				appendHistogram(out, "shellsim_request_duration_seconds", string("cmd=\"") + ServerStats::commandName(i) + "\"", stats.getCommand(i) );
+			}//end for
+
+			appendHeader(out, "shellsim_lock_wait_seconds", "histogram", "Time spent waiting to acquire a file monitor, by acquire.");
+
+			for(int i = 0; i < NUMSTATWAITS; i++) {
+				appendHistogram(out, "shellsim_lock_wait_seconds", string("lock=\"") + ServerStats::waitName(i) + "\"", stats.getWait(i) );
+			}//end for
+
+			appendHeader(out, "shellsim_file_io_seconds", "histogram", "Time spent in bin and log file operations, by operation.");
+
+			for(int i = 0; i < NUMSTATIOS; i++) {
+				appendHistogram(out, "shellsim_file_io_seconds", string("op=\"") + ServerStats::ioName(i) + "\"", stats.getIO(i) );
+			}//end for
+
+			appendHeader(out, "shellsim_active_connections", "gauge", "Client connections currently open.");
+			appendSample(out, "shellsim_active_connections", "", stats.getActiveConnections() );
+			appendHeader(out, "shellsim_connections_total", "counter", "Client connections accepted.");
+			appendSample(out, "shellsim_connections_total", "", stats.getTotalConnections() );
+			appendHeader(out, "shellsim_received_bytes_total", "counter", "Bytes received from clients.");
+			appendSample(out, "shellsim_received_bytes_total", "", stats.getBytesReceived() );
+			appendHeader(out, "shellsim_sent_bytes_total", "counter", "Bytes sent to clients.");
+			appendSample(out, "shellsim_sent_bytes_total", "", stats.getBytesSent() );
+			appendHeader(out, "shellsim_records", "gauge", "Records stored in the dataset.");
+			appendSample(out, "shellsim_records", "", dataset.getNumRecords() );
+			appendHeader(out, "shellsim_shard_records", "gauge", "Records stored in each shard of the dataset.");
+
+			for(int i = 0; i < dataset.getNumShards(); i++) {
+				appendSample(out, "shellsim_shard_records", "shard=\"" + to_string(i) + "\"", dataset.getShard(i).aggregates.getNumRecords() );
+			}//end for
+
+			appendHeader(out, "shellsim_record_file_bytes", "gauge", "Combined size of the bin files.");
+			appendSample(out, "shellsim_record_file_bytes", "", binSize);
+			appendHeader(out, "shellsim_log_file_bytes", "gauge", "Size of the server log file.");
+			appendSample(out, "shellsim_log_file_bytes", "", fileSize(logPtr) );
+			appendHeader(out, "shellsim_journal_entries", "gauge", "Writes recorded in the write journal.");
+			appendSample(out, "shellsim_journal_entries", "", dataset.getJournal().getNumEntries() );
+
+			//Only a replica has a primary to lag behind
+			if(dataset.isReadOnly() ) {
+				appendHeader(out, "shellsim_replica_lag_entries", "gauge", "Journal entries the primary has that this replica has not applied.");
+				appendSample(out, "shellsim_replica_lag_entries", "", max<int64_t>(stats.getReplicaHead() - dataset.getJournal().getNumEntries(), 0) );
+				appendHeader(out, "shellsim_replica_staleness_seconds", "gauge", "Seconds since this replica last held every write of its primary (-1 before it first has).");
+				appendSample(out, "shellsim_replica_staleness_seconds", "", stats.getReplicaStaleness() == -1 ? -1 : stats.getReplicaStaleness() / 1e9);
+			}//end if
+
+			appendHeader(out, "shellsim_uptime_seconds", "gauge", "Seconds since the server started.");
+			appendSample(out, "shellsim_uptime_seconds", "", stats.getUptime() );
+
+			return out;
+		}//end render
+
+		/**
+		 *@brief Reads a single HTTP request from a scraper and answers it.
+		 *@param commfd The scraper's socket.
+		 */
+		void serveScrape(int commfd) {
+			char request[MAXSCRAPEREQUESTSIZE+1];
+			size_t received = 0;
+			ssize_t numRead;
+			string body, response;
+
+			//Read until the end of the request header
+			while(received < MAXSCRAPEREQUESTSIZE) {
+				numRead = read(commfd, request + received, MAXSCRAPEREQUESTSIZE - received);
+
+				if(numRead <= 0) {
+					return;
+				}//end if
+
+				received += numRead;
+				request[received] = '\0';
+
+				if(strstr(request, "\r\n\r\n") != NULL || strstr(request, "\n\n") != NULL) {
+					break;
+				}//end if
+
+			}//end while
+
+			request[received] = '\0';
+
+			if(strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET / ", 6) == 0) {
+				body = render();
+				response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n";
+			} else {
+				body = "Not Found\n";
+				response = "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\n";
+			}//end if
+
+			response += "Content-Length: " + to_string(body.size() ) + "\r\nConnection: close\r\n\r\n" + body;
+
+			for(size_t sent = 0; sent < response.size(); sent += numRead) {
+				if( (numRead = write(commfd, response.data() + sent, response.size() - sent) ) <= 0) {
+					return;
+				}//end if
+			}//end for
+
+		}//end serveScrape
+
+	public:
+
+		/**
+		 *@brief Constructs the MetricsExporter. Nothing is served until listen() and serve() are called.
+		 *@param stats The shared server statistics to be exported.
+		 *@param dataset The sharded dataset, whose aggregates count its records.
+		 *@param logPtr The file pointer to the server log file.
+		 */
+		MetricsExporter(ServerStats &stats, ShardedDataset &dataset, FILE * logPtr) : stats(stats), dataset(dataset) {
+			this->logPtr = logPtr;
+			this->listenfd = -1;
+		}//end constructor
+
+		/**
+		 *@brief Creates the listening socket for scrapes on the loopback interface.
+		 *@param port The port to listen on.
+		 *@return Whether the socket was created, bound, and is listening.
+		 */
+		bool listen(int port) {
+			const int MAX_CONN = 10;
+			struct sockaddr_in address;
+			int reuse = 1;
+
+			if( (listenfd = socket(AF_INET, SOCK_STREAM, 0) ) == -1) {
+				perror("Error creating metrics socket: ");
+				return false;
+			}//end if
+
+			setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse) );
+
+			memset(&address, 0, sizeof(address) );
+			address.sin_family = AF_INET;
+			address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			address.sin_port = htons(port);
+
+			if( bind(listenfd, (struct sockaddr *) &address, sizeof(address) ) == -1 || ::listen(listenfd, MAX_CONN) == -1) {
+				perror("Error binding metrics socket: ");
+				close(listenfd);
+				listenfd = -1;
+				return false;
+			}//end if
+
+			return true;
+		}//end listen
+
+		/**
+		 *@brief Answers scrapes one at a time, forever.
+		 */
+		void serve() {
+			struct timeval timeout = {SCRAPETIMEOUT, 0};
+			int commfd;
+
+			while(true) {
+
+				if( (commfd = accept(listenfd, NULL, NULL) ) == -1) {
+					continue;
+				}//end if
+
+				//A stalled scraper must not hold up the next one
+				setsockopt(commfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout) );
+				setsockopt(commfd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout) );
+				serveScrape(commfd);
+				close(commfd);
+			}//end while
+
+		}//end serve
+
+};//end MetricsExporter
+#endif
@@ -0,0 +1,201 @@
+/**
+ *@file Money.cpp
+ *@author Griffin Nye
+ *@brief Fixed-point revenue amount stored as a whole number of minor units (cents by default),
+ *       so sums over any number of records are exact integer adds and parsing and
+ *       formatting never go through floating point.
+ */
+
+
+#ifndef MONEY
+#define MONEY
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+/*! Number of decimal places kept by a Money amount. */
+#define MONEYDECIMALS 2
+/*! Largest number of integer digits a Money amount may be parsed with. */
+#define MONEYMAXDIGITS 15
+
+/**
+ *@brief A revenue amount held as an int64 count of 10^-MONEYDECIMALS units.
+ */
+class Money {
+	private:
+		int64_t units;
+
+		/**
+		 *@brief Returns the number of minor units in one whole unit.
+		 *@return 10^MONEYDECIMALS
+		 */
+		static constexpr int64_t scale() {
+			int64_t s = 1;
+
+			for(int i = 0; i < MONEYDECIMALS; i++) {
+				s *= 10;
+			}//end for
+
+			return s;
+		}//end scale
+
+	public:
+
+		/**
+		 *@brief Constructs a zero amount.
+		 */
+		Money() {
+			units = 0;
+		}//end constructor
+
+		/**
+		 *@brief Constructs an amount from a count of minor units.
+		 *@param units The number of minor units (e.g. cents).
+		 */
+		explicit Money(int64_t units) {
+			this->units = units;
+		}//end constructor
+
+		/**
+		 *@brief Retrieves the amount as a count of minor units.
+		 *@return The number of minor units.
+		 */
+		int64_t getUnits() const {
+			return units;
+		}//end getUnits
+
+		/**
+		 *@brief Converts the amount to a double (for display and statistics only).
+		 *@return The amount in whole units.
+		 */
+		double toDouble() const {
+			return (double) units / scale();
+		}//end toDouble
+
+		/**
+		 *@brief Parses a decimal amount ("-12.34", "5", ".5") using integer arithmetic only.
+		 *       Digits beyond MONEYDECIMALS are rounded half away from zero.
+		 *@param text The text to be parsed; all of it must be consumed.
+		 *@param money Set to the parsed amount.
+		 *@return Whether the text was a valid amount.
+		 */
+		static bool parse(string_view text, Money &money) {
+			const char * c = text.data();
+			const char * end = text.data() + text.size();
+			int64_t whole = 0, fraction = 0;
+			int numDigits = 0, numWhole = 0, numFraction = 0;
+			bool negative = false, roundUp = false;
+
+			if(c < end && (*c == '-' || *c == '+') ) {
+				negative = (*c++ == '-');
+			}//end if
+
+			//Whole units
+			for(; c < end && isdigit(*c); c++, numDigits++) {
+
+				if(++numWhole > MONEYMAXDIGITS) {
+					return false;
+				}//end if
+
+				whole = whole * 10 + (*c - '0');
+			}//end for
+
+			//Minor units, remembering the first extra digit for rounding
+			if(c < end && *c == '.') {
+
+				for(c++; c < end && isdigit(*c); c++, numDigits++) {
+
+					if(numFraction < MONEYDECIMALS) {
+						fraction = fraction * 10 + (*c - '0');
+						numFraction++;
+					} else if(numFraction++ == MONEYDECIMALS) {
+						roundUp = (*c >= '5');
+					}//end if
+
+				}//end for
+
+			}//end if
+
+			if(c != end || numDigits == 0) {
+				return false;
+			}//end if
+
+			for(; numFraction < MONEYDECIMALS; numFraction++) {
+				fraction *= 10;
+			}//end for
+
+			money.units = whole * scale() + fraction + roundUp;
+
+			if(negative) {
+				money.units = -money.units;
+			}//end if
+
+			return true;
+		}//end parse
+
+		/**
+		 *@brief Formats the amount with exactly MONEYDECIMALS decimal places using integer arithmetic only.
+		 *@param out Where the amount is to be written.
+		 *@param end One past the last writable byte.
+		 *@return One past the last byte written, or NULL if the amount did not fit.
+		 */
+		char * format(char * out, char * end) const {
+			uint64_t magnitude = (units < 0) ? -(uint64_t) units : units;
+			uint64_t fraction = magnitude % scale();
+
+			if(units < 0) {
+
+				if(out >= end) {
+					return NULL;
+				}//end if
+
+				*out++ = '-';
+			}//end if
+
+			to_chars_result formatted = to_chars(out, end, magnitude / scale() );
+
+			if(formatted.ec != errc() || end - formatted.ptr < 1 + MONEYDECIMALS) {
+				return NULL;
+			}//end if
+
+			out = formatted.ptr;
+			*out++ = '.';
+
+			//Minor units, zero-padded from the right
+			for(int i = MONEYDECIMALS - 1; i >= 0; i--) {
+				out[i] = '0' + fraction % 10;
+				fraction /= 10;
+			}//end for
+
+			return out + MONEYDECIMALS;
+		}//end format
+
+		/**
+		 *@brief Converts the amount to a string.
+		 *@return The amount with exactly MONEYDECIMALS decimal places.
+		 */
+		string toString() const {
+			char buf[32];
+
+			return string(buf, format(buf, buf + sizeof(buf) ) - buf);
+		}//end toString
+
+		Money operator+(Money other) const { return Money(units + other.units); }
+		Money operator-(Money other) const { return Money(units - other.units); }
+		Money operator-() const { return Money(-units); }
+		Money &operator+=(Money other) { units += other.units; return *this; }
+		Money &operator-=(Money other) { units -= other.units; return *this; }
+		bool operator==(Money other) const { return units == other.units; }
+		bool operator!=(Money other) const { return units != other.units; }
+		bool operator<(Money other) const { return units < other.units; }
+		bool operator<=(Money other) const { return units <= other.units; }
+		bool operator>(Money other) const { return units > other.units; }
+		bool operator>=(Money other) const { return units >= other.units; }
+
+};//end Money
+#endif
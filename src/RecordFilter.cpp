@@ -0,0 +1,402 @@
+/**
+ *@file RecordFilter.cpp
+ *@author Griffin Nye
+ *@brief Compiles predicate expressions over the record columns (e.g. "total > 2 AND year = 20")
+ *       into a small postfix program that can be evaluated against each record in the dataset.
+ */
+
+
+#ifndef RECORDFILTER
+#define RECORDFILTER
+
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "DataRecord.cpp"
+#include "msgPackets.cpp"
+
+using namespace std;
+
+/**
+ *@brief Compiles a filter expression once and evaluates it against records of the dataset.
+ *
+ * Grammar (keywords and column names are case-insensitive):
+ *   expr       := term { (OR | ||) term }
+ *   term       := factor { (AND | &&) factor }
+ *   factor     := (NOT | !) factor | '(' expr ')' | comparison
+ *   comparison := column (= | == | != | <> | < | <= | > | >=) value
+ *   column     := month | year | accessories | hardware | software | total | index
+ *   value      := number | 3-letter month abbreviation (month column only)
+ *
+ * Revenue columns are compared as exact Money amounts; the other columns are integers.
+ */
+class RecordFilter {
+	private:
+		enum COLUMN {MONTHCOL, YEARCOL, ACCESSORIESCOL, HARDWARECOL, SOFTWARECOL, TOTALCOL, INDEXCOL, NUMCOLUMNS};
+		enum OPCODE {CMPEQ, CMPNE, CMPLT, CMPLE, CMPGT, CMPGE, OPAND, OPOR, OPNOT};
+
+		/**
+		 *@brief A single instruction of the compiled postfix program.
+		 */
+		struct instruction {
+			OPCODE op;
+			int column;
+			int64_t val;
+		};
+
+		vector<instruction> program;
+		string expr, error;
+		size_t pos;
+		bool usedColumns[NUMCOLUMNS];
+		stringToMonthConverter monthConverter;
+
+		/**
+		 *@brief Skips any whitespace at the current position of the expression.
+		 */
+		void skipSpace() {
+			while(pos < expr.length() && isspace(expr[pos]) ) {
+				pos++;
+			}//end while
+		}//end skipSpace
+
+		/**
+		 *@brief Reads the next word (identifier or number) from the expression without consuming it.
+		 *@return The next word, lowercased, or an empty string if the next token is a symbol.
+		 */
+		string peekWord() {
+			size_t end;
+			string word;
+
+			skipSpace();
+			end = pos;
+
+			while(end < expr.length() && (isalnum(expr[end]) || expr[end] == '.' || expr[end] == '-') ) {
+				word += tolower(expr[end]);
+				end++;
+			}//end while
+
+			return word;
+		}//end peekWord
+
+		/**
+		 *@brief Consumes the provided keyword or symbol if it is next in the expression.
+		 *@param token The keyword (lowercase) or symbol to be matched.
+		 *@return Whether the token was matched and consumed.
+		 */
+		bool accept(string token) {
+			skipSpace();
+
+			if(isalpha(token[0]) ) {
+				if(peekWord() == token) {
+					pos += token.length();
+					return true;
+				}//end if
+			} else if(expr.compare(pos, token.length(), token) == 0) {
+				pos += token.length();
+				return true;
+			}//end if
+
+			return false;
+		}//end accept
+
+		/**
+		 *@brief Records a compilation error at the current position.
+		 *@param msg Description of the error.
+		 *@return Always false, so callers can return the result directly.
+		 */
+		bool fail(string msg) {
+			if(error.empty() ) {
+				error = msg + " at position " + to_string(pos + 1);
+			}//end if
+
+			return false;
+		}//end fail
+
+		/**
+		 *@brief Parses an OR-separated list of terms.
+		 *@return Whether the sub-expression was compiled successfully.
+		 */
+		bool parseExpr() {
+			if(!parseTerm() ) {
+				return false;
+			}//end if
+
+			while(accept("or") || accept("||") ) {
+				if(!parseTerm() ) {
+					return false;
+				}//end if
+				program.push_back({OPOR, -1, 0});
+			}//end while
+
+			return true;
+		}//end parseExpr
+
+		/**
+		 *@brief Parses an AND-separated list of factors.
+		 *@return Whether the sub-expression was compiled successfully.
+		 */
+		bool parseTerm() {
+			if(!parseFactor() ) {
+				return false;
+			}//end if
+
+			while(accept("and") || accept("&&") ) {
+				if(!parseFactor() ) {
+					return false;
+				}//end if
+				program.push_back({OPAND, -1, 0});
+			}//end while
+
+			return true;
+		}//end parseTerm
+
+		/**
+		 *@brief Parses a negation, a parenthesized expression, or a single comparison.
+		 *@return Whether the sub-expression was compiled successfully.
+		 */
+		bool parseFactor() {
+			if(accept("not") || accept("!") ) {
+				if(!parseFactor() ) {
+					return false;
+				}//end if
+				program.push_back({OPNOT, -1, 0});
+				return true;
+			} else if(accept("(") ) {
+				if(!parseExpr() ) {
+					return false;
+				} else if(!accept(")") ) {
+					return fail("Expected ')'");
+				}//end if
+				return true;
+			}//end if
+
+			return parseComparison();
+		}//end parseFactor
+
+		/**
+		 *@brief Parses a comparison between a column and a constant value.
+		 *@return Whether the comparison was compiled successfully.
+		 */
+		bool parseComparison() {
+			const string COLUMNNAMES[NUMCOLUMNS] = {"month", "year", "accessories", "hardware", "software", "total", "index"};
+			int column = -1;
+			OPCODE op;
+			string word = peekWord();
+			Money amount;
+			int64_t val;
+
+			//Match column name
+			for(int i = 0; i < NUMCOLUMNS; i++) {
+				if(word == COLUMNNAMES[i]) {
+					column = i;
+				}//end if
+			}//end for
+
+			if(column == -1) {
+				return fail("Expected column name");
+			}//end if
+
+			pos += word.length();
+
+			//Match comparison operator (longest operators first)
+			if(accept("==") || accept("=") ) {
+				op = CMPEQ;
+			} else if(accept("!=") || accept("<>") ) {
+				op = CMPNE;
+			} else if(accept("<=") ) {
+				op = CMPLE;
+			} else if(accept(">=") ) {
+				op = CMPGE;
+			} else if(accept("<") ) {
+				op = CMPLT;
+			} else if(accept(">") ) {
+				op = CMPGT;
+			} else {
+				return fail("Expected comparison operator");
+			}//end if
+
+			//Match constant value (years may be written as '20)
+			accept("'");
+			word = peekWord();
+
+			if(word.empty() ) {
+				return fail("Expected value");
+			}//end if
+
+			if(column == MONTHCOL && isalpha(word[0]) ) {
+				word[0] = toupper(word[0]);
+				val = monthConverter.toMonth(word);
+
+				if(val < 0) {
+					return fail("Invalid month '" + word + "'");
+				}//end if
+
+			} else if(column >= ACCESSORIESCOL && column <= TOTALCOL) {
+
+				if( !Money::parse(word, amount) ) {
+					return fail("Invalid amount '" + word + "'");
+				}//end if
+
+				val = amount.getUnits();
+			} else {
+				from_chars_result parsed = from_chars(word.data(), word.data() + word.size(), val);
+
+				if(parsed.ec != errc() || parsed.ptr != word.data() + word.size() ) {
+					return fail("Invalid number '" + word + "'");
+				}//end if
+
+				//Allow 4-digit years
+				if(column == YEARCOL && val >= 100) {
+					val -= 2000;
+				}//end if
+
+				//Months are entered 1-based but stored as MONTH values
+				if(column == MONTHCOL) {
+					val -= 1;
+				}//end if
+
+			}//end if
+
+			pos += word.length();
+			usedColumns[column] = true;
+			program.push_back({op, column, val});
+
+			return true;
+		}//end parseComparison
+
+	public:
+
+		/**
+		 *@brief Default constructor for the RecordFilter. Matches no records until compiled.
+		 */
+		RecordFilter() {
+		}//end constructor
+
+		/**
+		 *@brief Compiles the provided expression into the filter's postfix program.
+		 *@param expression The predicate expression to be compiled.
+		 *@return Whether the expression was compiled successfully.
+		 */
+		bool compile(string expression) {
+			expr = expression;
+			pos = 0;
+			error = "";
+			program.clear();
+
+			for(int i = 0; i < NUMCOLUMNS; i++) {
+				usedColumns[i] = false;
+			}//end for
+
+			if(!parseExpr() ) {
+				program.clear();
+				return false;
+			}//end if
+
+			skipSpace();
+
+			if(pos != expr.length() ) {
+				program.clear();
+				return fail("Unexpected input");
+			}//end if
+
+			return true;
+		}//end compile
+
+		/**
+		 *@brief Retrieves the description of the last compilation error.
+		 *@return The error message, or an empty string if compilation succeeded.
+		 */
+		string getError() {
+			return error;
+		}//end getError
+
+		/**
+		 *@brief Evaluates the compiled program against a single record.
+		 *@param record The record to be tested.
+		 *@param idx The index of the record in the bin file.
+		 *@return Whether the record satisfies the expression.
+		 */
+		bool matches(DataRecord &record, int idx) {
+			int64_t cols[NUMCOLUMNS];
+			bool stack[MAXEXPRSIZE];
+			int top = 0;
+
+			if(program.empty() ) {
+				return false;
+			}//end if
+
+			//Load only the columns referenced by the expression
+			if(usedColumns[MONTHCOL]) {
+				cols[MONTHCOL] = record.getMonth();
+			}//end if
+
+			if(usedColumns[YEARCOL]) {
+				cols[YEARCOL] = record.getYear();
+			}//end if
+
+			if(usedColumns[ACCESSORIESCOL]) {
+				cols[ACCESSORIESCOL] = record.getAccessories().getUnits();
+			}//end if
+
+			if(usedColumns[HARDWARECOL]) {
+				cols[HARDWARECOL] = record.getHardware().getUnits();
+			}//end if
+
+			if(usedColumns[SOFTWARECOL]) {
+				cols[SOFTWARECOL] = record.getSoftware().getUnits();
+			}//end if
+
+			if(usedColumns[TOTALCOL]) {
+				cols[TOTALCOL] = record.getTotal().getUnits();
+			}//end if
+
+			if(usedColumns[INDEXCOL]) {
+				cols[INDEXCOL] = idx;
+			}//end if
+
+			//Run the postfix program
+			for(size_t i = 0; i < program.size(); i++) {
+				instruction &ins = program[i];
+
+				switch(ins.op) {
+					case CMPEQ:
+						stack[top++] = cols[ins.column] == ins.val;
+						break;
+					case CMPNE:
+						stack[top++] = cols[ins.column] != ins.val;
+						break;
+					case CMPLT:
+						stack[top++] = cols[ins.column] < ins.val;
+						break;
+					case CMPLE:
+						stack[top++] = cols[ins.column] <= ins.val;
+						break;
+					case CMPGT:
+						stack[top++] = cols[ins.column] > ins.val;
+						break;
+					case CMPGE:
+						stack[top++] = cols[ins.column] >= ins.val;
+						break;
+					case OPAND:
+						top--;
+						stack[top-1] = stack[top-1] && stack[top];
+						break;
+					case OPOR:
+						top--;
+						stack[top-1] = stack[top-1] || stack[top];
+						break;
+					case OPNOT:
+						stack[top-1] = !stack[top-1];
+						break;
+				}//end switch
+
+			}//end for
+
+			return stack[0];
+		}//end matches
+
+};//end RecordFilter
+#endif
@@ -0,0 +1,323 @@
+/**
+ *@file RevenueAggregates.cpp
+ *@author Griffin Nye
+ *@brief Incrementally maintained revenue aggregates kept in System V shared memory, so
+ *       every child server sees the same yearly/quarterly buckets and Fenwick tree of
+ *       record totals without rescanning the dataset. Totals are kept as exact Money
+ *       amounts, so they never drift however many updates are applied.
+ */
+
+
+#ifndef REVENUEAGGREGATES
+#define REVENUEAGGREGATES
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include "DataRecord.cpp"
+#include "msgPackets.cpp"
+
+using namespace std;
+
+/*! Fewest records the rolling-sum Fenwick tree is sized for (it covers twice the records the bin file starts with, if more). */
+#define MINAGGRECORDS 1048576
+/*! Number of 2-digit years tracked by the yearly and quarterly buckets. */
+#define NUMAGGYEARS 100
+
+/**
+ *@brief Maintains per-year/per-quarter revenue totals and a Fenwick tree over record order.
+ *
+ * All updates are O(log n) and must be made while holding the bin writer lock; all queries
+ * are O(log n) (or O(1) for buckets) and must be made while holding a bin reader lock. The
+ * Fenwick tree follows the shared space, sized when it is created; rolling sums past the
+ * records it covers are refused until the server is restarted and sizes it anew.
+ */
+class RevenueAggregates {
+	private:
+
+		/**
+		 *@brief Layout of the shared memory space holding the aggregates.
+		 */
+		struct aggregateSpace {
+			int numRecords;
+			int capacity;
+			bool capacityExceeded;
+			Money yearTotals[NUMAGGYEARS];
+			Money quarterTotals[NUMAGGYEARS][4];
+		};
+
+		int shmID, key;
+		aggregateSpace * space;
+		Money * fenwick;
+
+		/**
+		 *@brief Extracts the 2-digit year and quarter of a record.
+		 *@param record The record to be examined.
+		 *@param year Set to the record's 2-digit year.
+		 *@param quarter Set to the record's quarter (0-3).
+		 *@return Whether the record's month and year were valid.
+		 */
+		bool getBucket(DataRecord &record, int &year, int &quarter) {
+			if(record.getMonth() == -1) {
+				return false;
+			}//end if
+
+			year = record.getYear();
+			quarter = record.getMonth() / 3;
+
+			return year >= 0 && year < NUMAGGYEARS;
+		}//end getBucket
+
+		/**
+		 *@brief Adds the provided amount to the Fenwick tree entry of a record.
+		 *@param idx The 1-based index of the record.
+		 *@param delta The amount to be added.
+		 */
+		void fenwickAdd(int idx, Money delta) {
+
+			//Records past the tree are left out of it, which is reported once
+			if(idx > space->capacity && !space->capacityExceeded) {
+				space->capacityExceeded = true;
+				cout << "Rolling revenue sums cover only the first " << space->capacity << " records of a shard until the server is restarted." << endl;
+			}//end if
+
+			for(; idx <= space->capacity; idx += idx & -idx) {
+				fenwick[idx] += delta;
+			}//end for
+		}//end fenwickAdd
+
+		/**
+		 *@brief Sums the totals of records 1 through idx.
+		 *@param idx The 1-based index of the last record to include.
+		 *@return The prefix sum of the record totals.
+		 */
+		Money fenwickSum(int idx) {
+			Money sum;
+
+			for(; idx > 0; idx -= idx & -idx) {
+				sum += fenwick[idx];
+			}//end for
+
+			return sum;
+		}//end fenwickSum
+
+		/**
+		 *@brief Adds or removes a record's total from its yearly and quarterly buckets.
+		 *@param record The record whose total is being applied.
+		 *@param sign 1 to add the record, -1 to remove it.
+		 */
+		void applyBuckets(DataRecord &record, int sign) {
+			Money amount = (sign > 0) ? record.getTotal() : -record.getTotal();
+			int year, quarter;
+
+			if( getBucket(record, year, quarter) ) {
+				space->yearTotals[year] += amount;
+				space->quarterTotals[year][quarter] += amount;
+			}//end if
+
+		}//end applyBuckets
+
+	public:
+
+		/**
+		 *@brief Constructs the RevenueAggregates object. The shared memory is attached by init().
+		 *@param key The key for the shared memory space.
+		 */
+		RevenueAggregates(int key) {
+			this->key = key;
+			this->space = NULL;
+			this->fenwick = NULL;
+		}//end constructor
+
+		/**
+		 *@brief Creates and attaches the shared memory space, sizing its Fenwick tree for twice the records in the
+		 *       bin file (and at least MINAGGRECORDS), then rebuilds the aggregates from the bin file.
+		 *@param binPtr The file pointer to the binary data file.
+		 *@param headerSize Bytes before the file's first record slot.
+		 *@return Whether the shared memory space was created and attached.
+		 */
+		bool init(FILE * binPtr, long headerSize = 0) {
+			const int BLOCKRECORDS = 256;
+			char block[BLOCKRECORDS][MAXRECORDSIZE+1];
+			int numRead, capacity;
+			long fileSize;
+
+			//Leave room for the dataset to double before the tree stops covering new records
+			fseek(binPtr, 0, SEEK_END);
+			fileSize = max(ftell(binPtr) - headerSize, 0L);
+			capacity = (int) min<long>(max<long>(MINAGGRECORDS, 2 * (fileSize / (MAXRECORDSIZE+1) ) ), INT_MAX / 2);
+
+			//Remove any stale space left behind by a previous server (possibly of a different size)
+			if( (shmID = shmget(key, 0, 0) ) != -1) {
+				shmctl(shmID, IPC_RMID, NULL);
+			}//end if
+
+			if( (shmID = shmget(key, sizeof(aggregateSpace) + sizeof(Money) * (capacity + 1), IPC_CREAT | 0666) ) == -1) {
+				perror("RevenueAggregates shmget error");
+				return false;
+			}//end if
+
+			if( (space = (aggregateSpace *) shmat(shmID, NULL, 0) ) == (void *) -1) {
+				perror("RevenueAggregates shmat error");
+				space = NULL;
+				return false;
+			}//end if
+
+			new (space) aggregateSpace();
+			space->capacity = capacity;
+			fenwick = (Money *) (space + 1);
+			uninitialized_fill_n(fenwick, capacity + 1, Money() );
+			fseek(binPtr, headerSize, SEEK_SET);
+
+			//Fill the buckets and the Fenwick leaves in a single pass
+			while( (numRead = fread(block, MAXRECORDSIZE+1, BLOCKRECORDS, binPtr) ) > 0) {
+
+				for(int i = 0; i < numRead; i++) {
+					DataRecord record;
+
+					//Malformed records still occupy a slot but contribute nothing
+					if( record.parse(block[i]) ) {
+						applyBuckets(record, 1);
+					}//end if
+
+					space->numRecords++;
+
+					if(space->numRecords <= capacity) {
+						fenwick[space->numRecords] = record.getTotal();
+					}//end if
+
+				}//end for
+
+			}//end while
+
+			//Build the Fenwick tree in place in O(n)
+			for(int i = 1; i <= capacity; i++) {
+				int parent = i + (i & -i);
+
+				if(parent <= capacity) {
+					fenwick[parent] += fenwick[i];
+				}//end if
+
+			}//end for
+
+			return true;
+		}//end init
+
+		/**
+		 *@brief Applies a new or updated record to the aggregates.
+		 *@param idx The 1-based index of the record.
+		 *@param oldRecord The record previously stored at idx (NULL when the record is new).
+		 *@param newRecord The record now stored at idx.
+		 */
+		void recordChanged(int idx, DataRecord * oldRecord, DataRecord &newRecord) {
+			Money delta = newRecord.getTotal();
+
+			if(oldRecord != NULL) {
+				applyBuckets(*oldRecord, -1);
+				delta -= oldRecord->getTotal();
+			} else if(idx > space->numRecords) {
+				space->numRecords = idx;
+			}//end if
+
+			applyBuckets(newRecord, 1);
+			fenwickAdd(idx, delta);
+
+		}//end recordChanged
+
+		/**
+		 *@brief Removes a record from the aggregates, leaving its slot (and so the record count) in place.
+		 *@param idx The 1-based index of the record.
+		 *@param oldRecord The record previously stored at idx.
+		 */
+		void recordRemoved(int idx, DataRecord &oldRecord) {
+			applyBuckets(oldRecord, -1);
+			fenwickAdd(idx, -oldRecord.getTotal() );
+
+		}//end recordRemoved
+
+		/**
+		 *@brief Retrieves the number of records covered by the aggregates.
+		 *@return The number of records.
+		 */
+		int getNumRecords() {
+			return space->numRecords;
+		}//end getNumRecords
+
+		/**
+		 *@brief Retrieves the total revenue of a year.
+		 *@param year The 2-digit year.
+		 *@param sum Set to the year's total revenue.
+		 *@return Whether the year was valid.
+		 */
+		bool getYearTotal(int year, Money &sum) {
+			if(year < 0 || year >= NUMAGGYEARS) {
+				return false;
+			}//end if
+
+			sum = space->yearTotals[year];
+			return true;
+		}//end getYearTotal
+
+		/**
+		 *@brief Retrieves the total revenue of a quarter.
+		 *@param year The 2-digit year.
+		 *@param quarter The quarter (1-4).
+		 *@param sum Set to the quarter's total revenue.
+		 *@return Whether the year and quarter were valid.
+		 */
+		bool getQuarterTotal(int year, int quarter, Money &sum) {
+			if(year < 0 || year >= NUMAGGYEARS || quarter < 1 || quarter > 4) {
+				return false;
+			}//end if
+
+			sum = space->quarterTotals[year][quarter-1];
+			return true;
+		}//end getQuarterTotal
+
+		/**
+		 *@brief Retrieves the sum of the totals of the first records.
+		 *@param idx The 1-based index of the last record in the sum (0 for an empty sum).
+		 *@param sum Set to the prefix sum.
+		 *@return Whether the records were all present and covered by the Fenwick tree.
+		 */
+		bool getPrefixTotal(int idx, Money &sum) {
+			if(idx < 0 || idx > space->numRecords || idx > space->capacity) {
+				return false;
+			}//end if
+
+			sum = fenwickSum(idx);
+			return true;
+		}//end getPrefixTotal
+
+		/**
+		 *@brief Retrieves the rolling sum of record totals over a window ending at a record.
+		 *@param endIdx The 1-based index of the last record in the window.
+		 *@param numMonths The number of records (months) in the window.
+		 *@param sum Set to the rolling sum.
+		 *@return Whether the window was valid.
+		 */
+		bool getRollingTotal(int endIdx, int numMonths, Money &sum) {
+			int startIdx = endIdx - numMonths;
+
+			if(numMonths < 1 || endIdx < 1 || endIdx > space->numRecords || endIdx > space->capacity) {
+				return false;
+			}//end if
+
+			//Windows reaching past the first record are truncated
+			if(startIdx < 0) {
+				startIdx = 0;
+			}//end if
+
+			sum = fenwickSum(endIdx) - fenwickSum(startIdx);
+			return true;
+		}//end getRollingTotal
+
+};//end RevenueAggregates
+#endif
@@ -8,6 +8,7 @@
 #ifndef SEMAPHORESET
 #define SEMAPHORESET
 
+#include <cerrno>
 #include <cstddef>
 #include <iostream>
 #include <sys/ipc.h>
@@ -100,7 +101,7 @@ public:
     semBuf.sem_op = -1;
     semBuf.sem_flg = 0;
     
-    return semop(semID, &semBuf, 1);
+    return operate(&semBuf, 1);
   }//end wait
   
   /**
@@ -116,9 +117,38 @@ public:
     semBuf.sem_op = 1;
     semBuf.sem_flg = 0;
     
-    return semop(semID, &semBuf, 1);
+    return operate(&semBuf, 1);
   }//end signal
   
+  /**
+   *@brief Atomically applies several operations to the set; none are applied until all can be.
+   *@param ops The operations to be applied.
+   *@param numOps The number of operations.
+   *@return 0 on success, -1 on failure.
+   */
+  int operate(struct sembuf ops[], unsigned numOps) {
+    int result;
+    
+    //semop is never restarted after a signal handler runs, so retry it ourselves
+    while( (result = semop(semID, ops, numOps) ) == -1 && errno == EINTR);
+    
+    return result;
+  }//end operate
+
+  /**
+   *@brief Applies several operations to the set atomically if they can all be applied without waiting.
+   *@param ops The operations to be applied (IPC_NOWAIT is added to each one's flags).
+   *@param numOps The number of operations.
+   *@return 0 on success, -1 on failure (errno is EAGAIN if the operations would have waited).
+   */
+  int tryOperate(struct sembuf ops[], unsigned numOps) {
+    for(unsigned i = 0; i < numOps; i++) {
+      ops[i].sem_flg |= IPC_NOWAIT;
+    }//end for
+    
+    return operate(ops, numOps);
+  }//end tryOperate
+  
   /**
    *@brief Retrives the value of all semaphores in the set.
    *@return The array of semaphore values on success, NULL on failure.
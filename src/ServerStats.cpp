@@ -0,0 +1,409 @@
+/**
+ *@file ServerStats.cpp
+ *@author Griffin Nye
+ *@brief Server instrumentation kept in System V shared memory: per-command latency
+ *       histograms, time spent waiting in each monitor acquire, file I/O times, bytes
+ *       sent/received, connection counts, and a replica's replication progress, aggregated
+ *       across every child server. Recording
+ *       is a clock read and a few relaxed atomic adds, and is skipped entirely until init()
+ *       attaches the space. Readers never lock, so reporting never contends with recording.
+ */
+
+
+#ifndef SERVERSTATS
+#define SERVERSTATS
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <string>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <vector>
+
+#include "LatencyHistogram.cpp"
+
+using namespace std;
+
+/*! Commands whose latencies are tracked (STATOTHER collects unrecognized commands). */
+enum STATCMD {STATCNT, STATGET, STATFIX, STATNEW, STATLOG, STATFLT, STATAGG, STATBLK, STATSTS, STATTRC, STATPUT, STATLAG, STATJRN, STATWCH, STATSYN, STATCMP, STATHLO, STATOTHER, NUMSTATCMDS};
+/*! Monitor acquires whose waits are tracked. */
+enum STATWAIT {BINREADWAIT, BINWRITEWAIT, LOGREADWAIT, LOGWRITEWAIT, NUMSTATWAITS};
+/*! File operations whose times are tracked. */
+enum STATIO {BINREADIO, BINWRITEIO, LOGREADIO, LOGWRITEIO, NUMSTATIOS};
+
+/**
+ *@brief Records server timings and traffic into shared histograms and reports snapshots of them.
+ *
+ * All values are recorded in nanoseconds. Each process keeps its own byte counts, which are
+ * added to the shared totals once per command rather than once per message.
+ */
+class ServerStats {
+	private:
+
+		/**
+		 *@brief Layout of the shared memory space holding the statistics.
+		 */
+		struct statsSpace {
+			uint64_t startTime;
+			uint64_t bytesReceived;
+			uint64_t bytesSent;
+			int64_t activeConnections;
+			uint64_t totalConnections;
+			int64_t replicaHead;
+			uint64_t replicaSyncTime;
+			LatencyHistogram commands[NUMSTATCMDS];
+			LatencyHistogram waits[NUMSTATWAITS];
+			LatencyHistogram fileIO[NUMSTATIOS];
+		};
+
+		int shmID, key;
+		statsSpace * space;
+		uint64_t pendingReceived, pendingSent;
+
+		/**
+		 *@brief Formats a histogram as a snapshot line.
+		 *@param name The name of the metric.
+		 *@param histogram The histogram to be reported (copied first, as it may be updated concurrently).
+		 *@return The line "name,count,mean_us,p50_us,p99_us,max_us".
+		 */
+		static string histogramLine(string name, const LatencyHistogram &histogram) {
+			LatencyHistogram copy = histogram;
+			char line[96];
+
+			snprintf(line, sizeof(line), "%s,%llu,%.1f,%.1f,%.1f,%.1f", name.c_str(), (unsigned long long) copy.getCount(), copy.getMean() / 1e3,
+			         copy.getPercentile(50) / 1e3, copy.getPercentile(99) / 1e3, copy.getMax() / 1e3);
+
+			return line;
+		}//end histogramLine
+
+	public:
+
+		/**
+		 *@brief Constructs the ServerStats object. Nothing is recorded until init() attaches the shared memory.
+		 *@param key The key for the shared memory space.
+		 */
+		ServerStats(int key) {
+			this->key = key;
+			this->space = NULL;
+			pendingReceived = pendingSent = 0;
+		}//end constructor
+
+		/**
+		 *@brief Creates and attaches an empty shared memory space (inherited by every child server).
+		 *@return Whether the shared memory space was created and attached.
+		 */
+		bool init() {
+
+			//Remove any stale space left behind by a previous server (possibly of a different size)
+			if( (shmID = shmget(key, 0, 0) ) != -1) {
+				shmctl(shmID, IPC_RMID, NULL);
+			}//end if
+
+			if( (shmID = shmget(key, sizeof(statsSpace), IPC_CREAT | 0666) ) == -1) {
+				perror("ServerStats shmget error");
+				return false;
+			}//end if
+
+			if( (space = (statsSpace *) shmat(shmID, NULL, 0) ) == (void *) -1) {
+				perror("ServerStats shmat error");
+				space = NULL;
+				return false;
+			}//end if
+
+			new (space) statsSpace();
+			space->startTime = now();
+
+			return true;
+		}//end init
+
+		/**
+		 *@brief Reads the monotonic clock, or returns 0 without reading it if recording is disabled.
+		 *@return The current time in nanoseconds.
+		 */
+		uint64_t now() {
+			struct timespec ts;
+
+			if(space == NULL) {
+				return 0;
+			}//end if
+
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+
+			return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+		}//end now
+
+		/**
+		 *@brief Maps a 3 letter command to its STATCMD.
+		 *@param cmd The command.
+		 *@return The command's STATCMD, or STATOTHER if it is not recognized.
+		 */
+		static int commandOf(const char cmd[]) {
+			for(int i = 0; i < STATOTHER; i++) {
+				if(strncmp(cmd, commandName(i), 3) == 0) {
+					return i;
+				}//end if
+			}//end for
+
+			return STATOTHER;
+		}//end commandOf
+
+		/**
+		 *@brief Retrieves the name of a STATCMD.
+		 *@param command The STATCMD.
+		 *@return The command's 3 letter name, or "other".
+		 */
+		static const char * commandName(int command) {
+			const char * NAMES[NUMSTATCMDS] = {"CNT", "GET", "FIX", "NEW", "LOG", "FLT", "AGG", "BLK", "STS", "TRC", "PUT", "LAG", "JRN", "WCH", "SYN", "CMP", "HLO", "other"};
+
+			return NAMES[command];
+		}//end commandName
+
+		/**
+		 *@brief Retrieves the name of a STATWAIT.
+		 *@param wait The STATWAIT.
+		 *@return The name of the monitor acquire.
+		 */
+		static const char * waitName(int wait) {
+			const char * NAMES[NUMSTATWAITS] = {"binRead", "binWrite", "logRead", "logWrite"};
+
+			return NAMES[wait];
+		}//end waitName
+
+		/**
+		 *@brief Retrieves the name of a STATIO.
+		 *@param io The STATIO.
+		 *@return The name of the file operation.
+		 */
+		static const char * ioName(int io) {
+			const char * NAMES[NUMSTATIOS] = {"binRead", "binWrite", "logRead", "logWrite"};
+
+			return NAMES[io];
+		}//end ioName
+
+		/**
+		 *@brief Whether init() attached the shared memory space, i.e. whether anything is being recorded.
+		 *@return Whether statistics are enabled.
+		 */
+		bool isEnabled() {
+			return space != NULL;
+		}//end isEnabled
+
+		/**
+		 *@brief Records the latency of a handled command, along with the bytes it moved.
+		 *@param command The command's STATCMD.
+		 *@param start The time the command was received, as returned by now().
+		 */
+		void recordCommand(int command, uint64_t start) {
+			if(space == NULL) {
+				return;
+			}//end if
+
+			space->commands[command].recordShared(now() - start);
+			__atomic_fetch_add(&space->bytesReceived, pendingReceived, __ATOMIC_RELAXED);
+			__atomic_fetch_add(&space->bytesSent, pendingSent, __ATOMIC_RELAXED);
+			pendingReceived = pendingSent = 0;
+		}//end recordCommand
+
+		/**
+		 *@brief Records the time spent waiting to acquire a monitor.
+		 *@param wait The acquire's STATWAIT.
+		 *@param start The time the acquire began, as returned by now().
+		 */
+		void recordWait(int wait, uint64_t start) {
+			if(space != NULL) {
+				space->waits[wait].recordShared(now() - start);
+			}//end if
+		}//end recordWait
+
+		/**
+		 *@brief Records the time taken by a file operation.
+		 *@param io The operation's STATIO.
+		 *@param start The time the operation began, as returned by now().
+		 */
+		void recordIO(int io, uint64_t start) {
+			if(space != NULL) {
+				space->fileIO[io].recordShared(now() - start);
+			}//end if
+		}//end recordIO
+
+		/**
+		 *@brief Counts a newly accepted client connection.
+		 */
+		void connectionOpened() {
+			if(space != NULL) {
+				__atomic_fetch_add(&space->activeConnections, 1, __ATOMIC_RELAXED);
+				__atomic_fetch_add(&space->totalConnections, 1, __ATOMIC_RELAXED);
+			}//end if
+		}//end connectionOpened
+
+		/**
+		 *@brief Counts a client connection as closed.
+		 */
+		void connectionClosed() {
+			if(space != NULL) {
+				__atomic_fetch_sub(&space->activeConnections, 1, __ATOMIC_RELAXED);
+			}//end if
+		}//end connectionClosed
+
+		/**
+		 *@brief Records what a replica has heard from its primary.
+		 *@param head The number of entries in the primary's journal.
+		 *@param caughtUp Whether the replica has applied all of them, i.e. was up to date as of now.
+		 */
+		void replicaSynced(int64_t head, bool caughtUp) {
+			if(space != NULL) {
+				__atomic_store_n(&space->replicaHead, head, __ATOMIC_RELAXED);
+
+				if(caughtUp) {
+					__atomic_store_n(&space->replicaSyncTime, now(), __ATOMIC_RELAXED);
+				}//end if
+
+			}//end if
+		}//end replicaSynced
+
+		/**
+		 *@brief Counts bytes received from the client (added to the shared total by recordCommand).
+		 *@param numBytes The number of bytes received.
+		 */
+		void addReceived(uint64_t numBytes) {
+			pendingReceived += numBytes;
+		}//end addReceived
+
+		/**
+		 *@brief Counts bytes sent to the client (added to the shared total by recordCommand).
+		 *@param numBytes The number of bytes sent.
+		 */
+		void addSent(uint64_t numBytes) {
+			pendingSent += numBytes;
+		}//end addSent
+
+		/**
+		 *@brief Reports every statistic as csv lines, reading the shared memory without locking.
+		 *@return The snapshot lines: a header, one line per histogram, then the uptime and byte counters.
+		 */
+		vector<string> snapshot() {
+			vector<string> lines;
+
+			if(space == NULL) {
+				return lines;
+			}//end if
+
+			lines.push_back("metric,count,mean_us,p50_us,p99_us,max_us");
+
+			for(int i = 0; i < NUMSTATCMDS; i++) {
+				lines.push_back( histogramLine(string("cmd.") + commandName(i), space->commands[i]) );
+			}//end for
+
+			for(int i = 0; i < NUMSTATWAITS; i++) {
+				lines.push_back( histogramLine(string("wait.") + waitName(i), space->waits[i]) );
+			}//end for
+
+			for(int i = 0; i < NUMSTATIOS; i++) {
+				lines.push_back( histogramLine(string("io.") + ioName(i), space->fileIO[i]) );
+			}//end for
+
+			lines.push_back("uptime_s," + to_string( getUptime() ) );
+			lines.push_back("connections.active," + to_string( getActiveConnections() ) );
+			lines.push_back("connections.total," + to_string( getTotalConnections() ) );
+			lines.push_back("bytes.received," + to_string( getBytesReceived() ) );
+			lines.push_back("bytes.sent," + to_string( getBytesSent() ) );
+
+			if(getReplicaStaleness() != -1) {
+				lines.push_back("replica.head," + to_string( getReplicaHead() ) );
+				lines.push_back("replica.staleness_ms," + to_string( getReplicaStaleness() / 1000000) );
+			}//end if
+
+			return lines;
+		}//end snapshot
+
+		/**
+		 *@brief Copies a command's latency histogram out of the shared memory.
+		 *@param command The STATCMD.
+		 *@return The command's latency histogram (ns).
+		 */
+		LatencyHistogram getCommand(int command) {
+			return space == NULL ? LatencyHistogram() : space->commands[command];
+		}//end getCommand
+
+		/**
+		 *@brief Copies a monitor acquire's wait histogram out of the shared memory.
+		 *@param wait The STATWAIT.
+		 *@return The acquire's wait histogram (ns).
+		 */
+		LatencyHistogram getWait(int wait) {
+			return space == NULL ? LatencyHistogram() : space->waits[wait];
+		}//end getWait
+
+		/**
+		 *@brief Copies a file operation's time histogram out of the shared memory.
+		 *@param io The STATIO.
+		 *@return The operation's time histogram (ns).
+		 */
+		LatencyHistogram getIO(int io) {
+			return space == NULL ? LatencyHistogram() : space->fileIO[io];
+		}//end getIO
+
+		/**
+		 *@brief Retrieves the number of seconds since init().
+		 *@return The server's uptime in seconds.
+		 */
+		uint64_t getUptime() {
+			return space == NULL ? 0 : (now() - space->startTime) / 1000000000ULL;
+		}//end getUptime
+
+		/**
+		 *@brief Retrieves the number of client connections currently open.
+		 *@return The number of active connections.
+		 */
+		int64_t getActiveConnections() {
+			return space == NULL ? 0 : __atomic_load_n(&space->activeConnections, __ATOMIC_RELAXED);
+		}//end getActiveConnections
+
+		/**
+		 *@brief Retrieves the number of client connections accepted since init().
+		 *@return The number of connections accepted.
+		 */
+		uint64_t getTotalConnections() {
+			return space == NULL ? 0 : __atomic_load_n(&space->totalConnections, __ATOMIC_RELAXED);
+		}//end getTotalConnections
+
+		/**
+		 *@brief Retrieves the number of bytes received from clients by completed commands.
+		 *@return The number of bytes received.
+		 */
+		uint64_t getBytesReceived() {
+			return space == NULL ? 0 : __atomic_load_n(&space->bytesReceived, __ATOMIC_RELAXED);
+		}//end getBytesReceived
+
+		/**
+		 *@brief Retrieves the number of bytes sent to clients by completed commands.
+		 *@return The number of bytes sent.
+		 */
+		uint64_t getBytesSent() {
+			return space == NULL ? 0 : __atomic_load_n(&space->bytesSent, __ATOMIC_RELAXED);
+		}//end getBytesSent
+
+		/**
+		 *@brief Retrieves the number of entries in the primary's journal, when this server last heard from it.
+		 *@return The primary's journal length (0 on a primary, or before a replica first hears from its primary).
+		 */
+		int64_t getReplicaHead() {
+			return space == NULL ? 0 : __atomic_load_n(&space->replicaHead, __ATOMIC_RELAXED);
+		}//end getReplicaHead
+
+		/**
+		 *@brief Retrieves how far behind its primary a replica's dataset may be: the time since the replica
+		 *       last held every write its primary had journaled.
+		 *@return The staleness in nanoseconds, or -1 if this server has never caught up with a primary.
+		 */
+		int64_t getReplicaStaleness() {
+			uint64_t syncTime = (space == NULL) ? 0 : __atomic_load_n(&space->replicaSyncTime, __ATOMIC_RELAXED);
+
+			return syncTime == 0 ? -1 : (int64_t) (now() - syncTime);
+		}//end getReplicaStaleness
+
+};//end ServerStats
+#endif
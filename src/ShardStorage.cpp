@@ -0,0 +1,212 @@
+/**
+ *@file ShardStorage.cpp
+ *@author Griffin Nye
+ *@brief The server's file operations on the record slots of a shard and on the log file.
+ *       Each read or write is timed into the server statistics and marked in the trace, and
+ *       record writes keep the shard's aggregates current.
+ */
+
+
+#ifndef SHARDSTORAGE
+#define SHARDSTORAGE
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "DataRecord.cpp"
+#include "msgPackets.cpp"
+#include "ServerStats.cpp"
+#include "ShardedDataset.cpp"
+#include "TraceBuffer.cpp"
+
+using namespace std;
+
+/*! Statistics the file operations are timed into; defined by each program including this unit. */
+extern ServerStats serverStats;
+/*! Trace the file operations are marked in; defined by each program including this unit. */
+extern TraceBuffer tracer;
+
+/**
+ *@brief Marks the start of a file operation in the trace.
+ *@param io The operation's STATIO.
+ *@return The time the operation began, to be passed to endIO.
+ */
+uint64_t beginIO(int io);
+
+/**
+ *@brief Empties the slot of a record in a shard, removing the record from the shard's aggregates.
+ *@param shard The shard holding the record.
+ *@param idx The index of the record to be removed within the shard.
+ *@return The success of removing the record (slots that are already empty succeed).
+ */
+bool clearRecord(BinShard &shard, int idx);
+
+/**
+ *@brief Marks the end of a file operation in the trace and records its duration in the server statistics.
+ *@param io The operation's STATIO.
+ *@param start The time the operation began, as returned by beginIO.
+ */
+void endIO(int io, uint64_t start);
+
+/**
+ *@brief Retrieves a record with the provided index from the shard specified.
+ *@param shard The shard holding the record.
+ *@param idx Index of the desired record within the shard
+ *@return The desired record in C-string format, or an empty string if its slot could not be read in full
+ */
+string getRecord(BinShard &shard, int idx);
+
+/**
+ *@brief Calculates and returns the number of log records stored in the server log file.
+ *@param logPtr The file pointer to the server log file.
+ *@return The total number of log records stored in log server file
+ */
+int getTotalLogRecords(FILE *logPtr);
+
+/**
+ *@brief Calculates and returns the number of records stored in a shard's bin file.
+ *@param shard The shard.
+ *@return The total number of records stored in the shard's bin file.
+ */
+int getTotalRecords(BinShard &shard);
+
+/**
+ *@brief Updates the record at the provided index of a shard, along with the shard's aggregates.
+ *@param shard The shard holding the record.
+ *@param idx The index of the record to be updated within the shard.
+ *@param record The updated record string.
+ *@param recordSize The size of the updated record string.
+ *@return The success of updating the record.
+ */
+bool updateRecord(BinShard &shard, int idx, char record[], int recordSize);
+
+
+//Marks the start of a file operation in the trace.
+uint64_t beginIO(int io) {
+	tracer.begin(TRACEIO, io);
+	
+	return serverStats.now();
+}//end beginIO
+
+
+//Empties the slot of a record in a shard, removing the record from the shard's aggregates.
+bool clearRecord(BinShard &shard, int idx) {
+  char emptySlot[MAXRECORDSIZE+1] = {0};
+  int charsWritten;
+  DataRecord oldRecord;
+  string oldSlot = (idx <= shard.aggregates.getNumRecords() ) ? getRecord(shard, idx) : "";
+  
+  //Slots past the end of the shard, or already emptied, hold no record
+  if(oldSlot.empty() ) {
+    return true;
+  }//end if
+  
+  //Zero the slot in place (the record count is left alone, as later records keep their indexes)
+  uint64_t ioStart = beginIO(BINWRITEIO);
+  charsWritten = pwrite(fileno(shard.binPtr), emptySlot, sizeof(emptySlot), shard.headerSize + (off_t) (MAXRECORDSIZE+1) * (idx - 1) );
+  endIO(BINWRITEIO, ioStart);
+  
+  //Malformed records contributed nothing to the aggregates
+  if(charsWritten > 0 && oldRecord.parse(oldSlot) ) {
+    shard.aggregates.recordRemoved(idx, oldRecord);
+  }//end if
+  
+  return charsWritten > 0;
+}//end clearRecord
+
+
+//Marks the end of a file operation in the trace and records its duration in the server statistics.
+void endIO(int io, uint64_t start) {
+	serverStats.recordIO(io, start);
+	tracer.end(TRACEIO, io);
+}//end endIO
+
+
+//Retrieves a record with the provided index from the shard specified.
+string getRecord(BinShard &shard, int idx) {
+	char record[MAXRECORDSIZE+1]; 
+ 
+  uint64_t ioStart = beginIO(BINREADIO);
+  
+  //Read the record at its offset in one call, leaving the shared file offset alone
+  ssize_t charsRead = pread(fileno(shard.binPtr), record, sizeof(record), shard.headerSize + (off_t) (MAXRECORDSIZE + 1) * (idx - 1) );
+  endIO(BINREADIO, ioStart);
+  
+  //A short read leaves the slot unterminated, so it is reported like an empty slot
+  if(charsRead != (ssize_t) sizeof(record) ) {
+    return "";
+  }//end if
+  
+  record[MAXRECORDSIZE] = '\0';
+  string recordBuf(record);
+  
+  return recordBuf;
+}//end getRecord
+
+
+//Calculates and returns the number of log records stored in the server log file.
+int getTotalLogRecords(FILE *logPtr) {
+  char logRecord[MAXLOGRECORDSIZE];
+  int ctr = 0;
+  uint64_t ioStart = beginIO(LOGREADIO);
+  
+	//Set file pointer to beginning of file
+	rewind(logPtr);
+	
+  //Continue reading log records until end of file is reached.
+  while( fgets(logRecord, sizeof(logRecord)/sizeof(char), logPtr) != NULL ) {
+    ctr++;
+  }//end while
+  
+  endIO(LOGREADIO, ioStart);
+  
+  return ctr;
+}//end getTotalLogRecords
+
+
+//Calculates and returns the number of records stored in a shard's bin file.
+int getTotalRecords(BinShard &shard) {
+  struct stat binStat;
+  
+  //Records are fixed-size, so the count follows from the file size
+  fflush(shard.binPtr);
+  
+  if( fstat(fileno(shard.binPtr), &binStat) == -1) {
+    return 0;
+  }//end if
+
+  return (binStat.st_size - shard.headerSize) / (MAXRECORDSIZE + 1);
+}//end getTotalRecords
+
+
+//Updates the record at the provided index of a shard, along with the shard's aggregates.
+bool updateRecord(BinShard &shard, int idx, char record[], int recordSize) {
+  int charsWritten;
+  DataRecord newRecord, oldRecord;
+  string oldSlot = (idx <= shard.aggregates.getNumRecords() ) ? getRecord(shard, idx) : "";
+  bool exists = !oldSlot.empty();
+  
+  //Reject records that cannot be parsed before touching the file (empty slots hold no record to replace)
+  if( !newRecord.parse( string_view(record, strnlen(record, recordSize) ) ) || (exists && !oldRecord.parse(oldSlot) ) ) {
+    return false;
+  }//end if
+  
+  //Write updated record to file at its offset in one call
+  uint64_t ioStart = beginIO(BINWRITEIO);
+  charsWritten = pwrite(fileno(shard.binPtr), record, recordSize, shard.headerSize + (off_t) (MAXRECORDSIZE+1) * (idx - 1) );
+  endIO(BINWRITEIO, ioStart);
+  
+  //Apply the change to the shared aggregates in O(log n)
+  if(charsWritten > 0) {
+    shard.aggregates.recordChanged(idx, exists ? &oldRecord : NULL, newRecord);
+  }//end if
+  
+  return charsWritten > 0;
+}//end updateRecord
+
+#endif
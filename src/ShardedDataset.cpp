@@ -0,0 +1,470 @@
+/**
+ *@file ShardedDataset.cpp
+ *@author Griffin Nye
+ *@brief The dataset split across one or more bin files (shards), each guarded by its own
+ *       monitor and summarized by its own revenue aggregates. Records keep their single,
+ *       global numbering: record n lives in shard (n-1) % N, so consecutive records (and so
+ *       consecutive appends) fall in different shards and writers to different shards never
+ *       wait on each other. Every write is also appended to the dataset's WriteJournal, which
+ *       replicas follow.
+ */
+
+
+#ifndef SHARDEDDATASET
+#define SHARDEDDATASET
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "Coroutine.cpp"
+#include "LogBinRWSemMonitor.cpp"
+#include "msgPackets.cpp"
+#include "RevenueAggregates.cpp"
+#include "SemaphoreSet.cpp"
+#include "ServerStats.cpp"
+#include "TraceBuffer.cpp"
+#include "WriteJournal.cpp"
+
+using namespace std;
+
+/*! Largest number of shards the dataset may be split into. */
+#define MAXSHARDS 16
+/*! Distance between the IPC keys of consecutive shards (above any port, so keys never collide with another server's). */
+#define SHARDKEYSTRIDE 65536
+/*! Contents of the header slot that starts every shard file. */
+#define SHARDHEADERFORMAT "SHARD %d OF %d"
+/*! Number of records read (and journal entries written) at a time while seeding the journal. */
+#define SEEDBLOCKRECORDS 4096
+/*! Number of the journal's newest entries whose commit times are checked against the shard files. */
+#define JOURNALCHECKENTRIES 256
+
+/**
+ *@brief One bin file of the dataset, with the monitor and aggregates that guard and summarize it.
+ */
+struct BinShard {
+	FILE * binPtr;                /*!< The shard's bin file. */
+	long headerSize;              /*!< Bytes before the shard's first record slot. */
+	LogBinRWSemMonitor monitor;   /*!< Guards the shard's records (shard 0's also guards the log). */
+	RevenueAggregates aggregates; /*!< Aggregates over the shard's records, in the shard's own order. */
+
+	/**
+	 *@brief Constructs a shard with no file. The monitor and aggregates are created with the shard's IPC key.
+	 *@param key The IPC key for the shard's semaphores and shared memory.
+	 */
+	BinShard(int key) : monitor(key), aggregates(key) {
+		binPtr = NULL;
+		headerSize = 0;
+	}//end constructor
+};
+
+/**
+ *@brief Maps global record indexes onto shards and owns every shard of the dataset.
+ *
+ * A dataset of one shard is the bin file itself, unchanged. A dataset of N > 1 shards is kept
+ * in N files named after the bin file (gameRevenue.0.bin, ...), created from it on first use,
+ * each starting with a header slot naming its shard. Appends are serialized by a single
+ * appender lock, since the next index decides which shard is written.
+ */
+class ShardedDataset {
+	private:
+		deque<BinShard> shards;
+		SemaphoreSet appendSem;
+		WriteJournal journal;
+		bool readOnly;
+
+		/**
+		 *@brief Builds the filename of a shard from the bin file's.
+		 *@param binFile Filename of the unsharded bin file.
+		 *@param shard The shard.
+		 *@return The shard's filename.
+		 */
+		static string shardName(string binFile, int shard) {
+			size_t dot = binFile.rfind('.');
+
+			if(dot == string::npos) {
+				return binFile + "." + to_string(shard);
+			}//end if
+
+			return binFile.substr(0, dot) + "." + to_string(shard) + binFile.substr(dot);
+		}//end shardName
+
+		/**
+		 *@brief Builds the filename of the journal from the bin file's.
+		 *@param binFile Filename of the unsharded bin file.
+		 *@return The journal's filename.
+		 */
+		static string journalName(string binFile) {
+			return binFile.substr(0, binFile.rfind('.') ) + ".journal";
+		}//end journalName
+
+		/**
+		 *@brief Creates the shard files from the unsharded bin file, dealing its records out in order.
+		 *@param binFile Filename of the unsharded bin file.
+		 *@param numShards The number of shards.
+		 *@return Whether every shard file was written.
+		 */
+		static bool split(string binFile, int numShards) {
+			char slot[MAXRECORDSIZE+1];
+			FILE * inPtr = fopen(binFile.c_str(), "rb");
+			FILE * outPtrs[MAXSHARDS];
+			bool success = inPtr != NULL;
+
+			for(int i = 0; i < numShards; i++) {
+				outPtrs[i] = fopen(shardName(binFile, i).c_str(), "wb");
+				success = success && outPtrs[i] != NULL;
+
+				//Every shard starts with its header slot
+				memset(slot, 0, sizeof(slot) );
+				snprintf(slot, sizeof(slot), SHARDHEADERFORMAT, i, numShards);
+
+				if(outPtrs[i] != NULL) {
+					fwrite(slot, sizeof(slot), 1, outPtrs[i]);
+				}//end if
+
+			}//end for
+
+			//Record n goes to shard (n-1) % numShards
+			for(long n = 0; success && fread(slot, sizeof(slot), 1, inPtr) == 1; n++) {
+				success = fwrite(slot, sizeof(slot), 1, outPtrs[n % numShards]) == 1;
+			}//end for
+
+			for(int i = 0; i < numShards; i++) {
+				if(outPtrs[i] != NULL) {
+					success = fclose(outPtrs[i]) == 0 && success;
+				}//end if
+			}//end for
+
+			if(inPtr != NULL) {
+				fclose(inPtr);
+			}//end if
+
+			//Leave no partial shards behind to be mistaken for the dataset
+			if( !success) {
+				perror("Error splitting the bin file into shards");
+
+				for(int i = 0; i < numShards; i++) {
+					unlink(shardName(binFile, i).c_str() );
+				}//end for
+
+			}//end if
+
+			return success;
+		}//end split
+
+		/**
+		 *@brief Checks that a shard file's header names the shard it was opened as.
+		 *@param shard The shard.
+		 *@param numShards The number of shards the dataset is opened with.
+		 *@return Whether the header matches.
+		 */
+		bool checkHeader(int shard, int numShards) {
+			char header[MAXRECORDSIZE+1];
+			int headerShard = -1, headerNumShards = -1;
+
+			if( pread(fileno(shards[shard].binPtr), header, sizeof(header), 0) != sizeof(header) ) {
+				return false;
+			}//end if
+
+			header[MAXRECORDSIZE] = '\0';
+			sscanf(header, SHARDHEADERFORMAT, &headerShard, &headerNumShards);
+
+			return headerShard == shard && headerNumShards == numShards;
+		}//end checkHeader
+
+	public:
+
+		/**
+		 *@brief Constructs an empty, writable dataset. Nothing is opened until open().
+		 */
+		ShardedDataset() {
+			readOnly = false;
+		}//end constructor
+
+		/**
+		 *@brief Opens every shard of the dataset, splitting the bin file into shards if they do not exist yet.
+		 *@param binFile Filename of the unsharded bin file.
+		 *@param numShards The number of shards (1 uses the bin file itself).
+		 *@param baseKey The IPC key of shard 0; the other shards' keys follow it SHARDKEYSTRIDE apart.
+		 *@return Whether every shard and the journal were opened and the shards match the requested layout (the bin
+		 *        file is not opened unsharded once shard files exist, as they hold every write since the split).
+		 */
+		bool open(string binFile, int numShards, int baseKey) {
+
+			for(int i = 0; i < numShards; i++) {
+				shards.emplace_back(baseKey + SHARDKEYSTRIDE * i);
+			}//end for
+
+			appendSem = SemaphoreSet(baseKey + SHARDKEYSTRIDE * MAXSHARDS, 1, IPC_CREAT | 0777);
+
+			if( !journal.open( journalName(binFile) ) ) {
+				perror("Error opening the write journal");
+				return false;
+			}//end if
+
+			if(numShards == 1 && access(shardName(binFile, 0).c_str(), F_OK) == 0) {
+				cout << "The dataset is sharded in " << shardName(binFile, 0) << " and its siblings; start with the same -s." << endl;
+				return false;
+			} else if(numShards == 1) {
+				shards[0].binPtr = fopen(binFile.c_str(), "rb+");
+				return shards[0].binPtr != NULL;
+			}//end if
+
+			//The shards are created once and are the dataset from then on
+			if( access(shardName(binFile, 0).c_str(), F_OK) == -1 && !split(binFile, numShards) ) {
+				return false;
+			}//end if
+
+			for(int i = 0; i < numShards; i++) {
+				shards[i].headerSize = MAXRECORDSIZE + 1;
+
+				if( (shards[i].binPtr = fopen(shardName(binFile, i).c_str(), "rb+") ) == NULL) {
+					return false;
+				} else if( !checkHeader(i, numShards) ) {
+					cout << shardName(binFile, i) << " is not shard " << i << " of " << numShards << "." << endl;
+					return false;
+				}//end if
+
+			}//end for
+
+			return true;
+		}//end open
+
+		/**
+		 *@brief Initializes the monitors and builds the aggregates of every shard.
+		 *@return Whether every shard's aggregates were created.
+		 */
+		bool init() {
+			appendSem.set(0, 1);
+
+			for(size_t i = 0; i < shards.size(); i++) {
+				shards[i].monitor.init();
+
+				if( !shards[i].aggregates.init(shards[i].binPtr, shards[i].headerSize) ) {
+					return false;
+				}//end if
+
+			}//end for
+
+			return true;
+		}//end init
+
+		/**
+		 *@brief Checks that the journal belongs to the shard files. Every write is journaled right after it is
+		 *       made, so no shard file changed after the journal's newest entry was committed unless it was
+		 *       regenerated (or written) outside the server, and then the journal no longer replays to it.
+		 *@return Whether the journal is empty or no shard file changed after its newest entry.
+		 */
+		bool journalMatches() {
+			int64_t lastCommitTime = journal.getLastCommitTime(JOURNALCHECKENTRIES);
+			struct stat binStat;
+
+			for(size_t s = 0; s < shards.size() && lastCommitTime > 0; s++) {
+
+				if(fstat(fileno(shards[s].binPtr), &binStat) == -1 || (int64_t) binStat.st_mtim.tv_sec * 1000000000LL + binStat.st_mtim.tv_nsec > lastCommitTime) {
+					return false;
+				}//end if
+
+			}//end for
+
+			return true;
+		}//end journalMatches
+
+		/**
+		 *@brief Starts the journal of a dataset that has none with an entry for every record it holds, so a
+		 *       replica following the journal from its start ends up with the whole dataset. A journal left
+		 *       behind by an older copy of the shard files is emptied and started over. Only called before any
+		 *       child server is running.
+		 *@return Whether every record was journaled (a journal that belongs to the shard files is left alone).
+		 */
+		bool seedJournal() {
+			const int SLOTSIZE = MAXRECORDSIZE + 1;
+			vector<char> block(SEEDBLOCKRECORDS * SLOTSIZE);
+			vector<JournalEntry> entries;
+			bool success = true;
+
+			if(journal.getNumEntries() > 0 && journalMatches() ) {
+				return true;
+			} else if(journal.getNumEntries() > 0) {
+				cout << "The write journal is older than the dataset; journaling the dataset anew." << endl;
+
+				if( !journal.clear() ) {
+					perror("Error emptying the write journal");
+					return false;
+				}//end if
+
+			}//end if
+
+			for(size_t s = 0; s < shards.size() && success; s++) {
+				ssize_t bytesRead;
+
+				for(int first = 1; success && (bytesRead = pread(fileno(shards[s].binPtr), &block[0], block.size(), shards[s].headerSize + (off_t) SLOTSIZE * (first - 1) ) ) > 0; first += SEEDBLOCKRECORDS) {
+					entries.clear();
+
+					//Empty slots hold no record to replay
+					for(int i = 0; (i + 1) * SLOTSIZE <= bytesRead; i++) {
+						if(block[i * SLOTSIZE] != '\0') {
+							entries.push_back( WriteJournal::entry(globalIndex(s, first + i), &block[i * SLOTSIZE], MAXRECORDSIZE) );
+						}//end if
+					}//end for
+
+					success = entries.empty() || journal.append(&entries[0], entries.size() );
+				}//end for
+
+			}//end for
+
+			return success;
+		}//end seedJournal
+
+		/**
+		 *@brief Sets where the time spent waiting on every shard's monitor is recorded.
+		 *@param stats The server statistics, or NULL to stop recording.
+		 */
+		void setStats(ServerStats * stats) {
+			for(size_t i = 0; i < shards.size(); i++) {
+				shards[i].monitor.setStats(stats);
+			}//end for
+		}//end setStats
+
+		/**
+		 *@brief Sets where the waits on every shard's monitor are traced.
+		 *@param tracer The process's trace, or NULL to stop tracing.
+		 */
+		void setTracer(TraceBuffer * tracer) {
+			for(size_t i = 0; i < shards.size(); i++) {
+				shards[i].monitor.setTracer(tracer);
+			}//end for
+		}//end setTracer
+
+		/**
+		 *@brief Retrieves the number of shards.
+		 *@return The number of shards.
+		 */
+		int getNumShards() {
+			return shards.size();
+		}//end getNumShards
+
+		/**
+		 *@brief Retrieves a shard by number.
+		 *@param shard The shard (0 to getNumShards() - 1).
+		 *@return The shard.
+		 */
+		BinShard & getShard(int shard) {
+			return shards[shard];
+		}//end getShard
+
+		/**
+		 *@brief Retrieves the shard holding a record.
+		 *@param idx The record's 1-based global index (indexes below 1 map to shard 0).
+		 *@return The shard.
+		 */
+		BinShard & shardOf(int idx) {
+			return shards[idx >= 1 ? (idx - 1) % shards.size() : 0];
+		}//end shardOf
+
+		/**
+		 *@brief Retrieves a record's index within its shard.
+		 *@param idx The record's 1-based global index.
+		 *@return The record's 1-based index within shardOf(idx) (below 1 when idx is).
+		 */
+		int localIndex(int idx) {
+			return idx >= 1 ? (idx - 1) / (int) shards.size() + 1 : idx;
+		}//end localIndex
+
+		/**
+		 *@brief Retrieves a record's global index from its index within its shard.
+		 *@param shard The shard.
+		 *@param local The record's 1-based index within the shard.
+		 *@return The record's 1-based global index (0 when local is 0).
+		 */
+		int globalIndex(int shard, int local) {
+			return local >= 1 ? (local - 1) * (int) shards.size() + shard + 1 : 0;
+		}//end globalIndex
+
+		/**
+		 *@brief Counts a shard's records among the first records of the dataset.
+		 *@param shard The shard.
+		 *@param idx The global index of the last record counted.
+		 *@return The number of records 1 through idx held by the shard.
+		 */
+		int localCount(int shard, int idx) {
+			return idx > shard ? (idx - 1 - shard) / (int) shards.size() + 1 : 0;
+		}//end localCount
+
+		/**
+		 *@brief Finds a shard's first record in a run of consecutive records.
+		 *@param shard The shard.
+		 *@param first The global index of the run's first record.
+		 *@return The offset within the run of the shard's first record.
+		 */
+		int runOffset(int shard, int first) {
+			int numShards = shards.size();
+
+			return ( (shard - (first - 1) ) % numShards + numShards) % numShards;
+		}//end runOffset
+
+		/**
+		 *@brief Retrieves the number of records in the dataset from the shards' aggregates: the highest
+		 *       index stored, as a cluster node holds only the records hashed to it and leaves the rest
+		 *       of its slots empty. Only exact while holding the appender lock, as appends are what change it.
+		 *@return The number of records.
+		 */
+		int getNumRecords() {
+			int numRecords = 0;
+
+			for(size_t i = 0; i < shards.size(); i++) {
+				numRecords = max(numRecords, globalIndex(i, shards[i].aggregates.getNumRecords() ) );
+			}//end for
+
+			return numRecords;
+		}//end getNumRecords
+
+		/**
+		 *@brief Retrieves the journal every write to the dataset is appended to.
+		 *@return The journal.
+		 */
+		WriteJournal & getJournal() {
+			return journal;
+		}//end getJournal
+
+		/**
+		 *@brief Sets whether clients are refused writes, as on a replica, whose dataset only changes
+		 *       by replaying its primary's journal.
+		 *@param readOnly Whether the dataset is read-only to clients.
+		 */
+		void setReadOnly(bool readOnly) {
+			this->readOnly = readOnly;
+		}//end setReadOnly
+
+		/**
+		 *@brief Retrieves whether clients are refused writes.
+		 *@return Whether the dataset is read-only to clients.
+		 */
+		bool isReadOnly() {
+			return readOnly;
+		}//end isReadOnly
+
+		/**
+		 *@brief Waits to become the only process appending records.
+		 */
+		Task<> addAppender() {
+			struct sembuf op = {0, -1, 0};
+
+			co_await SemaphoreAcquire(appendSem, &op, 1);
+		}//end addAppender
+
+		/**
+		 *@brief Lets the next appender append.
+		 */
+		void remAppender() {
+			appendSem.signal(0);
+		}//end remAppender
+
+};//end ShardedDataset
+#endif
@@ -0,0 +1,739 @@
+/**
+ *@file ShellSimClient.cpp
+ *@author Griffin Nye
+ *@brief The client library (libshellsim_client): a typed call for every command, served over a
+ *       pool of warm connections to the configured servers. Each call takes a pooled connection
+ *       (opening one to the next endpoint in turn if none is idle), bounds the request by the
+ *       configured timeout, and returns the connection to the pool once the reply is in. A call
+ *       whose connection breaks is retried on a fresh one, except NEW and BLK once they may have
+ *       reached the server, as repeating them would add their records twice. Services include
+ *       this file to share connections across threads instead of running the client binary.
+ */
+
+
+#ifndef SHELLSIMCLIENT
+#define SHELLSIMCLIENT
+
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DataRecord.cpp"
+#include "ShellSimConnection.cpp"
+#include "msgPackets.cpp"
+
+using namespace std;
+
+/*! Default number of idle connections kept open for reuse. */
+#define CLIENTPOOLSIZE 4
+/*! Default milliseconds a request may take before it fails. */
+#define CLIENTTIMEOUTMS 5000
+/*! Default milliseconds a connection attempt may take before the next endpoint is tried. */
+#define CLIENTCONNECTMS 2000
+/*! Default number of times a call whose connection broke is retried on a fresh one. */
+#define CLIENTRETRIES 2
+/*! Milliseconds waited before the first retry, doubled before each one after. */
+#define CLIENTBACKOFFMS 50
+
+/**
+ *@struct clientConfig
+ *@brief How a ShellSimClient reaches its servers.
+ *@var clientConfig::endpoints
+ *  The servers (or routers) serving the same dataset, connected to in turn
+ *@var clientConfig::poolSize
+ *  Most idle connections kept open for reuse
+ *@var clientConfig::timeoutMs
+ *  Most milliseconds a request may take (0 for no limit)
+ *@var clientConfig::connectTimeoutMs
+ *  Most milliseconds a connection attempt may take (0 for no limit)
+ *@var clientConfig::retries
+ *  Times a call whose connection broke is retried on a fresh one
+ *@var clientConfig::compress
+ *  Whether to offer the servers compression of bulk transfers
+ */
+struct clientConfig {
+	vector<serverEndpoint> endpoints;
+	size_t poolSize;
+	int timeoutMs;
+	int connectTimeoutMs;
+	int retries;
+	bool compress;
+
+	/**
+	 *@brief Constructs the default configuration: a single server on this host.
+	 */
+	clientConfig() {
+		endpoints.push_back( {"localhost", CLIENTPORT} );
+		poolSize = CLIENTPOOLSIZE;
+		timeoutMs = CLIENTTIMEOUTMS;
+		connectTimeoutMs = CLIENTCONNECTMS;
+		retries = CLIENTRETRIES;
+		compress = true;
+	}//end constructor
+
+};//end clientConfig
+
+/**
+ *@struct recordChange
+ *@brief A change to a record, as reported by SYN and WCH.
+ *@var recordChange::idx
+ *  The record's index (-1 for a report of changes missed by a slow subscriber)
+ *@var recordChange::removed
+ *  Whether the record was removed
+ *@var recordChange::record
+ *  The record's new value (unless removed)
+ *@var recordChange::missed
+ *  The number of changes missed (only when idx is -1)
+ */
+struct recordChange {
+	int idx;
+	bool removed;
+	DataRecord record;
+	long missed;
+};//end recordChange
+
+/**
+ *@brief A thread-safe client of the servers of one dataset. Every call returns false (or -1) if the server
+ *       refused the request or could not be reached in time, with errno set in the latter case.
+ */
+class ShellSimClient {
+	private:
+		clientConfig config;
+		vector<ShellSimConnection *> idle;
+		mutex poolLock;
+		size_t nextEndpoint;
+
+		/**
+		 *@brief Takes an idle connection from the pool, or opens one to the next endpoint in turn
+		 *       (failing over to the others) if none is idle.
+		 *@return The connection, or NULL if no endpoint could be connected to.
+		 */
+		ShellSimConnection * acquire() {
+			ShellSimConnection * server = NULL;
+			size_t first;
+
+			{
+				lock_guard<mutex> guard(poolLock);
+
+				//Connections the server closed while they sat idle are dropped
+				while(server == NULL && !idle.empty() ) {
+					server = idle.back();
+					idle.pop_back();
+
+					if( !server->isIdle() ) {
+						delete server;
+						server = NULL;
+					}//end if
+
+				}//end while
+
+				first = nextEndpoint++;
+			}
+
+			if(server != NULL) {
+				return server;
+			}//end if
+
+			server = new ShellSimConnection();
+
+			for(size_t i = 0; i < config.endpoints.size(); i++) {
+
+				if(server->open(config.endpoints[(first + i) % config.endpoints.size()], config.connectTimeoutMs, config.compress) ) {
+					return server;
+				}//end if
+
+			}//end for
+
+			delete server;
+
+			return NULL;
+		}//end acquire
+
+		/**
+		 *@brief Returns a connection to the pool, or closes it if it broke or the pool is full.
+		 *@param server The connection.
+		 *@param healthy Whether its last request completed.
+		 */
+		void release(ShellSimConnection * server, bool healthy) {
+			{
+				lock_guard<mutex> guard(poolLock);
+
+				if(healthy && idle.size() < config.poolSize) {
+					idle.push_back(server);
+					return;
+				}//end if
+
+			}
+
+			delete server;
+		}//end release
+
+		/**
+		 *@brief Makes a request on a pooled connection, retrying it on fresh connections while they break.
+		 *@param resend Whether the request may be repeated after reaching the server.
+		 *@param exchange Sends the request and receives its reply; returns whether both completed.
+		 *@return Whether the reply was received.
+		 */
+		bool call(bool resend, const function<bool(ShellSimConnection &)> &exchange) {
+			int backoffMs = CLIENTBACKOFFMS, error;
+			bool delivered, connected;
+
+			for(int attempt = 0; ; attempt++) {
+				ShellSimConnection * server = acquire();
+
+				delivered = false;
+				connected = server != NULL;
+				error = errno;
+
+				if(connected) {
+					server->setDeadline(config.timeoutMs);
+					delivered = exchange(*server);
+					error = errno;
+					server->setDeadline(0);
+					release(server, delivered);
+				}//end if
+
+				//A request that may have been applied is not repeated
+				if(delivered || attempt >= config.retries || (connected && !resend) ) {
+					errno = error;
+					return delivered;
+				}//end if
+
+				this_thread::sleep_for( chrono::milliseconds(backoffMs) );
+				backoffMs *= 2;
+			}//end for
+
+		}//end call
+
+		/**
+		 *@brief Converts a record to the string sent to the server.
+		 *@param record The record.
+		 *@param recordString Receives the record string.
+		 *@return Whether the record fits in a packet.
+		 */
+		static bool recordToString(DataRecord &record, string &recordString) {
+			recordString = record.toString();
+
+			return recordString.size() <= MAXRECORDSIZE + 1;
+		}//end recordToString
+
+		/**
+		 *@brief Converts a record change received from the server.
+		 *@param changeMsg The change's packet.
+		 *@return The change.
+		 */
+		static recordChange toChange(intRecMsgPacket &changeMsg) {
+			recordChange change = {changeMsg.val, changeMsg.record[0] == '\0', DataRecord(), 0};
+
+			if(changeMsg.val == -1) {
+				change.missed = atol(changeMsg.record);
+			} else if( !change.removed) {
+				change.record.parse(changeMsg.record, changeMsg.val);
+			}//end if
+
+			return change;
+		}//end toChange
+
+	public:
+
+		/**
+		 *@brief Constructs a client of the configured servers (connections are opened as they are first needed).
+		 *@param config How to reach the servers.
+		 */
+		ShellSimClient(clientConfig config = clientConfig() ) {
+			this->config = config;
+			nextEndpoint = 0;
+		}//end constructor
+
+		ShellSimClient(const ShellSimClient &) = delete;
+		ShellSimClient & operator=(const ShellSimClient &) = delete;
+
+		/**
+		 *@brief Closes every pooled connection.
+		 */
+		~ShellSimClient() {
+			for(size_t i = 0; i < idle.size(); i++) {
+				delete idle[i];
+			}//end for
+
+		}//end destructor
+
+		/**
+		 *@brief Adds a new record (NEW). Not retried once sent, as it is not idempotent.
+		 *@param record The record.
+		 *@return The new record's index, or -1 on failure.
+		 */
+		int add(DataRecord record) {
+			intRecMsgPacket ackMsg;
+			string recordString;
+
+			if( !recordToString(record, recordString) || !call(false, [&](ShellSimConnection &server) {
+				return server.sendMsg( intRecMsgPacket(server.getPID(), "NEW", -1, &recordString[0]) ) && server.receiveMsg(ackMsg);
+			}) ) {
+				return -1;
+			}//end if
+
+			return (strcmp(ackMsg.record, "SUCCESS") == 0) ? ackMsg.val : -1;
+		}//end add
+
+		/**
+		 *@brief Retrieves the aggregate of the total field of a range of records (AGG).
+		 *@param type YEARLY (first is the 2 digit year), QUARTERLY (first is the year, second the quarter), or
+		 *       ROLLING (first is the number of months, second the last record of the window).
+		 *@param first The first parameter.
+		 *@param second The second parameter (unused by YEARLY).
+		 *@param sum Receives the aggregate.
+		 *@return Whether the aggregate was retrieved.
+		 */
+		bool aggregate(AGGREGATE type, int first, int second, Money &sum) {
+			string params = to_string(first) + "," + to_string(second);
+			intRecMsgPacket ackMsg;
+
+			if( !call(true, [&](ShellSimConnection &server) {
+				return server.sendMsg( intRecMsgPacket(server.getPID(), "AGG", type, &params[0]) ) && server.receiveMsg(ackMsg);
+			}) ) {
+				return false;
+			}//end if
+
+			return ackMsg.val == 0 && Money::parse(ackMsg.record, sum);
+		}//end aggregate
+
+		/**
+		 *@brief Appends a batch of records in one request (BLK). Not retried once sent, as it is not idempotent.
+		 *@param payload Csv lines, or binary record slots.
+		 *@param binary Whether the payload is record slots.
+		 *@param first Receives the index of the first record added.
+		 *@param last Receives the index of the last record added.
+		 *@return Whether the records were added.
+		 */
+		bool bulkLoad(const vector<char> &payload, bool binary, int &first, int &last) {
+			char format[4];
+			intRecMsgPacket ackMsg;
+
+			if(payload.empty() || payload.size() > MAXBULKSIZE) {
+				return false;
+			}//end if
+
+			strcpy(format, binary ? "BIN" : "CSV");
+
+			if( !call(false, [&](ShellSimConnection &server) {
+				return server.sendMsg( intRecMsgPacket(server.getPID(), "BLK", payload.size(), format) ) &&
+				       server.sendBulk(payload.data(), payload.size() ) && server.receiveMsg(ackMsg);
+			}) ) {
+				return false;
+			}//end if
+
+			return ackMsg.val != -1 && sscanf(ackMsg.record, "%i,%i", &first, &last) == 2;
+		}//end bulkLoad
+
+		/**
+		 *@brief Retrieves the number of records (CNT).
+		 *@return The number of records, or -1 on failure.
+		 */
+		int count() {
+			intMsgPacket cntMsg;
+
+			if( !call(true, [&](ShellSimConnection &server) {
+				return server.sendMsg( msgPacket(server.getPID(), "CNT") ) && server.receiveMsg(cntMsg);
+			}) ) {
+				return -1;
+			}//end if
+
+			return cntMsg.val;
+		}//end count
+
+		/**
+		 *@brief Retrieves the records matching a filter expression, e.g. "total > 2 AND year = 20" (FLT).
+		 *@param expr The filter expression.
+		 *@param matches Receives the matching records (each holding its index).
+		 *@return Whether the expression compiled and the matches were retrieved.
+		 */
+		bool filter(string expr, vector<DataRecord> &matches) {
+			intRecMsgPacket matchMsg;
+
+			if(expr.empty() || expr.length() > MAXEXPRSIZE) {
+				return false;
+			}//end if
+
+			return call(true, [&](ShellSimConnection &server) {
+				matches.clear();
+
+				if( !server.sendMsg( intMsgPacket(server.getPID(), "FLT", expr.length() ) ) || !server.sendBytes(expr.c_str(), expr.length() ) ||
+				    !server.receiveMsg(matchMsg) ) {
+					return false;
+				}//end if
+
+				//Matches stream in until the packet of index 0 that ends them
+				while(matchMsg.val > 0) {
+					matches.push_back( DataRecord() );
+					matches.back().parse(matchMsg.record, matchMsg.val);
+
+					if( !server.receiveMsg(matchMsg) ) {
+						return false;
+					}//end if
+
+				}//end while
+
+				return true;
+			}) && matchMsg.val != -1;
+		}//end filter
+
+		/**
+		 *@brief Updates an existing record (FIX).
+		 *@param idx The record's index.
+		 *@param record The record's new value.
+		 *@return Whether the record was updated.
+		 */
+		bool fix(int idx, DataRecord record) {
+			intRecMsgPacket ackMsg;
+			string recordString;
+
+			if( !recordToString(record, recordString) || !call(true, [&](ShellSimConnection &server) {
+				return server.sendMsg( intRecMsgPacket(server.getPID(), "FIX", idx, &recordString[0]) ) && server.receiveMsg(ackMsg);
+			}) ) {
+				return false;
+			}//end if
+
+			return strcmp(ackMsg.record, "SUCCESS") == 0;
+		}//end fix
+
+		/**
+		 *@brief Retrieves a record (GET).
+		 *@param idx The record's index.
+		 *@param record Receives the record.
+		 *@return Whether the record was retrieved.
+		 */
+		bool get(int idx, DataRecord &record) {
+			recMsgPacket recMsg;
+
+			if(idx < 1 || !call(true, [&](ShellSimConnection &server) {
+				return server.sendMsg( intMsgPacket(server.getPID(), "GET", idx) ) && server.receiveMsg(recMsg);
+			}) ) {
+				return false;
+			}//end if
+
+			return record.parse(recMsg.record, idx);
+		}//end get
+
+		/**
+		 *@brief Retrieves every record (GET -999), in the record encoding the server agreed to.
+		 *@param records Receives the records in index order (a record lost to a concurrent truncation is left with index -1).
+		 *@return Whether the records were retrieved.
+		 */
+		bool getAll(vector<DataRecord> &records) {
+			return call(true, [&](ShellSimConnection &server) {
+				bool slots = server.getWire().encoding == ENCODINGSLOTS;
+				recMsgPacket probe;
+				size_t stride = slots ? MAXRECORDSIZE + 1 : sizeof(recMsgPacket);
+				size_t recordOffset = slots ? 0 : probe.record - (char *) &probe;
+				intMsgPacket cntMsg;
+				vector<char> replies;
+
+				records.clear();
+
+				//A version 1 server does not prefix the records with their count, so it is asked for first
+				if(server.getWire().version < 2 && !server.sendMsg( msgPacket(server.getPID(), "CNT") ) ) {
+					return false;
+				}//end if
+
+				if( !server.sendMsg( intMsgPacket(server.getPID(), "GET", -999) ) || !server.receiveMsg(cntMsg) ) {
+					return false;
+				}//end if
+
+				replies.resize( (size_t) max(cntMsg.val, 0) * stride);
+
+				if( !server.receiveBytes(replies.data(), replies.size(), true) ) {
+					return false;
+				}//end if
+
+				records.resize( max(cntMsg.val, 0) );
+
+				for(size_t i = 0; i < records.size(); i++) {
+					char * record = &replies[i * stride + recordOffset];
+
+					if( !records[i].parse( string_view(record, strnlen(record, MAXRECORDSIZE) ), i + 1) ) {
+						records[i] = DataRecord();
+					}//end if
+
+				}//end for
+
+				return true;
+			});
+		}//end getAll
+
+		/**
+		 *@brief Retrieves how far the server lags behind its primary (LAG).
+		 *@param behind Receives the journal entries it is behind (-1 for a replica that never caught up, 0 on a primary).
+		 *@param applied Receives the journal entries it has applied.
+		 *@param staleness Receives the milliseconds its data is behind.
+		 *@return Whether the lag was retrieved.
+		 */
+		bool lag(int &behind, long &applied, long &staleness) {
+			intRecMsgPacket ackMsg;
+
+			if( !call(true, [&](ShellSimConnection &server) {
+				return server.sendMsg( msgPacket(server.getPID(), "LAG") ) && server.receiveMsg(ackMsg);
+			}) ) {
+				return false;
+			}//end if
+
+			behind = ackMsg.val;
+
+			return sscanf(ackMsg.record, "%li,%li", &applied, &staleness) == 2;
+		}//end lag
+
+		/**
+		 *@brief Retrieves the server log (LOG).
+		 *@param entries Receives the log's lines.
+		 *@return Whether the log was retrieved.
+		 */
+		bool log(vector<string> &entries) {
+			return call(true, [&](ShellSimConnection &server) {
+				intMsgPacket cntMsg;
+				logMsgPacket logMsg;
+
+				entries.clear();
+
+				if( !server.sendMsg( msgPacket(server.getPID(), "LOG") ) || !server.receiveMsg(cntMsg) ) {
+					return false;
+				}//end if
+
+				for(int i = 0; i < cntMsg.val; i++) {
+
+					if( !server.receiveMsg(logMsg, true) ) {
+						return false;
+					}//end if
+
+					entries.push_back( string(logMsg.logRecord, strnlen(logMsg.logRecord, MAXLOGRECORDSIZE) ) );
+
+					if( !entries.back().empty() && entries.back().back() == '\n') {
+						entries.back().pop_back();
+					}//end if
+
+				}//end for
+
+				return true;
+			});
+		}//end log
+
+		/**
+		 *@brief Stores a record at an index, creating it or replacing it (PUT).
+		 *@param idx The record's index.
+		 *@param record The record.
+		 *@return Whether the record was stored.
+		 */
+		bool put(int idx, DataRecord record) {
+			intRecMsgPacket ackMsg;
+			string recordString;
+
+			if( !recordToString(record, recordString) || !call(true, [&](ShellSimConnection &server) {
+				return server.sendMsg( intRecMsgPacket(server.getPID(), "PUT", idx, &recordString[0]) ) && server.receiveMsg(ackMsg);
+			}) ) {
+				return false;
+			}//end if
+
+			return strcmp(ackMsg.record, "SUCCESS") == 0;
+		}//end put
+
+		/**
+		 *@brief Removes a record (PUT of an empty record).
+		 *@param idx The record's index.
+		 *@return Whether the record was removed.
+		 */
+		bool remove(int idx) {
+			char noRecord[1] = "";
+			intRecMsgPacket ackMsg;
+
+			if( !call(true, [&](ShellSimConnection &server) {
+				return server.sendMsg( intRecMsgPacket(server.getPID(), "PUT", idx, noRecord) ) && server.receiveMsg(ackMsg);
+			}) ) {
+				return false;
+			}//end if
+
+			return strcmp(ackMsg.record, "SUCCESS") == 0;
+		}//end remove
+
+		/**
+		 *@brief Retrieves a snapshot of the server statistics (STS).
+		 *@param lines Receives the csv lines, the first naming the columns of the rest.
+		 *@return Whether the statistics were retrieved.
+		 */
+		bool stats(vector<string> &lines) {
+			return call(true, [&](ShellSimConnection &server) {
+				intMsgPacket cntMsg;
+				logMsgPacket logMsg;
+
+				lines.clear();
+
+				if( !server.sendMsg( msgPacket(server.getPID(), "STS") ) || !server.receiveMsg(cntMsg) ) {
+					return false;
+				}//end if
+
+				for(int i = 0; i < cntMsg.val; i++) {
+
+					if( !server.receiveMsg(logMsg) ) {
+						return false;
+					}//end if
+
+					lines.push_back( string(logMsg.logRecord, strnlen(logMsg.logRecord, MAXLOGRECORDSIZE) ) );
+				}//end for
+
+				return true;
+			});
+		}//end stats
+
+		/**
+		 *@brief Retrieves the records changed since a sequence number (SYN). If the server's journal was started over
+		 *       since the sequence number was handed out, every record is retrieved (GET -999) instead.
+		 *@param sequence The sequence number the caller is synced to (0 for every record); receives the one to sync from next time.
+		 *@param epoch The epoch of the journal the sequence number was handed out by; receives the journal's epoch now.
+		 *@param changes Receives the changed records in index order (every record, with empty slots as removed, if reloaded).
+		 *@param reloaded Receives whether every record was retrieved, so any the caller holds past the last one no longer exist.
+		 *@return Whether the changes were retrieved.
+		 */
+		bool sync(long &sequence, uint32_t &epoch, vector<recordChange> &changes, bool &reloaded) {
+			intRecMsgPacket syncMsg;
+			vector<DataRecord> records;
+			char strEpoch[9];
+			long head;
+			unsigned int current;
+
+			if(sequence < 0 || sequence > INT_MAX) {
+				return false;
+			}//end if
+
+			snprintf(strEpoch, sizeof(strEpoch), "%08x", epoch);
+
+			if( !call(true, [&](ShellSimConnection &server) {
+				intRecMsgPacket changeMsg;
+
+				changes.clear();
+
+				if( !server.sendMsg( intRecMsgPacket(server.getPID(), "SYN", sequence, strEpoch) ) || !server.receiveMsg(syncMsg) ) {
+					return false;
+				}//end if
+
+				for(int i = 0; i < syncMsg.val; i++) {
+
+					if( !server.receiveMsg(changeMsg) ) {
+						return false;
+					}//end if
+
+					changes.push_back( toChange(changeMsg) );
+				}//end for
+
+				return true;
+			}) ) {
+				return false;
+			}//end if
+
+			//A journal started over since is refused with its new high-water mark and epoch
+			syncMsg.record[MAXRECORDSIZE] = '\0';
+			reloaded = syncMsg.val == -1 && sscanf(syncMsg.record, "EPOCH,%li,%x", &head, &current) == 2;
+
+			if( !reloaded && (syncMsg.val == -1 || sscanf(syncMsg.record, "%li,%x", &head, &current) != 2) ) {
+				return false;
+			}//end if
+
+			//Every record is re-read after the mark is taken, so the writes in between are sent again next time
+			if(reloaded) {
+
+				if( !getAll(records) ) {
+					return false;
+				}//end if
+
+				for(size_t i = 0; i < records.size(); i++) {
+					changes.push_back( {(int) i + 1, records[i].getRecordIndex() == -1, records[i], 0} );
+				}//end for
+
+			}//end if
+
+			sequence = head;
+			epoch = current;
+
+			return true;
+		}//end sync
+
+		/**
+		 *@brief Asks the server to write its trace (TRC).
+		 *@param file Receives the name of the trace file.
+		 *@return The number of events written, or -1 on failure.
+		 */
+		int trace(string &file) {
+			intRecMsgPacket ackMsg;
+
+			if( !call(true, [&](ShellSimConnection &server) {
+				return server.sendMsg( msgPacket(server.getPID(), "TRC") ) && server.receiveMsg(ackMsg);
+			}) ) {
+				return -1;
+			}//end if
+
+			file = ackMsg.record;
+
+			return ackMsg.val;
+		}//end trace
+
+		/**
+		 *@brief Subscribes to changes (WCH) on a connection of its own, passing each to a callback as it arrives
+		 *       until the callback declines more. Only the subscription itself is bounded by the timeout.
+		 *@param first The first index watched (0 to watch every record).
+		 *@param last The last index watched.
+		 *@param onChange Receives each change; returns whether to keep watching.
+		 *@return Whether the subscription ran until the callback ended it.
+		 */
+		bool watch(int first, int last, const function<bool(recordChange &)> &onChange) {
+			string range = (first > 0) ? to_string(first) + "," + to_string(last) : "";
+			ShellSimConnection server;
+			intRecMsgPacket ackMsg;
+			recordChange change;
+			size_t firstEndpoint;
+
+			{
+				lock_guard<mutex> guard(poolLock);
+				firstEndpoint = nextEndpoint++;
+			}
+
+			//The subscription is retried like any call, then its connection carries nothing but changes
+			for(int attempt = 0; ; attempt++) {
+
+				for(size_t i = 0; i < config.endpoints.size() && server.getFd() == -1; i++) {
+					server.open(config.endpoints[(firstEndpoint + i) % config.endpoints.size()], config.connectTimeoutMs, config.compress);
+				}//end for
+
+				server.setDeadline(config.timeoutMs);
+
+				if(server.getFd() != -1 && server.sendMsg( intRecMsgPacket(server.getPID(), "WCH", 0, &range[0]) ) && server.receiveMsg(ackMsg) ) {
+					break;
+				} else if(attempt >= config.retries) {
+					return false;
+				}//end if
+
+				server.close();
+				this_thread::sleep_for( chrono::milliseconds(CLIENTBACKOFFMS << attempt) );
+			}//end for
+
+			if(ackMsg.val == -1) {
+				return false;
+			}//end if
+
+			server.setDeadline(0);
+
+			do {
+
+				if( !server.receiveMsg(ackMsg) ) {
+					return false;
+				}//end if
+
+				change = toChange(ackMsg);
+			} while( onChange(change) );
+
+			return true;
+		}//end watch
+
+};//end ShellSimClient
+#endif
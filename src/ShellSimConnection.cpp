@@ -0,0 +1,469 @@
+/**
+ *@file ShellSimConnection.cpp
+ *@author Griffin Nye
+ *@brief A client's connection to a server: connecting within a timeout, the HELLO handshake, and
+ *       the packets and bulk transfers (compressed as agreed) of its requests. Every wait on the
+ *       socket is bounded by the deadline of the request in progress, so a server that stops
+ *       answering fails the request rather than hanging the caller.
+ */
+
+
+#ifndef SHELLSIMCONNECTION
+#define SHELLSIMCONNECTION
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include "LzCodec.cpp"
+#include "msgPackets.cpp"
+
+using namespace std;
+
+/*! Milliseconds to wait for the reply to HELLO before assuming a server that predates it. */
+#define HELLOTIMEOUTMS 1000
+/*! Port a client connects to when no endpoint is given (the server's and router's default). */
+#define CLIENTPORT 15005
+
+/**
+ *@brief The host and port of a server (or router).
+ */
+struct serverEndpoint {
+	string host;
+	int port;
+
+	/**
+	 *@brief Parses an endpoint given as [host:]port (the host defaulting to localhost).
+	 *@param spec The endpoint.
+	 *@return Whether the endpoint had a valid port.
+	 */
+	bool parse(string spec) {
+		size_t colon = spec.rfind(':');
+
+		host = (colon == string::npos) ? "localhost" : spec.substr(0, colon);
+		port = atoi(spec.substr(colon == string::npos ? 0 : colon + 1).c_str() );
+
+		return port > 0 && port <= 65535 && !host.empty();
+	}//end parse
+
+	/**
+	 *@brief Retrieves the endpoint as host:port.
+	 *@return The endpoint.
+	 */
+	string toString() const {
+		return host + ":" + to_string(port);
+	}//end toString
+
+};//end serverEndpoint
+
+/**
+ *@brief A connection to a server, speaking whatever wire format the server agreed to in reply to HELLO.
+ *       Failures are reported as false (or -1) with errno set; a connection that failed mid-request is
+ *       out of step with its server and must be closed.
+ */
+class ShellSimConnection {
+	private:
+		int fd;
+		pid_t myPID;
+		wireFormat wire;
+		bool bounded;
+		chrono::steady_clock::time_point deadline;
+		vector<char> frame;
+		size_t framePos;
+
+		/**
+		 *@brief Waits for the socket to become ready, until the deadline of the request in progress.
+		 *@param events POLLIN to wait to read, or POLLOUT to wait to write.
+		 *@return Whether the socket became ready in time (errno is ETIMEDOUT if not).
+		 */
+		bool awaitReady(short events) {
+			struct pollfd ready = {fd, events, 0};
+			int waitMs = -1, numReady;
+
+			if(bounded) {
+				waitMs = max<long>(0, chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now() ).count() );
+			}//end if
+
+			do {
+				numReady = poll(&ready, 1, waitMs);
+			} while(numReady == -1 && errno == EINTR);
+
+			if(numReady == 0) {
+				errno = ETIMEDOUT;
+			}//end if
+
+			return numReady == 1;
+		}//end awaitReady
+
+		/**
+		 *@brief Sends a HELLO offering every feature this library supports and adopts what the server agrees to.
+		 *       A server that does not reply within HELLOTIMEOUTMS predates HELLO, and is spoken to in version 1.
+		 *@param compress Whether to offer compression of bulk transfers.
+		 *@return Whether the server was greeted (false if it closed the connection or sent a malformed reply).
+		 */
+		bool greet(bool compress) {
+			uint32_t features = FEATUREPIPELINE | (compress ? FEATURECOMPRESS : 0);
+			helloMsgPacket hello;
+			bool predates;
+
+			setDeadline(HELLOTIMEOUTMS);
+
+			if( !sendMsg( helloMsgPacket(myPID, "HLO", PROTOCOLVERSION, features, COMPRESSFRAMESIZE, ENCODINGSLOTS) ) ) {
+				return false;
+			}//end if
+
+			//A server predating HELLO ignores it without replying
+			if( !awaitReady(POLLIN) ) {
+				predates = errno == ETIMEDOUT;
+				setDeadline(0);
+				return predates;
+			} else if( !receiveMsg(hello) ) {
+				return false;
+			}//end if
+
+			//Only what this library offered can have been agreed to
+			if(strcmp(hello.cmd, "HLO") != 0 || hello.maxFrameSize <= 0 || hello.maxFrameSize > COMPRESSFRAMESIZE ||
+			   (hello.features & ~features) != 0 || (hello.encoding != ENCODINGPACKETS && hello.encoding != ENCODINGSLOTS) ) {
+				errno = EPROTO;
+				return false;
+			}//end if
+
+			wire.adopt(hello);
+			setDeadline(0);
+
+			return true;
+		}//end greet
+
+	public:
+
+		/**
+		 *@brief Constructs a connection that is not yet open.
+		 */
+		ShellSimConnection() {
+			fd = -1;
+			myPID = getpid();
+			bounded = false;
+			framePos = 0;
+		}//end constructor
+
+		ShellSimConnection(const ShellSimConnection &) = delete;
+		ShellSimConnection & operator=(const ShellSimConnection &) = delete;
+
+		/**
+		 *@brief Closes the connection.
+		 */
+		~ShellSimConnection() {
+			close();
+		}//end destructor
+
+		/**
+		 *@brief Connects to a server and greets it, closing any connection already open.
+		 *@param endpoint The server.
+		 *@param connectTimeoutMs Most milliseconds to wait for the connection (0 to wait as long as connect does).
+		 *@param compress Whether to offer compression of bulk transfers.
+		 *@return Whether the connection was opened.
+		 */
+		bool open(const serverEndpoint &endpoint, int connectTimeoutMs, bool compress) {
+			struct addrinfo hints, *addrs;
+			int connected, flags, error = 0;
+			socklen_t errorLen = sizeof(error);
+
+			close();
+			memset(&hints, 0, sizeof(hints) );
+			hints.ai_family = AF_INET;
+			hints.ai_socktype = SOCK_STREAM;
+
+			//getaddrinfo, unlike gethostbyname, is safe to call from every thread sharing a client
+			if(getaddrinfo(endpoint.host.c_str(), to_string(endpoint.port).c_str(), &hints, &addrs) != 0) {
+				errno = EHOSTUNREACH;
+				return false;
+			} else if( (fd = socket(AF_INET, SOCK_STREAM, 0) ) == -1) {
+				freeaddrinfo(addrs);
+				return false;
+			}//end if
+
+			//Connect without blocking, so the attempt can be abandoned at its deadline
+			flags = fcntl(fd, F_GETFL);
+			fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+			connected = connect(fd, addrs->ai_addr, addrs->ai_addrlen);
+			freeaddrinfo(addrs);
+
+			if(connected == -1 && errno == EINPROGRESS) {
+				setDeadline(connectTimeoutMs);
+
+				if(awaitReady(POLLOUT) && getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &errorLen) == 0) {
+					connected = (error == 0) ? 0 : -1;
+					errno = error;
+				}//end if
+
+			}//end if
+
+			if(connected == -1 || fcntl(fd, F_SETFL, flags) == -1 || !greet(compress) ) {
+				error = errno;
+				close();
+				errno = error;
+				return false;
+			}//end if
+
+			return true;
+		}//end open
+
+		/**
+		 *@brief Closes the connection, forgetting what was agreed with the server.
+		 */
+		void close() {
+			if(fd != -1) {
+				::close(fd);
+			}//end if
+
+			fd = -1;
+			wire = wireFormat();
+			frame.clear();
+			framePos = 0;
+			bounded = false;
+		}//end close
+
+		/**
+		 *@brief Determines whether the connection is open and idle: a server sends nothing unasked, so an idle
+		 *       connection with anything to read has been closed (or reset) by its server.
+		 *@return Whether the connection can carry a request.
+		 */
+		bool isIdle() {
+			struct pollfd ready = {fd, POLLIN, 0};
+
+			return fd != -1 && framePos == frame.size() && poll(&ready, 1, 0) == 0;
+		}//end isIdle
+
+		/**
+		 *@brief Retrieves the connection's socket file descriptor.
+		 *@return The file descriptor, or -1 if the connection is closed.
+		 */
+		int getFd() {
+			return fd;
+		}//end getFd
+
+		/**
+		 *@brief Retrieves the PID this connection's requests are sent on behalf of.
+		 *@return The PID.
+		 */
+		pid_t getPID() {
+			return myPID;
+		}//end getPID
+
+		/**
+		 *@brief Retrieves what the server agreed to in reply to HELLO.
+		 *@return The connection's wire format.
+		 */
+		const wireFormat & getWire() {
+			return wire;
+		}//end getWire
+
+		/**
+		 *@brief Bounds every wait of the request about to be made.
+		 *@param timeoutMs Most milliseconds the request may take (0 for no limit).
+		 */
+		void setDeadline(int timeoutMs) {
+			bounded = timeoutMs > 0;
+			deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+		}//end setDeadline
+
+		/**
+		 *@brief Writes exactly the provided number of bytes to the socket.
+		 *@param buf The data to be sent.
+		 *@param len The number of bytes to be sent.
+		 *@return Whether all of the data was sent.
+		 */
+		bool sendBytes(const char * buf, size_t len) {
+			ssize_t numWritten;
+
+			//A server that has gone away must fail the request, not raise SIGPIPE in the embedding process
+			while(len > 0) {
+
+				if( !awaitReady(POLLOUT) ) {
+					return false;
+				} else if( (numWritten = send(fd, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT) ) == -1) {
+
+					if(errno == EAGAIN || errno == EINTR) {
+						continue;
+					}//end if
+
+					return false;
+				}//end if
+
+				buf += numWritten;
+				len -= numWritten;
+			}//end while
+
+			return true;
+		}//end sendBytes
+
+		/**
+		 *@brief Sends a request, padded to a full serMsgPacket frame so the server can read requests back to back.
+		 *@param msg The request.
+		 *@return Whether the request was sent.
+		 */
+		template<class MsgPacket> bool sendMsg(MsgPacket msg) {
+			serMsgPacket request;
+
+			memset(static_cast<void *>(&request), 0, sizeof(request) );
+			memcpy(static_cast<void *>(&request), &msg, sizeof(msg) );
+
+			return sendBytes( (const char *) &request, sizeof(request) );
+		}//end sendMsg
+
+		/**
+		 *@brief Sends a bulk transfer, compressed a frame at a time when compression was agreed.
+		 *@param buf The data to be sent.
+		 *@param len The number of bytes to be sent.
+		 *@return Whether all of the data was sent.
+		 */
+		bool sendBulk(const char * buf, size_t len) {
+			vector<char> packed;
+			frameHeader header;
+
+			if(wire.codec == CODECNONE) {
+				return sendBytes(buf, len);
+			}//end if
+
+			for(size_t done = 0; done < len; done += header.rawSize) {
+				header.rawSize = min<size_t>(len - done, wire.frameSize);
+				packed.resize(sizeof(header) + LzCodec::maxPackedSize(header.rawSize) );
+				header.packedSize = LzCodec::compress(buf + done, header.rawSize, &packed[sizeof(header)]);
+
+				//Send a frame that would not shrink as it is
+				if(header.packedSize >= header.rawSize) {
+					header.packedSize = header.rawSize;
+					memcpy(&packed[sizeof(header)], buf + done, header.rawSize);
+				}//end if
+
+				memcpy(&packed[0], &header, sizeof(header) );
+
+				if( !sendBytes(&packed[0], sizeof(header) + header.packedSize) ) {
+					return false;
+				}//end if
+
+			}//end for
+
+			return true;
+		}//end sendBulk
+
+		/**
+		 *@brief Reads whatever bytes of a reply have arrived, up to the requested number.
+		 *@param buf The buffer receiving the bytes.
+		 *@param len The most bytes to read.
+		 *@return The number of bytes read, 0 if the server closed the connection, or -1 on failure.
+		 */
+		ssize_t receiveSome(char * buf, size_t len) {
+			ssize_t numRead;
+
+			do {
+
+				if( !awaitReady(POLLIN) ) {
+					return -1;
+				}//end if
+
+				numRead = recv(fd, buf, len, MSG_DONTWAIT);
+			} while(numRead == -1 && (errno == EAGAIN || errno == EINTR) );
+
+			return numRead;
+		}//end receiveSome
+
+		/**
+		 *@brief Reads up to the requested number of bytes of a bulk transfer, decompressing a frame at a time when
+		 *       compression was agreed.
+		 *@param buf The buffer receiving the bytes.
+		 *@param len The most bytes to read.
+		 *@return The number of bytes read, 0 if the server closed the connection, or -1 on failure (errno is EPROTO
+		 *        for a malformed frame).
+		 */
+		ssize_t receiveBulk(char * buf, size_t len) {
+			vector<char> packed;
+			frameHeader header;
+
+			if(wire.codec == CODECNONE) {
+				return receiveSome(buf, len);
+			}//end if
+
+			//Receive and decompress the next frame once the last one is used up
+			if(framePos == frame.size() ) {
+
+				if( !receiveBytes(&header, sizeof(header) ) ) {
+					return (errno == ECONNRESET) ? 0 : -1;
+				} else if(header.rawSize == 0 || header.rawSize > (uint32_t) wire.frameSize ||
+				          header.packedSize > (uint32_t) LzCodec::maxPackedSize(header.rawSize) ) {
+					errno = EPROTO;
+					return -1;
+				}//end if
+
+				packed.resize(header.packedSize);
+
+				if( !receiveBytes(&packed[0], packed.size() ) ) {
+					return (errno == ECONNRESET) ? 0 : -1;
+				}//end if
+
+				frame.resize(header.rawSize);
+				framePos = 0;
+
+				//Frames that would not shrink were sent as they are
+				if(header.packedSize == header.rawSize) {
+					frame.swap(packed);
+				} else if( !LzCodec::decompress(&packed[0], header.packedSize, &frame[0], header.rawSize) ) {
+					errno = EPROTO;
+					return -1;
+				}//end if
+
+			}//end if
+
+			len = min(len, frame.size() - framePos);
+			memcpy(buf, &frame[framePos], len);
+			framePos += len;
+
+			return len;
+		}//end receiveBulk
+
+		/**
+		 *@brief Reads exactly the requested number of bytes of a reply.
+		 *@param buf The buffer receiving the bytes.
+		 *@param len The number of bytes to read.
+		 *@param bulk Whether the bytes are part of a bulk transfer.
+		 *@return Whether all of the bytes were read (errno is ECONNRESET if the server closed the connection).
+		 */
+		bool receiveBytes(void * buf, size_t len, bool bulk = false) {
+			ssize_t numRead;
+
+			for(size_t received = 0; received < len; received += numRead) {
+				numRead = bulk ? receiveBulk( (char *) buf + received, len - received) : receiveSome( (char *) buf + received, len - received);
+
+				if(numRead == 0) {
+					errno = ECONNRESET;
+				}//end if
+
+				if(numRead <= 0) {
+					return false;
+				}//end if
+
+			}//end for
+
+			return true;
+		}//end receiveBytes
+
+		/**
+		 *@brief Receives a reply packet.
+		 *@param msg Receives the packet.
+		 *@param bulk Whether the packet is part of a bulk transfer.
+		 *@return Whether the whole packet was received.
+		 */
+		template<class MsgPacket> bool receiveMsg(MsgPacket &msg, bool bulk = false) {
+			return receiveBytes(&msg, sizeof(msg), bulk);
+		}//end receiveMsg
+
+};//end ShellSimConnection
+#endif
@@ -0,0 +1,312 @@
+/**
+ *@file TraceBuffer.cpp
+ *@author Griffin Nye
+ *@brief Per-process ring buffer of fixed-size binary trace events. Every request handled by a
+ *       child server is a span, and the monitor waits, file operations, and sends made on its
+ *       behalf are recorded as begin/end events within it. Recording is a clock read and a
+ *       16 byte store; the ring is only formatted (as Chrome trace JSON, which Perfetto and
+ *       chrome://tracing load) when it is dumped.
+ */
+
+
+#ifndef TRACEBUFFER
+#define TRACEBUFFER
+
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ServerStats.cpp"
+
+using namespace std;
+
+/*! Number of events kept per process (a power of two); older events are overwritten. */
+#define TRACECAPACITY (1 << 16)
+
+/*! The kinds of traced intervals. */
+enum TRACEKIND {TRACEREQUEST, TRACEWAIT, TRACEIO, TRACESEND};
+
+/**
+ *@brief A single trace event, stored exactly as recorded.
+ */
+struct TraceEvent {
+	uint64_t time;    /*!< CLOCK_MONOTONIC nanoseconds, shared by every process. */
+	uint32_t span;    /*!< The request the event belongs to (0 outside of any request). */
+	uint8_t kind;     /*!< The TRACEKIND of the interval. */
+	uint8_t detail;   /*!< The STATCMD, STATWAIT, or STATIO of the interval. */
+	char phase;       /*!< 'B' at the start of the interval, 'E' at its end. */
+	uint8_t unused;
+};
+
+/**
+ *@brief Records trace events into a fixed ring and writes them out as Chrome trace JSON.
+ *
+ * Only the owning process writes to the ring. dump() uses nothing but async-signal-safe calls and
+ * reads only completed events, so it may be called from a signal handler that interrupted record().
+ */
+class TraceBuffer {
+	private:
+		TraceEvent events[TRACECAPACITY];
+		volatile uint64_t head;
+		uint32_t lastSpan;
+		uint32_t currentSpan;
+
+		/**
+		 *@brief Appends a string to an output buffer, writing the buffer out when it fills.
+		 *@param fd The file the buffer is written to.
+		 *@param buf The output buffer.
+		 *@param used The number of bytes in the buffer.
+		 *@param bufSize The size of the buffer.
+		 *@param str The string to be appended.
+		 */
+		static void put(int fd, char buf[], size_t &used, size_t bufSize, const char * str) {
+			for(; *str != '\0'; str++) {
+				if(used == bufSize) {
+					flush(fd, buf, used);
+				}//end if
+
+				buf[used++] = *str;
+			}//end for
+		}//end put
+
+		/**
+		 *@brief Appends an unsigned integer in decimal to an output buffer.
+		 *@param fd The file the buffer is written to.
+		 *@param buf The output buffer.
+		 *@param used The number of bytes in the buffer.
+		 *@param bufSize The size of the buffer.
+		 *@param value The value to be appended.
+		 *@param minDigits The least number of digits written (zero padded).
+		 */
+		static void putNum(int fd, char buf[], size_t &used, size_t bufSize, uint64_t value, int minDigits = 1) {
+			char digits[21];
+			int pos = sizeof(digits) - 1;
+
+			digits[pos] = '\0';
+
+			do {
+				digits[--pos] = '0' + value % 10;
+				value /= 10;
+				minDigits--;
+			} while(value > 0 || minDigits > 0);
+
+			put(fd, buf, used, bufSize, digits + pos);
+		}//end putNum
+
+		/**
+		 *@brief Writes out and empties an output buffer.
+		 *@param fd The file the buffer is written to.
+		 *@param buf The output buffer.
+		 *@param used The number of bytes in the buffer.
+		 */
+		static void flush(int fd, char buf[], size_t &used) {
+			ssize_t written;
+
+			for(size_t done = 0; done < used; done += written) {
+				if( (written = write(fd, buf + done, used - done) ) <= 0) {
+					break;
+				}//end if
+			}//end for
+
+			used = 0;
+		}//end flush
+
+		/**
+		 *@brief Retrieves the name shown for an event's interval.
+		 *@param event The event.
+		 *@return The name of the interval.
+		 */
+		static const char * nameOf(const TraceEvent &event) {
+			const char * WAITS[NUMSTATWAITS] = {"wait.binRead", "wait.binWrite", "wait.logRead", "wait.logWrite"};
+			const char * IOS[NUMSTATIOS] = {"io.binRead", "io.binWrite", "io.logRead", "io.logWrite"};
+
+			switch(event.kind) {
+				case TRACEREQUEST:
+					return ServerStats::commandName(event.detail);
+				case TRACEWAIT:
+					return WAITS[event.detail];
+				case TRACEIO:
+					return IOS[event.detail];
+				default:
+					return "send";
+			}//end switch
+
+		}//end nameOf
+
+	public:
+
+		/**
+		 *@brief Constructs an empty TraceBuffer.
+		 */
+		TraceBuffer() {
+			head = 0;
+			lastSpan = currentSpan = 0;
+		}//end constructor
+
+		/**
+		 *@brief Retrieves the current CLOCK_MONOTONIC time.
+		 *@return The time in nanoseconds.
+		 */
+		static uint64_t now() {
+			struct timespec ts;
+
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+
+			return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+		}//end now
+
+		/**
+		 *@brief Records a single event in the current span.
+		 *@param kind The TRACEKIND of the interval.
+		 *@param detail The STATCMD, STATWAIT, or STATIO of the interval.
+		 *@param phase 'B' at the start of the interval, 'E' at its end.
+		 */
+		void record(int kind, int detail, char phase) {
+			TraceEvent &event = events[head & (TRACECAPACITY - 1)];
+
+			event.time = now();
+			event.span = currentSpan;
+			event.kind = kind;
+			event.detail = detail;
+			event.phase = phase;
+
+			//Publish the event only once it is complete, in case dump() interrupts us
+			__atomic_signal_fence(__ATOMIC_RELEASE);
+			head = head + 1;
+		}//end record
+
+		/**
+		 *@brief Records the start of an interval.
+		 *@param kind The TRACEKIND of the interval.
+		 *@param detail The STATCMD, STATWAIT, or STATIO of the interval.
+		 */
+		void begin(int kind, int detail = 0) {
+			record(kind, detail, 'B');
+		}//end begin
+
+		/**
+		 *@brief Records the end of an interval.
+		 *@param kind The TRACEKIND of the interval.
+		 *@param detail The STATCMD, STATWAIT, or STATIO of the interval.
+		 */
+		void end(int kind, int detail = 0) {
+			record(kind, detail, 'E');
+		}//end end
+
+		/**
+		 *@brief Starts a new span for a request, which every event until endSpan() belongs to.
+		 *@param command The request's STATCMD.
+		 */
+		void beginSpan(int command) {
+			currentSpan = ++lastSpan;
+			begin(TRACEREQUEST, command);
+		}//end beginSpan
+
+		/**
+		 *@brief Ends the current request's span.
+		 *@param command The request's STATCMD.
+		 */
+		void endSpan(int command) {
+			end(TRACEREQUEST, command);
+			currentSpan = 0;
+		}//end endSpan
+
+		/**
+		 *@brief Retrieves the span events are currently recorded into.
+		 *@return The current span (0 outside of any request).
+		 */
+		uint32_t getSpan() {
+			return currentSpan;
+		}//end getSpan
+
+		/**
+		 *@brief Switches to recording into another request's span, e.g. when a worker resumes a suspended request.
+		 *@param span The span, as returned by getSpan().
+		 */
+		void setSpan(uint32_t span) {
+			currentSpan = span;
+		}//end setSpan
+
+		/**
+		 *@brief Retrieves the number of events that a dump would write.
+		 *@return The number of events held by the ring.
+		 */
+		uint64_t getNumEvents() {
+			return head < TRACECAPACITY ? head : TRACECAPACITY - 1;
+		}//end getNumEvents
+
+		/**
+		 *@brief Writes the events held by the ring, oldest first, as a Chrome trace JSON document.
+		 *       Only async-signal-safe calls are made.
+		 *@param fd The file to write to.
+		 *@return The number of events written.
+		 */
+		uint64_t dump(int fd) {
+			char buf[16384];
+			size_t used = 0;
+			uint64_t last = head, first;
+			pid_t pid = getpid();
+
+			//The slot after the newest may be mid-overwrite, so a full ring skips its oldest event
+			__atomic_signal_fence(__ATOMIC_ACQUIRE);
+			first = last < TRACECAPACITY ? 0 : last - TRACECAPACITY + 1;
+
+			put(fd, buf, used, sizeof(buf), "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+			for(uint64_t i = first; i < last; i++) {
+				const TraceEvent &event = events[i & (TRACECAPACITY - 1)];
+				char phase[2] = {event.phase, '\0'};
+
+				put(fd, buf, used, sizeof(buf), i == first ? "{\"name\":\"" : ",\n{\"name\":\"");
+				put(fd, buf, used, sizeof(buf), nameOf(event) );
+				put(fd, buf, used, sizeof(buf), event.kind == TRACEREQUEST ? "\",\"cat\":\"request\",\"ph\":\"" : "\",\"cat\":\"server\",\"ph\":\"");
+				put(fd, buf, used, sizeof(buf), phase);
+				put(fd, buf, used, sizeof(buf), "\",\"ts\":");
+				putNum(fd, buf, used, sizeof(buf), event.time / 1000);
+				put(fd, buf, used, sizeof(buf), ".");
+				putNum(fd, buf, used, sizeof(buf), event.time % 1000, 3);
+				put(fd, buf, used, sizeof(buf), ",\"pid\":");
+				putNum(fd, buf, used, sizeof(buf), pid);
+				put(fd, buf, used, sizeof(buf), ",\"tid\":");
+				putNum(fd, buf, used, sizeof(buf), pid);
+				put(fd, buf, used, sizeof(buf), ",\"args\":{\"span\":");
+				putNum(fd, buf, used, sizeof(buf), event.span);
+				put(fd, buf, used, sizeof(buf), "}}");
+			}//end for
+
+			put(fd, buf, used, sizeof(buf), "\n]}\n");
+			flush(fd, buf, used);
+
+			return last - first;
+		}//end dump
+
+		/**
+		 *@brief Writes the events held by the ring to trace.<pid>.json in the working directory.
+		 *       Only async-signal-safe calls are made; a process that has recorded nothing writes no file.
+		 *@param path Receives the name of the file written (at least 32 bytes).
+		 *@return The number of events written.
+		 */
+		uint64_t dumpToFile(char path[]) {
+			size_t used = 0;
+			uint64_t numEvents;
+			int fd;
+
+			put(-1, path, used, 32, "trace.");
+			putNum(-1, path, used, 32, getpid() );
+			put(-1, path, used, 32, ".json");
+			path[used] = '\0';
+
+			if(head == 0 || (fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644) ) == -1) {
+				return 0;
+			}//end if
+
+			numEvents = dump(fd);
+			close(fd);
+
+			return numEvents;
+		}//end dumpToFile
+
+};//end TraceBuffer
+#endif
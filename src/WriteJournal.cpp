@@ -0,0 +1,241 @@
+/**
+ *@file WriteJournal.cpp
+ *@author Griffin Nye
+ *@brief Append-only journal of every write committed to the dataset, in commit order, which
+ *       replicas replay to keep their own copy of the dataset. Each entry is the record an
+ *       index was left holding (an empty record once it is removed), so replaying an entry
+ *       twice does no harm, and an entry's number is its position in the file after the header.
+ *       The header holds the journal's epoch, a random id drawn whenever the journal is started
+ *       over, so an entry number handed out before then is known to point into another history.
+ */
+
+
+#ifndef WRITEJOURNAL
+#define WRITEJOURNAL
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "msgPackets.cpp"
+
+using namespace std;
+
+/*! Marks the start of a journal file that has a header (older journals begin with their first entry). */
+#define JOURNALMAGIC "JOURNAL"
+
+/**
+ *@brief The header at the start of the journal file, the size of an entry so entries stay page aligned.
+ */
+struct JournalHeader {
+	char magic[8];                     /*!< JOURNALMAGIC. */
+	uint32_t epoch;                    /*!< Random id of the journal's history (never 0). */
+	char unused[52];
+};
+
+static_assert(sizeof(JournalHeader) == 64, "the journal header must be the size of an entry");
+
+/**
+ *@brief A single journal entry. Entries are 64 bytes so that none straddles a page of the
+ *       file, and a reader racing an append sees either all of an entry or none of it.
+ */
+struct JournalEntry {
+	int64_t commitTime;                /*!< CLOCK_REALTIME nanoseconds at which the write was committed. */
+	int32_t idx;                       /*!< The record's 1-based global index. */
+	char record[MAXRECORDSIZE+1];      /*!< The record now held at idx (empty if removed). */
+	char unused[24];
+};
+
+static_assert(sizeof(JournalEntry) == 64, "journal entries must evenly divide a page");
+
+/**
+ *@brief The journal file of a dataset. Appends are single O_APPEND writes, so the child servers
+ *       (each holding the writer lock of the shard it changed) never interleave parts of entries.
+ */
+class WriteJournal {
+	private:
+		int fd;
+
+		/**
+		 *@brief Writes the header of a journal that has just been emptied.
+		 *@param epoch The journal's new epoch.
+		 *@return Whether the header was written.
+		 */
+		bool writeHeader(uint32_t epoch) {
+			JournalHeader header;
+
+			memset(&header, 0, sizeof(header) );
+			strcpy(header.magic, JOURNALMAGIC);
+			header.epoch = epoch;
+
+			return write(fd, &header, sizeof(header) ) == (ssize_t) sizeof(header);
+		}//end writeHeader
+
+	public:
+
+		/**
+		 *@brief Constructs a journal with no file.
+		 */
+		WriteJournal() {
+			fd = -1;
+		}//end constructor
+
+		/**
+		 *@brief Builds the entry for a write committed now.
+		 *@param idx The record's 1-based global index.
+		 *@param record The record now held at idx (empty if removed).
+		 *@param recordSize The size of the record string.
+		 *@return The entry.
+		 */
+		static JournalEntry entry(int idx, const char record[], int recordSize) {
+			struct timespec ts;
+			JournalEntry entry;
+
+			memset(&entry, 0, sizeof(entry) );
+			clock_gettime(CLOCK_REALTIME, &ts);
+			entry.commitTime = (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+			entry.idx = idx;
+			memcpy(entry.record, record, strnlen(record, min(recordSize, MAXRECORDSIZE) ) );
+
+			return entry;
+		}//end entry
+
+		/**
+		 *@brief Empties the journal, so that it can be started over, and gives it a new epoch.
+		 *@param epoch The new epoch (a replica takes its primary's), or 0 to draw a random one.
+		 *@return Whether the journal was emptied.
+		 */
+		bool clear(uint32_t epoch = 0) {
+			random_device rd;
+
+			while(epoch == 0) {
+				epoch = rd();
+			}//end while
+
+			return ftruncate(fd, 0) == 0 && writeHeader(epoch);
+		}//end clear
+
+		/**
+		 *@brief Retrieves the journal's epoch. It is read from the file each time, as another process may have
+		 *       started the journal over.
+		 *@return The epoch, or 0 if the header could not be read.
+		 */
+		uint32_t getEpoch() {
+			JournalHeader header;
+
+			if(pread(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header) ) {
+				return 0;
+			}//end if
+
+			return header.epoch;
+		}//end getEpoch
+
+		/**
+		 *@brief Retrieves the latest commit time among the journal's newest entries. Entries are appended in
+		 *       about commit order (writers to different shards may append theirs in either order), so a few
+		 *       hundred of the newest cover any reordering.
+		 *@param window The number of the newest entries examined.
+		 *@return The latest commit time in CLOCK_REALTIME nanoseconds, or 0 if the journal is empty.
+		 */
+		int64_t getLastCommitTime(int window) {
+			long numEntries = getNumEntries();
+			int count = (int) min<long>(numEntries, window);
+			vector<JournalEntry> entries(max(count, 1) );
+			int64_t lastCommitTime = 0;
+
+			count = read(numEntries - count, count, &entries[0]);
+
+			for(int i = 0; i < count; i++) {
+				lastCommitTime = max(lastCommitTime, entries[i].commitTime);
+			}//end for
+
+			return lastCommitTime;
+		}//end getLastCommitTime
+
+		/**
+		 *@brief Opens the journal, creating it if it does not exist. A journal without a header (new, or written
+		 *       before journals had epochs) is started over, as its entry numbers cannot be told apart from another's.
+		 *@param filename The journal's filename.
+		 *@return Whether the journal was opened.
+		 */
+		bool open(string filename) {
+			JournalHeader header;
+
+			fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_APPEND, 0666);
+
+			if(fd == -1) {
+				return false;
+			} else if(pread(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header) || strncmp(header.magic, JOURNALMAGIC, sizeof(header.magic) ) != 0) {
+				return clear();
+			}//end if
+
+			return true;
+		}//end open
+
+		/**
+		 *@brief Appends entries to the journal in one write.
+		 *@param entries The entries.
+		 *@param numEntries The number of entries.
+		 *@return Whether every entry was appended.
+		 */
+		bool append(const JournalEntry entries[], int numEntries) {
+			size_t len = sizeof(JournalEntry) * numEntries;
+
+			if(numEntries > 0 && write(fd, entries, len) != (ssize_t) len) {
+				perror("Error appending to the write journal");
+				return false;
+			}//end if
+
+			return true;
+		}//end append
+
+		/**
+		 *@brief Appends the entry for a write committed now.
+		 *@param idx The record's 1-based global index.
+		 *@param record The record now held at idx (empty if removed).
+		 *@param recordSize The size of the record string.
+		 *@return Whether the entry was appended.
+		 */
+		bool append(int idx, const char record[], int recordSize) {
+			JournalEntry committed = entry(idx, record, recordSize);
+
+			return append(&committed, 1);
+		}//end append
+
+		/**
+		 *@brief Reads a run of consecutive entries.
+		 *@param first The number of the first entry (0-based).
+		 *@param count The number of entries.
+		 *@param entries Receives the entries.
+		 *@return The number of whole entries read.
+		 */
+		int read(long first, int count, JournalEntry entries[]) {
+			ssize_t bytesRead = pread(fd, entries, sizeof(JournalEntry) * count, sizeof(JournalHeader) + (off_t) sizeof(JournalEntry) * first);
+
+			return (bytesRead > 0) ? bytesRead / sizeof(JournalEntry) : 0;
+		}//end read
+
+		/**
+		 *@brief Retrieves the number of entries in the journal (the number of the next entry appended).
+		 *@return The number of entries.
+		 */
+		long getNumEntries() {
+			struct stat journalStat;
+
+			if(fd == -1 || fstat(fd, &journalStat) == -1 || journalStat.st_size < (off_t) sizeof(JournalHeader) ) {
+				return 0;
+			}//end if
+
+			return (journalStat.st_size - sizeof(JournalHeader) ) / sizeof(JournalEntry);
+		}//end getNumEntries
+
+};//end WriteJournal
+#endif
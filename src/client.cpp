@@ -6,18 +6,67 @@
  */
 
 
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
-#include <netdb.h>
+#include <sstream>
 #include <string>
 #include <sys/socket.h>
 #include <unistd.h>
+#include <vector>
 
 #include "DataRecord.cpp"
+#include "ShellSimConnection.cpp"
 #include "msgPackets.cpp"
 
 
 using namespace std;
 
+/*! Maximum number of batch requests sent ahead of their replies. */
+#define MAXPIPELINE 64
+/*! Number of record packets received per read when all records are displayed. */
+#define RENDERCHUNKRECORDS 4096
+/*! Size of the buffer rows are formatted into before being written to stdout. */
+#define RENDERBUFSIZE (1 << 20)
+
+/*! The connection to the server, speaking what it agreed to in reply to HELLO. */
+ShellSimConnection server;
+
+/**
+ *@brief A batch mode request that has been sent to the server and is awaiting its reply.
+ *@var batchCmd::line
+ * Line of the script the request was read from
+ *@var batchCmd::cmd
+ * The request's 3 letter command
+ *@var batchCmd::val
+ * The request's index (GET, FIX) or aggregate type (AGG)
+ *@var batchCmd::params
+ * The request's aggregate parameters (AGG)
+ */
+struct batchCmd {
+	int line;
+	string cmd;
+	int val;
+	string params;
+};
+
+/**
+ *@brief Handles client-server and user-client interaction for the Aggregate Revenue menu option.
+ *@param sockfd The currently connected socket's file descriptor.
+ *@param myPID This client's PID.
+ */
+void aggregateRevenue(int sockfd, pid_t myPID);
+
+/**
+ *@brief Handles client-server and user-client interaction for the Bulk Load menu option.
+ *@param sockfd The currently connected socket's file descriptor.
+ *@param myPID This client's PID.
+ */
+void bulkLoad(int sockfd, pid_t myPID);
+
 /**
  *@brief Handles client-server and user-client interaction for the Change Record menu option.
  *@param sockfd The currently connected sockets file descriptor.
@@ -26,12 +75,12 @@ using namespace std;
 void changeRecord(int sockfd, pid_t myPID);
 
 /**
- *@brief Attempts to connect to the server. Returns socket file descriptor on successful connection.
- *@param SERVER_PORT The server's dedicated port number.
- *@param SERVER_ADDRESS The server's address (stored as in_addr).
+ *@brief Attempts to connect to the server and greet it. Returns socket file descriptor on successful connection.
+ *@param endpoint The server's host and port.
+ *@param compress Whether to offer compression of bulk transfers.
  *@return Socket file descriptor on successful connection; client exits on failed connection.
  */ 
-int connect(int SERVER_PORT, struct in_addr *SERVER_ADDRESS);
+int connect(serverEndpoint endpoint, bool compress);
 
 /**
  *@brief Displays the menu of editable field options to the user
@@ -43,15 +92,40 @@ void displayFieldMenu();
  */
 void displayMenu();
 
+/**
+ *@brief Emits a single reply of a batch mode request as a csv or json line.
+ *@param cmd The request being replied to.
+ *@param fields The reply's names and values (csv lines omit the names).
+ *@param quoted Whether each value must be quoted as a string.
+ *@param json Whether to emit a json line rather than a csv line.
+ */
+void emitBatchLine(batchCmd &cmd, vector<pair<string, string> > fields, vector<bool> quoted, bool json);
+
+/**
+ *@brief Emits a record received in reply to a batch mode request.
+ *@param cmd The request being replied to.
+ *@param idx The index of the record.
+ *@param record The record received from the server.
+ *@param json Whether to emit a json line rather than a csv line.
+ */
+void emitBatchRecord(batchCmd &cmd, int idx, char record[], bool json);
+
 /**
  *@brief Handles client-server and user-client interaction for the Display Record menu option.
  *@param sockfd The currently connected socket's file descriptor.
  *@param myPID This client's PID.
  *@param selectedMenuOption Whether or not Display Record is the currently selected menu option (false removes -999 option).
- *@return The retrieved record as an instance of DataRecord. (Last record retrieved for all records option (-999), however the return value is not used in this case).
+ *@return The retrieved record as an instance of DataRecord. (An empty record for the all records option (-999), as the return value is not used in this case).
  */
 DataRecord displayRecord(int sockfd, pid_t myPID, bool selectedMenuOption);
 
+/**
+ *@brief Handles client-server and user-client interaction for the Filter Records menu option.
+ *@param sockfd The currently connected socket's file descriptor.
+ *@param myPID This client's PID.
+ */
+void filterRecords(int sockfd, pid_t myPID);
+
 /**
  *@brief Handles interaction with server for retrieving the record count.
  *@param sockfd The currently connected socket's file descriptor.
@@ -67,6 +141,7 @@ int getCount(int sockfd, pid_t myPID);
  */
 char getMenuInput(bool mainMenu);
 
+
 /**
  *@brief Handles client-server and user-client interaction for the New Record menu option
  *@param sockfd The currently connected socket's file descriptor.
@@ -74,6 +149,14 @@ char getMenuInput(bool mainMenu);
  */
 void newRecord(int sockfd, pid_t myPID);
 
+/**
+ *@brief Receives every record sent in reply to GET -999 (as packets or bare slots, per the agreed encoding) in large
+ *       chunks and writes them to stdout in large blocks, formatting each row directly into the output buffer.
+ *@param numRecords The number of records the server is sending.
+ *@param raw Whether to write the records as raw csv lines rather than aligned display rows.
+ */
+void printAllRecords(int numRecords, bool raw);
+
 /**
  *@brief Prints the data labels for output records.
  */
@@ -82,10 +165,9 @@ void printDataLabels();
 /**
  *@brief Receives and prints all log records sent by the server.
  *@param sockfd The currently connected socket's file descriptor.
- *@param myPID This client's PID.
  *@param numRecords The number of log records to receive from the server.
  */
-void printLogRecords(int sockfd, pid_t myPID, int numRecords);
+void printLogRecords(int sockfd, int numRecords);
 
 /**
  *@brief Prints the provided record.
@@ -94,11 +176,11 @@ void printLogRecords(int sockfd, pid_t myPID, int numRecords);
 void printRecord(char record[]);
 
 /**
- *@brief Prompts the user for one of the float fields for a new or updated record.
+ *@brief Prompts the user for one of the revenue fields for a new or updated record.
  *@param field A Character representing a field in the DataRecord
  *@return The value assigned to the field
  */
-float promptFloatField(char field);
+Money promptMoneyField(char field);
 
 /**
  *@brief Prompts the user for the month for a new record. Validates input through recursive calls until valid input is given.
@@ -126,12 +208,68 @@ int promptSelRecord(int numRecords, bool allRecords);
  */
 string promptYear();
 
+/**
+ *@brief Receives and emits every record sent in reply to GET -999 in batch mode, prefixed by their count.
+ *@param sockfd The currently connected socket's file descriptor.
+ *@param cmd The request being replied to.
+ *@param json Whether to emit json lines rather than csv lines.
+ *@return The number of records received.
+ */
+int receiveBatchRecords(int sockfd, batchCmd &cmd, bool json);
+
+/**
+ *@brief Receives and emits the reply to a batch mode request.
+ *@param sockfd The currently connected socket's file descriptor.
+ *@param cmd The request being replied to.
+ *@param json Whether to emit json lines rather than csv lines.
+ *@return Whether the server reported success.
+ */
+bool receiveBatchReply(int sockfd, batchCmd &cmd, bool json);
+
 /**
  *@brief Handles the receipt of messages from the server.
  *@param sockfd The currently connected socket's file descriptor.
  *@param msg The expected message packet to be received.
+ *@param bulk Whether the message is part of a bulk transfer.
+ */
+template<class MsgPacket> void receiveMsg(int sockfd, MsgPacket &msg, bool bulk = false);
+
+/**
+ *@brief Requests every record (GET -999), first requesting their count (CNT) from a server that speaks version 1 and
+ *       so does not prefix the records with it. Either way, the reply begins with an intMsgPacket of the count.
+ *@param sockfd The currently connected socket's file descriptor.
+ *@param myPID This client's PID.
+ */
+void requestAllRecords(int sockfd, pid_t myPID);
+
+/**
+ *@brief Issues every request of a batch script back to back, keeping up to MAXPIPELINE requests in flight (one, if the server does not pipeline).
+ *@param sockfd The currently connected socket's file descriptor.
+ *@param myPID This client's PID.
+ *@param script The batch script (one request per line).
+ *@param json Whether to emit json lines rather than csv lines.
+ *@return The number of requests that failed or could not be parsed.
+ */
+int runBatch(int sockfd, pid_t myPID, istream &script, bool json);
+
+/**
+ *@brief Parses a single line of a batch script and sends the request it describes.
+ *@param sockfd The currently connected socket's file descriptor.
+ *@param myPID This client's PID.
+ *@param cmd Set to the request sent.
+ *@param args The remainder of the script line following the command.
+ *@return Whether the line was a valid request.
+ */
+bool sendBatchCmd(int sockfd, pid_t myPID, batchCmd &cmd, string args);
+
+/**
+ *@brief Handles the transmission of raw data following a request to the server.
+ *@param sockfd The currently connected socket's file descriptor.
+ *@param buf The data to be sent.
+ *@param len The number of bytes to be sent.
+ *@return Whether all of the data was sent.
  */
-template<class MsgPacket> void receiveMsg(int sockfd, MsgPacket &msg);
+bool sendBytes(int sockfd, const char * buf, size_t len);
 
 /**
  *@brief Handles the transmission of messages to the server.
@@ -153,15 +291,72 @@ void showServerLog(int sockfd, pid_t myPID);
  *@param argv List of command-line arguments
  */
 int main(int argc, char *argv[]) {
-	const int SERVER_PORT = 15005;
-	struct in_addr *SERVER_ADDRESS = (struct in_addr *) (gethostbyname("acad.kutztown.edu")->h_addr);
-
+	serverEndpoint endpoint = {"localhost", CLIENTPORT};
 	char selection;
-	int sockfd;
+	int sockfd, opt;
+	bool json = false, compress = true;
+	string scriptName, dumpFormat, serverName;
 	pid_t myPID = getpid();
+	
+	//Parse the batch mode options
+	while( (opt = getopt(argc, argv, "s:b:o:d:n") ) != -1) {
+		
+		if(opt == 's') {
+			serverName = optarg;
+		} else if(opt == 'b') {
+			scriptName = optarg;
+		} else if(opt == 'o' && (strcmp(optarg, "csv") == 0 || strcmp(optarg, "json") == 0) ) {
+			json = strcmp(optarg, "json") == 0;
+		} else if(opt == 'd' && (strcmp(optarg, "table") == 0 || strcmp(optarg, "csv") == 0) ) {
+			dumpFormat = optarg;
+		} else if(opt == 'n') {
+			compress = false;
+		} else {
+			cout << "USAGE: ./client [-s [host:]port] [-b <script file> | -b -] [-o csv|json] [-d table|csv] [-n]" << endl;
+			return EXIT_FAILURE;
+		}//end if
+		
+	}//end while
+	
+	if( !serverName.empty() && !endpoint.parse(serverName) ) {
+		cout << "Invalid server " << serverName << ", expected [host:]port." << endl;
+		return EXIT_FAILURE;
+	}//end if
 
-	//Connect to server
-	sockfd = connect(SERVER_PORT, SERVER_ADDRESS);
+	//Connect to server, agreeing on the fastest paths it supports (compressing bulk transfers unless asked not to)
+	sockfd = connect(endpoint, compress);
+	
+	//Run the batch script instead of the menu when one is provided
+	if( !scriptName.empty() ) {
+		ifstream scriptFile;
+		
+		if(scriptName != "-") {
+			scriptFile.open(scriptName);
+			
+			if( !scriptFile ) {
+				cerr << "Unable to open " << scriptName << "." << endl;
+				return EXIT_FAILURE;
+			}//end if
+			
+		}//end if
+		
+		return runBatch(sockfd, myPID, scriptName == "-" ? cin : scriptFile, json) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}//end if
+	
+	//Dump every record to stdout instead of running the menu
+	if( !dumpFormat.empty() ) {
+		intMsgPacket cntMsg;
+		
+		requestAllRecords(sockfd, myPID);
+		receiveMsg(sockfd, cntMsg);
+		
+		if(dumpFormat == "table") {
+			printDataLabels();
+		}//end if
+		
+		printAllRecords(cntMsg.val, dumpFormat == "csv");
+		return EXIT_SUCCESS;
+	}//end if
 	
 	do {
 		//Display Main Menu & get user input
@@ -181,6 +376,15 @@ int main(int argc, char *argv[]) {
 			case 'S':
 				showServerLog(sockfd, myPID);
 				break;
+			case 'F':
+				filterRecords(sockfd, myPID);
+				break;
+			case 'A':
+				aggregateRevenue(sockfd, myPID);
+				break;
+			case 'B':
+				bulkLoad(sockfd, myPID);
+				break;
 			case 'V':
 				//viewClientLog(commfd);
 				break;
@@ -195,10 +399,127 @@ int main(int argc, char *argv[]) {
 	
 }//end main
 
+//Handles client-server and user-client interaction for the Aggregate Revenue menu option.
+void aggregateRevenue(int sockfd, pid_t myPID) {
+	char type;
+	int aggType, first, second = 0;
+	intRecMsgPacket aggMsg;
+	string params, label;
+	
+	//Prompt for the type of aggregate, reprompting for invalid entries
+	do {
+		cout << endl << "Aggregate Y)early, Q)uarterly, or R)olling total: ";
+		cin >> type;
+		type = toupper(type);
+	} while( !cin.fail() && type != 'Y' && type != 'Q' && type != 'R');
+	
+	//Prompt for the aggregate's parameters
+	if(type == 'R') {
+		aggType = ROLLING;
+		
+		do {
+			cout << "Number of months: ";
+			cin >> first;
+		} while( !cin.fail() && first < 1);
+		
+		second = promptSelRecord(getCount(sockfd, myPID), false);
+		label = to_string(first) + "-month total ending at record #" + to_string(second);
+	} else {
+		first = stoi( promptYear() );
+		aggType = YEARLY;
+		label = "Total for 20" + to_string(first);
+		
+		if(type == 'Q') {
+			aggType = QUARTERLY;
+			
+			do {
+				cout << "Quarter (1-4): ";
+				cin >> second;
+			} while( !cin.fail() && (second < 1 || second > 4) );
+			
+			label = "Q" + to_string(second) + " 20" + to_string(first) + " total";
+		}//end if
+		
+	}//end if
+	
+	params = to_string(first) + "," + to_string(second);
+	
+	//Send the aggregate request to the server
+	sendMsg(sockfd, intRecMsgPacket(myPID, "AGG", aggType, &params[0]) );
+	
+	//Receive the aggregate
+	receiveMsg(sockfd, aggMsg);
+	
+	if(aggMsg.val == 0) {
+		cout << endl << label << ": $" << aggMsg.record << " bil" << endl;
+	} else {
+		cout << endl << "Failed to retrieve aggregate." << endl;
+	}//end if
+	
+}//end aggregateRevenue
+
+//Handles client-server and user-client interaction for the Bulk Load menu option.
+void bulkLoad(int sockfd, pid_t myPID) {
+	intRecMsgPacket ackMsg;
+	string fileName, format = "CSV";
+	vector<char> payload;
+	
+	//Prompt user for the file of records
+	cout << endl << "File of records (.csv, or .bin as produced by createBin): ";
+	cin >> fileName;
+	
+	ifstream inFile(fileName, ios::binary | ios::ate);
+	
+	if( !inFile ) {
+		cout << endl << "Unable to open " << fileName << "." << endl;
+		return;
+	}//end if
+	
+	//Read the whole file
+	payload.resize(inFile.tellg() );
+	inFile.seekg(0);
+	inFile.read(payload.data(), payload.size() );
+	
+	if(payload.empty() || payload.size() > MAXBULKSIZE) {
+		cout << endl << "File must be between 1 byte and " << (MAXBULKSIZE >> 20) << "MB." << endl;
+		return;
+	}//end if
+	
+	if(fileName.size() > 4 && fileName.compare(fileName.size() - 4, 4, ".bin") == 0) {
+		format = "BIN";
+	}//end if
+	
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	
+	//Send the bulk request followed by the records themselves
+	sendMsg(sockfd, intRecMsgPacket(myPID, "BLK", payload.size(), &format[0]) );
+	
+	if( !server.sendBulk(payload.data(), payload.size() ) ) {
+		perror("Error sending message to server: ");
+		return;
+	}//end if
+	
+	//Receive the range of indexes assigned to the new records
+	receiveMsg(sockfd, ackMsg);
+	
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	
+	if(ackMsg.val == -1) {
+		cout << endl << "Bulk load failed; no records were added." << endl;
+	} else {
+		int first, last;
+		
+		sscanf(ackMsg.record, "%i,%i", &first, &last);
+		cout << endl << "Records #" << first << "-#" << last << " successfully added ("
+		     << (long) ( (last - first + 1) / max(seconds, 1e-9) ) << " records/sec)." << endl;
+	}//end if
+	
+}//end bulkLoad
+
 //Handles client-server and user-client interaction for the Change Record menu option.
 void changeRecord(int sockfd, pid_t myPID) {
 	char selectedField;
-	float fieldValue;
+	Money fieldValue;
 	intRecMsgPacket updateMsg;
 	string recordString;
 	
@@ -212,7 +533,7 @@ void changeRecord(int sockfd, pid_t myPID) {
 	selectedField = getMenuInput(false);
 	
 	//Prompt the user to edit the field's value
-	fieldValue = promptFloatField(selectedField);
+	fieldValue = promptMoneyField(selectedField);
 	
 	//Update the appropriate field
 	switch(selectedField) {
@@ -250,41 +571,19 @@ void changeRecord(int sockfd, pid_t myPID) {
 	
 }//end changeRecord
 
-//Attempts to connect to the server. Returns socket file descriptor on successful connection.
-int connect(int SERVER_PORT, struct in_addr * SERVER_ADDRESS) {
-  int sockfd;
-	struct sockaddr_in server;
-
-	//Create socket for connecting to server
-  if((sockfd = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
-		perror("Error connecting to server: ");
-		cout << "Shutting down..." << endl;	
-		exit(EXIT_FAILURE);		
-  }//end if
-	
-  //Specify Server Address and Port
-  server.sin_family = AF_INET;
-  server.sin_port = htons(SERVER_PORT);
-	
-	struct in_addr * addr;
-	struct hostent * he;
-	
-	he = gethostbyname("localhost");
-    
-	//  STORE IN STRUCT
-	addr = (struct in_addr *) he->h_addr;
-	server.sin_addr = *addr;
+//Attempts to connect to the server and greet it. Returns socket file descriptor on successful connection.
+int connect(serverEndpoint endpoint, bool compress) {
 	
 	//Connect to Server
-  if( connect(sockfd, (struct sockaddr *) &server, sizeof(server) ) == -1) {
+	if( !server.open(endpoint, 0, compress) ) {
 		perror("Failed to connect to server: ");
 		cout << "Shutting down..." << endl;
 		exit(EXIT_FAILURE);
-  } else {
-		cout << "Successfully connected to server." << endl;
-  }//end if
-
-  return sockfd;	
+	} else {
+		clog << "Successfully connected to server." << endl;
+	}//end if
+	
+	return server.getFd();
 }//end connect	
 
 //Displays the menu of editable field options to the user
@@ -301,10 +600,104 @@ void displayMenu() {
 	cout << "N)ew Record" << endl;
 	cout << "D)isplay Record" << endl;
 	cout << "C)hange Record" << endl;
+	cout << "F)ilter Records" << endl;
+	cout << "A)ggregate Revenue" << endl;
+	cout << "B)ulk Load" << endl;
 	cout << "S)how Server Log" << endl;
 	cout << "E)xit" << endl << endl;
 }//end displayMenu
 
+//Emits a single reply of a batch mode request as a csv or json line.
+void emitBatchLine(batchCmd &cmd, vector<pair<string, string> > fields, vector<bool> quoted, bool json) {
+	string line;
+	
+	if(json) {
+		line = "{\"cmd\":\"" + cmd.cmd + "\",\"line\":" + to_string(cmd.line);
+		
+		for(size_t i = 0; i < fields.size(); i++) {
+			line += ",\"" + fields[i].first + "\":";
+			
+			if( !quoted[i] ) {
+				line += fields[i].second;
+				continue;
+			}//end if
+			
+			//Escape the string value
+			line += '"';
+			
+			for(char c : fields[i].second) {
+				if(c == '"' || c == '\\') {
+					line += '\\';
+				}//end if
+				
+				line += c;
+			}//end for
+			
+			line += '"';
+		}//end for
+		
+		line += "}\n";
+	} else {
+		line = cmd.cmd;
+		
+		for(size_t i = 0; i < fields.size(); i++) {
+			
+			//Quote any value containing a delimiter
+			if(quoted[i] && fields[i].second.find_first_of(",\"") != string::npos) {
+				string escaped = "\"";
+				
+				for(char c : fields[i].second) {
+					escaped += c;
+					
+					if(c == '"') {
+						escaped += '"';
+					}//end if
+					
+				}//end for
+				
+				line += "," + escaped + "\"";
+			} else {
+				line += "," + fields[i].second;
+			}//end if
+			
+		}//end for
+		
+		line += "\n";
+	}//end if
+	
+	fwrite(line.data(), sizeof(char), line.size(), stdout);
+}//end emitBatchLine
+
+//Emits a record received in reply to a batch mode request.
+void emitBatchRecord(batchCmd &cmd, int idx, char record[], bool json) {
+	const char * NAMES[5] = {"month", "total", "hardware", "software", "accessories"};
+	vector<pair<string, string> > fields;
+	vector<bool> quoted;
+	string strRecord(record);
+	size_t pos;
+	
+	fields.push_back( make_pair("index", to_string(idx) ) );
+	quoted.push_back(false);
+	
+	//Records that could not be retrieved are reported as a status
+	if(strRecord == "FAILURE" || strRecord.empty() ) {
+		fields.push_back( make_pair("status", "FAILURE") );
+		quoted.push_back(true);
+		emitBatchLine(cmd, fields, quoted, json);
+		return;
+	}//end if
+	
+	//Split the record into its fields
+	for(int i = 0; i < 5; i++) {
+		pos = strRecord.find(',');
+		fields.push_back( make_pair(NAMES[i], strRecord.substr(0, pos) ) );
+		quoted.push_back(i == 0);
+		strRecord.erase(0, pos == string::npos ? pos : pos + 1);
+	}//end for
+	
+	emitBatchLine(cmd, fields, quoted, json);
+}//end emitBatchRecord
+
 //Handles client-server and user-client interaction for the Display Record menu option.
 DataRecord displayRecord(int sockfd, pid_t myPID, bool selectedMenuOption) {
 	DataRecord retrievedRecord;
@@ -320,16 +713,26 @@ DataRecord displayRecord(int sockfd, pid_t myPID, bool selectedMenuOption) {
 	//Assemble the record request message
 	idxMsg = intMsgPacket(myPID, "GET", recNum);
 	
-	//Request record at index recNum
-	sendMsg(sockfd, idxMsg);
-	
+	//Request record at index recNum, or all records after the number of records being sent
 	if(recNum == -999) {
-		numRecords = count;
+		intMsgPacket cntMsg;
+		
+		requestAllRecords(sockfd, myPID);
+		receiveMsg(sockfd, cntMsg);
+		numRecords = cntMsg.val;
+	} else {
+		sendMsg(sockfd, idxMsg);
 	}//end if
 	
 	//Print the Data Headings
 	printDataLabels();
 	
+	//All records are rendered in bulk rather than one at a time
+	if(recNum == -999) {
+		printAllRecords(numRecords, false);
+		return retrievedRecord;
+	}//end if
+	
 	for(int i = 0; i < numRecords; i++) {
 		//Receive the requested record
 		receiveMsg(sockfd, recMsg);
@@ -345,6 +748,53 @@ DataRecord displayRecord(int sockfd, pid_t myPID, bool selectedMenuOption) {
 	return retrievedRecord;
 }//end displayRecord
 
+//Handles client-server and user-client interaction for the Filter Records menu option.
+void filterRecords(int sockfd, pid_t myPID) {
+	intRecMsgPacket recMsg;
+	int numMatches;
+	string expr;
+	
+	//Prompt user for the filter expression
+	cout << endl << "Columns: month, year, accessories, hardware, software, total, index" << endl;
+	
+	do {
+		cout << "Filter (e.g. total > 2 AND year = 20): ";
+		
+		//Discard the remainder of the menu selection line
+		if(cin.peek() == '\n') {
+			cin.ignore();
+		}//end if
+		
+		getline(cin, expr);
+	} while( (expr.empty() || expr.length() > MAXEXPRSIZE) && !cin.fail() );
+	
+	//Send the filter request followed by the expression itself
+	sendMsg(sockfd, intMsgPacket(myPID, "FLT", expr.length() ) );
+	
+	sendBytes(sockfd, expr.c_str(), expr.length() );
+	
+	//Receive the first matching record (an index of -1 if the expression could not be compiled)
+	recMsg.val = 0;
+	receiveMsg(sockfd, recMsg);
+	
+	if(recMsg.val == -1) {
+		cout << endl << "Invalid filter expression." << endl;
+		return;
+	}//end if
+	
+	//Print the Data Headings
+	printDataLabels();
+	
+	//Print each matching record as it arrives, until the packet of index 0 that ends them
+	for(numMatches = 0; recMsg.val > 0; numMatches++) {
+		printRecord(recMsg.record);
+		recMsg.val = 0;
+		receiveMsg(sockfd, recMsg);
+	}//end for
+	
+	cout << endl << numMatches << " matching records." << endl;
+}//end filterRecords
+
 //Handles interaction with server for retrieving the record count.
 int getCount(int sockfd, pid_t myPID) {
 	msgPacket msg;
@@ -382,7 +832,7 @@ char getMenuInput(bool mainMenu) {
 	sel = toupper(sel);
 	
 	//Return selection if valid, otherwise prompt again
-	if(mainMenu && (sel == 'C' || sel == 'D' || sel == 'E' || sel == 'N' || sel == 'S') ) {
+	if(mainMenu && (sel == 'A' || sel == 'B' || sel == 'C' || sel == 'D' || sel == 'E' || sel == 'F' || sel == 'N' || sel == 'S') ) {
 		return sel;
 	} else if (!mainMenu && (sel == 'A' || sel == 'H' || sel == 'S') ) {
 		return sel;
@@ -392,6 +842,7 @@ char getMenuInput(bool mainMenu) {
 	
 }//end getMenuInput
 
+
 //Handles client-server and user-client interaction for the New Record menu option
 void newRecord(int sockfd, pid_t myPID) {
 	intRecMsgPacket recMsg;
@@ -422,6 +873,72 @@ void newRecord(int sockfd, pid_t myPID) {
 
 }//end newRecord
 
+//Receives every record sent in reply to GET -999 in large chunks and writes them to stdout in large blocks.
+void printAllRecords(int numRecords, bool raw) {
+	recMsgPacket probe;
+	bool slots = server.getWire().encoding == ENCODINGSLOTS;
+	size_t stride = slots ? MAXRECORDSIZE + 1 : sizeof(recMsgPacket);
+	size_t recordOffset = slots ? 0 : probe.record - (char *) &probe;
+	vector<char> packets(RENDERCHUNKRECORDS * stride);
+	vector<char> out(RENDERBUFSIZE);
+	size_t outLen = 0, received = 0;
+	size_t remaining = (size_t) max(numRecords, 0) * stride;
+	char * inBuf = packets.data();
+	ssize_t numRead;
+	
+	//Anything already printed through cout must precede the rows
+	cout.flush();
+	
+	while(remaining > 0) {
+		size_t numPackets;
+		
+		//Read as many whole packets (or record slots) as fit in the chunk
+		numRead = server.receiveBulk(inBuf + received, min(remaining, packets.size() - received) );
+		
+		if(numRead == -1) {
+			perror("Error receiving message from server: ");
+			break;
+		} else if(numRead == 0) {
+			fwrite(out.data(), sizeof(char), outLen, stdout);
+			cout << "Server closed the connection." << endl;
+			exit(EXIT_FAILURE);
+		}//end if
+		
+		received += numRead;
+		remaining -= numRead;
+		numPackets = received / stride;
+		
+		//Format each whole packet straight into the output buffer
+		for(size_t i = 0; i < numPackets; i++) {
+			char * record = inBuf + i * stride + recordOffset;
+			size_t len = strnlen(record, MAXRECORDSIZE);
+			DataRecord data;
+			
+			//Flush before the buffer could overflow
+			if(out.size() - outLen < RECORDBUFSIZE) {
+				fwrite(out.data(), sizeof(char), outLen, stdout);
+				outLen = 0;
+			}//end if
+			
+			if(raw && len > 0 && strcmp(record, "FAILURE") != 0) {
+				memcpy(&out[outLen], record, len);
+				outLen += len;
+				out[outLen++] = '\n';
+			} else if( !raw && data.parse(string_view(record, len) ) ) {
+				outLen += data.formatRow(&out[outLen], out.size() - outLen);
+			}//end if
+			
+		}//end for
+		
+		//Keep any partial packet for the next read
+		received -= numPackets * stride;
+		memmove(inBuf, inBuf + numPackets * stride, received);
+	}//end while
+	
+	fwrite(out.data(), sizeof(char), outLen, stdout);
+	fflush(stdout);
+}//end printAllRecords
+
 //Prints the data labels for output records.
 void printDataLabels() {
 	//Print Data Headings
@@ -432,7 +949,7 @@ void printDataLabels() {
 }//end printDataLabels
 
 //Receives and prints all log records sent by the server.
-void printLogRecords(int sockfd, pid_t myPID, int numRecords) {
+void printLogRecords(int sockfd, int numRecords) {
 	logMsgPacket logMsg;
 	
 	cout << endl << "SERVER LOG:" << endl;
@@ -441,7 +958,7 @@ void printLogRecords(int sockfd, pid_t myPID, int numRecords) {
 	for(int i = 0; i < numRecords; i++) {
 		
 		//Receive log record from server
-		receiveMsg(sockfd, logMsg);
+		receiveMsg(sockfd, logMsg, true);
 		
 		//Print server log record
 		cout << logMsg.logRecord;
@@ -453,21 +970,19 @@ void printLogRecords(int sockfd, pid_t myPID, int numRecords) {
 //Prints the provided record.
 void printRecord(char record[]) {
 	
-	//Convert the record from char array to string
-  string strRecord(record);  
+  DataRecord data;
     
-  //Construct DataRecord
-  DataRecord data(strRecord);
-    
-  //Print record
-  data.printRecord();
+  //Parse the record in place and print it
+  if( data.parse(record) ) {
+    data.printRecord();
+  }//end if
 	
 }//end printRecord
 
-//Prompts the user for one of the float fields for a new or updated record.
-float promptFloatField(char field) {
-	string fieldName;
-	float fieldValue;
+//Prompts the user for one of the revenue fields for a new or updated record.
+Money promptMoneyField(char field) {
+	string fieldName, entry;
+	Money fieldValue;
 	
 	//Determine field being edited
 	switch(field) {
@@ -488,11 +1003,11 @@ float promptFloatField(char field) {
 	//Prompt for field value, reprompt if invalid entry	
 	do {
 		cout << "Value for field " << fieldName << ": ";
-		cin >> fieldValue;
-	} while( cin.fail() );
+		cin >> entry;
+	} while( cin && !Money::parse(entry, fieldValue) );
 	
 	return fieldValue;
-}//end promptFloatField
+}//end promptMoneyField
 
 //Prompts the user for the month for a new record.
 //Validates input through recursive calls until valid input is given.
@@ -511,7 +1026,7 @@ string promptMonth() {
 		//Convert entry to capitalize the first letter only	
 		month[0] = toupper(month[0]);
 		
-		for(int i = 1; i < month.length(); i++) {
+		for(size_t i = 1; i < month.length(); i++) {
 			month[i] = tolower(month[i]);
 		}//end for
 		
@@ -530,10 +1045,10 @@ string promptMonth() {
 //Prompts the user to create a new record
 DataRecord promptNewRecord() {
 	DataRecord newRecord;
-	float accessories;
-	float hardware;
-	float software;
-	float total;
+	Money accessories;
+	Money hardware;
+	Money software;
+	Money total;
 	string monthYear;
 	string month;
 	
@@ -542,9 +1057,9 @@ DataRecord promptNewRecord() {
 	//Prompt user for record fields
 	month = promptMonth();
 	monthYear = month + " '" + promptYear();
-	accessories = promptFloatField('A');
-	hardware = promptFloatField('H');
-	software = promptFloatField('S');
+	accessories = promptMoneyField('A');
+	hardware = promptMoneyField('H');
+	software = promptMoneyField('S');
 	
 	//Calculate total
 	total = accessories + hardware + software;
@@ -592,7 +1107,7 @@ string promptYear() {
 		}//end if
 		
 		//Check entry is valid 2-digit year
-		for(int i = 0; i < year.length(); i++) {
+		for(size_t i = 0; i < year.length(); i++) {
 			
 			if( isdigit(year[i]) == 0) {
 				//invalidInput = true;
@@ -618,21 +1133,484 @@ string promptYear() {
 	
 }//end promptYear
 
-//Handles the receipt of messages from the server.
-template<class MsgPacket> void receiveMsg(int sockfd, MsgPacket &msg) {
+//Receives and emits every record sent in reply to GET -999 in batch mode, prefixed by their count.
+int receiveBatchRecords(int sockfd, batchCmd &cmd, bool json) {
+	intMsgPacket cntMsg;
+	recMsgPacket recMsg;
+	char slot[MAXRECORDSIZE + 1];
 	
-	if( read(sockfd, &msg, sizeof(msg) ) == -1) {
-		perror("Error receiving message from server: ");
-	} else {
+	receiveMsg(sockfd, cntMsg);
+	
+	for(int i = 1; i <= cntMsg.val; i++) {
+		
+		//Records lost to a concurrent truncation arrive as empty slots
+		if(server.getWire().encoding == ENCODINGSLOTS) {
+			receiveMsg(sockfd, slot, true);
+			slot[MAXRECORDSIZE] = '\0';
+			emitBatchRecord(cmd, i, slot[0] != '\0' ? slot : (char *) "FAILURE", json);
+			continue;
+		}//end if
+		
+		receiveMsg(sockfd, recMsg, true);
+		emitBatchRecord(cmd, i, recMsg.record, json);
+	}//end for
+	
+	return cntMsg.val;
+}//end receiveBatchRecords
+
+//Receives and emits the reply to a batch mode request.
+bool receiveBatchReply(int sockfd, batchCmd &cmd, bool json) {
+	intMsgPacket cntMsg;
+	intRecMsgPacket ackMsg;
+	recMsgPacket recMsg;
+	logMsgPacket logMsg;
+	
+	if(cmd.cmd == "CNT") {
+		receiveMsg(sockfd, cntMsg);
+		emitBatchLine(cmd, { {"count", to_string(cntMsg.val)} }, {false}, json);
+	} else if(cmd.cmd == "GET" && cmd.val == -999) {
+		
+		//A reply with no records still gets a line, so every script line can be matched to its output
+		if(receiveBatchRecords(sockfd, cmd, json) == 0) {
+			emitBatchLine(cmd, { {"count", "0"} }, {false}, json);
+		}//end if
+		
+	} else if(cmd.cmd == "GET") {
+		receiveMsg(sockfd, recMsg);
+		emitBatchRecord(cmd, cmd.val, recMsg.record, json);
+		return strcmp(recMsg.record, "FAILURE") != 0;
+	} else if(cmd.cmd == "LOG") {
+		receiveMsg(sockfd, cntMsg);
+		
+		for(int i = 0; i < cntMsg.val; i++) {
+			receiveMsg(sockfd, logMsg, true);
+			string logRecord(logMsg.logRecord);
+			
+			if( !logRecord.empty() && logRecord.back() == '\n') {
+				logRecord.pop_back();
+			}//end if
+			
+			emitBatchLine(cmd, { {"entry", logRecord} }, {true}, json);
+		}//end for
+		
+		if(cntMsg.val == 0) {
+			emitBatchLine(cmd, { {"count", "0"} }, {false}, json);
+		}//end if
+		
+	} else if(cmd.cmd == "FLT") {
+		ackMsg.val = 0;
+		receiveMsg(sockfd, ackMsg);
+		
+		if(ackMsg.val == -1) {
+			emitBatchLine(cmd, { {"status", "FAILURE"} }, {true}, json);
+			return false;
+		}//end if
+		
+		//Matches stream in until the packet of index 0 that ends them, which holds their number
+		if(ackMsg.val == 0) {
+			emitBatchLine(cmd, { {"count", "0"} }, {false}, json);
+		}//end if
+		
+		while(ackMsg.val > 0) {
+			emitBatchRecord(cmd, ackMsg.val, ackMsg.record, json);
+			ackMsg.val = 0;
+			receiveMsg(sockfd, ackMsg);
+		}//end while
+		
+	} else if(cmd.cmd == "STATS") {
+		vector<string> columns;
+		
+		receiveMsg(sockfd, cntMsg);
+		
+		//The first line names the columns of the lines that follow
+		for(int i = 0; i < cntMsg.val; i++) {
+			vector<pair<string, string> > fields;
+			vector<bool> quoted;
+			istringstream stat;
+			string value;
+			
+			receiveMsg(sockfd, logMsg);
+			stat.str(logMsg.logRecord);
+			
+			for(size_t col = 0; getline(stat, value, ','); col++) {
+				
+				if(i == 0) {
+					columns.push_back(value);
+				} else {
+					fields.push_back( make_pair(col < columns.size() ? columns[col] : "value", value) );
+					quoted.push_back(col == 0);
+				}//end if
+				
+			}//end for
+			
+			if(i > 0) {
+				emitBatchLine(cmd, fields, quoted, json);
+			}//end if
+			
+		}//end for
+		
+	} else if(cmd.cmd == "AGG") {
+		const char * TYPES[3] = {"YEARLY", "QUARTERLY", "ROLLING"};
+		
+		receiveMsg(sockfd, ackMsg);
+		emitBatchLine(cmd, { {"type", TYPES[cmd.val]}, {"params", cmd.params}, {ackMsg.val == 0 ? "sum" : "status", ackMsg.record} },
+		              {true, true, ackMsg.val != 0}, json);
+		return ackMsg.val == 0;
+	} else if(cmd.cmd == "BLK") {
+		int first = -1, last = -1;
+		
+		receiveMsg(sockfd, ackMsg);
+		sscanf(ackMsg.record, "%i,%i", &first, &last);
+		emitBatchLine(cmd, { {"first", to_string(first)}, {"last", to_string(last)} }, {false, false}, json);
+		return ackMsg.val != -1;
+	} else if(cmd.cmd == "TRACE") {
+		receiveMsg(sockfd, ackMsg);
+		emitBatchLine(cmd, { {"events", to_string(ackMsg.val)}, {"file", ackMsg.record} }, {false, true}, json);
+		return ackMsg.val > 0;
+	} else if(cmd.cmd == "WATCH") {
+		receiveMsg(sockfd, ackMsg);
+		
+		if(ackMsg.val == -1) {
+			emitBatchLine(cmd, { {"status", ackMsg.record} }, {true}, json);
+			return false;
+		}//end if
+		
+		//Every change is written out as soon as it arrives; a count of -1 reports changes missed by a slow subscriber
+		for(int i = 0; cmd.val == 0 || i < cmd.val; i++) {
+			receiveMsg(sockfd, ackMsg);
+			
+			if(ackMsg.val == -1) {
+				emitBatchLine(cmd, { {"missed", ackMsg.record} }, {false}, json);
+			} else if(ackMsg.record[0] == '\0') {
+				emitBatchLine(cmd, { {"index", to_string(ackMsg.val)}, {"status", "REMOVED"} }, {false, true}, json);
+			} else {
+				emitBatchRecord(cmd, ackMsg.val, ackMsg.record, json);
+			}//end if
+			
+			fflush(stdout);
+		}//end for
+		
+	} else if(cmd.cmd == "SYNC") {
+		intRecMsgPacket syncMsg;
+		
+		char strHead[MAXRECORDSIZE + 1], strEpoch[MAXRECORDSIZE + 1] = "";
+		int head = 0, numChanged;
+		
+		//The count of changed records arrives with the new high-water mark and epoch, which are emitted once they are all in
+		receiveMsg(sockfd, syncMsg);
+		syncMsg.record[MAXRECORDSIZE] = '\0';
+		
+		//Once the journal has been started over, the mirror is rebuilt from every record instead
+		if(syncMsg.val == -1 && sscanf(syncMsg.record, "EPOCH,%i,%27s", &head, strEpoch) == 2) {
+			emitBatchLine(cmd, { {"status", "EPOCH"} }, {true}, json);
+			requestAllRecords(sockfd, getpid() );
+			numChanged = receiveBatchRecords(sockfd, cmd, json);
+			emitBatchLine(cmd, { {"changed", to_string(numChanged)}, {"sequence", to_string(head)}, {"epoch", strEpoch} }, {false, false, true}, json);
+			return true;
+		} else if(syncMsg.val == -1) {
+			emitBatchLine(cmd, { {"status", syncMsg.record} }, {true}, json);
+			return false;
+		}//end if
+		
+		for(int i = 0; i < syncMsg.val; i++) {
+			receiveMsg(sockfd, ackMsg);
+			
+			if(ackMsg.record[0] == '\0') {
+				emitBatchLine(cmd, { {"index", to_string(ackMsg.val)}, {"status", "REMOVED"} }, {false, true}, json);
+			} else {
+				emitBatchRecord(cmd, ackMsg.val, ackMsg.record, json);
+			}//end if
+			
+		}//end for
+		
+		sscanf(syncMsg.record, "%27[^,],%27s", strHead, strEpoch);
+		emitBatchLine(cmd, { {"changed", to_string(syncMsg.val)}, {"sequence", strHead}, {"epoch", strEpoch} }, {false, false, true}, json);
+	} else if(cmd.cmd == "LAG") {
+		long applied = -1, staleness = -1;
 		
+		//The entries behind arrive with the entries applied and the staleness in milliseconds
+		receiveMsg(sockfd, ackMsg);
+		sscanf(ackMsg.record, "%li,%li", &applied, &staleness);
+		emitBatchLine(cmd, { {"behind", to_string(ackMsg.val)}, {"applied", to_string(applied)}, {"staleness_ms", to_string(staleness)} },
+		              {false, false, false}, json);
+		return ackMsg.val >= 0;
+	} else {
+		//NEW & FIX
+		receiveMsg(sockfd, ackMsg);
+		emitBatchLine(cmd, { {"index", to_string(ackMsg.val)}, {"status", ackMsg.record} }, {false, true}, json);
+		return strcmp(ackMsg.record, "SUCCESS") == 0;
 	}//end if
+	
+	return true;
+}//end receiveBatchReply
+
+//Handles the receipt of messages from the server.
+template<class MsgPacket> void receiveMsg(int sockfd, MsgPacket &msg, bool bulk) {
+	size_t received = 0;
+	ssize_t numRead;
+	
+	//Continue reading until the whole packet arrives
+	while(received < sizeof(msg) ) {
+		
+		if(bulk) {
+			numRead = server.receiveBulk( (char *) &msg + received, sizeof(msg) - received);
+		} else {
+			numRead = read(sockfd, (char *) &msg + received, sizeof(msg) - received);
+		}//end if
+		
+		
+		if(numRead == -1) {
+			perror("Error receiving message from server: ");
+			return;
+		} else if(numRead == 0) {
+			cout << "Server closed the connection." << endl;
+			exit(EXIT_FAILURE);
+		}//end if
+		
+		received += numRead;
+	}//end while
   
 }//end receiveMsg
 
+//Requests every record (GET -999), first requesting their count (CNT) from a server that speaks version 1.
+void requestAllRecords(int sockfd, pid_t myPID) {
+	
+	if(server.getWire().version < 2) {
+		sendMsg(sockfd, msgPacket(myPID, "CNT") );
+	}//end if
+	
+	sendMsg(sockfd, intMsgPacket(myPID, "GET", -999) );
+}//end requestAllRecords
+
+//Issues every request of a batch script back to back, keeping up to MAXPIPELINE requests in flight (one, if the server does not pipeline).
+int runBatch(int sockfd, pid_t myPID, istream &script, bool json) {
+	deque<batchCmd> inFlight;
+	batchCmd cmd;
+	string line;
+	int lineNum = 0, failures = 0;
+	size_t depth = (server.getWire().features & FEATUREPIPELINE) ? MAXPIPELINE : 1;
+	
+	//Emit output in large blocks rather than per line
+	setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+	
+	while( getline(script, line) ) {
+		istringstream words(line);
+		string args;
+		
+		lineNum++;
+		words >> cmd.cmd;
+		
+		//Skip blank lines & comments
+		if(cmd.cmd.empty() || cmd.cmd[0] == '#') {
+			cmd.cmd.clear();
+			continue;
+		}//end if
+		
+		for(size_t i = 0; i < cmd.cmd.size(); i++) {
+			cmd.cmd[i] = toupper(cmd.cmd[i]);
+		}//end for
+		
+		getline(words >> ws, args);
+		cmd.line = lineNum;
+		
+		//BLK streams its records after the request, and SYNC may follow its reply with GET ALL, so wait for every earlier reply first
+		//(SYNC is also answered before the next request is sent)
+		while( !inFlight.empty() && (inFlight.size() >= depth || cmd.cmd == "BLK" || cmd.cmd == "SYNC") ) {
+			failures += !receiveBatchReply(sockfd, inFlight.front(), json);
+			inFlight.pop_front();
+		}//end while
+		
+		if( sendBatchCmd(sockfd, myPID, cmd, args) ) {
+			inFlight.push_back(cmd);
+			
+			//A subscription carries nothing but changes from then on, so it ends the script
+			if(cmd.cmd == "WATCH") {
+				break;
+			} else if(cmd.cmd == "SYNC") {
+				failures += !receiveBatchReply(sockfd, inFlight.front(), json);
+				inFlight.pop_front();
+			}//end if
+			
+		} else {
+			
+			//Keep the output in script order
+			for(; !inFlight.empty(); inFlight.pop_front() ) {
+				failures += !receiveBatchReply(sockfd, inFlight.front(), json);
+			}//end for
+			
+			emitBatchLine(cmd, { {"status", "INVALID"} }, {true}, json);
+			failures++;
+		}//end if
+		
+		cmd.cmd.clear();
+	}//end while
+	
+	//Collect the remaining replies
+	for(; !inFlight.empty(); inFlight.pop_front() ) {
+		failures += !receiveBatchReply(sockfd, inFlight.front(), json);
+	}//end for
+	
+	fflush(stdout);
+	
+	return failures;
+}//end runBatch
+
+//Parses a single line of a batch script and sends the request it describes.
+bool sendBatchCmd(int sockfd, pid_t myPID, batchCmd &cmd, string args) {
+	istringstream words(args);
+	string recordString;
+	
+	cmd.val = -1;
+	cmd.params.clear();
+	
+	if(cmd.cmd == "CNT" && args.empty() ) {
+		sendMsg(sockfd, msgPacket(myPID, "CNT") );
+	} else if(cmd.cmd == "LOG" && args.empty() ) {
+		sendMsg(sockfd, msgPacket(myPID, "LOG") );
+	} else if(cmd.cmd == "STATS" && args.empty() ) {
+		sendMsg(sockfd, msgPacket(myPID, "STS") );
+	} else if(cmd.cmd == "TRACE" && args.empty() ) {
+		sendMsg(sockfd, msgPacket(myPID, "TRC") );
+	} else if(cmd.cmd == "LAG" && args.empty() ) {
+		sendMsg(sockfd, msgPacket(myPID, "LAG") );
+	} else if(cmd.cmd == "GET") {
+		cmd.val = (args == "ALL" || args == "all") ? -999 : atoi(args.c_str() );
+		
+		if(cmd.val == 0) {
+			return false;
+		}//end if
+		
+		
+		if(cmd.val == -999) {
+			requestAllRecords(sockfd, myPID);
+		} else {
+			sendMsg(sockfd, intMsgPacket(myPID, "GET", cmd.val) );
+		}//end if
+		
+	} else if(cmd.cmd == "NEW" || cmd.cmd == "FIX") {
+		
+		//FIX is followed by the index, then both are followed by the whole csv record
+		if(cmd.cmd == "FIX" && !(words >> cmd.val) ) {
+			return false;
+		}//end if
+		
+		getline(words >> ws, recordString);
+		
+		try {
+			recordString = DataRecord(recordString).toString();
+		} catch(exception &e) {
+			return false;
+		}//end try
+		
+		if(recordString.size() > MAXRECORDSIZE + 1) {
+			return false;
+		}//end if
+		
+		sendMsg(sockfd, intRecMsgPacket(myPID, &cmd.cmd[0], cmd.val, &recordString[0]) );
+	} else if(cmd.cmd == "FLT") {
+		
+		if(args.empty() || args.length() > MAXEXPRSIZE) {
+			return false;
+		}//end if
+		
+		sendMsg(sockfd, intMsgPacket(myPID, "FLT", args.length() ) );
+		sendBytes(sockfd, args.c_str(), args.length() );
+	} else if(cmd.cmd == "AGG") {
+		char type;
+		int first, second = 0;
+		
+		//Y <year>, Q <year> <quarter>, or R <months> <ending record>
+		if( !(words >> type >> first) ) {
+			return false;
+		}//end if
+		
+		type = toupper(type);
+		cmd.val = (type == 'Y') ? YEARLY : (type == 'Q') ? QUARTERLY : (type == 'R') ? ROLLING : -1;
+		
+		if(cmd.val == -1 || (cmd.val != YEARLY && !(words >> second) ) ) {
+			return false;
+		}//end if
+		
+		cmd.params = to_string(first) + "," + to_string(second);
+		sendMsg(sockfd, intRecMsgPacket(myPID, "AGG", cmd.val, &cmd.params[0]) );
+	} else if(cmd.cmd == "BLK") {
+		ifstream inFile(args, ios::binary | ios::ate);
+		vector<char> payload;
+		string format = "CSV";
+		
+		if( !inFile || inFile.tellg() <= 0 || inFile.tellg() > MAXBULKSIZE) {
+			return false;
+		}//end if
+		
+		payload.resize(inFile.tellg() );
+		inFile.seekg(0);
+		inFile.read(payload.data(), payload.size() );
+		
+		if(args.size() > 4 && args.compare(args.size() - 4, 4, ".bin") == 0) {
+			format = "BIN";
+		}//end if
+		
+		sendMsg(sockfd, intRecMsgPacket(myPID, "BLK", payload.size(), &format[0]) );
+		server.sendBulk(payload.data(), payload.size() );
+	} else if(cmd.cmd == "SYNC") {
+		
+		//<sequence number> the mirror is synced to (0 for every record), then the <epoch> it was handed out in
+		if( !(words >> cmd.val) || cmd.val < 0 || (cmd.val > 0 && !(words >> cmd.params) ) || cmd.params.size() > MAXRECORDSIZE) {
+			return false;
+		}//end if
+		
+		sendMsg(sockfd, intRecMsgPacket(myPID, "SYN", cmd.val, &cmd.params[0]) );
+	} else if(cmd.cmd == "WATCH") {
+		int first, last;
+		
+		//<changes> (0 for no limit), optionally followed by <first> <last> to watch only those indexes
+		if( !(words >> cmd.val) || cmd.val < 0) {
+			return false;
+		} else if(words >> first) {
+			
+			if( !(words >> last) || first < 1 || last < first) {
+				return false;
+			}//end if
+			
+			cmd.params = to_string(first) + "," + to_string(last);
+		}//end if
+		
+		sendMsg(sockfd, intRecMsgPacket(myPID, "WCH", 0, &cmd.params[0]) );
+	} else {
+		return false;
+	}//end if
+	
+	return true;
+}//end sendBatchCmd
+
+//Handles the transmission of raw data following a request to the server.
+bool sendBytes(int sockfd, const char * buf, size_t len) {
+	ssize_t numWritten;
+	
+	//Large writes may be split by the socket, so keep writing until all data is sent
+	while(len > 0) {
+		
+		if( (numWritten = write(sockfd, buf, len) ) == -1) {
+			perror("Error sending message to server: ");
+			return false;
+		}//end if
+		
+		buf += numWritten;
+		len -= numWritten;
+	}//end while
+	
+	return true;
+}//end sendBytes
+
 //Handles the transmission of messages to the server.
 template<class MsgPacket> void sendMsg(int sockfd, MsgPacket msg) {
+	serMsgPacket frame;
+	
+	//Pad every request to a full serMsgPacket frame so the server can read requests back to back
+	memset(static_cast<void *>(&frame), 0, sizeof(frame) );
+	memcpy(static_cast<void *>(&frame), &msg, sizeof(msg) );
 	
-	if( write(sockfd, &msg, sizeof(msg) ) == -1) {
+	if( write(sockfd, &frame, sizeof(frame) ) == -1) {
 		perror("Error sending message to server: ");
 	}//end if
 	
@@ -653,5 +1631,5 @@ void showServerLog(int sockfd, pid_t myPID) {
 	receiveMsg(sockfd, cntMsg);
 	
 	//Receive and print the log records
-	printLogRecords(sockfd, myPID, cntMsg.val);
+	printLogRecords(sockfd, cntMsg.val);
 }//end showLog
@@ -4,21 +4,66 @@
  * @brief CSC552 Dr. Spiegel Spring 2020 Transfers data from an input .csv file into an output binary-encoded
  *        file, whose filenames are provided as command-line arguments. Returns
  *        the number of lines read from the inFile or failed open flags.
+ *        The input file is memory-mapped, split into one chunk per core at line
+ *        boundaries, and each chunk is tokenized with the vectorized CsvScanner,
+ *        parsed by the CsvRecordParser, and written in parallel as fixed-size records
+ *        of MAXRECORDSIZE+1 bytes.
  */
 
 
-#include<cstring>
-#include<fstream>
-#include<iostream>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "CsvRecordParser.cpp"
 
 using namespace std;
 
+/*! Number of records each thread formats before issuing a single large write. */
+#define WRITEWINDOWRECORDS 65536
+
+/**
+ *@brief A contiguous range of whole lines of the input file handled by a single thread.
+ *@var importChunk::begin
+ * First byte of the chunk
+ *@var importChunk::end
+ * One past the last byte of the chunk
+ *@var importChunk::numRecords
+ * Number of (non-empty) records in the chunk
+ *@var importChunk::firstRecord
+ * 0-based index of the chunk's first record in the output file
+ *@var importChunk::badRecord
+ * 0-based index of the first malformed record in the chunk, -1 if none
+ */
+struct importChunk {
+  const char * begin;
+  const char * end;
+  long numRecords;
+  long firstRecord;
+  long badRecord;
+};
+
+/**
+ *@brief Parses the records of a chunk and writes them to their positions in the output file.
+ *@param chunk The chunk to be transferred.
+ *@param outfd The output file's descriptor.
+ */
+void transferChunk(importChunk * chunk, int outfd);
+
 /**
- *@brief Transfers data from the input csv file using File Pointers into the output binary file using file streams.
+ *@brief Transfers data from the input csv file into the output binary file using all available cores.
  *@param inFile Filename for the inFile.
  *@param outFile Filename for the outFile.
- *@return The number of lines read from the inFile. -1 indicates inFile_FAIL 0 indicates outFile fail.
- */ 
+ *@return The number of lines read from the inFile. -1 indicates inFile_FAIL 0 indicates outFile fail, -3 indicates a malformed record.
+ */
 int transferData(char * inFile, char * outFile);
 
 /**
@@ -28,7 +73,7 @@ int transferData(char * inFile, char * outFile);
  *@return The number of lines read from the inFile. -1 indicates inFile_FAIL, 0 indicates outFile fail.
  */
 int main(int argc, char * argv[]) {
-  
+
   //Print Usage statement if improper usage occurs
   if(argc!=3) {
     cout << "USAGE: ./createBin <.csv source file> <destination file>" << endl;
@@ -36,49 +81,158 @@ int main(int argc, char * argv[]) {
   } else {
     return transferData(argv[1], argv[2]);
   }//end if
-  
+
 }//end main
-             
+
+//Parses the records of a chunk and writes them to their positions in the output file.
+void transferChunk(importChunk * chunk, int outfd) {
+  vector<char> window(min<long>(max<long>(chunk->numRecords, 1), WRITEWINDOWRECORDS) * RECORDSLOTSIZE);
+  long record = 0, buffered = 0;
+
+  chunk->badRecord = -1;
+
+  CsvRecordParser::forEachLine(chunk->begin, chunk->end, [&](const char * line, const char * lineEnd, const char * commas[], int numCommas) {
+
+    //Format the record into the write window
+    if( !CsvRecordParser::formatRecord(line, lineEnd, commas, numCommas, &window[buffered * RECORDSLOTSIZE]) && chunk->badRecord == -1) {
+      chunk->badRecord = chunk->firstRecord + record;
+    }//end if
+
+    record++;
+    buffered++;
+
+    //Write the window with a single large write once it fills up (or the chunk ends)
+    if(buffered == WRITEWINDOWRECORDS || record == chunk->numRecords) {
+      off_t offset = (off_t) (chunk->firstRecord + record - buffered) * RECORDSLOTSIZE;
+
+      if( pwrite(outfd, &window[0], buffered * RECORDSLOTSIZE, offset) == -1) {
+        perror("Error writing output file");
+      }//end if
+
+      buffered = 0;
+    }//end if
+
+  });
+
+}//end transferChunk
+
 int transferData(char * inFile, char * outFile) {
-  FILE * filePtr;
-  ifstream in;
-  int lines = 0;
-  string buf;
-  
+  const char * data;
+  int infd, outfd;
+  long lines = 0;
+  struct stat inStat;
+  unsigned numThreads = max(1u, thread::hardware_concurrency() );
+  vector<importChunk> chunks;
+  vector<thread> threads;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
   //Open the files
-  in.open(inFile, ios::in);
-  filePtr = fopen(outFile, "wb");
-  
+  infd = open(inFile, O_RDONLY);
+
   //If the inFile fails to open, return inFile_FAIL flag
-  if( in.fail() ) {
+  if(infd == -1 || fstat(infd, &inStat) == -1) {
     cerr<< strerror(errno);
     return -1;
+  }//end if
+
+  outfd = open(outFile, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
   //If the outFile fails to open or be created, return outFile_FAIL flag
-  } else if(filePtr==NULL) {
+  if(outfd == -1) {
+    close(infd);
+    return 0;
+  }//end if
+
+  //Map the whole input file (an empty file produces an empty output file)
+  if(inStat.st_size == 0) {
+    close(infd);
+    close(outfd);
     return 0;
   }//end if
-  
-  //Read & Transfer each line until the file is empty
-  while(getline(in,buf,'\r') ) {
-    
-    //Ignore carriage return character
-    in.ignore(1,'\r');
-    
-    //Copy std::string into c-string
-    char charBuf[buf.length()+1];
-    strcpy(charBuf, buf.c_str());
-    charBuf[buf.length()+1] = '\n';
-    
-    //Write to binary-encoded file
-    fwrite(&charBuf, sizeof(char), sizeof(charBuf)/sizeof(char), filePtr);
-    
-    //increment line count
-    lines++;
-  }//end while
-  
+
+  data = (const char *) mmap(NULL, inStat.st_size, PROT_READ, MAP_PRIVATE, infd, 0);
+
+  if(data == MAP_FAILED) {
+    cerr<< strerror(errno);
+    close(infd);
+    close(outfd);
+    return -1;
+  }//end if
+
+  madvise((void *) data, inStat.st_size, MADV_SEQUENTIAL);
+
+  //Split the file into one chunk per thread, moving each split point past the next line terminator
+  const char * chunkBegin = data;
+  const char * fileEnd = data + inStat.st_size;
+
+  for(unsigned i = 1; i <= numThreads && chunkBegin < fileEnd; i++) {
+    const char * chunkEnd = (i == numThreads) ? fileEnd : data + inStat.st_size / numThreads * i;
+
+    chunkEnd = max(chunkEnd, chunkBegin);
+
+    while(chunkEnd < fileEnd && !CsvRecordParser::isLineEnd(*chunkEnd) ) {
+      chunkEnd++;
+    }//end while
+
+    while(chunkEnd < fileEnd && CsvRecordParser::isLineEnd(*chunkEnd) ) {
+      chunkEnd++;
+    }//end while
+
+    chunks.push_back( {chunkBegin, chunkEnd, 0, 0, -1} );
+    chunkBegin = chunkEnd;
+  }//end for
+
+  //Count each chunk's records in parallel
+  for(size_t i = 0; i < chunks.size(); i++) {
+    threads.push_back( thread([](importChunk * chunk) {
+      chunk->numRecords = CsvRecordParser::countRecords(chunk->begin, chunk->end);
+    }, &chunks[i]) );
+  }//end for
+
+  for(size_t i = 0; i < threads.size(); i++) {
+    threads[i].join();
+  }//end for
+
+  threads.clear();
+
+  //Assign each chunk its position in the output file and size the file up front
+  for(size_t i = 0; i < chunks.size(); i++) {
+    chunks[i].firstRecord = lines;
+    lines += chunks[i].numRecords;
+  }//end for
+
+  if( ftruncate(outfd, (off_t) lines * RECORDSLOTSIZE) == -1) {
+    perror("Error sizing output file");
+  }//end if
+
+  //Parse and write each chunk in parallel
+  for(size_t i = 0; i < chunks.size(); i++) {
+    threads.push_back( thread(transferChunk, &chunks[i], outfd) );
+  }//end for
+
+  for(size_t i = 0; i < threads.size(); i++) {
+    threads[i].join();
+  }//end for
+
   //Close the files
-  in.close();
-  fclose(filePtr);
-  
+  munmap((void *) data, inStat.st_size);
+  close(infd);
+  close(outfd);
+
+  //Report the first malformed record, if any
+  for(size_t i = 0; i < chunks.size(); i++) {
+
+    if(chunks[i].badRecord != -1) {
+      cerr << "Malformed record #" << chunks[i].badRecord + 1 << " of " << inFile << endl;
+      return -3;
+    }//end if
+
+  }//end for
+
+  //Report import throughput
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cout << "Imported " << lines << " records in " << seconds << " sec ("
+       << (long) (lines / max(seconds, 1e-9) ) << " records/sec)" << endl;
+
   return lines;
 }//end readData
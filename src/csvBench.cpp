@@ -0,0 +1,154 @@
+/**
+ * @file csvBench.cpp
+ * @author Griffin Nye
+ * @brief Microbenchmark comparing the throughput (GB/s) of the original getline-based csv
+ *        tokenizing path against the scalar, SSE2, and AVX2 CsvScanner paths.
+ *        USAGE: ./csvBench [size in MB | .csv file]
+ */
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "CsvScanner.cpp"
+
+using namespace std;
+
+/*! Number of bytes handed to the CsvScanner at once. */
+#define SCANBLOCKSIZE (1 << 20)
+
+/**
+ *@brief Builds a synthetic csv dataset in the format of gameRevenue.csv.
+ *@param numBytes The approximate size of the dataset.
+ *@return The csv data.
+ */
+string buildDataset(size_t numBytes);
+
+/**
+ *@brief Tokenizes the data the way createBin originally did: getline per line, then find(',') per field.
+ *@param data The csv data.
+ *@return The number of delimiters found (to keep the work observable).
+ */
+size_t getlineTokenize(const string &data);
+
+/**
+ *@brief Runs a tokenizer over the data several times and reports its best throughput.
+ *@param name The name of the tokenizer.
+ *@param data The csv data.
+ *@param tokenize The tokenizer to be measured.
+ */
+template<class Tokenizer> void report(const char * name, const string &data, Tokenizer tokenize);
+
+/**
+ *@brief Tokenizes the data in blocks using the CsvScanner.
+ *@param data The csv data.
+ *@param isa The instruction set for the scanner to use.
+ *@return The number of delimiters found.
+ */
+size_t scannerTokenize(const string &data, CsvScanner::ISA isa);
+
+/**
+ *@brief Builds or loads the dataset and benchmarks each tokenizer against it.
+ *@param argc Number of command line arguments
+ *@param argv Array of command line arguments
+ */
+int main(int argc, char * argv[]) {
+	string data;
+	CsvScanner::ISA best = CsvScanner::bestISA();
+
+	//Load the provided csv file, or build a synthetic dataset of the provided size (default 64MB)
+	if(argc == 2 && atoi(argv[1]) == 0) {
+		ifstream in(argv[1], ios::binary);
+		stringstream ss;
+		ss << in.rdbuf();
+		data = ss.str();
+	} else {
+		data = buildDataset( (argc == 2 ? atoi(argv[1]) : 64) * (size_t) (1 << 20) );
+	}//end if
+
+	cout << "tokenizer,bytes,GB/s" << endl;
+
+	report("getline", data, getlineTokenize);
+	report("scalar", data, [](const string &d) { return scannerTokenize(d, CsvScanner::SCALAR); });
+
+	if(best >= CsvScanner::SSE2) {
+		report("sse2", data, [](const string &d) { return scannerTokenize(d, CsvScanner::SSE2); });
+	}//end if
+
+	if(best >= CsvScanner::AVX2) {
+		report("avx2", data, [](const string &d) { return scannerTokenize(d, CsvScanner::AVX2); });
+	}//end if
+
+}//end main
+
+//Builds a synthetic csv dataset in the format of gameRevenue.csv.
+string buildDataset(size_t numBytes) {
+	const char * MONTHS[12] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+	char line[64];
+	string data;
+
+	data.reserve(numBytes + sizeof(line) );
+	srand(552);
+
+	for(int i = 0; data.size() < numBytes; i++) {
+		int len = snprintf(line, sizeof(line), "%s '%02d,%d.%02d,%d.%02d,%d.%02d,%d.%02d\r\n", MONTHS[i % 12], i / 12 % 100,
+		                   rand() % 10, rand() % 100, rand() % 10, rand() % 100, rand() % 10, rand() % 100, rand() % 10, rand() % 100);
+		data.append(line, len);
+	}//end for
+
+	return data;
+}//end buildDataset
+
+//Tokenizes the data the way createBin originally did: getline per line, then find(',') per field.
+size_t getlineTokenize(const string &data) {
+	istringstream in(data);
+	string buf;
+	size_t delims = 0, pos;
+
+	while( getline(in, buf, '\r') ) {
+		in.ignore(1, '\r');
+		delims++;
+
+		for(pos = buf.find(','); pos != string::npos; pos = buf.find(',', pos + 1) ) {
+			delims++;
+		}//end for
+
+	}//end while
+
+	return delims;
+}//end getlineTokenize
+
+//Runs a tokenizer over the data several times and reports its best throughput.
+template<class Tokenizer> void report(const char * name, const string &data, Tokenizer tokenize) {
+	const int RUNS = 5;
+	double best = 1e30;
+	volatile size_t sink = 0;
+
+	for(int run = 0; run < RUNS; run++) {
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		sink += tokenize(data);
+		best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count() );
+	}//end for
+
+	cout << name << "," << data.size() << "," << data.size() / best / 1e9 << endl;
+}//end report
+
+//Tokenizes the data in blocks using the CsvScanner.
+size_t scannerTokenize(const string &data, CsvScanner::ISA isa) {
+	static vector<uint32_t> offsets(SCANBLOCKSIZE);
+	size_t delims = 0;
+
+	for(size_t block = 0; block < data.size(); block += SCANBLOCKSIZE) {
+		delims += CsvScanner::scan(data.data() + block, min<size_t>(SCANBLOCKSIZE, data.size() - block), &offsets[0], isa);
+	}//end for
+
+	return delims;
+}//end scannerTokenize
@@ -0,0 +1,451 @@
+/**
+ * @file loadgen.cpp
+ * @author Griffin Nye
+ * @brief Load generator for the server. Opens N connections and drives a configurable mix
+ *        of CNT/GET/GET -999/FIX/NEW/LOG requests either as fast as each connection can go
+ *        (closed loop) or at a fixed total rate (open loop), then reports throughput and
+ *        p50/p99/p999 latency per command from HDR-style histograms as csv.
+ *        Latencies in open loop are measured from each request's scheduled send time, so
+ *        time spent queued behind a slow server is counted rather than hidden.
+ *        USAGE: ./loadgen [-h host] [-p port] [-c connections] [-d seconds] [-r ops/sec] [-m mix]
+ *        e.g.   ./loadgen -c 8 -d 10 -m CNT=30,GET=50,FIX=10,NEW=10
+ *        Note that FIX and NEW modify the dataset.
+ */
+
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <netdb.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "LatencyHistogram.cpp"
+#include "msgPackets.cpp"
+
+using namespace std;
+
+/*! The commands the load generator can issue (ALL is GET -999). */
+enum LOADCMD {CNT, GET, ALL, FIX, NEW, LOG, NUMLOADCMDS};
+
+/*! The names of the commands, in LOADCMD order. */
+const char * LOADCMDNAMES[NUMLOADCMDS] = {"CNT", "GET", "ALL", "FIX", "NEW", "LOG"};
+
+/**
+ *@brief The settings shared by every connection of a load test.
+ *@var loadSettings::host
+ * The server's host name
+ *@var loadSettings::port
+ * The server's port number
+ *@var loadSettings::seconds
+ * Duration of the test
+ *@var loadSettings::rate
+ * Total requests per second across all connections (0 for closed loop)
+ *@var loadSettings::numConnections
+ * Number of concurrent connections
+ *@var loadSettings::weights
+ * Relative weight of each command in the mix
+ */
+struct loadSettings {
+	string host;
+	int port;
+	double seconds;
+	double rate;
+	int numConnections;
+	int weights[NUMLOADCMDS];
+};
+
+/**
+ *@brief The results gathered by a single connection.
+ *@var connectionResults::latencies
+ * Latency (ns) of each command
+ *@var connectionResults::errors
+ * Number of failed requests
+ */
+struct connectionResults {
+	LatencyHistogram latencies[NUMLOADCMDS];
+	long errors;
+};
+
+/**
+ *@brief Opens a connection to the server.
+ *@param settings The load test's settings.
+ *@return Socket file descriptor, or -1 on failure.
+ */
+int connectServer(loadSettings &settings);
+
+/**
+ *@brief Issues a single request and waits for its whole reply.
+ *@param sockfd The connection's socket file descriptor.
+ *@param cmd The command to be issued.
+ *@param numRecords The number of records in the dataset, updated by CNT and NEW replies.
+ *@param rng The connection's random number generator.
+ *@return Whether the request succeeded.
+ */
+bool issueRequest(int sockfd, LOADCMD cmd, int &numRecords, mt19937 &rng);
+
+/**
+ *@brief Parses a mix of the form CMD=weight,CMD=weight into command weights.
+ *@param mix The mix to be parsed.
+ *@param weights Receives the weight of each command.
+ *@return Whether the mix was valid.
+ */
+bool parseMix(string mix, int weights[]);
+
+/**
+ *@brief Reads exactly the requested number of bytes from the socket.
+ *@param sockfd The connection's socket file descriptor.
+ *@param buf The buffer receiving the bytes.
+ *@param len The number of bytes to read.
+ *@return Whether all of the bytes were read.
+ */
+bool receiveBytes(int sockfd, void *buf, size_t len);
+
+/**
+ *@brief Prints the throughput and latency percentiles of each command as csv.
+ *@param results The merged results of every connection.
+ *@param seconds The measured duration of the test.
+ */
+void report(connectionResults &results, double seconds);
+
+/**
+ *@brief Drives the mix over a single connection until the test ends.
+ *@param settings The load test's settings.
+ *@param id The connection's number (0-based).
+ *@param results Receives the connection's results.
+ */
+void runConnection(loadSettings * settings, int id, connectionResults * results);
+
+/**
+ *@brief Sends a request padded to a full serMsgPacket frame.
+ *@param sockfd The connection's socket file descriptor.
+ *@param msg The message packet to be transmitted.
+ *@return Whether the request was sent.
+ */
+template<class MsgPacket> bool sendMsg(int sockfd, MsgPacket msg);
+
+/**
+ *@brief Parses the options, runs every connection in its own thread, and reports the results.
+ *@param argc Number of command line arguments
+ *@param argv Array of command line arguments
+ */
+int main(int argc, char * argv[]) {
+	loadSettings settings = {"localhost", 15005, 10, 0, 4, {30, 50, 0, 10, 10, 0} };
+	vector<connectionResults> results;
+	vector<thread> threads;
+	connectionResults total;
+	int opt;
+
+	//Parse the options
+	while( (opt = getopt(argc, argv, "h:p:c:d:r:m:") ) != -1) {
+
+		switch(opt) {
+			case 'h':
+				settings.host = optarg;
+				break;
+			case 'p':
+				settings.port = atoi(optarg);
+				break;
+			case 'c':
+				settings.numConnections = atoi(optarg);
+				break;
+			case 'd':
+				settings.seconds = atof(optarg);
+				break;
+			case 'r':
+				settings.rate = atof(optarg);
+				break;
+			case 'm':
+				if( parseMix(optarg, settings.weights) ) {
+					break;
+				}//end if
+			default:
+				cerr << "USAGE: ./loadgen [-h host] [-p port] [-c connections] [-d seconds] [-r ops/sec, 0 for closed loop] [-m CNT=30,GET=50,ALL=0,FIX=10,NEW=10,LOG=0]" << endl;
+				return EXIT_FAILURE;
+		}//end switch
+
+	}//end while
+
+	if(settings.numConnections < 1 || settings.seconds <= 0 || settings.rate < 0) {
+		cerr << "Connections and duration must be positive." << endl;
+		return EXIT_FAILURE;
+	}//end if
+
+	cerr << (settings.rate > 0 ? "Open" : "Closed") << " loop: " << settings.numConnections << " connections for "
+	     << settings.seconds << " sec against " << settings.host << ":" << settings.port << endl;
+
+	//Run every connection in its own thread
+	results.resize(settings.numConnections);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	for(int i = 0; i < settings.numConnections; i++) {
+		threads.push_back( thread(runConnection, &settings, i, &results[i]) );
+	}//end for
+
+	for(size_t i = 0; i < threads.size(); i++) {
+		threads[i].join();
+	}//end for
+
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	//Merge and report the results
+	total.errors = 0;
+
+	for(size_t i = 0; i < results.size(); i++) {
+		for(int cmd = 0; cmd < NUMLOADCMDS; cmd++) {
+			total.latencies[cmd].merge(results[i].latencies[cmd]);
+		}//end for
+
+		total.errors += results[i].errors;
+	}//end for
+
+	report(total, seconds);
+
+	return total.errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}//end main
+
+//Opens a connection to the server.
+int connectServer(loadSettings &settings) {
+	struct sockaddr_in server;
+	struct hostent * he;
+	int sockfd;
+
+	if( (he = gethostbyname(settings.host.c_str() ) ) == NULL) {
+		cerr << "Unable to resolve " << settings.host << "." << endl;
+		return -1;
+	}//end if
+
+	if( (sockfd = socket(AF_INET, SOCK_STREAM, 0) ) == -1) {
+		perror("Error creating socket: ");
+		return -1;
+	}//end if
+
+	memset(&server, 0, sizeof(server) );
+	server.sin_family = AF_INET;
+	server.sin_port = htons(settings.port);
+	server.sin_addr = *(struct in_addr *) he->h_addr;
+
+	if( connect(sockfd, (struct sockaddr *) &server, sizeof(server) ) == -1) {
+		perror("Failed to connect to server: ");
+		close(sockfd);
+		return -1;
+	}//end if
+
+	return sockfd;
+}//end connectServer
+
+//Issues a single request and waits for its whole reply.
+bool issueRequest(int sockfd, LOADCMD cmd, int &numRecords, mt19937 &rng) {
+	char record[MAXRECORDSIZE+1] = "Jan '20,3.00,1.00,1.00,1.00";
+	pid_t myPID = getpid();
+	intMsgPacket cntMsg;
+	recMsgPacket recMsg;
+	intRecMsgPacket ackMsg;
+	logMsgPacket logMsg;
+	int idx = numRecords > 0 ? uniform_int_distribution<int>(1, numRecords)(rng) : 1;
+
+	switch(cmd) {
+		case CNT:
+			if( !sendMsg(sockfd, msgPacket(myPID, "CNT") ) || !receiveBytes(sockfd, &cntMsg, sizeof(cntMsg) ) ) {
+				return false;
+			}//end if
+
+			numRecords = cntMsg.val;
+			return true;
+		case GET:
+			return sendMsg(sockfd, intMsgPacket(myPID, "GET", idx) ) && receiveBytes(sockfd, &recMsg, sizeof(recMsg) )
+			       && strcmp(recMsg.record, "FAILURE") != 0;
+		case ALL:
+			//Without HELLO the server speaks version 1, so the count is asked for before the records
+			if( !sendMsg(sockfd, msgPacket(myPID, "CNT") ) || !sendMsg(sockfd, intMsgPacket(myPID, "GET", -999) ) ||
+			    !receiveBytes(sockfd, &cntMsg, sizeof(cntMsg) ) ) {
+				return false;
+			}//end if
+
+			for(int i = 0; i < cntMsg.val; i++) {
+				if( !receiveBytes(sockfd, &recMsg, sizeof(recMsg) ) ) {
+					return false;
+				}//end if
+			}//end for
+
+			return true;
+		case FIX:
+		case NEW:
+			if( !sendMsg(sockfd, intRecMsgPacket(myPID, LOADCMDNAMES[cmd], cmd == FIX ? idx : -1, record) )
+			    || !receiveBytes(sockfd, &ackMsg, sizeof(ackMsg) ) ) {
+				return false;
+			}//end if
+
+			if(cmd == NEW && ackMsg.val > numRecords) {
+				numRecords = ackMsg.val;
+			}//end if
+
+			return strcmp(ackMsg.record, "SUCCESS") == 0;
+		case LOG:
+			if( !sendMsg(sockfd, msgPacket(myPID, "LOG") ) || !receiveBytes(sockfd, &cntMsg, sizeof(cntMsg) ) ) {
+				return false;
+			}//end if
+
+			for(int i = 0; i < cntMsg.val; i++) {
+				if( !receiveBytes(sockfd, &logMsg, sizeof(logMsg) ) ) {
+					return false;
+				}//end if
+			}//end for
+
+			return true;
+		default:
+			return false;
+	}//end switch
+
+}//end issueRequest
+
+//Parses a mix of the form CMD=weight,CMD=weight into command weights.
+bool parseMix(string mix, int weights[]) {
+	char name[4];
+	int weight, numRead, sum = 0;
+	const char * pos = mix.c_str();
+
+	memset(weights, 0, sizeof(int) * NUMLOADCMDS);
+
+	//Read each CMD=weight pair
+	while(sscanf(pos, "%3[A-Za-z]=%d%n", name, &weight, &numRead) == 2) {
+		int cmd;
+
+		for(cmd = 0; cmd < NUMLOADCMDS && strcasecmp(name, LOADCMDNAMES[cmd]) != 0; cmd++);
+
+		if(cmd == NUMLOADCMDS || weight < 0) {
+			return false;
+		}//end if
+
+		weights[cmd] = weight;
+		sum += weight;
+		pos += numRead;
+
+		if(*pos == ',') {
+			pos++;
+		}//end if
+
+	}//end while
+
+	return *pos == '\0' && sum > 0;
+}//end parseMix
+
+//Reads exactly the requested number of bytes from the socket.
+bool receiveBytes(int sockfd, void *buf, size_t len) {
+	size_t received = 0;
+	ssize_t numRead;
+
+	while(received < len) {
+		numRead = read(sockfd, (char *) buf + received, len - received);
+
+		if(numRead <= 0) {
+			return false;
+		}//end if
+
+		received += numRead;
+	}//end while
+
+	return true;
+}//end receiveBytes
+
+//Prints the throughput and latency percentiles of each command as csv.
+void report(connectionResults &results, double seconds) {
+	LatencyHistogram all;
+
+	printf("cmd,requests,ops/sec,mean_us,p50_us,p99_us,p999_us,max_us\n");
+
+	for(int cmd = 0; cmd <= NUMLOADCMDS; cmd++) {
+		LatencyHistogram &hist = (cmd == NUMLOADCMDS) ? all : results.latencies[cmd];
+
+		if(cmd < NUMLOADCMDS) {
+			all.merge(hist);
+		}//end if
+
+		if(hist.getCount() == 0) {
+			continue;
+		}//end if
+
+		printf("%s,%llu,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n", cmd == NUMLOADCMDS ? "TOTAL" : LOADCMDNAMES[cmd],
+		       (unsigned long long) hist.getCount(), hist.getCount() / seconds, hist.getMean() / 1e3,
+		       hist.getPercentile(50) / 1e3, hist.getPercentile(99) / 1e3, hist.getPercentile(99.9) / 1e3, hist.getMax() / 1e3);
+	}//end for
+
+	printf("errors,%ld\n", results.errors);
+}//end report
+
+//Drives the mix over a single connection until the test ends.
+void runConnection(loadSettings * settings, int id, connectionResults * results) {
+	int sockfd, numRecords = 0, totalWeight = 0;
+	mt19937 rng(552 + id);
+	chrono::steady_clock::time_point start, end, scheduled, now;
+	chrono::nanoseconds interval(0);
+
+	results->errors = 0;
+
+	if( (sockfd = connectServer(*settings) ) == -1) {
+		results->errors++;
+		return;
+	}//end if
+
+	//Learn the record count so GET and FIX pick existing records
+	issueRequest(sockfd, CNT, numRecords, rng);
+
+	for(int cmd = 0; cmd < NUMLOADCMDS; cmd++) {
+		totalWeight += settings->weights[cmd];
+	}//end for
+
+	//In open loop each connection sends its share of the rate on a fixed schedule
+	if(settings->rate > 0) {
+		interval = chrono::nanoseconds( (long long) (1e9 * settings->numConnections / settings->rate) );
+	}//end if
+
+	start = scheduled = chrono::steady_clock::now();
+	end = start + chrono::nanoseconds( (long long) (settings->seconds * 1e9) );
+
+	while( (now = chrono::steady_clock::now() ) < end) {
+		int pick = uniform_int_distribution<int>(0, totalWeight - 1)(rng);
+		int cmd = 0;
+
+		//Pick a command according to the mix
+		for(; pick >= settings->weights[cmd]; cmd++) {
+			pick -= settings->weights[cmd];
+		}//end for
+
+		//Wait for the request's scheduled time (closed loop sends immediately)
+		if(interval.count() > 0) {
+			scheduled += interval;
+
+			if(scheduled > now) {
+				this_thread::sleep_until(scheduled);
+			}//end if
+
+		} else {
+			scheduled = now;
+		}//end if
+
+		if( !issueRequest(sockfd, (LOADCMD) cmd, numRecords, rng) ) {
+			results->errors++;
+		}//end if
+
+		results->latencies[cmd].record( chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - scheduled).count() );
+	}//end while
+
+	close(sockfd);
+}//end runConnection
+
+//Sends a request padded to a full serMsgPacket frame.
+template<class MsgPacket> bool sendMsg(int sockfd, MsgPacket msg) {
+	serMsgPacket frame;
+
+	memset(static_cast<void *>(&frame), 0, sizeof(frame) );
+	memcpy(static_cast<void *>(&frame), &msg, sizeof(msg) );
+
+	return write(sockfd, &frame, sizeof(frame) ) == sizeof(frame);
+}//end sendMsg
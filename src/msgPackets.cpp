@@ -50,7 +50,10 @@
  * has the option to enter -999 to display all records. The client will then issue
  * the GET command, indicating a request for a particular record or set of records,
  * and await the server's response. The client will then display the received record(s)
- * to the user.
+ * to the user. When all records are requested, the server first sends the number of
+ * records that follow, then sends them in blocks of SENDBLOCKRECORDS packets, which the
+ * client receives in large chunks and renders into a single output buffer. Running
+ * "./client -d table" (or "-d csv" for raw csv lines) dumps all records the same way.
  *@subsection change_record Change Record
  * Upon selecting the Change Record menu option, the client will perform the same
  * operations as Display Record, however, without the option to display all records.
@@ -74,9 +77,131 @@
  * Upon selecting the List Local Clients menu option, the client will access the shared
  * memory and retrieve each of the local client's process IDs one at a time,
  * displaying them to the user
+ *@subsection filter_records Filter Records
+ * Upon selecting the Filter Records menu option, the client will prompt the user
+ * for a predicate expression over the record columns (month, year, accessories,
+ * hardware, software, total, index), such as "total > 2 AND year = 20". The client
+ * will then issue the FLT command to the server, followed by the expression itself.
+ * The server compiles the expression once and evaluates it against the records a block
+ * at a time, streaming back each block's matching records and their indexes as soon as
+ * the block is evaluated, so it never holds more than a block of matches. The matches end
+ * with a packet of index 0 holding their number. A lone packet of index -1 ("FAILURE")
+ * indicates the expression could not be compiled; an expression longer than MAXEXPRSIZE
+ * is read off and discarded first, and a negative length closes the connection.
+ *@subsection aggregate_revenue Aggregate Revenue
+ * Upon selecting the Aggregate Revenue menu option, the client will prompt the user
+ * for a yearly total, a quarterly total, or a rolling sum of the total field over a
+ * number of months ending at a given record, along with its parameters. The client will
+ * then issue the AGG command to the server, which answers from aggregates it maintains
+ * incrementally in shared memory (per-year/quarter buckets and a Fenwick tree over record
+ * order) whenever a record is added or changed, so no records are scanned. Revenue is
+ * held as fixed-point Money (whole cents), so the sums are exact however many records
+ * they cover. The Fenwick tree is sized for twice the records the server starts with; a
+ * rolling sum ending past that fails until the server is restarted.
+ *@subsection bulk_load Bulk Load
+ * Upon selecting the Bulk Load menu option, the client will prompt the user for a
+ * .csv file (or a binary-encoded .bin file) of records. The client will then issue the
+ * BLK command to the server with the size and encoding of the batch, followed by the
+ * batch itself. The server parses the whole batch, appends it to the dataset in a single
+ * writer critical section with a single log entry, and acknowledges with the range of
+ * indexes assigned to the new records.
+ *@subsection batch_mode Batch Mode
+ * Running the client as "./client -b <script>" (or "-b -" for stdin) skips the menus and
+ * issues one request per script line: CNT, GET <index|ALL>, NEW <record>, FIX <index> <record>,
+ * LOG, FLT <expression>, AGG Y <year> | Q <year> <quarter> | R <months> <index>, LAG, SYNC <sequence> <epoch>,
+ * and BLK <file>, where a record is written as in the dataset ("Jan '20,5.10,1.00,3.00,1.10").
+ * Up to MAXPIPELINE requests are sent ahead of their replies, and every reply is written
+ * as a csv line (or a json line with "-o json") tagged with its command and script line.
+ *@subsection client_library Client Library
+ * The client connects to localhost:15005, or to the server given as "-s [host:]port", through a
+ * ShellSimConnection. The same connections serve the client library, ShellSimClient, which
+ * services include to make typed calls (count, get, getAll, add, fix, put, remove, filter,
+ * aggregate, bulkLoad, log, stats, trace, lag, sync, watch). It keeps a pool of warm
+ * connections to its endpoints, bounds every request by a timeout, and reconnects and retries
+ * the calls whose connections break (except NEW and BLK once they may have been applied).
+ *@subsection server_stats Server Statistics
+ * The STATS batch request issues the STS command, which the server answers with a count
+ * followed by csv lines taken from its ServerStats: a latency histogram per command, the
+ * time spent waiting on each monitor acquire, bin and log file I/O times, and the bytes
+ * sent and received. Every child server records into the same shared memory with relaxed
+ * atomic adds, so measuring costs a clock read per event and no locks.
+ *@subsection workers Worker Pool
+ * Started as "./server -w <workers>", the server pre-forks that many workers instead of
+ * forking per connection. Each worker listens on its own SO_REUSEPORT socket and serves all
+ * of its connections from an EventLoop, reading request frames as they arrive and handling
+ * each one as soon as it is complete. The parent restarts workers that exit. With "-u" the
+ * EventLoop submits those receives through an io_uring, falling back to epoll without one.
+ *@subsection coroutines Coroutine Handlers
+ * Every handler in server.cpp returns a Task and awaits its socket reads and writes
+ * (SocketReceive, SocketWritable) and monitor acquires (SemaphoreAcquire) rather than
+ * blocking on them. In a worker each connection's receiveMsgs() runs under the worker's
+ * CoRuntime, which parks a suspended handler until the EventLoop reports its socket ready
+ * or its semaphore operation succeeds, so one process serves thousands of clients with the
+ * same sequential logic. A forked child server runs the same Tasks without a runtime, where
+ * every await completes immediately.
+ *@subsection sharding Sharding
+ * Started as "./server -s <shards>", the server keeps the dataset in a ShardedDataset of
+ * that many bin files, striped by record index, each guarded by its own LogBinRWSemMonitor
+ * and summarized by its own RevenueAggregates. Requests for one record lock only its shard;
+ * counts, full listings, filters, and aggregates are combined from every shard.
+ *@subsection cluster Cluster
+ * Servers started as "./server -p <port> -c" derive every IPC key from their port, so several run
+ * on one host as the nodes of a cluster behind the router ("./router <nodes>"), which clients
+ * connect to as if it were the server. A HashRing assigns each record index to a node; the node
+ * stores the record at that index (the PUT command) and leaves the rest of its slots empty. The
+ * router relays requests for one record to its owner and scatters the others to every node,
+ * gathering their replies. Adding a node to the ring moves only the indexes it takes over, which
+ * "./router -b <nodes>" copies to their new owners and removes from the old.
+ *@subsection replication Replication
+ * Every write is appended to the dataset's WriteJournal as the record its index was left holding.
+ * A server started as "./server -r <primary host:port>" is a read-only replica: a process of its own
+ * sends the primary (started with -c) the JRN command with the length and epoch of the replica's journal, and the primary
+ * streams the journal from there on, sending new entries as they are appended and an empty block while there
+ * are none. A replica whose journal has another epoch is told to start over: it removes its records,
+ * takes the primary's epoch, and follows the journal from entry 0. The replica applies each entry (appending it to its own journal, so it resumes where it
+ * stopped) and records in its ServerStats how recently it held everything the primary had. With
+ * "-l <ms>", reads are refused once that is longer ago; the LAG command reports the lag.
+ *@subsection watch Change Subscriptions
+ * The WCH command (the WATCH batch request) subscribes a connection to changes, optionally of an
+ * index range only. The journal serves as the fan-out queue: each subscription tails it from its
+ * own position and pushes every matching change as an intRecMsgPacket of the index and new record.
+ * A subscriber whose socket stays full while WATCHMAXBACKLOG changes pile up is skipped ahead and
+ * told how many it missed, so slow subscribers cost writers nothing.
+ *@subsection sync Delta Sync
+ * A write's position in the journal is its commit sequence number, and a record's last-modified
+ * sequence number is that of its newest entry. The SYN command returns the records changed since a
+ * sequence number by reading the journal back from its end to that number (the change index, so
+ * the records themselves are never scanned), along with the new high-water mark and the journal's
+ * epoch. The epoch is drawn anew whenever the journal is started over, so a sequence number from
+ * another epoch is refused ("EPOCH") and the client re-reads every record with GET -999 instead.
+ *@subsection handshake Handshake
+ * A client opens every connection with HLO, a helloMsgPacket offering its protocol version, its
+ * FEATURE bits, its largest frame, and its preferred record encoding. The server replies with
+ * the wireFormat both sides support, which the connection uses from then on. A server that predates
+ * HLO never replies, so after HELLOTIMEOUTMS the client falls back to version 1. In version 2,
+ * GET -999 prefixes the records with their count; a version 1 client asks for it with CNT first.
+ *@subsection compression Compression
+ * A client offers compression in its HLO (or, before version 2, the CMP command), and the codec the
+ * server picks compresses the connection's bulk transfers: the records of GET -999, the lines
+ * of LOG, and the payload of BLK. Each is sent in frames of up to the agreed frame size, each
+ * preceded by a frameHeader and compressed by LzCodec (LZ4's block format) unless it would not shrink.
+ *@subsection metrics Metrics Endpoint
+ * Started as "./server -m <port>", the server forks a MetricsExporter that answers HTTP
+ * GET /metrics on the loopback interface with the same statistics in the Prometheus text
+ * format, plus the number of open connections and the bin and log file sizes.
+ *@subsection tracing Tracing
+ * Every server process records the requests it handles into a TraceBuffer: a span per
+ * request, with begin/end events around each monitor wait, file operation, and send. On
+ * SIGUSR1, or on the TRC command (the TRACE batch request), the ring is written to
+ * trace.<pid>.json in the Chrome trace format for viewing in Perfetto.
  */
 
+#ifndef MSGPACKETS
+#define MSGPACKETS
+
 #include<map>
+#include <string>
+#include <stdint.h>
 #include <string.h>
 #include <sys/types.h>
 
@@ -84,11 +209,37 @@ using namespace std;
 
 /*! The current year, for validating new record entries */
 #define CURRENTYEAR 21
+/*! No compression of bulk transfers (a connection's codec until HLO or CMP negotiates another). */
+#define CODECNONE 0
+/*! LzCodec compression of bulk transfers (the bit a client sets in its CMP request to offer it). */
+#define CODECLZ 1
+/*! Most bytes of a bulk transfer compressed into one frame. */
+#define COMPRESSFRAMESIZE (1 << 18)
+/*! Fewest bytes a connection's frames may be limited to and still compress (smaller limits leave bulk transfers uncompressed). */
+#define MINFRAMESIZE 4096
+/*! Version of the protocol agreed in a HELLO exchange (a connection that never sends HELLO speaks version 1). */
+#define PROTOCOLVERSION 2
+/*! Feature bit: bulk transfers may be compressed with LzCodec. */
+#define FEATURECOMPRESS 0x1
+/*! Feature bit: requests may be sent ahead of the replies to earlier ones. */
+#define FEATUREPIPELINE 0x2
+/*! Record encoding: the records of GET -999 sent as recMsgPackets (version 1's encoding). */
+#define ENCODINGPACKETS 0
+/*! Record encoding: the records of GET -999 sent as bare MAXRECORDSIZE+1 byte slots, as stored, with no packet headers. */
+#define ENCODINGSLOTS 1
+/*! Maximum size of the batch of records sent with the BLK command. */
+#define MAXBULKSIZE (1 << 28)
+/*! Maximum size of a filter expression sent with the FLT command. */
+#define MAXEXPRSIZE 256
 /*! Maximum size of a log record on the server. */
 #define MAXLOGRECORDSIZE 64
 /*! Maximum size of a record on the server. */
 #define MAXRECORDSIZE 27
 
+//AGGREGATE ENUMERATION
+/*! An enumerated type for the revenue aggregates served by the AGG command */
+enum AGGREGATE {YEARLY, QUARTERLY, ROLLING};
+
 //MONTH ENUMERATION	
 /*! An enumerated type for all of the months in a year */
 enum MONTH {JAN, FEB, MAR, APR, MAY, JUN, JUL, AUG, SEP, OCT, NOV, DEC};
@@ -138,6 +289,22 @@ class stringToMonthConverter {
 			
 		}//end isMonth
 		
+		/**
+		 *@brief Returns the MONTH corresponding to the provided 3-letter month abbreviation
+		 *@param month The month abbreviation to be converted
+		 *@return The corresponding MONTH, or -1 if the string is not a valid month
+		 */
+		int toMonth(string month) {
+			map<string, MONTH>::iterator itr = monthMap.find(month);
+			
+			if(itr != monthMap.end() ) {
+				return itr->second;
+			} else {
+				return -1;
+			}//end if
+			
+		}//end toMonth
+		
 };//end stringToMonthConverter
 
 //PACKETS
@@ -228,7 +395,7 @@ struct recMsgPacket : public msgPacket {
 		recMsgPacket(pid_t sender, const char cmd[], char record[]) {
 			this->sender = sender;
 			strcpy(this->cmd, cmd);
-			strcpy(this->record, record);
+			strncpy(this->record, record, sizeof(this->record) );
 		}//end constructor
 		
 };//end recMsgPacket
@@ -263,7 +430,7 @@ struct intRecMsgPacket : public msgPacket{
 			this->sender = sender;
 			strcpy(this->cmd, cmd);
 			this->val = val;
-			strcpy(this->record, record);
+			strncpy(this->record, record, sizeof(this->record) );
 		}//end constructor
 		
 };//end intRecMsgPacket
@@ -293,11 +460,119 @@ struct logMsgPacket: public msgPacket{
 		logMsgPacket(pid_t sender, const char cmd[], char logRecord[]) {
 			this->sender = sender;
 			strcpy(this->cmd, cmd);
-			strcpy(this->logRecord, logRecord);
+			strncpy(this->logRecord, logRecord, sizeof(this->logRecord) );
 		}//end constructor
 			
 };//end logMsgPacket
 
+/**
+ *@struct helloMsgPacket
+ *@brief Sub-Struct TCP message packet exchanged (as the HLO command) when a connection opens. The client
+ *       offers what it supports, and the server replies with what the connection will use.
+ *@var helloMsgPacket::version
+ *  The sender's PROTOCOLVERSION (the server replies with the lower of the two)
+ *@var helloMsgPacket::features
+ *  FEATURE bits supported by the client (in the reply, those both sides support)
+ *@var helloMsgPacket::maxFrameSize
+ *  Most bytes the client accepts in one frame of a bulk transfer (in the reply, the frame size used)
+ *@var helloMsgPacket::encoding
+ *  The client's preferred record encoding (in the reply, the encoding used)
+ */
+struct helloMsgPacket : public msgPacket {
+	public:
+		int version;
+		uint32_t features;
+		int maxFrameSize;
+		int encoding;
+		
+		/**
+		 *@brief Default constructor for helloMsgPacket.
+		 */
+		helloMsgPacket() {
+		}//end constructor
+		
+		/**
+		 *@brief Constructs a helloMsgPacket given its elements.
+		 *@param sender The sender of the message's PID.
+		 *@param cmd The command for the message.
+		 *@param version The protocol version.
+		 *@param features The feature bits.
+		 *@param maxFrameSize The frame size.
+		 *@param encoding The record encoding.
+		 */
+		helloMsgPacket(pid_t sender, const char cmd[], int version, uint32_t features, int maxFrameSize, int encoding) {
+			this->sender = sender;
+			strcpy(this->cmd, cmd);
+			this->version = version;
+			this->features = features;
+			this->maxFrameSize = maxFrameSize;
+			this->encoding = encoding;
+		}//end constructor
+		
+};//end helloMsgPacket
+
+/**
+ *@struct wireFormat
+ *@brief What a connection agreed to in its HELLO exchange (until then, version 1: uncompressed record packets, with
+ *       requests pipelined as every version 1 server reads them back to back).
+ *@var wireFormat::version
+ *  The protocol version spoken
+ *@var wireFormat::features
+ *  The FEATURE bits both sides support
+ *@var wireFormat::codec
+ *  The codec bulk transfers are compressed with
+ *@var wireFormat::frameSize
+ *  Most bytes of a bulk transfer sent in one frame
+ *@var wireFormat::encoding
+ *  The encoding of the records of GET -999
+ */
+struct wireFormat {
+	public:
+		int version;
+		uint32_t features;
+		int codec;
+		int frameSize;
+		int encoding;
+		
+		/**
+		 *@brief Constructs the wire format of a connection that has not sent HELLO.
+		 */
+		wireFormat() {
+			version = 1;
+			features = FEATUREPIPELINE;
+			codec = CODECNONE;
+			frameSize = COMPRESSFRAMESIZE;
+			encoding = ENCODINGPACKETS;
+		}//end constructor
+		
+		/**
+		 *@brief Adopts what the server's reply to HELLO agreed.
+		 *@param hello The server's reply.
+		 */
+		void adopt(const helloMsgPacket &hello) {
+			version = hello.version;
+			features = hello.features;
+			codec = (features & FEATURECOMPRESS) ? CODECLZ : CODECNONE;
+			frameSize = hello.maxFrameSize;
+			encoding = hello.encoding;
+		}//end adopt
+		
+};//end wireFormat
+
+/**
+ *@struct frameHeader
+ *@brief Header of each frame of a bulk transfer on a connection that negotiated compression
+ *       (the records of GET -999, the lines of LOG, and the payload of BLK).
+ *@var frameHeader::rawSize
+ *  The number of bytes of the transfer the frame holds (at most the connection's frame size)
+ *@var frameHeader::packedSize
+ *  The number of bytes that follow (equal to rawSize when they are sent uncompressed, as they would not shrink)
+ */
+struct frameHeader {
+	uint32_t rawSize;
+	uint32_t packedSize;
+};
+
 /**
  *@struct serMsgPacket 
  *@brief Union Struct TCP message packet for receiving messages on server side
@@ -327,3 +602,4 @@ struct serMsgPacket : public intRecMsgPacket {
 	
 	
 };//end serPacket
+#endif
@@ -0,0 +1,1186 @@
+/**
+ * @file router.cpp
+ * @author Griffin Nye
+ * @brief Cluster router. Clients connect to the router exactly as they would to a single server,
+ *        and the router spreads the dataset over several server nodes (e.g. "./server -p 15011"
+ *        run from their own directories): every record index is owned by one node, chosen by a
+ *        consistent hash ring, and the node stores the record at that same index, leaving the
+ *        indexes it does not own empty. GET, FIX, and PUT go to the record's owner alone; CNT,
+ *        FLT, AGG, GET -999, LOG, STS, and TRC are scattered to every node and their replies
+ *        gathered into one. NEW and BLK take the next indexes under the router's append lock and
+ *        store each record on its owner.
+ *        Run as "./router -b <nodes>" once nodes are added (with the router stopped), it moves
+ *        every record that the new ring assigns elsewhere to its new owner and reports the
+ *        share of records moved.
+ *        USAGE: ./router [-p port] [-b] <node> [<node> ...], where a node is [host:]port
+ */
+
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <netdb.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "CsvRecordParser.cpp"
+#include "DataRecord.cpp"
+#include "HashRing.cpp"
+#include "Money.cpp"
+#include "msgPackets.cpp"
+#include "SemaphoreSet.cpp"
+
+using namespace std;
+
+/*! The router's default port, where clients expect the server. */
+#define ROUTERPORT 15005
+/*! Number of records stored per round trip to the nodes by BLK and rebalancing. */
+#define PUTBLOCKRECORDS 1024
+/*! Number of records sent in one write when all records are requested. */
+#define SENDBLOCKRECORDS 4096
+
+//PROTOTYPES//
+
+/**
+ *@brief Listens for incoming client connections and creates a child router, with its own connections to every node, for each.
+ *@param listenfd The listening socket's file descriptor.
+ *@param ring The hash ring of the cluster's nodes.
+ *@param appendSem The append lock shared by every child router.
+ */
+void awaitClients(int listenfd, HashRing &ring, SemaphoreSet &appendSem);
+
+/**
+ *@brief Connects to a single node.
+ *@param name The node's "host:port".
+ *@return The connection's socket file descriptor, or -1 on failure.
+ */
+int connectNode(string name);
+
+/**
+ *@brief Connects to every node of the ring.
+ *@param ring The hash ring of the cluster's nodes.
+ *@param nodefds Receives each node's connection, in node order.
+ *@return Whether every node was connected to.
+ */
+bool connectNodes(HashRing &ring, vector<int> &nodefds);
+
+/**
+ *@brief Retrieves every node's record count (the highest index it stores).
+ *@param nodefds Each node's connection.
+ *@param counts Receives each node's count.
+ *@return The cluster's record count (the highest count of any node), or -1 if a node failed to answer.
+ */
+int gatherCounts(vector<int> &nodefds, vector<int> &counts);
+
+/**
+ *@brief Issues a filter to every node and gathers the matching records, sorted by index.
+ *@param nodefds Each node's connection.
+ *@param expr The filter expression.
+ *@param matches Receives the matching records (and their indexes).
+ *@param sources Receives the node each matching record came from (in the same order).
+ *@return 1 if every node answered, 0 if the expression could not be compiled, -1 if a node failed to answer.
+ */
+int gatherMatches(vector<int> &nodefds, string expr, vector<intRecMsgPacket> &matches, vector<int> &sources);
+
+/**
+ *@brief Normalizes a node's name to "host:port".
+ *@param node The node as given on the command line ([host:]port).
+ *@return The node's name, or an empty string if it has no valid port.
+ */
+string nodeName(string node);
+
+/**
+ *@brief Stores records on the given nodes, a block of records per round trip, each node receiving its share of the block in one write.
+ *@param nodefds Each node's connection.
+ *@param owners The node each record is stored on.
+ *@param records The records and their indexes (an empty record removes the record from its node).
+ *@param sender The PID the stores are issued on behalf of.
+ *@return Whether every record was stored.
+ */
+bool putRecords(vector<int> &nodefds, vector<int> &owners, vector<intRecMsgPacket> &records, pid_t sender);
+
+/**
+ *@brief Moves every record held by a node other than its owner on the ring to its owner, then reports the share of records moved.
+ *@param ring The hash ring of the cluster's nodes (including any new nodes).
+ *@param nodefds Each node's connection.
+ *@return Whether every misplaced record was moved.
+ */
+bool rebalance(HashRing &ring, vector<int> &nodefds);
+
+/**
+ *@brief Reads exactly the requested number of bytes from a socket.
+ *@param sockfd The socket's file descriptor.
+ *@param buf The buffer receiving the bytes.
+ *@param len The number of bytes to read.
+ *@return Whether all of the bytes were read.
+ */
+bool receiveBytes(int sockfd, void *buf, size_t len);
+
+/**
+ *@brief Handles client request for a revenue aggregate by summing every node's share of it. A rolling window
+ *       is cut down, for each node, to the node's records, so no node is asked past its last record.
+ *@param clientfd The client's connection.
+ *@param nodefds Each node's connection.
+ *@param request The client's request.
+ *@return Whether every node answered.
+ */
+bool routeAggregate(int clientfd, vector<int> &nodefds, serMsgPacket request);
+
+/**
+ *@brief Handles client request for every record, gathered from every node and sent in index order
+ *       (indexes that no node holds are reported as failures).
+ *@param clientfd The client's connection.
+ *@param nodefds Each node's connection.
+ *@param prefixed Whether the records are prefixed with their count (the client agreed to version 2).
+ *@return Whether every node answered.
+ */
+bool routeAll(int clientfd, vector<int> &nodefds, bool prefixed);
+
+/**
+ *@brief Handles client request for the addition of a batch of records, stored on their owners at the next indexes.
+ *@param clientfd The client's connection.
+ *@param ring The hash ring of the cluster's nodes.
+ *@param nodefds Each node's connection.
+ *@param appendSem The append lock.
+ *@param request The client's request.
+ *@return Whether every node answered (and the batch could be received).
+ */
+bool routeBulk(int clientfd, HashRing &ring, vector<int> &nodefds, SemaphoreSet &appendSem, serMsgPacket request);
+
+/**
+ *@brief Handles client request for the record count, the highest count of any node.
+ *@param clientfd The client's connection.
+ *@param nodefds Each node's connection.
+ *@return Whether every node answered.
+ */
+bool routeCount(int clientfd, vector<int> &nodefds);
+
+/**
+ *@brief Handles client request for the records matching a filter, gathered from every node.
+ *@param clientfd The client's connection.
+ *@param nodefds Each node's connection.
+ *@param request The client's request.
+ *@return Whether every node answered (and the expression could be received).
+ */
+bool routeFilter(int clientfd, vector<int> &nodefds, serMsgPacket request);
+
+/**
+ *@brief Handles client request for the replication lag of the nodes (each of which may be a replica):
+ *       the most entries any node is behind (-1 if any has never caught up), the entries the nodes have
+ *       applied between them, and the greatest staleness.
+ *@param clientfd The client's connection.
+ *@param nodefds Each node's connection.
+ *@param request The client's request.
+ *@return Whether every node answered.
+ */
+bool routeLag(int clientfd, vector<int> &nodefds, serMsgPacket request);
+
+/**
+ *@brief Handles client request for a list of lines (LOG or STS), sending every node's lines in node order.
+ *@param clientfd The client's connection.
+ *@param nodefds Each node's connection.
+ *@param request The client's request.
+ *@return Whether every node answered.
+ */
+bool routeLines(int clientfd, vector<int> &nodefds, serMsgPacket request);
+
+/**
+ *@brief Handles client request for the addition of a new record, stored on its owner at the next index.
+ *@param clientfd The client's connection.
+ *@param ring The hash ring of the cluster's nodes.
+ *@param nodefds Each node's connection.
+ *@param appendSem The append lock.
+ *@param request The client's request.
+ *@return Whether every node answered.
+ */
+bool routeNew(int clientfd, HashRing &ring, vector<int> &nodefds, SemaphoreSet &appendSem, serMsgPacket request);
+
+/**
+ *@brief Handles client request for a single record (GET, FIX, or PUT) by relaying it to the record's owner.
+ *@param clientfd The client's connection.
+ *@param ring The hash ring of the cluster's nodes.
+ *@param nodefds Each node's connection.
+ *@param request The client's request.
+ *@return Whether the owner answered.
+ */
+bool routeRecord(int clientfd, HashRing &ring, vector<int> &nodefds, serMsgPacket request);
+
+/**
+ *@brief Handles client request for the records changed since a sequence number. Sequence numbers are positions in a
+ *       node's own journal, so only a single-node cluster can answer; a larger one replies with a count of -1.
+ *@param clientfd The client's connection.
+ *@param nodefds Each node's connection.
+ *@param request The client's request.
+ *@return Whether the node answered.
+ */
+bool routeSync(int clientfd, vector<int> &nodefds, serMsgPacket request);
+
+/**
+ *@brief Handles client request for a trace dump on every node, answering with the total number of events written.
+ *@param clientfd The client's connection.
+ *@param nodefds Each node's connection.
+ *@param request The client's request.
+ *@return Whether every node answered.
+ */
+bool routeTrace(int clientfd, vector<int> &nodefds, serMsgPacket request);
+
+/**
+ *@brief Handles client request for a subscription to changes: subscribes to every node, then relays each node's
+ *       changes to the client as they arrive, until the client disconnects.
+ *@param clientfd The client's connection.
+ *@param nodefds Each node's connection.
+ *@param request The client's request.
+ *@return Whether the subscription ended with the client (rather than with a node failing).
+ */
+bool routeWatch(int clientfd, vector<int> &nodefds, serMsgPacket request);
+
+/**
+ *@brief Writes exactly the provided number of bytes to a socket.
+ *@param sockfd The socket's file descriptor.
+ *@param buf The data to be sent.
+ *@param len The number of bytes to be sent.
+ *@return Whether all of the data was sent.
+ */
+bool sendBytes(int sockfd, const void *buf, size_t len);
+
+/**
+ *@brief Sends a message packet.
+ *@param sockfd The socket's file descriptor.
+ *@param msg The message packet to be transmitted (requests to nodes are always full serMsgPacket frames).
+ *@return Whether the message was sent.
+ */
+template<class MsgPacket> bool sendMsg(int sockfd, MsgPacket msg);
+
+/**
+ *@brief Relays a client's requests to the nodes until the client disconnects or a node fails.
+ *@param clientfd The client's connection.
+ *@param ring The hash ring of the cluster's nodes.
+ *@param nodefds Each node's connection.
+ *@param appendSem The append lock.
+ */
+void serveClient(int clientfd, HashRing &ring, vector<int> &nodefds, SemaphoreSet &appendSem);
+
+/**
+ *@brief Sets up the router's listening socket.
+ *@param port The router's port number.
+ *@return The listening socket's file descriptor; the router exits on failure.
+ */
+int setupConnection(int port);
+
+//DEFINITIONS//
+
+/**
+ *@brief Builds the hash ring from the nodes given, then either rebalances the nodes or routes clients to them.
+ *@param argc The number of command-line arguments
+ *@param argv List of command-line arguments
+ */
+int main(int argc, char * argv[]) {
+	int port = ROUTERPORT, opt;
+	bool rebalancing = false;
+	HashRing ring;
+
+	//Parse command-line options
+	while( (opt = getopt(argc, argv, "p:b") ) != -1) {
+
+		if(opt == 'p' && atoi(optarg) > 0) {
+			port = atoi(optarg);
+		} else if(opt == 'b') {
+			rebalancing = true;
+		} else {
+			cout << "USAGE: ./router [-p <port>] [-b] <node> [<node> ...], where a node is [host:]port" << endl;
+			exit(EXIT_FAILURE);
+		}//end if
+
+	}//end while
+
+	//Place every node on the ring
+	for(int i = optind; i < argc; i++) {
+		string name = nodeName(argv[i]);
+
+		if(name.empty() ) {
+			cout << "USAGE: ./router [-p <port>] [-b] <node> [<node> ...], where a node is [host:]port" << endl;
+			exit(EXIT_FAILURE);
+		}//end if
+
+		ring.addNode(name);
+	}//end for
+
+	if(ring.getNumNodes() == 0) {
+		cout << "USAGE: ./router [-p <port>] [-b] <node> [<node> ...], where a node is [host:]port" << endl;
+		exit(EXIT_FAILURE);
+	}//end if
+
+	//Rebalance the nodes instead of routing
+	if(rebalancing) {
+		vector<int> nodefds;
+
+		if( !connectNodes(ring, nodefds) ) {
+			cout << "Shutting down router..." << endl;
+			exit(EXIT_FAILURE);
+		}//end if
+
+		return rebalance(ring, nodefds) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}//end if
+
+	//The append lock keeps NEW and BLK requests from being given the same indexes
+	SemaphoreSet appendSem(port, 1, IPC_CREAT | 0777);
+
+	if(appendSem.set(0, 1) == -1) {
+		perror("Error creating append lock: ");
+		cout << "Shutting down router..." << endl;
+		exit(EXIT_FAILURE);
+	}//end if
+
+	int listenfd = setupConnection(port);
+
+	cout << "Routing incoming connections on port " << port << " to " << ring.getNumNodes() << " nodes..." << endl;
+	awaitClients(listenfd, ring, appendSem);
+}//end main
+
+//Listens for incoming client connections and creates a child router for each.
+void awaitClients(int listenfd, HashRing &ring, SemaphoreSet &appendSem) {
+	int clientfd, pid;
+
+	//Continuously accept incoming client connections
+	while(true) {
+
+		//Reap child routers whose clients have disconnected
+		while(waitpid(-1, NULL, WNOHANG) > 0);
+
+		if( (clientfd = accept(listenfd, NULL, NULL) ) == -1) {
+			perror("Error accepting incoming connection: ");
+			cout << "Shutting down router..." << endl;
+			exit(EXIT_FAILURE);
+		}//end if
+
+		//Delegate connection to child router
+		if( (pid = fork() ) == -1) {
+			perror("Error creating child router process: ");
+			cout << "Shutting down router..." << endl;
+			exit(EXIT_FAILURE);
+		} else if(pid == 0) { //Child Router
+			vector<int> nodefds;
+
+			close(listenfd);
+
+			//A client the cluster cannot serve in full is not served at all
+			if(connectNodes(ring, nodefds) ) {
+				serveClient(clientfd, ring, nodefds, appendSem);
+			}//end if
+
+			exit(EXIT_SUCCESS);
+		}//end if
+
+		close(clientfd);
+	}//end while
+
+}//end awaitClients
+
+//Connects to a single node.
+int connectNode(string name) {
+	struct sockaddr_in server;
+	struct hostent * he;
+	size_t colon = name.rfind(':');
+	string host = name.substr(0, colon);
+	int sockfd;
+
+	if( (he = gethostbyname(host.c_str() ) ) == NULL) {
+		cerr << "Unable to resolve " << host << "." << endl;
+		return -1;
+	}//end if
+
+	if( (sockfd = socket(AF_INET, SOCK_STREAM, 0) ) == -1) {
+		perror("Error creating socket: ");
+		return -1;
+	}//end if
+
+	memset(&server, 0, sizeof(server) );
+	server.sin_family = AF_INET;
+	server.sin_port = htons( atoi(name.substr(colon + 1).c_str() ) );
+	server.sin_addr = *(struct in_addr *) he->h_addr;
+
+	if( connect(sockfd, (struct sockaddr *) &server, sizeof(server) ) == -1) {
+		perror( ("Failed to connect to node " + name + ": ").c_str() );
+		close(sockfd);
+		return -1;
+	}//end if
+
+	return sockfd;
+}//end connectNode
+
+//Connects to every node of the ring.
+bool connectNodes(HashRing &ring, vector<int> &nodefds) {
+
+	for(int n = 0; n < ring.getNumNodes(); n++) {
+		nodefds.push_back( connectNode( ring.getNode(n) ) );
+
+		if(nodefds.back() == -1) {
+			return false;
+		}//end if
+
+	}//end for
+
+	return true;
+}//end connectNodes
+
+//Retrieves every node's record count.
+int gatherCounts(vector<int> &nodefds, vector<int> &counts) {
+	char noRecord[1] = "";
+	int numRecords = 0;
+	intMsgPacket cntMsg;
+
+	//Ask every node before waiting on any of them
+	for(size_t n = 0; n < nodefds.size(); n++) {
+		if( !sendMsg(nodefds[n], serMsgPacket(getpid(), "CNT", -1, noRecord) ) ) {
+			return -1;
+		}//end if
+	}//end for
+
+	counts.resize(nodefds.size() );
+
+	for(size_t n = 0; n < nodefds.size(); n++) {
+		if( !receiveBytes(nodefds[n], &cntMsg, sizeof(cntMsg) ) ) {
+			return -1;
+		}//end if
+
+		counts[n] = cntMsg.val;
+		numRecords = max(numRecords, cntMsg.val);
+	}//end for
+
+	return numRecords;
+}//end gatherCounts
+
+//Issues a filter to every node and gathers the matching records, sorted by index.
+int gatherMatches(vector<int> &nodefds, string expr, vector<intRecMsgPacket> &matches, vector<int> &sources) {
+	char noRecord[1] = "";
+	bool compiled = true;
+	vector<pair<int, int> > order;
+	vector<intRecMsgPacket> unsorted;
+	vector<int> unsortedSources;
+	intRecMsgPacket matchMsg;
+
+	//Ask every node before waiting on any of them
+	for(size_t n = 0; n < nodefds.size(); n++) {
+		if( !sendMsg(nodefds[n], serMsgPacket(getpid(), "FLT", expr.size(), noRecord) ) || !sendBytes(nodefds[n], expr.data(), expr.size() ) ) {
+			return -1;
+		}//end if
+	}//end for
+
+	//Each node streams its matches, ending them with a packet of index 0 (or replying -1 alone if the filter does not compile)
+	for(size_t n = 0; n < nodefds.size(); n++) {
+		if( !receiveBytes(nodefds[n], &matchMsg, sizeof(matchMsg) ) ) {
+			return -1;
+		}//end if
+
+		while(matchMsg.val > 0) {
+			unsorted.push_back(matchMsg);
+			unsortedSources.push_back(n);
+
+			if( !receiveBytes(nodefds[n], &matchMsg, sizeof(matchMsg) ) ) {
+				return -1;
+			}//end if
+
+		}//end while
+
+		compiled = compiled && matchMsg.val != -1;
+	}//end for
+
+	//Each node's matches are in index order, but the nodes' matches interleave
+	for(size_t i = 0; i < unsorted.size(); i++) {
+		order.push_back( make_pair(unsorted[i].val, i) );
+	}//end for
+
+	sort(order.begin(), order.end() );
+
+	for(size_t i = 0; i < order.size(); i++) {
+		matches.push_back(unsorted[order[i].second]);
+		sources.push_back(unsortedSources[order[i].second]);
+	}//end for
+
+	return compiled ? 1 : 0;
+}//end gatherMatches
+
+//Normalizes a node's name to "host:port".
+string nodeName(string node) {
+	size_t colon = node.rfind(':');
+	string host = (colon == string::npos) ? "localhost" : node.substr(0, colon);
+	int port = atoi(node.substr(colon == string::npos ? 0 : colon + 1).c_str() );
+
+	if(port <= 0 || host.empty() ) {
+		return "";
+	}//end if
+
+	return host + ":" + to_string(port);
+}//end nodeName
+
+//Stores records on the given nodes, a block of records per round trip.
+bool putRecords(vector<int> &nodefds, vector<int> &owners, vector<intRecMsgPacket> &records, pid_t sender) {
+	vector<vector<serMsgPacket> > frames(nodefds.size() );
+	intRecMsgPacket ackMsg;
+	bool success = true;
+
+	for(size_t first = 0; first < records.size(); first += PUTBLOCKRECORDS) {
+		size_t last = min(records.size(), first + PUTBLOCKRECORDS);
+
+		//Deal the block out to its nodes
+		for(size_t n = 0; n < frames.size(); n++) {
+			frames[n].clear();
+		}//end for
+
+		for(size_t i = first; i < last; i++) {
+			serMsgPacket frame;
+
+			//Nodes store the whole record field, so nothing past the record may be left uninitialized
+			memset(static_cast<void *>(&frame), 0, sizeof(frame) );
+			frame.sender = sender;
+			strcpy(frame.cmd, "PUT");
+			frame.val = records[i].val;
+			strncpy(frame.record, records[i].record, MAXRECORDSIZE);
+			frames[ owners[i] ].push_back(frame);
+		}//end for
+
+		//Send every node its share in one write, then collect the acknowledgments (a block's replies fit in the socket buffers)
+		for(size_t n = 0; n < frames.size(); n++) {
+			if( !frames[n].empty() && !sendBytes(nodefds[n], &frames[n][0], frames[n].size() * sizeof(serMsgPacket) ) ) {
+				return false;
+			}//end if
+		}//end for
+
+		for(size_t n = 0; n < frames.size(); n++) {
+			for(size_t i = 0; i < frames[n].size(); i++) {
+
+				if( !receiveBytes(nodefds[n], &ackMsg, sizeof(ackMsg) ) ) {
+					return false;
+				}//end if
+
+				success = success && strcmp(ackMsg.record, "SUCCESS") == 0;
+			}//end for
+		}//end for
+
+	}//end for
+
+	return success;
+}//end putRecords
+
+//Moves every misplaced record to its owner on the ring, then reports the share of records moved.
+bool rebalance(HashRing &ring, vector<int> &nodefds) {
+	vector<intRecMsgPacket> matches, moves, removals;
+	vector<int> sources, owners;
+	bool success;
+
+	//Every record a node can parse, wherever it is
+	if(gatherMatches(nodefds, "index >= 1", matches, sources) != 1) {
+		cout << "Error scanning the nodes' records." << endl;
+		return false;
+	}//end if
+
+	for(size_t i = 0; i < matches.size(); i++) {
+		if(ring.ownerOf(matches[i].val) != sources[i]) {
+			moves.push_back(matches[i]);
+			owners.push_back( ring.ownerOf(matches[i].val) );
+		}//end if
+	}//end for
+
+	//Copy each misplaced record to its owner before removing it from where it was
+	success = putRecords(nodefds, owners, moves, getpid() );
+
+	if(success) {
+		owners.clear();
+
+		for(size_t i = 0; i < matches.size(); i++) {
+			if(ring.ownerOf(matches[i].val) != sources[i]) {
+				removals.push_back(matches[i]);
+				removals.back().record[0] = '\0';
+				owners.push_back(sources[i]);
+			}//end if
+		}//end for
+
+		success = putRecords(nodefds, owners, removals, getpid() );
+	}//end if
+
+	printf("Moved %zu of %zu records (%.1f%%) across %d nodes%s.\n", moves.size(), matches.size(), matches.empty() ? 0.0 : 100.0 * moves.size() / matches.size(),
+	       ring.getNumNodes(), success ? "" : "; some records failed to move");
+
+	return success;
+}//end rebalance
+
+//Reads exactly the requested number of bytes from a socket.
+bool receiveBytes(int sockfd, void *buf, size_t len) {
+	size_t received = 0;
+	ssize_t numRead;
+
+	while(received < len) {
+		numRead = read(sockfd, (char *) buf + received, len - received);
+
+		if(numRead <= 0) {
+			return false;
+		}//end if
+
+		received += numRead;
+	}//end while
+
+	return true;
+}//end receiveBytes
+
+//Handles client request for a revenue aggregate by summing every node's share of it.
+bool routeAggregate(int clientfd, vector<int> &nodefds, serMsgPacket request) {
+	int first = 0, second = 0, numRecords = 0;
+	bool success = true;
+	vector<bool> asked(nodefds.size(), true);
+	vector<int> counts;
+	vector<serMsgPacket> requests(nodefds.size(), request);
+	intRecMsgPacket aggMsg;
+	Money sum, nodeSum;
+	string strSum = "FAILURE";
+
+	request.record[MAXRECORDSIZE] = '\0';
+	sscanf(request.record, "%d,%d", &first, &second);
+
+	//A rolling window covers the records after second - first up to second, so each node is asked for the part it holds
+	if(request.val == ROLLING) {
+
+		if( (numRecords = gatherCounts(nodefds, counts) ) == -1) {
+			return false;
+		}//end if
+
+		success = first >= 1 && second >= 1 && second <= numRecords;
+
+		for(size_t n = 0; n < nodefds.size(); n++) {
+			int start = max(second - first, 0), end = min(second, counts[n]);
+
+			asked[n] = success && end > start;
+			snprintf(requests[n].record, sizeof(requests[n].record), "%d,%d", end - start, end);
+		}//end for
+
+	}//end if
+
+	//Ask every node before waiting on any of them
+	for(size_t n = 0; n < nodefds.size(); n++) {
+		if(asked[n] && !sendMsg(nodefds[n], requests[n]) ) {
+			return false;
+		}//end if
+	}//end for
+
+	for(size_t n = 0; n < nodefds.size(); n++) {
+
+		if( !asked[n]) {
+			continue;
+		}//end if
+
+		if( !receiveBytes(nodefds[n], &aggMsg, sizeof(aggMsg) ) ) {
+			return false;
+		}//end if
+
+		success = success && aggMsg.val == 0 && Money::parse(aggMsg.record, nodeSum);
+		sum += nodeSum;
+	}//end for
+
+	if(success) {
+		strSum = sum.toString();
+	}//end if
+
+	return sendMsg(clientfd, intRecMsgPacket(getpid(), "AGG", success ? 0 : -1, &strSum[0]) );
+}//end routeAggregate
+
+//Handles client request for every record, gathered from every node and sent in index order.
+bool routeAll(int clientfd, vector<int> &nodefds, bool prefixed) {
+	char failure[] = "FAILURE";
+	int numRecords;
+	vector<int> counts, sources;
+	vector<intRecMsgPacket> matches;
+	vector<recMsgPacket> packets;
+	pid_t myPID = getpid();
+
+	//Every record each node holds (the empty slots of a node never match)
+	if( (numRecords = gatherCounts(nodefds, counts) ) == -1 || gatherMatches(nodefds, "index >= 1", matches, sources) == -1) {
+		return false;
+	}//end if
+
+	packets.assign(numRecords, recMsgPacket(myPID, "GET", failure) );
+
+	for(size_t i = 0; i < matches.size(); i++) {
+		if(matches[i].val >= 1 && matches[i].val <= numRecords) {
+			packets[matches[i].val - 1] = recMsgPacket(myPID, "GET", matches[i].record);
+		}//end if
+	}//end for
+
+	//Prefix the records with their count (version 1 clients ask with CNT first), then send them in blocks
+	if(prefixed && !sendMsg(clientfd, intMsgPacket(myPID, "GET", numRecords) ) ) {
+		return false;
+	}//end if
+
+	for(int sent = 0; sent < numRecords; sent += SENDBLOCKRECORDS) {
+		if( !sendBytes(clientfd, &packets[sent], min(SENDBLOCKRECORDS, numRecords - sent) * sizeof(recMsgPacket) ) ) {
+			return false;
+		}//end if
+	}//end for
+
+	return true;
+}//end routeAll
+
+//Handles client request for the addition of a batch of records, stored on their owners at the next indexes.
+bool routeBulk(int clientfd, HashRing &ring, vector<int> &nodefds, SemaphoreSet &appendSem, serMsgPacket request) {
+	struct sembuf lockOp = {0, -1, SEM_UNDO}, unlockOp = {0, 1, SEM_UNDO};
+	int numRecords, first = -1;
+	string strRange = "FAILURE";
+	vector<char> payload, slots;
+	vector<int> counts, owners;
+	vector<intRecMsgPacket> records;
+
+	if(request.val > 0 && request.val <= MAXBULKSIZE) {
+		payload.resize(request.val);
+
+		if( !receiveBytes(clientfd, &payload[0], payload.size() ) ) {
+			return false;
+		}//end if
+
+		//Convert the batch into record slots
+		if( strncmp(request.record, "BIN", 3) == 0 && payload.size() % RECORDSLOTSIZE == 0) {
+			slots.swap(payload);
+		} else if( strncmp(request.record, "CSV", 3) == 0 && CsvRecordParser::parseRecords(&payload[0], &payload[0] + payload.size(), slots) != 0) {
+			slots.clear();
+		}//end if
+
+	} else if(request.val > MAXBULKSIZE) {
+		char discard[65536];
+
+		//Drain the oversized batch so the next request is read correctly
+		for(int remaining = request.val; remaining > 0; remaining -= min<int>(remaining, sizeof(discard) ) ) {
+			if( !receiveBytes(clientfd, discard, min<int>(remaining, sizeof(discard) ) ) ) {
+				return false;
+			}//end if
+		}//end for
+
+	}//end if
+
+	numRecords = slots.size() / RECORDSLOTSIZE;
+
+	//Reject the whole batch if any record cannot be parsed, as a single server would
+	for(int i = 0; i < numRecords; i++) {
+		DataRecord record;
+
+		slots[i * RECORDSLOTSIZE + MAXRECORDSIZE] = '\0';
+
+		if( !record.parse( string_view(&slots[i * RECORDSLOTSIZE], strnlen(&slots[i * RECORDSLOTSIZE], MAXRECORDSIZE) ) ) ) {
+			numRecords = 0;
+		}//end if
+
+	}//end for
+
+	//Give the batch the next indexes and store each record on its owner
+	if(numRecords > 0) {
+		appendSem.operate(&lockOp, 1);
+		first = gatherCounts(nodefds, counts) + 1;
+
+		for(int i = 0; i < numRecords && first > 0; i++) {
+			records.push_back( intRecMsgPacket(request.sender, "PUT", first + i, &slots[i * RECORDSLOTSIZE]) );
+			owners.push_back( ring.ownerOf(first + i) );
+		}//end for
+
+		if(first <= 0 || !putRecords(nodefds, owners, records, request.sender) ) {
+			first = -1;
+		}//end if
+
+		appendSem.operate(&unlockOp, 1);
+	}//end if
+
+	if(first != -1) {
+		strRange = to_string(first) + "," + to_string(first + numRecords - 1);
+	}//end if
+
+	return sendMsg(clientfd, intRecMsgPacket(getpid(), "BLK", first, &strRange[0]) );
+}//end routeBulk
+
+//Handles client request for the record count.
+bool routeCount(int clientfd, vector<int> &nodefds) {
+	vector<int> counts;
+	int numRecords = gatherCounts(nodefds, counts);
+
+	return numRecords != -1 && sendMsg(clientfd, intMsgPacket(getpid(), "CNT", numRecords) );
+}//end routeCount
+
+//Handles client request for the records matching a filter, gathered from every node.
+bool routeFilter(int clientfd, vector<int> &nodefds, serMsgPacket request) {
+	char expr[MAXEXPRSIZE+1];
+	char failure[] = "FAILURE";
+	int compiled;
+	string strMatches;
+	vector<intRecMsgPacket> matches;
+	vector<int> sources;
+
+	//Receive the filter expression following the request (a negative length leaves no way to find the next request)
+	if(request.val < 0) {
+		errno = EPROTO;
+		return false;
+	} else if(request.val > MAXEXPRSIZE) {
+
+		//Drain the oversized expression a buffer at a time; it is sent on empty, so it fails to compile
+		for(int remaining = request.val; remaining > 0; remaining -= min(remaining, MAXEXPRSIZE) ) {
+			if( !receiveBytes(clientfd, expr, min(remaining, MAXEXPRSIZE) ) ) {
+				return false;
+			}//end if
+		}//end for
+
+		request.val = 0;
+	} else if( !receiveBytes(clientfd, expr, request.val) ) {
+		return false;
+	}//end if
+
+	if( (compiled = gatherMatches(nodefds, string(expr, request.val), matches, sources) ) == -1) {
+		return false;
+	} else if(compiled == 0) {
+		return sendMsg(clientfd, intRecMsgPacket(getpid(), "FLT", -1, failure) );
+	}//end if
+
+	//Send the matching records, ended with a packet of index 0 holding their number, as a single server would
+	strMatches = to_string(matches.size() );
+
+	return (matches.empty() || sendBytes(clientfd, &matches[0], matches.size() * sizeof(intRecMsgPacket) ) ) &&
+	       sendMsg(clientfd, intRecMsgPacket(getpid(), "FLT", 0, &strMatches[0]) );
+}//end routeFilter
+
+//Handles client request for the replication lag of the nodes.
+bool routeLag(int clientfd, vector<int> &nodefds, serMsgPacket request) {
+	long applied = 0, staleness = 0;
+	int behind = 0;
+	intRecMsgPacket lagMsg;
+	string strLag;
+
+	for(size_t n = 0; n < nodefds.size(); n++) {
+		if( !sendMsg(nodefds[n], request) ) {
+			return false;
+		}//end if
+	}//end for
+
+	for(size_t n = 0; n < nodefds.size(); n++) {
+		long nodeApplied = 0, nodeStaleness = 0;
+
+		if( !receiveBytes(nodefds[n], &lagMsg, sizeof(lagMsg) ) ) {
+			return false;
+		}//end if
+
+		lagMsg.record[MAXRECORDSIZE] = '\0';
+		sscanf(lagMsg.record, "%li,%li", &nodeApplied, &nodeStaleness);
+
+		//A node that has never caught up leaves the cluster's lag unknown
+		behind = (behind == -1 || lagMsg.val == -1) ? -1 : max(behind, lagMsg.val);
+		staleness = (staleness == -1 || nodeStaleness == -1) ? -1 : max(staleness, nodeStaleness);
+		applied += nodeApplied;
+	}//end for
+
+	strLag = to_string(applied) + "," + to_string(staleness);
+
+	return sendMsg(clientfd, intRecMsgPacket(getpid(), "LAG", behind, &strLag[0]) );
+}//end routeLag
+
+//Handles client request for a list of lines (LOG or STS), sending every node's lines in node order.
+bool routeLines(int clientfd, vector<int> &nodefds, serMsgPacket request) {
+	vector<logMsgPacket> lines;
+	intMsgPacket cntMsg;
+
+	//Ask every node before waiting on any of them
+	for(size_t n = 0; n < nodefds.size(); n++) {
+		if( !sendMsg(nodefds[n], request) ) {
+			return false;
+		}//end if
+	}//end for
+
+	for(size_t n = 0; n < nodefds.size(); n++) {
+		if( !receiveBytes(nodefds[n], &cntMsg, sizeof(cntMsg) ) ) {
+			return false;
+		}//end if
+
+		for(int i = 0; i < cntMsg.val; i++) {
+			lines.push_back( logMsgPacket() );
+
+			if( !receiveBytes(nodefds[n], &lines.back(), sizeof(logMsgPacket) ) ) {
+				return false;
+			}//end if
+
+		}//end for
+
+	}//end for
+
+	return sendMsg(clientfd, intMsgPacket(getpid(), request.cmd, lines.size() ) ) &&
+	       (lines.empty() || sendBytes(clientfd, &lines[0], lines.size() * sizeof(logMsgPacket) ) );
+}//end routeLines
+
+//Handles client request for the addition of a new record, stored on its owner at the next index.
+bool routeNew(int clientfd, HashRing &ring, vector<int> &nodefds, SemaphoreSet &appendSem, serMsgPacket request) {
+	struct sembuf lockOp = {0, -1, SEM_UNDO}, unlockOp = {0, 1, SEM_UNDO};
+	int idx;
+	vector<int> counts;
+	intRecMsgPacket ackMsg;
+
+	//The next index is only the next until the record is stored
+	appendSem.operate(&lockOp, 1);
+
+	if( (idx = gatherCounts(nodefds, counts) ) == -1) {
+		appendSem.operate(&unlockOp, 1);
+		return false;
+	}//end if
+
+	idx++;
+	request.val = idx;
+	strcpy(request.cmd, "PUT");
+
+	//An empty record would remove the record rather than add it
+	if(request.record[0] == '\0') {
+		strcpy(ackMsg.record, "FAILURE");
+	} else if( !sendMsg(nodefds[ ring.ownerOf(idx) ], request) || !receiveBytes(nodefds[ ring.ownerOf(idx) ], &ackMsg, sizeof(ackMsg) ) ) {
+		appendSem.operate(&unlockOp, 1);
+		return false;
+	}//end if
+
+	appendSem.operate(&unlockOp, 1);
+
+	if(strcmp(ackMsg.record, "SUCCESS") != 0) {
+		idx = -1;
+	}//end if
+
+	return sendMsg(clientfd, intRecMsgPacket(getpid(), "NEW", idx, ackMsg.record) );
+}//end routeNew
+
+//Handles client request for a single record by relaying it to the record's owner.
+bool routeRecord(int clientfd, HashRing &ring, vector<int> &nodefds, serMsgPacket request) {
+	int ownerfd = nodefds[ ring.ownerOf(request.val) ];
+
+	//A GET is answered with a record alone; FIX and PUT with the index and an acknowledgment
+	if(strcmp(request.cmd, "GET") == 0) {
+		recMsgPacket recMsg;
+
+		return sendMsg(ownerfd, request) && receiveBytes(ownerfd, &recMsg, sizeof(recMsg) ) && sendMsg(clientfd, recMsg);
+	} else {
+		intRecMsgPacket ackMsg;
+
+		return sendMsg(ownerfd, request) && receiveBytes(ownerfd, &ackMsg, sizeof(ackMsg) ) && sendMsg(clientfd, ackMsg);
+	}//end if
+
+}//end routeRecord
+
+//Handles client request for the records changed since a sequence number, relayed to a single node.
+bool routeSync(int clientfd, vector<int> &nodefds, serMsgPacket request) {
+	intRecMsgPacket syncMsg;
+	vector<intRecMsgPacket> changes;
+	char failure[] = "FAILURE";
+
+	//Every node numbers its own writes, so there is no cluster-wide sequence to sync from
+	if(nodefds.size() != 1) {
+		return sendMsg(clientfd, intRecMsgPacket(getpid(), "SYN", -1, failure) );
+	}//end if
+
+	if( !sendMsg(nodefds[0], request) || !receiveBytes(nodefds[0], &syncMsg, sizeof(syncMsg) ) ) {
+		return false;
+	}//end if
+
+	changes.resize( max(syncMsg.val, 0) );
+
+	if( !changes.empty() && !receiveBytes(nodefds[0], &changes[0], changes.size() * sizeof(intRecMsgPacket) ) ) {
+		return false;
+	}//end if
+
+	return sendMsg(clientfd, syncMsg) &&
+	       (changes.empty() || sendBytes(clientfd, &changes[0], changes.size() * sizeof(intRecMsgPacket) ) );
+}//end routeSync
+
+//Handles client request for a trace dump on every node.
+bool routeTrace(int clientfd, vector<int> &nodefds, serMsgPacket request) {
+	int numEvents = 0;
+	intRecMsgPacket trcMsg;
+	string path;
+
+	//Ask every node before waiting on any of them
+	for(size_t n = 0; n < nodefds.size(); n++) {
+		if( !sendMsg(nodefds[n], request) ) {
+			return false;
+		}//end if
+	}//end for
+
+	//Each node writes its own trace in its own directory; the reply names the first node's
+	for(size_t n = 0; n < nodefds.size(); n++) {
+		if( !receiveBytes(nodefds[n], &trcMsg, sizeof(trcMsg) ) ) {
+			return false;
+		}//end if
+
+		numEvents += max(trcMsg.val, 0);
+
+		if(n == 0) {
+			path = trcMsg.record;
+		}//end if
+
+	}//end for
+
+	return sendMsg(clientfd, intRecMsgPacket(getpid(), "TRC", numEvents, &path[0]) );
+}//end routeTrace
+
+//Handles client request for a subscription to changes, relaying every node's changes until the client disconnects.
+bool routeWatch(int clientfd, vector<int> &nodefds, serMsgPacket request) {
+	vector<struct pollfd> fds(nodefds.size() + 1);
+	intRecMsgPacket change;
+	bool subscribed = true;
+	char failure[] = "FAILURE", success[] = "SUCCESS";
+
+	for(size_t n = 0; n < nodefds.size(); n++) {
+		if( !sendMsg(nodefds[n], request) ) {
+			return false;
+		}//end if
+	}//end for
+
+	//The subscription holds only if every node accepted it
+	for(size_t n = 0; n < nodefds.size(); n++) {
+		if( !receiveBytes(nodefds[n], &change, sizeof(change) ) ) {
+			return false;
+		}//end if
+
+		subscribed = subscribed && change.val != -1;
+	}//end for
+
+	if( !sendMsg(clientfd, intRecMsgPacket(getpid(), "WCH", subscribed ? 0 : -1, subscribed ? success : failure) ) ) {
+		return true;
+	}//end if
+
+	if( !subscribed) {
+		return true;
+	}//end if
+
+	//Each node pushes its own records' changes; the client only ever sends its disconnect
+	for(size_t n = 0; n < nodefds.size(); n++) {
+		fds[n] = {nodefds[n], POLLIN, 0};
+	}//end for
+
+	fds[nodefds.size()] = {clientfd, POLLIN, 0};
+
+	while( poll(&fds[0], fds.size(), -1) != -1 || errno == EINTR) {
+
+		if(fds[nodefds.size()].revents != 0) {
+			return true;
+		}//end if
+
+		for(size_t n = 0; n < nodefds.size(); n++) {
+			if(fds[n].revents != 0 && !(receiveBytes(nodefds[n], &change, sizeof(change) ) && sendMsg(clientfd, change) ) ) {
+				return false;
+			}//end if
+		}//end for
+
+	}//end while
+
+	return false;
+}//end routeWatch
+
+//Writes exactly the provided number of bytes to a socket.
+bool sendBytes(int sockfd, const void *buf, size_t len) {
+	size_t sent = 0;
+	ssize_t numWritten;
+
+	while(sent < len) {
+		numWritten = write(sockfd, (const char *) buf + sent, len - sent);
+
+		if(numWritten == -1) {
+			return false;
+		}//end if
+
+		sent += numWritten;
+	}//end while
+
+	return true;
+}//end sendBytes
+
+//Sends a message packet.
+template<class MsgPacket> bool sendMsg(int sockfd, MsgPacket msg) {
+	return sendBytes(sockfd, &msg, sizeof(msg) );
+}//end sendMsg
+
+//Relays a client's requests to the nodes until the client disconnects or a node fails.
+void serveClient(int clientfd, HashRing &ring, vector<int> &nodefds, SemaphoreSet &appendSem) {
+	serMsgPacket request;
+	bool served = true;
+	int version = 1;
+
+	//Every request arrives as a full serMsgPacket frame
+	while(served && receiveBytes(clientfd, &request, sizeof(request) ) ) {
+		request.cmd[3] = '\0';
+
+		if(strcmp(request.cmd, "CNT") == 0) {
+			served = routeCount(clientfd, nodefds);
+		} else if(strcmp(request.cmd, "GET") == 0 && request.val == -999) {
+			served = routeAll(clientfd, nodefds, version >= 2);
+		} else if(strcmp(request.cmd, "GET") == 0 || strcmp(request.cmd, "FIX") == 0 || strcmp(request.cmd, "PUT") == 0) {
+			served = routeRecord(clientfd, ring, nodefds, request);
+		} else if(strcmp(request.cmd, "NEW") == 0) {
+			served = routeNew(clientfd, ring, nodefds, appendSem, request);
+		} else if(strcmp(request.cmd, "BLK") == 0) {
+			served = routeBulk(clientfd, ring, nodefds, appendSem, request);
+		} else if(strcmp(request.cmd, "FLT") == 0) {
+			served = routeFilter(clientfd, nodefds, request);
+		} else if(strcmp(request.cmd, "AGG") == 0) {
+			served = routeAggregate(clientfd, nodefds, request);
+		} else if(strcmp(request.cmd, "LOG") == 0 || strcmp(request.cmd, "STS") == 0) {
+			served = routeLines(clientfd, nodefds, request);
+		} else if(strcmp(request.cmd, "TRC") == 0) {
+			served = routeTrace(clientfd, nodefds, request);
+		} else if(strcmp(request.cmd, "LAG") == 0) {
+			served = routeLag(clientfd, nodefds, request);
+		} else if(strcmp(request.cmd, "HLO") == 0) {
+			helloMsgPacket hello;
+			
+			//Replies are relayed as the nodes send them, so only pipelining and plain record packets are agreed
+			memcpy(static_cast<void *>(&hello), &request, sizeof(hello) );
+			version = max(1, min(hello.version, PROTOCOLVERSION) );
+			served = sendMsg(clientfd, helloMsgPacket(getpid(), "HLO", version, hello.features & FEATUREPIPELINE,
+			                                          max(1, min(hello.maxFrameSize, COMPRESSFRAMESIZE) ), ENCODINGPACKETS) );
+		} else if(strcmp(request.cmd, "CMP") == 0) {
+			//Replies are relayed as the nodes send them, so bulk transfers through the router stay uncompressed
+			served = sendMsg(clientfd, intMsgPacket(getpid(), "CMP", CODECNONE) );
+		} else if(strcmp(request.cmd, "SYN") == 0) {
+			served = routeSync(clientfd, nodefds, request);
+		} else if(strcmp(request.cmd, "WCH") == 0) {
+			served = routeWatch(clientfd, nodefds, request);
+		}//end if
+
+	}//end while
+
+	//The client is dropped rather than answered from part of the cluster
+	if( !served) {
+		perror("Error relaying request to the nodes: ");
+	}//end if
+
+	close(clientfd);
+}//end serveClient
+
+//Sets up the router's listening socket.
+int setupConnection(int port) {
+	const int MAX_CONN = 10;
+	int listenfd, reuse = 1;
+	struct sockaddr_in routerAddress;
+
+	if( (listenfd = socket(AF_INET, SOCK_STREAM, 0) ) == -1) {
+		perror("Error creating listening socket: ");
+		cout << "Shutting down router..." << endl;
+		exit(EXIT_FAILURE);
+	}//end if
+
+	//Allow a restarted router to bind while old connections linger in TIME_WAIT
+	setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse) );
+
+	memset(&routerAddress, 0, sizeof(routerAddress) );
+	routerAddress.sin_family = AF_INET;
+	routerAddress.sin_addr.s_addr = INADDR_ANY;
+	routerAddress.sin_port = htons(port);
+
+	if( bind(listenfd, (struct sockaddr *) &routerAddress, sizeof(routerAddress) ) == -1 || listen(listenfd, MAX_CONN) == -1) {
+		perror("Error setting up listening socket: ");
+		cout << "Shutting down router..." << endl;
+		close(listenfd);
+		exit(EXIT_FAILURE);
+	}//end if
+
+	return listenfd;
+}//end setupConnection
@@ -6,33 +6,115 @@
  */
 
 
+#include <algorithm>
 #include <arpa/inet.h>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <fcntl.h>
+#include <ctime>
 #include <cstdio>
 #include <iostream>
+#include <map>
+#include <netdb.h>
 #include <string>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include <unistd.h>
+#include <unordered_set>
+#include <vector>
 
 #include "msgPackets.cpp"
 #include "LogBinRWSemMonitor.cpp"
+#include "CsvRecordParser.cpp"
+#include "RecordFilter.cpp"
+#include "RevenueAggregates.cpp"
+#include "ServerStats.cpp"
+#include "MetricsExporter.cpp"
+#include "TraceBuffer.cpp"
+#include "EventLoop.cpp"
+#include "ShardedDataset.cpp"
+#include "ShardStorage.cpp"
+#include "LzCodec.cpp"
 
 
 using namespace std;
 
-/*! My assigned port on acad for the server's listening socket. */
+/*! My assigned port on acad for the server's listening socket (the default; -p picks another, e.g. for each node of a cluster). */
 #define PORTNUM 15005
+/*! Number of records read under one reader lock and sent in one write when all records are requested. */
+#define SENDBLOCKRECORDS 4096
+/*! Key for the server statistics' shared memory, past every shard's keys so servers on neighbouring ports never share one. */
+#define STATSKEY(port) ((port) + SHARDKEYSTRIDE * (MAXSHARDS + 1) )
+/*! Most journal entries streamed to a replica in one write. */
+#define JOURNALBLOCKENTRIES 256
+/*! Microseconds between checks of the journal for new entries while a replica is up to date. */
+#define JOURNALPOLLINTERVAL 10000
+/*! Number of idle journal checks after which an up-to-date replica is sent a heartbeat (an empty block). */
+#define JOURNALHEARTBEATPOLLS 10
+/*! Most journal entries a WATCH subscriber may fall behind before it is skipped ahead to the newest change. */
+#define WATCHMAXBACKLOG 65536
+
+/*! Statistics shared by the server and every child server; records nothing until attached in main. */
+ServerStats serverStats(STATSKEY(PORTNUM) );
+
+/*! This process's trace of the requests it has handled (each child server starts with an empty copy). */
+TraceBuffer tracer;
+
+/*! Milliseconds a replica may fall behind its primary before it refuses reads (0 never refuses). */
+long maxStaleness = 0;
+
+/*! Whether the server runs as a node of a cluster (-c), accepting the router's PUT and replicas' JRN; other servers refuse both. */
+bool clusterNode = false;
 
 //PROTOTYPES//
 
 /**
- *@brief Adds a record to the bin file
- *@param binPtr File pointer to the bin file
+ *@brief Accepts every pending client connection in a worker and starts a receiveMsgs coroutine for each one.
+ *@param listenfd The worker's (non-blocking) listening socket's file descriptor.
+ *@param dataset The sharded dataset.
+ *@param logPtr The file pointer to the server log file.
+ *@param fileMonitor Monitor for synchronizing read & write operations on the server log.
+ */
+void acceptClient(int listenfd, ShardedDataset &dataset, FILE *logPtr, LogBinRWSemMonitor &fileMonitor);
+
+/**
+ *@brief Counts a newly accepted client as connected and announces its connection on stdout.
+ *@param client The client's address.
+ *@return The client's address as "ip:port", for logging.
+ */
+string acceptConnection(struct sockaddr_in &client);
+
+/**
+ *@brief Adds a record to the end of the dataset, in the shard its index falls in.
+ *@param dataset The sharded dataset.
  *@param record The record to be added.
  *@param recordSize Size of the record to be added.
- *@param fileMonitor Monitor for synchronizing read & write operations on the dataset and server log.
- *@return The success of the addition  
+ *@return The index assigned to the added record, or -1 on failure
+ */
+Task<int> addRecord(ShardedDataset &dataset, char record[], int recordSize);
+
+/**
+ *@brief Handles client request for a yearly, quarterly, or rolling revenue aggregate.
+ *@param commfd The communications socket's file descriptor.
+ *@param dataset The sharded dataset, whose shards' aggregates are combined.
+ *@param logPtr The file pointer to the server log file.
+ *@param cliPID The requesting client's PID.
+ *@param aggType The type of aggregate requested (see AGGREGATE).
+ *@param params The aggregate's comma-separated parameters.
+ *@param fileMonitor Monitor for synchronizing read & write operations on the server log.
+ */
+Task<> aggregateRevenue(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, int aggType, char params[], LogBinRWSemMonitor &fileMonitor);
+
+/**
+ *@brief Appends a batch of record slots to the end of the dataset, writing each shard's share of the batch
+ *       in a single writer critical section.
+ *@param dataset The sharded dataset.
+ *@param slots The records to be added (RECORDSLOTSIZE bytes each).
+ *@return The index assigned to the first record, or -1 on failure.
  */
-bool addRecord(FILE * binPtr, char record[], int recordSize, LogBinRWSemMonitor &fileMonitor);
+Task<int> appendRecords(ShardedDataset &dataset, vector<char> &slots);
 
 /**
  *@brief Listens for incoming commands from the connected client.
@@ -45,66 +127,126 @@ void awaitCommands(int commfd, FILE *binPtr, FILE *logPtr);
 /**
  *@brief Listens for incoming client connections and creates child servers for each succesful connection.
  *@param listenfd The listening socket's file descriptor.
- *@param binPtr The file pointer to the binary data file.
+ *@param port The server's port number (the key of its log monitor).
+ *@param dataset The sharded dataset.
+ *@param logPtr The file pointer to the server log file.
+ */
+void awaitConnections(int listenfd, int port, ShardedDataset &dataset, FILE *logPtr);
+
+/**
+ *@brief Handles client request for the addition of a batch of records streamed after the request.
+ *@param commfd The communications socket's file descriptor.
+ *@param dataset The sharded dataset.
  *@param logPtr The file pointer to the server log file.
+ *@param cliPID The requesting client's PID.
+ *@param payloadSize The size in bytes of the records following the request.
+ *@param format The encoding of the records: "CSV" lines or "BIN" record slots.
+ *@param wire The connection's wire format.
+ *@param fileMonitor Monitor for synchronizing read & write operations on the server log.
  */
-void awaitConnections(int listenfd, FILE *binPtr, FILE *logPtr);
+Task<> bulkRecords(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, int payloadSize, char format[], const wireFormat &wire, LogBinRWSemMonitor &fileMonitor);
 
 /**
  *@brief Handles client request for the edit of a record from the dataset.
  *@param commfd The communications socket's file descriptor.
- *@param binPtr The file pointer to the binary data file.
+ *@param dataset The sharded dataset.
  *@param logPtr The file pointer to the server log file.
  *@param cliPID The requesting client's PID.
  *@param recIdx The index of the requested record to edit.
  *@param record The edited record string.
  *@param recordSize The size of the edited record string.
- *@param fileMonitor Monitor for synchronizing read & write operations on the dataset and server log.
+ *@param fileMonitor Monitor for synchronizing read & write operations on the server log.
+ */
+Task<> changeRecord(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, int recIdx, char record[], int recordSize, LogBinRWSemMonitor &fileMonitor);
+
+/**
+ *@brief Connects to a replica's primary.
+ *@param primary The primary's "host:port".
+ *@return The connection's socket file descriptor, or -1 on failure.
+ */
+int connectPrimary(string primary);
+
+/**
+ *@brief Counts the records in the dataset (up to the highest index stored), counting each shard under its own reader lock.
+ *@param dataset The sharded dataset.
+ *@return The number of records.
  */
-void changeRecord(int commfd, FILE *binPtr, FILE *logPtr, pid_t cliPID, int recIdx, char record[], int recordSize, LogBinRWSemMonitor &fileMonitor);
+Task<int> countRecords(ShardedDataset &dataset);
 
 /**
  *@brief Handles client request for the retrieval of one or more records from the dataset.
  *@param commfd The communications socket's file descriptor.
- *@param binPtr The file pointer to the binary data file.
+ *@param dataset The sharded dataset.
  *@param logPtr The file pointer to the server log file.
  *@param cliPID The requesting client's PID.
  *@param recIdx The index of the requested record (-999 for all records).
- *@param fileMonitor Monitor for synchronizing read & write operations on the dataset and server log.
+ *@param wire The connection's wire format.
+ *@param fileMonitor Monitor for synchronizing read & write operations on the server log.
+ */
+Task<> displayRecord(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, int recIdx, const wireFormat &wire, LogBinRWSemMonitor &fileMonitor);
+
+/**
+ *@brief Formats a client's address for display and logging.
+ *@param client The client's address.
+ *@return The address as "ip:port".
  */
-void displayRecord(int commfd, FILE *binPtr, FILE *logPtr, pid_t cliPID, int recIdx, LogBinRWSemMonitor &fileMonitor);
+string formatAddress(struct sockaddr_in &client);
 
 /**
- *@brief Retrieves a record with the provided index from the file specified.
- *@param binPtr File pointer to the bin file
- *@param idx Index of the desired record
- *@return The desired record in C-string format
+ *@brief Signal handler that writes this process's trace to trace.<pid>.json.
+ *@param sig The signal received (SIGUSR1).
  */
-string getRecord(FILE *binPtr, int idx);
+void dumpTrace(int sig);
 
 /**
- *@brief Calculates and returns the number of log records stored in the server log file.
+ *@brief Handles client request for the records matching a filter expression.
+ *@param commfd The communications socket's file descriptor.
+ *@param dataset The sharded dataset.
  *@param logPtr The file pointer to the server log file.
- *@return The total number of log records stored in log server file
+ *@param cliPID The requesting client's PID.
+ *@param exprLength The length of the filter expression following the request.
+ *@param fileMonitor Monitor for synchronizing read & write operations on the server log.
+ *@return Whether the connection is still at the start of a request (false if the expression could not be read).
  */
-int getTotalLogRecords(FILE *logPtr);
+Task<bool> filterRecords(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, int exprLength, LogBinRWSemMonitor &fileMonitor);
 
 /**
- *@brief Calculates and returns the number of records stored in the binary data file.
- *@param binPtr The file pointer to the binary data file.
- *@return The total number of records stored in binary data file.
+ *@brief Follows a primary's journal from the end of this replica's own, applying each entry (and so appending
+ *       it to this replica's journal) as it arrives, until the connection is lost or an entry cannot be applied.
+ *       A replica whose journal has another epoch than the primary's is reset, to follow it from entry 0 next time.
+ *@param primaryfd The connection to the primary.
+ *@param dataset The replica's sharded dataset.
+ */
+Task<> followJournal(int primaryfd, ShardedDataset &dataset);
+
+/**
+ *@brief Handles the HELLO a client sends when it connects, agreeing on the fastest paths both sides support: the
+ *       lower protocol version, the features both support, the smaller frame size (compression is left off below
+ *       MINFRAMESIZE), and the client's preferred record encoding. Replies with what the connection will use.
+ *@param commfd The communications socket's file descriptor.
+ *@param clientMsg The message packet received from the client, holding a helloMsgPacket.
+ *@param wire The connection's wire format; receives what was agreed.
  */
-int getTotalRecords(FILE *binPtr);
+Task<> greetClient(int commfd, serMsgPacket &clientMsg, wireFormat &wire);
 
 /**
  *@brief Decides the appropriate course of action for a received command then logs the operation(s) performed.
  *@param commfd The communications socket's file descriptor.
- *@param binPtr The file pointer to the binary data file.
+ *@param dataset The sharded dataset.
  *@param logPtr The file pointer to the server log file.
  *@param clientMsg The message packet received from the client.
- *@param fileMonitor Monitor for synchronizing read & write operations on the dataset and server log.
+ *@param wire The connection's wire format; set by the HLO (or CMP) request.
+ *@param fileMonitor Monitor for synchronizing read & write operations on the server log.
+ *@return Whether the connection is still at the start of a request (false once it has lost its framing).
+ */
+Task<bool> handleCmd(int commfd, ShardedDataset &dataset, FILE *logPtr, serMsgPacket clientMsg, wireFormat &wire, LogBinRWSemMonitor &fileMonitor);
+
+/**
+ *@brief Determines whether this server is a replica that has fallen further behind its primary than reads allow.
+ *@param dataset The sharded dataset.
+ *@return Whether reads should be refused.
  */
-void handleCmd(int commfd, FILE *binPtr, FILE *logPtr, serMsgPacket clientMsg, LogBinRWSemMonitor &fileMonitor);
+bool isStale(ShardedDataset &dataset);
 
 /**
  *@brief Logs the successful connection of an incoming client
@@ -118,22 +260,31 @@ void logConnection(FILE *logPtr, string clientAddress);
  *@param logPtr The file pointer to the server log file.
  *@param cliPID The connecting client's PID.
  *@param cmd Character representing the command issued to the server
- *@param numRecords (optional) The number of records stored on server(CMD)/sent to client(GET)
- *@param idx (optional) The index of the desired record from GET command
+ *@param numRecords (optional) The number of records stored on server(CMD)/sent to client(GET/FLT)
+ *@param idx (optional) The index of the desired record from GET command (or the aggregate type for AGG, first record added for BLK)
  */
  void logRequest(FILE *logPtr, pid_t cliPID, char cmd, int numRecords = -1, int idx = -1);
 
+/**
+ *@brief Handles client request to compress the connection's bulk transfers, replying with the codec chosen
+ *       from those offered (CODECNONE if none are supported).
+ *@param commfd The communications socket's file descriptor.
+ *@param offered The codecs the client supports, a bit for each.
+ *@param wire The connection's wire format; receives the codec chosen.
+ */
+Task<> negotiateCodec(int commfd, int offered, wireFormat &wire);
+
 /**
  *@brief Handles client request for the addition of a new record to the dataset.
  *@param commfd The communications socket's file descriptor.
- *@param binPtr The file pointer to the binary data file.
+ *@param dataset The sharded dataset.
  *@param logPtr The file pointer to the server log file.
  *@param cliPID The requesting client's PID.
  *@param record The record to be added.
  *@param recordSize The size of the record to be added.
- *@param fileMonitor Monitor for synchronizing read & write operations on the dataset and server log.
+ *@param fileMonitor Monitor for synchronizing read & write operations on the server log.
  */
-void newRecord(int commfd, FILE *binPtr, FILE *logPtr, pid_t cliPID, char record[], int recordSize, LogBinRWSemMonitor &fileMonitor);
+Task<> newRecord(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, char record[], int recordSize, LogBinRWSemMonitor &fileMonitor);
 
 /**
  *@brief Attempts to open the file provided. Returns file pointer on successful open.
@@ -144,83 +295,323 @@ void newRecord(int commfd, FILE *binPtr, FILE *logPtr, pid_t cliPID, char record
 FILE * openFile(string filename, string filetype);
 
 /**
- *@brief Handles the receipt of messages from clients.
+ *@brief Stores a record at a given index, or removes it (for an empty record), and journals the write.
+ *       Indexes past the last record leave empty slots behind.
+ *@param dataset The sharded dataset.
+ *@param idx The record's 1-based index.
+ *@param record The record string (empty to remove the record).
+ *@param recordSize The size of the record string.
+ *@return Whether the record was stored (or removed).
+ */
+Task<bool> putRecord(ShardedDataset &dataset, int idx, char record[], int recordSize);
+
+/**
+ *@brief Handles the receipt of messages from a client: logs its arrival, handles each request it sends,
+ *       and closes the connection once it disconnects.
  *@param commfd The communications socket's file descriptor.
- *@param binPtr The file pointer to the binary data file.
+ *@param clientAddress The string representation of the client's address.
+ *@param dataset The sharded dataset.
+ *@param logPtr The file pointer to the server log file.
+ *@param fileMonitor Monitor for synchronizing read & write operations on the server log.
+ */
+Task<> receiveMsgs(int commfd, string clientAddress, ShardedDataset &dataset, FILE *logPtr, LogBinRWSemMonitor &fileMonitor);
+
+/**
+ *@brief Retrieves a single record from the server log file.
  *@param logPtr The file pointer to the server log file.
- *@param fileMonitor Monitor for synchronizing read & write operations on the dataset and server log.
+ *@param offset The offset of the log record to be read; advanced to the next log record.
+ *@param logMsg Receives the log record.
+ *@param fileMonitor Monitor for synchronizing read & write operations on the dataset. 
  */
-void receiveMsgs(int commfd, FILE *binPtr, FILE *logPtr, LogBinRWSemMonitor &fileMonitor);
+Task<> readLogRecord(FILE *logPtr, long &offset, logMsgPacket &logMsg, LogBinRWSemMonitor &fileMonitor);
+
+/**
+ *@brief Reads a run of consecutive records, reading each shard's share of the run in one call under its own reader lock.
+ *@param dataset The sharded dataset.
+ *@param first The index of the run's first record.
+ *@param count The number of records in the run.
+ *@param slots Receives the records (RECORDSLOTSIZE bytes each); the slots of records that could not be read are left empty.
+ *@return The number of records read.
+ */
+Task<int> readRecords(ShardedDataset &dataset, int first, int count, char slots[]);
+
+/**
+ *@brief Reads exactly the requested number of bytes of a bulk transfer, decompressing each frame when the connection
+ *       negotiated a codec. A malformed frame shuts the connection down, as the requests after it cannot be found.
+ *@param commfd The communications socket's file descriptor.
+ *@param buf The buffer to store the received bytes in.
+ *@param len The number of bytes to be read.
+ *@param wire The connection's wire format.
+ *@return Whether all bytes were received.
+ */
+Task<bool> receiveBulk(int commfd, void *buf, size_t len, const wireFormat &wire);
+
+/**
+ *@brief Reads exactly the requested number of bytes from the socket.
+ *@param commfd The communications socket's file descriptor.
+ *@param buf The buffer to store the received bytes in.
+ *@param len The number of bytes to be read.
+ *@return Whether all bytes were received (false on error or client disconnect).
+ */
+Task<bool> receiveBytes(int commfd, void *buf, size_t len);
+
+/**
+ *@brief Receives the filter expression following a FLT request. An expression longer than MAXEXPRSIZE is
+ *       drained in bounded chunks and left empty (so it fails to compile); a negative length cannot be
+ *       drained, as nothing tells how many bytes follow.
+ *@param commfd The communications socket's file descriptor.
+ *@param expr Receives the NUL-terminated expression (at least MAXEXPRSIZE + 1 bytes).
+ *@param exprLength The length of the expression, as given in the request.
+ *@return Whether the expression was read off the socket (false on a negative length or a disconnect).
+ */
+Task<bool> receiveExpression(int commfd, char expr[], int exprLength);
 
 /**
  *@brief Handles client request for retrieving the record count.
  *@param commfd The communications socket's file descriptor.
- *@param binPtr The file pointer to the binary data file.
+ *@param dataset The sharded dataset.
  *@param logPtr The file poitner to the server log file.
  *@param cliPID The requesting client's PID.
- *@param fileMonitor Monitor for synchronizing read & write operations on the dataset and server log.
+ *@param fileMonitor Monitor for synchronizing read & write operations on the server log.
  */
-void recordCount(int commfd, FILE *binPtr, FILE *logPtr, pid_t cliPID, LogBinRWSemMonitor &fileMonitor);
+Task<> recordCount(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, LogBinRWSemMonitor &fileMonitor);
 
 /**
- *@brief Retrieves each record in the file one by one and sends them to the requesting client.
+ *@brief Refuses a read on a replica that has fallen too far behind its primary, replying as the request does on failure.
  *@param commfd The communications socket's file descriptor.
- *@param binPtr The file pointer to the binary data file
- *@param fileMonitor Monitor for synchronizing read & write operations on the dataset.
- *@return The number of records sent to the client
+ *@param clientMsg The message packet received from the client.
+ *@return Whether the connection is still at the start of a request (false if a FLT expression could not be read).
  */
-int sendAllRecords(int commfd, FILE *binPtr, LogBinRWSemMonitor &fileMonitor);
+Task<bool> refuseStale(int commfd, serMsgPacket &clientMsg);
 
 /**
- *@brief Handles client request for retrieving the contents of the server log.
+ *@brief Keeps a replica's dataset following its primary's journal, reconnecting whenever the connection is lost.
+ *@param primary The primary's "host:port".
+ *@param dataset The replica's sharded dataset.
+ */
+void replicate(string primary, ShardedDataset &dataset);
+
+/**
+ *@brief Handles client request for how far this server lags behind its primary.
  *@param commfd The communications socket's file descriptor.
+ *@param dataset The sharded dataset.
  *@param logPtr The file pointer to the server log file.
  *@param cliPID The requesting client's PID.
- *@param fileMonitor Monitor for synchronizing read & write operations on the dataset.
+ *@param fileMonitor Monitor for synchronizing read & write operations on the server log.
+ */
+Task<> reportLag(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, LogBinRWSemMonitor &fileMonitor);
+
+/**
+ *@brief Starts a replica over whose journal belongs to another history than its primary's: removes every record
+ *       (unless no entry was applied, as then the records are a copy of the primary's dataset) and empties the
+ *       journal, taking the primary's epoch, so the replica follows the primary's journal from entry 0.
+ *@param dataset The replica's sharded dataset.
+ *@param epoch The primary's journal epoch.
+ *@return Whether the replica was reset.
+ */
+Task<bool> resetReplica(ShardedDataset &dataset, uint32_t epoch);
+
+/**
+ *@brief Serves clients from a pre-forked worker process: accepts on the worker's own SO_REUSEPORT listening
+ *       socket and runs a receiveMsgs coroutine for every connection it accepted, resuming each from a single
+ *       event loop as its socket operations and semaphore acquires finish.
+ *@param port The server's dedicated port number.
+ *@param useUring Whether the event loop should use io_uring (falling back to epoll where it is unavailable).
+ *@param dataset The sharded dataset.
+ *@param logPtr The file pointer to the server log file.
  */
-void sendLog(int commfd, FILE *logPtr, pid_t cliPID, LogBinRWSemMonitor &fileMonitor);
+void runWorker(int port, bool useUring, ShardedDataset &dataset, FILE *logPtr);
 
 /**
- *@brief Retrieves and sends a single record from the server log file.
+ *@brief Sends the number of records in the dataset (to a connection that agreed to version 2), then retrieves the
+ *       records in blocks of SENDBLOCKRECORDS from every shard and sends each block to the requesting client in a
+ *       single write, as recMsgPackets or (when the connection agreed to ENCODINGSLOTS) as the record slots themselves.
+ *@param commfd The communications socket's file descriptor.
+ *@param dataset The sharded dataset.
+ *@param wire The connection's wire format.
+ *@return The number of records sent to the client
+ */
+Task<int> sendAllRecords(int commfd, ShardedDataset &dataset, const wireFormat &wire);
+
+/**
+ *@brief Writes a bulk transfer to the socket. When the connection negotiated a codec, the transfer is sent in frames
+ *       of up to the connection's frame size, each compressed (or left as it is, if it would not shrink) and sent in one write.
+ *@param commfd The communications socket's file descriptor.
+ *@param buf The data to be sent.
+ *@param len The number of bytes to be sent.
+ *@param wire The connection's wire format.
+ *@return Whether all of the data was sent.
+ */
+Task<bool> sendBulk(int commfd, const void *buf, size_t len, const wireFormat &wire);
+
+/**
+ *@brief Writes exactly the provided number of bytes to the socket.
+ *@param commfd The communications socket's file descriptor.
+ *@param buf The data to be sent.
+ *@param len The number of bytes to be sent.
+ *@return Whether all of the data was sent.
+ */
+Task<bool> sendBytes(int commfd, const void *buf, size_t len);
+
+/**
+ *@brief Handles client request for retrieving the contents of the server log.
  *@param commfd The communications socket's file descriptor.
  *@param logPtr The file pointer to the server log file.
- *@param idx The index of the log record to be sent.
- *@param fileMonitor Monitor for synchronizing read & write operations on the dataset. 
+ *@param cliPID The requesting client's PID.
+ *@param wire The connection's wire format.
+ *@param fileMonitor Monitor for synchronizing read & write operations on the dataset.
  */
-void sendLogRecord(int commfd, FILE *logPtr, int idx, LogBinRWSemMonitor &fileMonitor);
+Task<> sendLog(int commfd, FILE *logPtr, pid_t cliPID, const wireFormat &wire, LogBinRWSemMonitor &fileMonitor);
 
 /**
- *@brief Retrieves the record found at the provided index from the file and sends it to the requesting client.
+ *@brief Retrieves the record found at the provided index from its shard and sends it to the requesting client.
  *@param commfd The communications socket's file descriptor.
- *@param binPtr The file pointer to the binary data file
+ *@param dataset The sharded dataset.
  *@param idx The index of the desired record
- *@param fileMonitor Monitor for synchronizing read & write operations on the dataset.
  */
-void sendRecord(int commfd, FILE *binPtr, int idx, LogBinRWSemMonitor &fileMonitor);
+Task<> sendRecord(int commfd, ShardedDataset &dataset, int idx);
 
 /**
  *@brief Handles the transmission of messages to clients
  *@param commfd The communications socket's file descriptor.
  *@param msg The message packet to be transmitted
  */
-template<class MsgPacket> void sendMsg(int commfd, MsgPacket msg);
+template<class MsgPacket> Task<> sendMsg(int commfd, MsgPacket msg);
+
+/**
+ *@brief Handles client request for a snapshot of the server statistics.
+ *@param commfd The communications socket's file descriptor.
+ *@param logPtr The file pointer to the server log file.
+ *@param cliPID The requesting client's PID.
+ *@param fileMonitor Monitor for synchronizing read & write operations on the server log.
+ */
+Task<> sendStats(int commfd, FILE *logPtr, pid_t cliPID, LogBinRWSemMonitor &fileMonitor);
+
+/**
+ *@brief Handles client request for a dump of this child server's trace, which is written to trace.<pid>.json.
+ *@param commfd The communications socket's file descriptor.
+ *@param logPtr The file pointer to the server log file.
+ *@param cliPID The requesting client's PID.
+ *@param fileMonitor Monitor for synchronizing read & write operations on the server log.
+ */
+Task<> sendTrace(int commfd, FILE *logPtr, pid_t cliPID, LogBinRWSemMonitor &fileMonitor);
 
 /**
  *@brief Sets up the server connection by creating the listening socket, binding it to the server address, and creating the listening queue.
  *@param port The server's dedicated port number.
+ *@param reusePort Whether other processes may listen on the same port, with the kernel balancing connections between them.
  *@return The listening socket's file descriptor on successful creation; client exits on failure.
  */
-int setupConnection(int port);
+int setupConnection(int port, bool reusePort = false);
+
+/**
+ *@brief Creates a worker process.
+ *@param port The server's port number.
+ *@param useUring Whether the worker's event loop should use io_uring.
+ *@param dataset The sharded dataset.
+ *@param logPtr The file pointer to the server log file.
+ *@return The worker's PID.
+ */
+pid_t spawnWorker(int port, bool useUring, ShardedDataset &dataset, FILE *logPtr);
+
+/**
+ *@brief Starts serving the server statistics as Prometheus text metrics from a dedicated process.
+ *       The server runs on without metrics if the metrics port cannot be listened on.
+ *@param port The port the metrics are served on.
+ *@param dataset The sharded dataset.
+ *@param logPtr The file pointer to the server log file.
+ */
+void startMetricsExporter(int port, ShardedDataset &dataset, FILE *logPtr);
+
+/**
+ *@brief Starts the process that keeps a replica's dataset following its primary.
+ *@param primary The primary's "host:port".
+ *@param dataset The replica's sharded dataset.
+ */
+void startReplicator(string primary, ShardedDataset &dataset);
+
+/**
+ *@brief Handles request for storing a record at a given index (sent by a cluster router), creating the record,
+ *       replacing it, or, for an empty record, removing it. Indexes past the last record leave empty slots behind,
+ *       at most as many as one BLK could fill. Only a cluster node (-c) stores records this way.
+ *@param commfd The communications socket's file descriptor.
+ *@param dataset The sharded dataset.
+ *@param logPtr The file pointer to the server log file.
+ *@param cliPID The requesting client's PID.
+ *@param recIdx The index of the record to be stored.
+ *@param record The record string (empty to remove the record).
+ *@param recordSize The size of the record string.
+ *@param fileMonitor Monitor for synchronizing read & write operations on the server log.
+ */
+Task<> storeRecord(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, int recIdx, char record[], int recordSize, LogBinRWSemMonitor &fileMonitor);
+
+/**
+ *@brief Handles a replica's request for the journal: streams every entry from the given one on, then each new
+ *       entry as it is appended, until the replica disconnects. Each block of entries follows an intRecMsgPacket
+ *       holding the block's size and, as its record, the journal's length when the block was read. Only a cluster
+ *       node (-c) serves replicas; other servers reply with a size of -1 and a record of FAILURE. A replica whose
+ *       journal has another epoch is replied -1 and "EPOCH,<epoch>", telling it to start over from entry 0.
+ *@param commfd The communications socket's file descriptor.
+ *@param dataset The sharded dataset.
+ *@param logPtr The file pointer to the server log file.
+ *@param cliPID The requesting replica's PID.
+ *@param offset The number of the first entry to be sent (the number of entries the replica already has).
+ *@param epoch The epoch of the replica's journal, in hexadecimal.
+ *@param fileMonitor Monitor for synchronizing read & write operations on the server log.
+ */
+Task<> streamJournal(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, int offset, const char epoch[], LogBinRWSemMonitor &fileMonitor);
+
+/**
+ *@brief Starts a fixed pool of worker processes, then reaps any that exit and starts their replacements.
+ *@param numWorkers The number of workers.
+ *@param port The server's port number.
+ *@param useUring Whether the workers' event loops should use io_uring.
+ *@param dataset The sharded dataset.
+ *@param logPtr The file pointer to the server log file.
+ */
+void superviseWorkers(int numWorkers, int port, bool useUring, ShardedDataset &dataset, FILE *logPtr);
+
+/**
+ *@brief Handles client request for the records changed since a sequence number (the journal's length when the client
+ *       last synced). Replies with an intRecMsgPacket holding the number of records changed and, as its record, the new
+ *       high-water mark (the journal's length now) and the journal's epoch ("<mark>,<epoch>"), followed by an
+ *       intRecMsgPacket for each changed record (its index and current value, empty if removed). A record's sequence
+ *       number is that of its latest journal entry, so the changes are found by reading the journal back from its end
+ *       to the client's sequence number, never the records. A sequence number from another epoch is refused with -1
+ *       and "EPOCH,<mark>,<epoch>", as the journal was started over since and the client must re-read every record.
+ *@param commfd The communications socket's file descriptor.
+ *@param dataset The sharded dataset.
+ *@param logPtr The file pointer to the server log file.
+ *@param cliPID The requesting client's PID.
+ *@param since The sequence number the client is synced to (0 for every record).
+ *@param epoch The epoch of the journal the sequence number was handed out by, in hexadecimal (ignored for 0).
+ *@param fileMonitor Monitor for synchronizing read & write operations on the server log.
+ */
+Task<> syncRecords(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, int since, const char epoch[], LogBinRWSemMonitor &fileMonitor);
+
+/**
+ *@brief Waits for entries past a position in the journal, checking it every JOURNALPOLLINTERVAL microseconds.
+ *@param journal The journal.
+ *@param next The number of the first entry wanted.
+ *@param entries Receives up to JOURNALBLOCKENTRIES entries.
+ *@param head Receives the journal's length when the entries were read.
+ *@return The number of entries read, or 0 if none were appended within JOURNALHEARTBEATPOLLS checks.
+ */
+Task<int> tailJournal(WriteJournal &journal, long next, JournalEntry entries[], long &head);
 
 /**
- *@brief Updates the record at the provided index.
- *@param binPtr The file pointer to the bin file.
- *@param idx The index of the record to be updated.
- *@param record The updated record string.
- *@param recordSize The size of the updated record string.
- *@return The success of updating the record.
+ *@brief Handles client request for a subscription to changes: acknowledges with the journal position the subscription
+ *       starts at, then pushes an intRecMsgPacket (index and new record, empty once removed) for every write committed
+ *       to a record in the requested range, until the client disconnects. A subscriber that falls WATCHMAXBACKLOG
+ *       changes behind is skipped ahead and sent the number of changes it missed, with an index of -1, instead.
+ *@param commfd The communications socket's file descriptor.
+ *@param dataset The sharded dataset.
+ *@param logPtr The file pointer to the server log file.
+ *@param cliPID The requesting client's PID.
+ *@param range The range of indexes watched, as "first,last" (empty for every record).
+ *@param fileMonitor Monitor for synchronizing read & write operations on the server log.
  */
-bool updateRecord(FILE * binPtr, int idx, char record[], int recordSize);
+Task<> watchChanges(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, char range[], LogBinRWSemMonitor &fileMonitor);
 
 //DEFINITIONS//
 
@@ -233,219 +624,778 @@ int main(int argc, char * argv[]) {
 	const string BINFILE = "gameRevenue.bin";
 	const string LOGFILE = "ser.log";
 
-	FILE * binPtr,* logPtr;	
-	int listenfd, commfd;
+	FILE * logPtr;	
+	int listenfd, opt;
+	int port = PORTNUM, metricsPort = 0, numWorkers = 0, numShards = 1;
+	bool useUring = false;
+	string primary;
+	
+	//Parse command-line options
+	while( (opt = getopt(argc, argv, "l:m:p:r:s:w:cu") ) != -1) {
+		
+		if(opt == 'l' && atol(optarg) > 0) {
+			maxStaleness = atol(optarg);
+		} else if(opt == 'm') {
+			metricsPort = atoi(optarg);
+		} else if(opt == 'p' && atoi(optarg) > 0 && atoi(optarg) < SHARDKEYSTRIDE) {
+			port = atoi(optarg);
+		} else if(opt == 'r' && string(optarg).find(':') != string::npos) {
+			primary = optarg;
+		} else if(opt == 's' && atoi(optarg) > 0 && atoi(optarg) <= MAXSHARDS) {
+			numShards = atoi(optarg);
+		} else if(opt == 'w' && atoi(optarg) > 0) {
+			numWorkers = atoi(optarg);
+		} else if(opt == 'c') {
+			clusterNode = true;
+		} else if(opt == 'u') {
+			useUring = true;
+		} else {
+			cout << "USAGE: ./server [-p <port> [-c]] [-m <metrics port>] [-s <shards>] [-w <workers> [-u]] [-r <primary host:port> [-l <max staleness ms>]]" << endl;
+			exit(EXIT_FAILURE);
+		}//end if
+		
+	}//end while
+	
+	//io_uring only drives the workers' event loops, and only replicas have a primary to fall behind
+	if( (useUring && numWorkers == 0) || (maxStaleness > 0 && primary.empty() ) ) {
+		cout << "USAGE: ./server [-p <port> [-c]] [-m <metrics port>] [-s <shards>] [-w <workers> [-u]] [-r <primary host:port> [-l <max staleness ms>]]" << endl;
+		exit(EXIT_FAILURE);
+	}//end if
+	
+	//Every IPC key of the server follows from its port, so servers on different ports share nothing
+	serverStats = ServerStats(STATSKEY(port) );
+	
+	//Perform Server startup operations (each worker creates its own listening socket)
+	if(numWorkers == 0) {
+		listenfd = setupConnection(port);
+	}//end if
 	
-	//Perform Server startup operations
-	listenfd = setupConnection(PORTNUM);
-	binPtr = openFile(BINFILE, "data");
 	logPtr = openFile(LOGFILE, "log");
-  LogBinRWSemMonitor fileMonitor(PORTNUM);
+  LogBinRWSemMonitor fileMonitor(port);
 	fileMonitor.init();
+	ShardedDataset dataset;
+	
+	//Open every shard of the dataset (splitting the bin file the first time it is sharded)
+	if( !dataset.open(BINFILE, numShards, port) ) {
+		cout << "Error opening data file " + BINFILE + " in " << numShards << " shard(s)." << endl;
+		cout << "Shutting down server..." << endl;
+		exit(EXIT_FAILURE);
+	}//end if
+	
+	//Build each shard's monitor and shared revenue aggregates (inherited by every child server)
+	if( !dataset.init() ) {
+		cout << "Error creating revenue aggregates." << endl;
+		cout << "Shutting down server..." << endl;
+		exit(EXIT_FAILURE);
+	}//end if
+	
+	//A replica's journal is its primary's, so only a primary journals the records it starts with
+	if(primary.empty() && !dataset.seedJournal() ) {
+		cout << "Error seeding the write journal." << endl;
+		cout << "Shutting down server..." << endl;
+		exit(EXIT_FAILURE);
+	} else if( !primary.empty() && !dataset.journalMatches() ) {
+		cout << "The write journal is older than the dataset; following the primary's journal from its start." << endl;
+		dataset.getJournal().clear();
+	}//end if
+	
+	dataset.setReadOnly( !primary.empty() );
+	
+	//Statistics are optional, so the server runs on without them (but a replica tracks its lag in them)
+	if( !serverStats.init() ) {
+		cout << "Error creating server statistics; statistics disabled." << endl;
+		
+		if( !primary.empty() ) {
+			cout << "Shutting down server..." << endl;
+			exit(EXIT_FAILURE);
+		}//end if
+		
+	} else if(metricsPort > 0) {
+		startMetricsExporter(metricsPort, dataset, logPtr);
+	}//end if
+	
+	//A replica applies its primary's writes from a process of its own
+	if( !primary.empty() ) {
+		startReplicator(primary, dataset);
+	}//end if
+	
+	//SIGUSR1 makes every server process dump its trace (interrupted calls resume)
+	struct sigaction traceAction;
+	memset(&traceAction, 0, sizeof(traceAction) );
+	traceAction.sa_handler = dumpTrace;
+	traceAction.sa_flags = SA_RESTART;
+	sigaction(SIGUSR1, &traceAction, NULL);
 	
 	//Wait for incoming connections
-	cout << "Listening for incoming connections..." << endl;
-	awaitConnections(listenfd, binPtr, logPtr);
+	if(numWorkers > 0) {
+		cout << "Listening for incoming connections on port " << port << " with " << numWorkers << " workers..." << endl;
+		superviseWorkers(numWorkers, port, useUring, dataset, logPtr);
+	} else {
+		cout << "Listening for incoming connections on port " << port << "..." << endl;
+		awaitConnections(listenfd, port, dataset, logPtr);
+	}//end if
 
+	return EXIT_SUCCESS;
 }//end main
 
-//Adds a record to the bin file
-bool addRecord(FILE * binPtr, char record[], int recordSize, LogBinRWSemMonitor &fileMonitor) {
-  bool success;
-	
-	//Get record count
-	fileMonitor.addBinReader();
-	int count = getTotalRecords(binPtr);
-	fileMonitor.remBinReader();
-  
-	//Add the new record
-	fileMonitor.addBinWriter();
-	success = updateRecord(binPtr, count+1, record, recordSize);
-	fileMonitor.remBinWriter();
-	
-  return success;
-}//end addRecord
-
-//Listens for incoming client connections and creates child servers for each successful connection.
-void awaitConnections(int listenfd, FILE *binPtr, FILE *logPtr) {
-	char clientAddr[INET_ADDRSTRLEN];
-	int numClients = 0;
-	int commfd, pid;
+//Accepts every pending client connection in a worker and starts a receiveMsgs coroutine for each one.
+void acceptClient(int listenfd, ShardedDataset &dataset, FILE *logPtr, LogBinRWSemMonitor &fileMonitor) {
+	int commfd;
 	socklen_t cliSize;
 	string strClientAddress;
 	struct sockaddr_in client;
 	
-	//Continuously accept incoming client connections
+	//Accept incoming client connections until none are left (the worker carries on with its other clients on failure)
 	while(true) {
-		
 		cliSize = sizeof(client);
 		
-		//Accept incoming client connection
 		if((commfd = accept(listenfd, (struct sockaddr *) &client, &cliSize)) == -1) {
-		  perror("Error accepting incoming connection: ");
-		  cout << "Shutting down server..." << endl;
-		  exit(EXIT_FAILURE);
-		}//end if			
-		
-		//Increment Client count
-		numClients++;
-		
-		//Delegate connection to child server
-		if((pid = fork() ) == -1) {
-			perror("Error creating child server process: ");
-			cout << "Shutting down server..." << endl;
-			exit(EXIT_FAILURE);
-		} else if(pid == 0) { //Child Server
 			
-			//Construct client address string
-			inet_ntop(AF_INET, &client.sin_addr, clientAddr, INET_ADDRSTRLEN); 
-			strClientAddress = clientAddr;
-			strClientAddress += ":" + to_string( htons(client.sin_port) );
-			cout << strClientAddress << "connected\n"; 
-			
-			//Construct Monitor for child server (Essentially just gains access to previous semSet)
-			LogBinRWSemMonitor fileMonitor(PORTNUM);
-			
-			//Log client arrival
-			fileMonitor.addLogWriter();
-			logConnection(logPtr, strClientAddress);
-			fileMonitor.remLogWriter();
-			
-			//Await client connection
-			receiveMsgs(commfd, binPtr, logPtr, fileMonitor);
-		} else { //Parent Server
+			if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				perror("Error accepting incoming connection: ");
+			}//end if
 			
+			return;
 		}//end if
-
+		
+		strClientAddress = acceptConnection(client);
+		
+		//The client's coroutine runs until its first suspension, then is resumed by the worker's event loop
+		CoRuntime::spawn( receiveMsgs(commfd, strClientAddress, dataset, logPtr, fileMonitor) );
 	}//end while
 	
-}//end awaitConnections
+}//end acceptClient
 
-//Handles client request for the edit of a record from the dataset.
-void changeRecord(int commfd, FILE *binPtr, FILE *logPtr, pid_t cliPID, int recIdx, char record[], int recordSize, LogBinRWSemMonitor &fileMonitor) {
-	intRecMsgPacket ackMsg;
-	bool success;
-	string strSuccess;
+//Counts a newly accepted client as connected and announces its connection on stdout.
+string acceptConnection(struct sockaddr_in &client) {
+	string clientAddress = formatAddress(client);
 	
-	//Update the record
-	fileMonitor.addBinWriter();
-	success = updateRecord(binPtr, recIdx, record, recordSize);
-	fileMonitor.remBinWriter();
+	serverStats.connectionOpened();
+	cout << clientAddress << " connected" << endl;
 	
-	//Insert Success or Failure message
-	if(success) {
-		strSuccess = "SUCCESS";
-	} else {
-		strSuccess = "FAILURE";
+	return clientAddress;
+}//end acceptConnection
+
+//Adds a record to the end of the dataset, in the shard its index falls in.
+Task<int> addRecord(ShardedDataset &dataset, char record[], int recordSize) {
+  int idx;
+	
+	//A replica's dataset only changes by replaying its primary's journal
+	if(dataset.isReadOnly() ) {
+		co_return -1;
 	}//end if
 	
-	//Assemble acknowledgment message
-	ackMsg = intRecMsgPacket(getpid(), "FIX", recIdx, &strSuccess[0] );
+	//Appends are serialized, so the new record's index (and so its shard) holds until it is written
+	co_await dataset.addAppender();
+	idx = dataset.getNumRecords() + 1;
+	BinShard &shard = dataset.shardOf(idx);
 	
-	//Send acknowledgment to client
-	sendMsg(commfd, ackMsg);
+	//Add the new record after the last record of its shard
+	co_await shard.monitor.addBinWriter();
 	
-	//Log the client request & server response
-	fileMonitor.addLogWriter();
-	logRequest(logPtr, cliPID, 'F', -1, recIdx);
-	fileMonitor.remLogWriter();
-}//end changeRecord
+	if( !updateRecord(shard, dataset.localIndex(idx), record, recordSize) ) {
+		idx = -1;
+	} else {
+		dataset.getJournal().append(idx, record, recordSize);
+	}//end if
+	
+	shard.monitor.remBinWriter();
+	dataset.remAppender();
+	
+  co_return idx;
+}//end addRecord
+
+//Appends a batch of record slots to the end of the dataset, writing each shard's share of the batch in a single writer critical section.
+Task<int> appendRecords(ShardedDataset &dataset, vector<char> &slots) {
+	int numRecords = slots.size() / RECORDSLOTSIZE;
+	int numShards = dataset.getNumShards();
+	int first, charsWritten;
+	bool success = true;
+	vector<DataRecord> records(numRecords);
+	vector<char> stripe;
+	vector<JournalEntry> entries;
+	
+	//A replica's dataset only changes by replaying its primary's journal
+	if(dataset.isReadOnly() ) {
+		co_return -1;
+	}//end if
+	
+	//Reject the whole batch if any record cannot be parsed, before taking the lock
+	for(int i = 0; i < numRecords; i++) {
+		if( !records[i].parse( string_view(&slots[i * RECORDSLOTSIZE], strnlen(&slots[i * RECORDSLOTSIZE], MAXRECORDSIZE) ) ) ) {
+			co_return -1;
+		}//end if
+	}//end for
+	
+	if(numRecords == 0) {
+		co_return -1;
+	}//end if
+	
+	//Appends are serialized, so the batch's indexes hold until every shard's share is written
+	co_await dataset.addAppender();
+	first = dataset.getNumRecords() + 1;
+	
+	for(int s = 0; s < numShards && success; s++) {
+		int offset = dataset.runOffset(s, first);
+		BinShard &shard = dataset.getShard(s);
+		
+		if(offset >= numRecords) {
+			continue;
+		}//end if
+		
+		//Gather the shard's every numShards-th record of the batch
+		stripe.clear();
+		
+		for(int i = offset; i < numRecords; i += numShards) {
+			stripe.insert(stripe.end(), &slots[i * RECORDSLOTSIZE], &slots[(i + 1) * RECORDSLOTSIZE]);
+		}//end for
+		
+		//Append the shard's share with one write and one count update
+		int local = dataset.localIndex(first + offset);
+		
+		co_await shard.monitor.addBinWriter();
+		
+		uint64_t ioStart = beginIO(BINWRITEIO);
+		fseek(shard.binPtr, shard.headerSize + (long) RECORDSLOTSIZE * (local - 1), SEEK_SET);
+		charsWritten = fwrite(&stripe[0], sizeof(char), stripe.size(), shard.binPtr);
+		fflush(shard.binPtr);
+		endIO(BINWRITEIO, ioStart);
+		
+		success = charsWritten == (int) stripe.size();
+		
+		if(success) {
+			
+			entries.clear();
+			
+			for(int i = offset, j = 0; i < numRecords; i += numShards, j++) {
+				shard.aggregates.recordChanged(local + j, NULL, records[i]);
+				entries.push_back( WriteJournal::entry(first + i, &slots[i * RECORDSLOTSIZE], MAXRECORDSIZE) );
+			}//end for
+			
+			//Journal the shard's share with one write, too
+			dataset.getJournal().append(&entries[0], entries.size() );
+		}//end if
+		
+		shard.monitor.remBinWriter();
+	}//end for
+	
+	dataset.remAppender();
+	
+	co_return success ? first : -1;
+}//end appendRecords
+
+//Handles client request for a yearly, quarterly, or rolling revenue aggregate.
+Task<> aggregateRevenue(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, int aggType, char params[], LogBinRWSemMonitor &fileMonitor) {
+	bool success;
+	Money sum;
+	int first = 0, second = 0;
+	string strSum = "FAILURE";
+	
+	params[MAXRECORDSIZE] = '\0';
+	sscanf(params, "%d,%d", &first, &second);
+	
+	//A rolling window must end at a record and cover at least one
+	success = aggType != ROLLING || (first >= 1 && second >= 1 && second <= dataset.getNumRecords() );
+	
+	//Combine the requested aggregate of every shard, each queried under its own reader lock
+	for(int s = 0; s < dataset.getNumShards() && success; s++) {
+		BinShard &shard = dataset.getShard(s);
+		Money shardSum, shardStart;
+		
+		co_await shard.monitor.addBinReader();
+		
+		switch(aggType) {
+			case YEARLY:
+				success = shard.aggregates.getYearTotal(first, shardSum);
+				break;
+			case QUARTERLY:
+				success = shard.aggregates.getQuarterTotal(first, second, shardSum);
+				break;
+			case ROLLING:
+				//The window is the shard's records among the window's, as a difference of its prefix sums (a cluster node's shards may end early)
+				success = shard.aggregates.getPrefixTotal(min(dataset.localCount(s, second), shard.aggregates.getNumRecords() ), shardSum) &&
+				          shard.aggregates.getPrefixTotal(min(dataset.localCount(s, max(second - first, 0) ), shard.aggregates.getNumRecords() ), shardStart);
+				shardSum -= shardStart;
+				break;
+			default:
+				success = false;
+		}//end switch
+		
+		shard.monitor.remBinReader();
+		sum += shardSum;
+	}//end for
+	
+	if(success) {
+		strSum = sum.toString();
+	}//end if
+	
+	//Send the aggregate to the client
+	co_await sendMsg(commfd, intRecMsgPacket(getpid(), "AGG", success ? 0 : -1, &strSum[0]) );
+	
+	//Log the client request & server response
+	co_await fileMonitor.addLogWriter();
+	logRequest(logPtr, cliPID, 'A', -1, aggType);
+	fileMonitor.remLogWriter();
+}//end aggregateRevenue
+
+//Listens for incoming client connections and creates child servers for each successful connection.
+void awaitConnections(int listenfd, int port, ShardedDataset &dataset, FILE *logPtr) {
+	int commfd, pid;
+	socklen_t cliSize;
+	string strClientAddress;
+	struct sockaddr_in client;
+	
+	//Continuously accept incoming client connections
+	while(true) {
+		
+		cliSize = sizeof(client);
+		
+		//Reap child servers whose clients have disconnected
+		while(waitpid(-1, NULL, WNOHANG) > 0);
+		
+		//Accept incoming client connection
+		if((commfd = accept(listenfd, (struct sockaddr *) &client, &cliSize)) == -1) {
+		  perror("Error accepting incoming connection: ");
+		  cout << "Shutting down server..." << endl;
+		  exit(EXIT_FAILURE);
+		}//end if			
+		
+		//Count the client as connected until its child server exits, announcing it before the child takes over
+		strClientAddress = acceptConnection(client);
+		
+		//Delegate connection to child server
+		if((pid = fork() ) == -1) {
+			perror("Error creating child server process: ");
+			cout << "Shutting down server..." << endl;
+			exit(EXIT_FAILURE);
+		} else if(pid == 0) { //Child Server
+			
+			//Construct Monitor for child server (Essentially just gains access to previous semSet)
+			LogBinRWSemMonitor fileMonitor(port);
+			fileMonitor.setStats(&serverStats);
+			fileMonitor.setTracer(&tracer);
+			dataset.setStats(&serverStats);
+			dataset.setTracer(&tracer);
+			
+			//Serve the client until it disconnects, then shut down the child server
+			receiveMsgs(commfd, strClientAddress, dataset, logPtr, fileMonitor).run();
+			exit(EXIT_SUCCESS);
+		} else { //Parent Server
+			
+			//The child holds the connection now, so it closes when the child closes it
+			close(commfd);
+		}//end if
+
+	}//end while
+	
+}//end awaitConnections
+
+//Handles client request for the addition of a batch of records streamed after the request.
+Task<> bulkRecords(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, int payloadSize, char format[], const wireFormat &wire, LogBinRWSemMonitor &fileMonitor) {
+	int first = -1, last = -1;
+	bool received;
+	string strRange = "FAILURE";
+	vector<char> payload, slots;
+	
+	//Receive the whole batch before touching the dataset
+	if(payloadSize > 0 && payloadSize <= MAXBULKSIZE) {
+		payload.resize(payloadSize);
+		received = co_await receiveBulk(commfd, &payload[0], payloadSize, wire);
+		
+		if( !received) {
+			co_return;
+		}//end if
+		
+		//Convert the batch into record slots
+		if( strncmp(format, "BIN", 3) == 0 && payloadSize % RECORDSLOTSIZE == 0) {
+			slots.swap(payload);
+		} else if( strncmp(format, "CSV", 3) == 0 && CsvRecordParser::parseRecords(&payload[0], &payload[0] + payloadSize, slots) == 0) {
+			payload.clear();
+		}//end if
+		
+		//Append the batch
+		if( !slots.empty() ) {
+			first = co_await appendRecords(dataset, slots);
+		}//end if
+		
+		if(first != -1) {
+			last = first + slots.size() / RECORDSLOTSIZE - 1;
+			strRange = to_string(first) + "," + to_string(last);
+		}//end if
+		
+	} else if(payloadSize > MAXBULKSIZE) {
+		vector<char> discard(COMPRESSFRAMESIZE);
+		
+		//Drain the oversized batch so the next request is read correctly (a frame at a time, if compressed)
+		for(int remaining = payloadSize, step; remaining > 0; remaining -= step) {
+			step = min<int>(remaining, wire.frameSize);
+			received = co_await receiveBulk(commfd, &discard[0], step, wire);
+			
+			if( !received) {
+				co_return;
+			}//end if
+		}//end for
+		
+	}//end if
+	
+	//Acknowledge with the assigned index range
+	co_await sendMsg(commfd, intRecMsgPacket(getpid(), "BLK", first, &strRange[0]) );
+	
+	//Log the whole batch as a single operation
+	if(first != -1) {
+		co_await fileMonitor.addLogWriter();
+		logRequest(logPtr, cliPID, 'B', last, first);
+		fileMonitor.remLogWriter();
+	}//end if
+	
+}//end bulkRecords
+
+//Handles client request for the edit of a record from the dataset.
+Task<> changeRecord(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, int recIdx, char record[], int recordSize, LogBinRWSemMonitor &fileMonitor) {
+	intRecMsgPacket ackMsg;
+	bool success;
+	string strSuccess;
+	BinShard &shard = dataset.shardOf(recIdx);
+	int local = dataset.localIndex(recIdx);
+	
+	//Update the record under its shard's writer lock alone (only existing records may be changed, and never on a replica)
+	co_await shard.monitor.addBinWriter();
+	success = !dataset.isReadOnly() && local >= 1 && local <= shard.aggregates.getNumRecords() && updateRecord(shard, local, record, recordSize);
+	
+	if(success) {
+		dataset.getJournal().append(recIdx, record, recordSize);
+	}//end if
+	
+	shard.monitor.remBinWriter();
+	
+	//Insert Success or Failure message
+	if(success) {
+		strSuccess = "SUCCESS";
+	} else {
+		strSuccess = "FAILURE";
+	}//end if
+	
+	//Assemble acknowledgment message
+	ackMsg = intRecMsgPacket(getpid(), "FIX", recIdx, &strSuccess[0] );
+	
+	//Send acknowledgment to client
+	co_await sendMsg(commfd, ackMsg);
+	
+	//Log the client request & server response
+	co_await fileMonitor.addLogWriter();
+	logRequest(logPtr, cliPID, 'F', -1, recIdx);
+	fileMonitor.remLogWriter();
+}//end changeRecord
+
+//Connects to a replica's primary.
+int connectPrimary(string primary) {
+	struct sockaddr_in server;
+	struct hostent * he;
+	size_t colon = primary.rfind(':');
+	string host = primary.substr(0, colon);
+	int sockfd;
+	
+	if( (he = gethostbyname(host.c_str() ) ) == NULL) {
+		cout << "Unable to resolve primary " << host << "." << endl;
+		return -1;
+	}//end if
+	
+	if( (sockfd = socket(AF_INET, SOCK_STREAM, 0) ) == -1) {
+		perror("Error creating socket: ");
+		return -1;
+	}//end if
+	
+	memset(&server, 0, sizeof(server) );
+	server.sin_family = AF_INET;
+	server.sin_port = htons( atoi(primary.substr(colon + 1).c_str() ) );
+	server.sin_addr = *(struct in_addr *) he->h_addr;
+	
+	if( connect(sockfd, (struct sockaddr *) &server, sizeof(server) ) == -1) {
+		perror( ("Failed to connect to primary " + primary + ": ").c_str() );
+		close(sockfd);
+		return -1;
+	}//end if
+	
+	return sockfd;
+}//end connectPrimary
+
+//Counts the records in the dataset (up to the highest index stored), counting each shard under its own reader lock.
+Task<int> countRecords(ShardedDataset &dataset) {
+	int numRecords = 0;
+	
+	for(int s = 0; s < dataset.getNumShards(); s++) {
+		BinShard &shard = dataset.getShard(s);
+		
+		co_await shard.monitor.addBinReader();
+		numRecords = max(numRecords, dataset.globalIndex(s, getTotalRecords(shard) ) );
+		shard.monitor.remBinReader();
+	}//end for
+	
+	co_return numRecords;
+}//end countRecords
 
 //Handles client request for the retrieval of one or more records from the dataset.
-void displayRecord(int commfd, FILE *binPtr, FILE *logPtr, pid_t cliPID, int recIdx, LogBinRWSemMonitor &fileMonitor) {
+Task<> displayRecord(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, int recIdx, const wireFormat &wire, LogBinRWSemMonitor &fileMonitor) {
 	int numRecords;
 
 	//Determine whether to send all records or a single record.
 	if(recIdx == -999) {
 		//Send all records to client & log the operation
-		numRecords = sendAllRecords(commfd, binPtr, fileMonitor);
-		fileMonitor.addLogWriter();
+		numRecords = co_await sendAllRecords(commfd, dataset, wire);
+		co_await fileMonitor.addLogWriter();
 		logRequest(logPtr, cliPID, 'G', numRecords, recIdx);
 		fileMonitor.remLogWriter();
 	} else {
 		//Send record to client & log the operation
-		sendRecord(commfd, binPtr, recIdx, fileMonitor);
-		fileMonitor.addLogWriter();
+		co_await sendRecord(commfd, dataset, recIdx);
+		co_await fileMonitor.addLogWriter();
 		logRequest(logPtr, cliPID, 'G', -1, recIdx);
 		fileMonitor.remLogWriter();
 	}//end if
 		
 }//end displayRecord
 
-//Retrieves a record with the provided index from the file specified.
-string getRecord(FILE *binPtr, int idx) {
-	char record[MAXRECORDSIZE+1]; 
- 
- 	rewind(binPtr);
- 
-  //Seek to desired record
-  fseek(binPtr, (MAXRECORDSIZE + 1) * (idx - 1), SEEK_SET);
-  
-  //Read record
-  int i = fread(&record, sizeof(char), sizeof(record)/sizeof(char), binPtr);
-  
-  string recordBuf(record);
-  
-  return recordBuf;
-}//end getRecord
+//Signal handler that writes this process's trace to trace.<pid>.json.
+void dumpTrace(int) {
+	char path[32];
+	int savedErrno = errno;
+	
+	tracer.dumpToFile(path);
+	errno = savedErrno;
+}//end dumpTrace
 
-//Calculates and returns the number of log records stored in the server log file.
-int getTotalLogRecords(FILE *logPtr) {
-  char logRecord[MAXLOGRECORDSIZE];
-  int ctr = 0;
-  
-	//Set file pointer to beginning of file
-	rewind(logPtr);
+//Formats a client's address for display and logging.
+string formatAddress(struct sockaddr_in &client) {
+	char clientAddr[INET_ADDRSTRLEN];
 	
-  //Continue reading log records until end of file is reached.
-  while( fgets(logRecord, sizeof(logRecord)/sizeof(char), logPtr) != NULL ) {
-    ctr++;
-  }//end while
-  
-  return ctr;
-}//end getTotalLogRecords
+	inet_ntop(AF_INET, &client.sin_addr, clientAddr, INET_ADDRSTRLEN); 
+	
+	return string(clientAddr) + ":" + to_string( htons(client.sin_port) );
+}//end formatAddress
 
-//Calculates and returns the number of records stored in the binary data file.
-int getTotalRecords(FILE *binPtr) {
-  int ctr = 0;
-  char record[MAXRECORDSIZE+2];
-  
-  //Set file pointer to beginning of file
-  rewind(binPtr);
-  
-  //Continue reading records until end of file is reached
-  while( fgets(record, sizeof(record)/sizeof(char), binPtr) != NULL ) {
-    ctr++;
-  }//end while
+//Handles client request for the records matching a filter expression.
+Task<bool> filterRecords(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, int exprLength, LogBinRWSemMonitor &fileMonitor) {
+	const int BLOCKRECORDS = 256;
+	char block[BLOCKRECORDS][MAXRECORDSIZE+1];
+	char expr[MAXEXPRSIZE+1];
+	char failure[] = "FAILURE";
+	int numRecords, numMatches = 0;
+	bool received;
+	string strMatches;
+	vector<intRecMsgPacket> matches;
+	RecordFilter filter;
+	
+	//Receive the filter expression following the request
+	received = co_await receiveExpression(commfd, expr, exprLength);
+	
+	if( !received) {
+		co_return false;
+	}//end if
+	
+	//Compile the expression once for the whole request
+	if( !filter.compile(expr) ) {
+		co_await sendMsg(commfd, intRecMsgPacket(getpid(), "FLT", -1, failure) );
+		co_return true;
+	}//end if
+	
+	//Evaluate the filter against every record, a block of records at a time
+	numRecords = co_await countRecords(dataset);
+	
+	for(int first = 1; first <= numRecords; first += BLOCKRECORDS) {
+		int blockSize = min(BLOCKRECORDS, numRecords - first + 1);
+		
+		co_await readRecords(dataset, first, blockSize, block[0]);
+		matches.clear();
+		
+		for(int i = 0; i < blockSize; i++) {
+			DataRecord record;
+			
+			//Malformed (and unreadable) records never match
+			if( record.parse(block[i], first + i) && filter.matches(record, first + i) ) {
+				matches.push_back( intRecMsgPacket(getpid(), "FLT", first + i, block[i]) );
+			}//end if
+			
+		}//end for
+		
+		//Stream the block's matches as soon as they are known, so no more than a block is ever held
+		if( !matches.empty() ) {
+			co_await sendBytes(commfd, &matches[0], matches.size() * sizeof(intRecMsgPacket) );
+			numMatches += matches.size();
+		}//end if
+		
+	}//end for
+	
+	//End the matches with a packet of index 0 holding their number
+	strMatches = to_string(numMatches);
+	co_await sendMsg(commfd, intRecMsgPacket(getpid(), "FLT", 0, &strMatches[0]) );
+	
+	//Log the client request & server response
+	co_await fileMonitor.addLogWriter();
+	logRequest(logPtr, cliPID, 'Q', numMatches);
+	fileMonitor.remLogWriter();
+	
+	co_return true;
+}//end filterRecords
+
+//Follows a primary's journal from the end of this replica's own, applying each entry as it arrives.
+Task<> followJournal(int primaryfd, ShardedDataset &dataset) {
+	vector<JournalEntry> entries(JOURNALBLOCKENTRIES);
+	intRecMsgPacket header;
+	char strEpoch[9];
+	long applied = dataset.getJournal().getNumEntries();
+	unsigned int epoch;
+	bool received, stored = true;
+	
+	//Ask for every entry past the ones already applied (a replica's journal is a copy of the start of its primary's, epoch included)
+	snprintf(strEpoch, sizeof(strEpoch), "%08x", dataset.getJournal().getEpoch() );
+	co_await sendMsg(primaryfd, serMsgPacket(getpid(), "JRN", applied, strEpoch) );
+	received = co_await receiveBytes(primaryfd, &header, sizeof(header) );
+	
+	//Every block of entries follows a header with its size and the primary's journal length (heartbeats have no entries)
+	while(received && stored && header.val >= 0 && header.val <= JOURNALBLOCKENTRIES) {
+		
+		if(header.val > 0) {
+			received = co_await receiveBytes(primaryfd, &entries[0], sizeof(JournalEntry) * header.val);
+		}//end if
+		
+		//Apply the entries in order, each under the same locks as a client's write
+		for(int i = 0; received && stored && i < header.val; i++) {
+			entries[i].record[MAXRECORDSIZE] = '\0';
+			stored = co_await putRecord(dataset, entries[i].idx, entries[i].record, sizeof(entries[i].record) );
+			
+			if(stored) {
+				applied++;
+			}//end if
+			
+		}//end for
+		
+		//The replica is up to date as of now if it has everything the primary had when the block was sent
+		if(received && stored) {
+			header.record[MAXRECORDSIZE] = '\0';
+			serverStats.replicaSynced(atol(header.record), applied >= atol(header.record) );
+			received = co_await receiveBytes(primaryfd, &header, sizeof(header) );
+		}//end if
+		
+	}//end while
+	
+	if( !stored) {
+		cout << "Error applying journal entry " << applied << "; reconnecting to the primary..." << endl;
+	} else if(received && header.val == -1 && strncmp(header.record, "FAILURE", MAXRECORDSIZE) == 0) {
+		cout << "The primary does not serve replicas; was it started with -c?" << endl;
+	} else if(received && header.val == -1 && sscanf(header.record, "EPOCH,%x", &epoch) == 1) {
+		cout << "This replica's journal has another history than its primary's; starting over from entry 0..." << endl;
+		stored = co_await resetReplica(dataset, epoch);
+		
+		if( !stored) {
+			cout << "Error resetting the replica." << endl;
+		}//end if
+		
+	} else if(received && header.val == -1) {
+		cout << "This replica's journal is longer than its primary's; is it following another primary?" << endl;
+	}//end if
+	
+}//end followJournal
 
-  return ctr;
-}//end getTotalRecords
+//Handles the HELLO a client sends when it connects, agreeing on the fastest paths both sides support.
+Task<> greetClient(int commfd, serMsgPacket &clientMsg, wireFormat &wire) {
+	helloMsgPacket hello;
+	
+	memcpy(static_cast<void *>(&hello), &clientMsg, sizeof(hello) );
+	
+	wire.version = max(1, min(hello.version, PROTOCOLVERSION) );
+	wire.features = hello.features & (FEATURECOMPRESS | FEATUREPIPELINE);
+	wire.frameSize = max(1, min(hello.maxFrameSize, COMPRESSFRAMESIZE) );
+	wire.encoding = (hello.encoding == ENCODINGSLOTS) ? ENCODINGSLOTS : ENCODINGPACKETS;
+	
+	//Frames too small to find repeats in are not worth compressing
+	if(wire.frameSize < MINFRAMESIZE) {
+		wire.features &= ~FEATURECOMPRESS;
+	}//end if
+	
+	wire.codec = (wire.features & FEATURECOMPRESS) ? CODECLZ : CODECNONE;
+	
+	co_await sendMsg(commfd, helloMsgPacket(getpid(), "HLO", wire.version, wire.features, wire.frameSize, wire.encoding) );
+}//end greetClient
 
 //Decides the appropriate course of action for a received command then logs the operation(s) performed
-void handleCmd(int commfd, FILE *binPtr, FILE *logPtr, serMsgPacket clientMsg, LogBinRWSemMonitor &fileMonitor) {
+Task<bool> handleCmd(int commfd, ShardedDataset &dataset, FILE *logPtr, serMsgPacket clientMsg, wireFormat &wire, LogBinRWSemMonitor &fileMonitor) {
+  uint64_t start = serverStats.now();
+  int command = ServerStats::commandOf(clientMsg.cmd);
+  bool inFrame = true;
   
-	//Determine issued command
-  if( strcmp(clientMsg.cmd, "CNT") == 0) {
-    recordCount(commfd, binPtr, logPtr, clientMsg.sender, fileMonitor);
+  tracer.beginSpan(command);
+  
+	//Determine issued command (a replica too far behind its primary refuses reads rather than answer from stale data)
+  if( isStale(dataset) && (strcmp(clientMsg.cmd, "CNT") == 0 || strcmp(clientMsg.cmd, "GET") == 0 || strcmp(clientMsg.cmd, "FLT") == 0 || strcmp(clientMsg.cmd, "AGG") == 0 || strcmp(clientMsg.cmd, "SYN") == 0) ) {
+    inFrame = co_await refuseStale(commfd, clientMsg);
+  } else if( strcmp(clientMsg.cmd, "CNT") == 0) {
+    co_await recordCount(commfd, dataset, logPtr, clientMsg.sender, fileMonitor);
   } else if( strcmp(clientMsg.cmd, "GET") == 0) {
-    displayRecord(commfd, binPtr, logPtr, clientMsg.sender, clientMsg.val, fileMonitor);
+    co_await displayRecord(commfd, dataset, logPtr, clientMsg.sender, clientMsg.val, wire, fileMonitor);
   } else if( strcmp(clientMsg.cmd, "FIX") == 0) {
-    changeRecord(commfd, binPtr, logPtr, clientMsg.sender, clientMsg.val, clientMsg.record, sizeof(clientMsg.record), fileMonitor);
+    co_await changeRecord(commfd, dataset, logPtr, clientMsg.sender, clientMsg.val, clientMsg.record, sizeof(clientMsg.record), fileMonitor);
   } else if( strcmp(clientMsg.cmd, "NEW") == 0) {
-    newRecord(commfd, binPtr, logPtr, clientMsg.sender, clientMsg.record, sizeof(clientMsg.record), fileMonitor);
+    co_await newRecord(commfd, dataset, logPtr, clientMsg.sender, clientMsg.record, sizeof(clientMsg.record), fileMonitor);
   } else if( strcmp(clientMsg.cmd, "LOG") == 0) {
-    sendLog(commfd, logPtr, clientMsg.sender, fileMonitor);
+    co_await sendLog(commfd, logPtr, clientMsg.sender, wire, fileMonitor);
+  } else if( strcmp(clientMsg.cmd, "FLT") == 0) {
+    inFrame = co_await filterRecords(commfd, dataset, logPtr, clientMsg.sender, clientMsg.val, fileMonitor);
+  } else if( strcmp(clientMsg.cmd, "BLK") == 0) {
+    co_await bulkRecords(commfd, dataset, logPtr, clientMsg.sender, clientMsg.val, clientMsg.record, wire, fileMonitor);
+  } else if( strcmp(clientMsg.cmd, "AGG") == 0) {
+    co_await aggregateRevenue(commfd, dataset, logPtr, clientMsg.sender, clientMsg.val, clientMsg.record, fileMonitor);
+  } else if( strcmp(clientMsg.cmd, "STS") == 0) {
+    co_await sendStats(commfd, logPtr, clientMsg.sender, fileMonitor);
+  } else if( strcmp(clientMsg.cmd, "TRC") == 0) {
+    co_await sendTrace(commfd, logPtr, clientMsg.sender, fileMonitor);
+  } else if( strcmp(clientMsg.cmd, "PUT") == 0) {
+    co_await storeRecord(commfd, dataset, logPtr, clientMsg.sender, clientMsg.val, clientMsg.record, sizeof(clientMsg.record), fileMonitor);
+  } else if( strcmp(clientMsg.cmd, "LAG") == 0) {
+    co_await reportLag(commfd, dataset, logPtr, clientMsg.sender, fileMonitor);
+  } else if( strcmp(clientMsg.cmd, "SYN") == 0) {
+    co_await syncRecords(commfd, dataset, logPtr, clientMsg.sender, clientMsg.val, clientMsg.record, fileMonitor);
+  } else if( strcmp(clientMsg.cmd, "WCH") == 0) {
+    co_await watchChanges(commfd, dataset, logPtr, clientMsg.sender, clientMsg.record, fileMonitor);
+  } else if( strcmp(clientMsg.cmd, "HLO") == 0) {
+    co_await greetClient(commfd, clientMsg, wire);
+  } else if( strcmp(clientMsg.cmd, "CMP") == 0) {
+    co_await negotiateCodec(commfd, clientMsg.val, wire);
+  } else if( strcmp(clientMsg.cmd, "JRN") == 0) {
+    co_await streamJournal(commfd, dataset, logPtr, clientMsg.sender, clientMsg.val, clientMsg.record, fileMonitor);
   }//end if
 	
+	//Record the command's latency and traffic
+	tracer.endSpan(command);
+	serverStats.recordCommand(command, start);
+	
+	co_return inFrame;
 }//end handleCmd
 
+//Determines whether this server is a replica that has fallen further behind its primary than reads allow.
+bool isStale(ShardedDataset &dataset) {
+	int64_t staleness;
+	
+	if( !dataset.isReadOnly() || maxStaleness == 0) {
+		return false;
+	}//end if
+	
+	//A replica that has never caught up is as stale as can be
+	staleness = serverStats.getReplicaStaleness();
+	
+	return staleness == -1 || staleness > maxStaleness * 1000000LL;
+}//end isStale
+
 //Logs the successful connection of an incoming client
 void logConnection(FILE * logPtr, string clientAddress) {
+	uint64_t ioStart = beginIO(LOGWRITEIO);
+	
 	fprintf(logPtr, "%s successfully connected.\n", &clientAddress[0]);
+	endIO(LOGWRITEIO, ioStart);
 }//end logConnection
 
 //Logs the client request and server response for any given operation.
 void logRequest(FILE * logPtr, pid_t cliPID, char cmd, int numRecords, int idx) {
+	uint64_t ioStart = beginIO(LOGWRITEIO);
 	
   //Add Log entry based on command
   switch(cmd) {
@@ -480,35 +1430,87 @@ void logRequest(FILE * logPtr, pid_t cliPID, char cmd, int numRecords, int idx)
     case 'L':
       fprintf(logPtr, "Server responded to Client %li with list of %i log records.\n", (long) cliPID, numRecords);
       break;
+    //AGG command
+    case 'A':
+      fprintf(logPtr, "Server sent Client %li a %s revenue aggregate.\n", (long) cliPID, idx == YEARLY ? "yearly" : idx == QUARTERLY ? "quarterly" : "rolling");
+      break;
+    //BLK command
+    case 'B':
+      fprintf(logPtr, "Server bulk added records %i-%i for Client %li.\n", idx, numRecords, (long) cliPID);
+      break;
+    //FLT command
+    case 'Q':
+      fprintf(logPtr, "Server filtered %i records for Client %li.\n", numRecords, (long) cliPID);
+      break;
+    //STS command
+    case 'S':
+      fprintf(logPtr, "Server sent Client %li %i lines of server statistics.\n", (long) cliPID, numRecords);
+      break;
+    //TRC command
+    case 'T':
+      fprintf(logPtr, "Server wrote %i trace events for Client %li.\n", numRecords, (long) cliPID);
+      break;
+    //PUT command
+    case 'P':
+      fprintf(logPtr, "Server stored record #%i for Client %li.\n", idx, (long) cliPID);
+      break;
+    //PUT command with an empty record
+    case 'D':
+      fprintf(logPtr, "Server removed record #%i for Client %li.\n", idx, (long) cliPID);
+      break;
+    //JRN command
+    case 'J':
+      fprintf(logPtr, "Server streaming journal from #%i to Client %li.\n", idx, (long) cliPID);
+      break;
+    //WCH command
+    case 'W':
+      fprintf(logPtr, "Server watching records %i-%i for Client %li.\n", idx, numRecords, (long) cliPID);
+      break;
+    //SYN command
+    case 'Y':
+      fprintf(logPtr, "Server sent %i changes since #%i to Client %li.\n", numRecords, idx, (long) cliPID);
+      break;
+    //LAG command
+    case 'R':
+      fprintf(logPtr, "Server reported a lag of %i entries to Client %li.\n", numRecords, (long) cliPID);
+      break;
   }//end switch
 	
 	fflush(logPtr);
+	endIO(LOGWRITEIO, ioStart);
 }//end logRequest
 
+//Handles client request to compress the connection's bulk transfers, choosing a codec the client offered.
+Task<> negotiateCodec(int commfd, int offered, wireFormat &wire) {
+	wire.codec = (offered & CODECLZ) ? CODECLZ : CODECNONE;
+	
+	co_await sendMsg(commfd, intMsgPacket(getpid(), "CMP", wire.codec) );
+}//end negotiateCodec
+
 //Handles client request for the addition of a new record to the dataset and its subsequent logging.
-void newRecord(int commfd, FILE *binPtr, FILE *logPtr, pid_t cliPID, char record[], int recordSize, LogBinRWSemMonitor &fileMonitor) {
-	bool success;
+Task<> newRecord(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, char record[], int recordSize, LogBinRWSemMonitor &fileMonitor) {
+	int idx;
 	intRecMsgPacket ackMsg;
 	string strSuccess;
 	
 	//Add record
-	success = addRecord(binPtr, record, recordSize, fileMonitor);
+	idx = co_await addRecord(dataset, record, recordSize);
 	
 	//Insert Success or Failure message
-	if(success) {
+	if(idx != -1) {
 		strSuccess = "SUCCESS";
 	} else {
 		strSuccess = "FAILURE";
 	}//end if
 	
 	//Assemble acknowledgment message
-	ackMsg = intRecMsgPacket(getpid(), "NEW", -1, &strSuccess[0]);
+	ackMsg = intRecMsgPacket(getpid(), "NEW", idx, &strSuccess[0]);
 	
 	//Send acknowledgment to client
-	sendMsg(commfd, ackMsg);
+	co_await sendMsg(commfd, ackMsg);
 	
 	//Log server operation
-	fileMonitor.addLogWriter();
+	co_await fileMonitor.addLogWriter();
 	logRequest(logPtr, cliPID, 'N');
 	fileMonitor.remLogWriter();
 }//end newRecord
@@ -535,138 +1537,582 @@ FILE * openFile(string filename, string filetype) {
 	return filePtr;
 }//end openBinFile
 
+//Stores a record at a given index, or removes it (for an empty record), and journals the write.
+Task<bool> putRecord(ShardedDataset &dataset, int idx, char record[], int recordSize) {
+	bool success;
+	
+	if(idx < 1) {
+		co_return false;
+	}//end if
+	
+	BinShard &shard = dataset.shardOf(idx);
+	int local = dataset.localIndex(idx);
+	
+	//Storing past the last record changes the record count, so stores are serialized with appends
+	co_await dataset.addAppender();
+	co_await shard.monitor.addBinWriter();
+	success = (record[0] == '\0') ? clearRecord(shard, local) : updateRecord(shard, local, record, recordSize);
+	
+	if(success) {
+		dataset.getJournal().append(idx, record, recordSize);
+	}//end if
+	
+	shard.monitor.remBinWriter();
+	dataset.remAppender();
+	
+	co_return success;
+}//end putRecord
+
+//Retrieves a single record from the server log file.
+Task<> readLogRecord(FILE *logPtr, long &offset, logMsgPacket &logMsg, LogBinRWSemMonitor &fileMonitor) {
+  char logRecord[MAXLOGRECORDSIZE];
+	
+  //Get line from log at the desired offset
+	co_await fileMonitor.addLogReader();
+	uint64_t ioStart = beginIO(LOGREADIO);
+	fseek(logPtr, offset, SEEK_SET);
+  fgets(logRecord, sizeof(logRecord)/sizeof(char), logPtr);
+  offset = ftell(logPtr);
+	endIO(LOGREADIO, ioStart);
+	co_await fileMonitor.remLogReader();
+	
+	//Assemble retrieved log record message packet
+	logMsg = logMsgPacket(getpid(), "LOG", logRecord);
+}//end readLogRecord
+
+//Reads a run of consecutive records, reading each shard's share of the run in one call under its own reader lock.
+Task<int> readRecords(ShardedDataset &dataset, int first, int count, char slots[]) {
+	int numShards = dataset.getNumShards(), numRead = 0;
+	vector<char> stripe;
+	
+	for(int s = 0; s < numShards; s++) {
+		int offset = dataset.runOffset(s, first);
+		int stripeSize = (offset < count) ? (count - 1 - offset) / numShards + 1 : 0;
+		BinShard &shard = dataset.getShard(s);
+		ssize_t bytesRead = 0;
+		
+		//The shard's records in the run are consecutive in the shard's file
+		if(stripeSize > 0) {
+			stripe.resize(stripeSize * RECORDSLOTSIZE);
+			
+			co_await shard.monitor.addBinReader();
+			uint64_t ioStart = beginIO(BINREADIO);
+			bytesRead = pread(fileno(shard.binPtr), &stripe[0], stripe.size(), shard.headerSize + (off_t) RECORDSLOTSIZE * (dataset.localIndex(first + offset) - 1) );
+			endIO(BINREADIO, ioStart);
+			shard.monitor.remBinReader();
+		}//end if
+		
+		//Deal the shard's records back into their places in the run (records past the end of the shard are left empty)
+		for(int i = 0; i < stripeSize; i++) {
+			char * slot = &slots[(offset + (long) i * numShards) * RECORDSLOTSIZE];
+			
+			if( (i + 1) * RECORDSLOTSIZE <= bytesRead) {
+				memcpy(slot, &stripe[i * RECORDSLOTSIZE], RECORDSLOTSIZE);
+				numRead++;
+			} else {
+				slot[0] = '\0';
+			}//end if
+			
+		}//end for
+		
+	}//end for
+	
+	co_return numRead;
+}//end readRecords
+
+//Reads exactly the requested number of bytes of a bulk transfer, decompressing each frame when the connection negotiated a codec.
+Task<bool> receiveBulk(int commfd, void *buf, size_t len, const wireFormat &wire) {
+	vector<char> packed;
+	frameHeader header;
+	bool received;
+	
+	if(wire.codec == CODECNONE) {
+		received = co_await receiveBytes(commfd, buf, len);
+		co_return received;
+	}//end if
+	
+	for(size_t done = 0; done < len; done += header.rawSize) {
+		received = co_await receiveBytes(commfd, &header, sizeof(header) );
+		
+		//A frame must fit in what is left of the transfer, and can only have grown as much as compression allows
+		if(received && (header.rawSize == 0 || header.rawSize > min<size_t>(len - done, wire.frameSize) ||
+		                header.packedSize > (uint32_t) LzCodec::maxPackedSize(header.rawSize) ) ) {
+			shutdown(commfd, SHUT_RDWR);
+			received = false;
+		}//end if
+		
+		if(received) {
+			packed.resize(header.packedSize);
+			received = co_await receiveBytes(commfd, &packed[0], header.packedSize);
+		}//end if
+		
+		if( !received) {
+			co_return false;
+		}//end if
+		
+		//Frames that would not shrink were sent as they are
+		if(header.packedSize == header.rawSize) {
+			memcpy( (char *) buf + done, &packed[0], header.rawSize);
+		} else if( !LzCodec::decompress(&packed[0], header.packedSize, (char *) buf + done, header.rawSize) ) {
+			shutdown(commfd, SHUT_RDWR);
+			co_return false;
+		}//end if
+		
+	}//end for
+	
+	co_return true;
+}//end receiveBulk
+
+//Reads exactly the requested number of bytes from the socket.
+Task<bool> receiveBytes(int commfd, void *buf, size_t len) {
+	size_t received = 0;
+	int numRead;
+	
+	//Continue reading until the full length arrives, the client disconnects, or an error occurs
+	while(received < len) {
+		numRead = co_await SocketReceive(commfd, (char *) buf + received, len - received);
+		
+		if(numRead < 0) {
+			errno = -numRead;
+			perror("Error receiving messages from client: ");
+			co_return false;
+		} else if(numRead == 0) {
+			co_return false;
+		}//end if
+		
+		received += numRead;
+	}//end while
+	
+	serverStats.addReceived(len);
+	
+	co_return true;
+}//end receiveBytes
+
+//Receives the filter expression following a FLT request, draining one too long to hold.
+Task<bool> receiveExpression(int commfd, char expr[], int exprLength) {
+	bool received = true;
+	
+	expr[0] = '\0';
+	
+	if(exprLength < 0) {
+		co_return false;
+	} else if(exprLength <= MAXEXPRSIZE) {
+		received = co_await receiveBytes(commfd, expr, exprLength);
+		expr[received ? exprLength : 0] = '\0';
+		co_return received;
+	}//end if
+	
+	//Drain an oversized expression a buffer at a time, leaving it empty
+	for(int remaining = exprLength, step; received && remaining > 0; remaining -= step) {
+		step = min(remaining, MAXEXPRSIZE);
+		received = co_await receiveBytes(commfd, expr, step);
+	}//end for
+	
+	expr[0] = '\0';
+	
+	co_return received;
+}//end receiveExpression
+
 //Handles the receipt of messages from the client.
-void receiveMsgs(int commfd, FILE *binPtr, FILE *logPtr, LogBinRWSemMonitor &fileMonitor) {
+Task<> receiveMsgs(int commfd, string clientAddress, ShardedDataset &dataset, FILE *logPtr, LogBinRWSemMonitor &fileMonitor) {
   serMsgPacket msg; 
+  wireFormat wire;
+  bool received, inFrame;
   
-  while(true) {
-    if( read(commfd, &msg, sizeof(msg) ) == -1) {
-      perror("Error receiving messages from client: ");
-    } else {
-      handleCmd(commfd, binPtr, logPtr, msg, fileMonitor);
-    }//end if  
+  //Log client arrival
+  co_await fileMonitor.addLogWriter();
+  logConnection(logPtr, clientAddress);
+  fileMonitor.remLogWriter();
+  
+  //Every request arrives as a full serMsgPacket frame (awaited outside the condition, which g++ 12 miscompiles)
+  received = co_await receiveBytes(commfd, &msg, sizeof(msg) );
+  
+  while(received) {
+    inFrame = co_await handleCmd(commfd, dataset, logPtr, msg, wire, fileMonitor);
+    received = false;
+    
+    //A request whose payload could not be read leaves no way to find the next one, so the connection is closed
+    if(inFrame) {
+      received = co_await receiveBytes(commfd, &msg, sizeof(msg) );
+    }//end if
   }//end while
   
+  //Client disconnected (or lost its framing)
+  if(CoRuntime::current != NULL) {
+    CoRuntime::current->forget(commfd);
+  }//end if
+  
+  close(commfd);
+  serverStats.connectionClosed();
 }//end receiveMsgs
 
 //Handles client request for retrieving the record count.
-void recordCount(int commfd, FILE *binPtr, FILE *logPtr, pid_t cliPID, LogBinRWSemMonitor &fileMonitor) {
+Task<> recordCount(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, LogBinRWSemMonitor &fileMonitor) {
 	int numRecords;
 	intMsgPacket finalMsg;
     
 	//Get total number of records
-	fileMonitor.addBinReader();
-	numRecords = getTotalRecords(binPtr);
-	fileMonitor.remBinReader();
+	numRecords = co_await countRecords(dataset);
 	
 	//Assemble record count message packet
 	finalMsg = intMsgPacket(getpid(), "CNT", numRecords);
 	
 	//Send number of records to client
-	sendMsg(commfd, finalMsg);
+	co_await sendMsg(commfd, finalMsg);
 	
 	//Log the server response.
-	fileMonitor.addLogWriter();
+	co_await fileMonitor.addLogWriter();
 	logRequest(logPtr, cliPID, 'C', numRecords);
 	fileMonitor.remLogWriter();
 }//end recordCount
 
-//Retrieves each record in the file one by one and sends them to the requesting client.
-int sendAllRecords(int commfd, FILE *binPtr, LogBinRWSemMonitor &fileMonitor) {
+//Refuses a read on a replica that has fallen too far behind its primary, replying as the request does on failure.
+Task<bool> refuseStale(int commfd, serMsgPacket &clientMsg) {
+	char failure[] = "FAILURE";
+	char expr[MAXEXPRSIZE+1];
+	bool received = true;
+	
+	if( strcmp(clientMsg.cmd, "GET") == 0 && clientMsg.val != -999) {
+		co_await sendMsg(commfd, recMsgPacket(getpid(), "GET", failure) );
+	} else if( strcmp(clientMsg.cmd, "FLT") == 0) {
+		
+		//The filter expression follows the request, so it is drained before replying
+		received = co_await receiveExpression(commfd, expr, clientMsg.val);
+		
+		if(received) {
+			co_await sendMsg(commfd, intRecMsgPacket(getpid(), "FLT", -1, failure) );
+		}//end if
+		
+	} else if( strcmp(clientMsg.cmd, "AGG") == 0 || strcmp(clientMsg.cmd, "SYN") == 0) {
+		co_await sendMsg(commfd, intRecMsgPacket(getpid(), clientMsg.cmd, -1, failure) );
+	} else {
+		//CNT and GET -999 reply with a count of -1
+		co_await sendMsg(commfd, intMsgPacket(getpid(), clientMsg.cmd, -1) );
+	}//end if
+	
+	co_return received;
+}//end refuseStale
+
+//Keeps a replica's dataset following its primary's journal, reconnecting whenever the connection is lost.
+void replicate(string primary, ShardedDataset &dataset) {
+	int primaryfd;
+	
+	while(true) {
+		
+		if( (primaryfd = connectPrimary(primary) ) != -1) {
+			cout << "Following the journal of " << primary << " from entry " << dataset.getJournal().getNumEntries() << "..." << endl;
+			followJournal(primaryfd, dataset).run();
+			close(primaryfd);
+		}//end if
+		
+		//Retry once a second until the primary is back
+		sleep(1);
+	}//end while
+	
+}//end replicate
+
+//Handles client request for how far this server lags behind its primary.
+Task<> reportLag(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, LogBinRWSemMonitor &fileMonitor) {
+	long applied = dataset.getJournal().getNumEntries(), behind = 0;
+	int64_t staleness = 0;
+	string strLag;
+	
+	//A primary is never behind; a replica that has never caught up has no lag to report yet
+	if(dataset.isReadOnly() ) {
+		staleness = serverStats.getReplicaStaleness();
+		behind = (staleness == -1) ? -1 : max<long>(serverStats.getReplicaHead() - applied, 0);
+	}//end if
+	
+	//Reply with the entries behind, along with the entries applied and the staleness in milliseconds
+	strLag = to_string(applied) + "," + to_string(staleness == -1 ? -1 : staleness / 1000000);
+	co_await sendMsg(commfd, intRecMsgPacket(getpid(), "LAG", behind, &strLag[0]) );
+	
+	//Log the client request & server response
+	co_await fileMonitor.addLogWriter();
+	logRequest(logPtr, cliPID, 'R', behind);
+	fileMonitor.remLogWriter();
+}//end reportLag
+
+//Starts a replica over whose journal belongs to another history than its primary's, to follow the primary's from entry 0.
+Task<bool> resetReplica(ShardedDataset &dataset, uint32_t epoch) {
+	char noRecord[1] = "";
+	int numRecords = co_await countRecords(dataset);
+	bool applied = dataset.getJournal().getNumEntries() > 0, removed = true;
+	
+	//The records written in the other history are removed through the same path as a removal the primary journaled
+	for(int idx = 1; removed && applied && idx <= numRecords; idx++) {
+		removed = co_await putRecord(dataset, idx, noRecord, sizeof(noRecord) );
+	}//end for
+	
+	co_return removed && dataset.getJournal().clear(epoch);
+}//end resetReplica
+
+//Serves clients from a pre-forked worker process until the process is killed.
+void runWorker(int port, bool useUring, ShardedDataset &dataset, FILE *logPtr) {
+	int listenfd = setupConnection(port, true);
+	int numEvents;
+	LoopEvent events[MAXREADYEVENTS];
+	EventLoop loop;
+	CoRuntime runtime(loop);
+	
+	//Construct Monitor for the worker (Essentially just gains access to previous semSet)
+	LogBinRWSemMonitor fileMonitor(port);
+	fileMonitor.setStats(&serverStats);
+	fileMonitor.setTracer(&tracer);
+	dataset.setStats(&serverStats);
+	dataset.setTracer(&tracer);
+	
+	//Connections are accepted until none are left, so the listening socket must not block
+	if( fcntl(listenfd, F_SETFL, O_NONBLOCK) == -1 || !loop.init(useUring) || !loop.watch(listenfd) ) {
+		perror("Error creating worker event loop: ");
+		cout << "Shutting down worker..." << endl;
+		exit(EXIT_FAILURE);
+	}//end if
+	
+	if(useUring && loop.getBackend() != URINGBACKEND) {
+		cout << "io_uring unavailable; worker " << getpid() << " is using epoll." << endl;
+	}//end if
+	
+	runtime.setTracer(&tracer);
+	
+	//Accept new clients and resume each client's coroutine as its socket operations finish
+	while( (numEvents = loop.wait(events, runtime.getWaitTimeout() ) ) != -1) {
+		
+		for(int i = 0; i < numEvents; i++) {
+			if(events[i].fd == listenfd) {
+				acceptClient(listenfd, dataset, logPtr, fileMonitor);
+			} else {
+				runtime.complete(events[i]);
+			}//end if
+		}//end for
+		
+		//Semaphores cannot wake the loop, so the acquires still waiting are retried after every wait
+		runtime.retryLocks();
+		runtime.wakeSleepers();
+	}//end while
+	
+	perror("Error waiting for client requests: ");
+	cout << "Shutting down worker..." << endl;
+	exit(EXIT_FAILURE);
+}//end runWorker
+
+//Retrieves the records in blocks from every shard and sends each block to the requesting client in a single write.
+Task<int> sendAllRecords(int commfd, ShardedDataset &dataset, const wireFormat &wire) {
+	vector<char> block(SENDBLOCKRECORDS * RECORDSLOTSIZE);
+	vector<recMsgPacket> packets(SENDBLOCKRECORDS);
+	pid_t myPID = getpid();
+	bool delivered;
  
- 	//Prepare reader for reading, retrieve the record count, and cleanup
-  fileMonitor.addBinReader();
-	int numRecords = getTotalRecords(binPtr);
-	fileMonitor.remBinReader();
+ 	//Retrieve the record count
+	int numRecords = co_await countRecords(dataset);
   
-  //Call sendRecord for each record in file
-  for(int i = 1; i <= numRecords; i++) {
-    sendRecord(commfd, binPtr, i, fileMonitor);
+  //Prefix the records with their count so the client knows how many follow (version 1 clients ask with CNT first)
+  if(wire.version >= 2) {
+		co_await sendMsg(commfd, intMsgPacket(myPID, "GET", numRecords) );
+  }//end if
+  
+  //Read each block under its shards' own reader locks, so writers are never held off by a slow client
+  for(int sent = 0; sent < numRecords; sent += SENDBLOCKRECORDS) {
+		int blockSize = min(SENDBLOCKRECORDS, numRecords - sent);
+		
+		co_await readRecords(dataset, sent + 1, blockSize, &block[0]);
+		
+		//Send the slots as they are stored when the client reads them directly (lost records are empty slots)
+		if(wire.encoding == ENCODINGSLOTS) {
+			delivered = co_await sendBulk(commfd, &block[0], blockSize * RECORDSLOTSIZE, wire);
+			
+			if( !delivered) {
+				perror("Error sending message to client: ");
+				break;
+			}//end if
+			
+			continue;
+		}//end if
+		
+		//Records lost to a concurrent truncation are reported as failures
+		for(int i = 0; i < blockSize; i++) {
+			char * slot = &block[i * RECORDSLOTSIZE];
+			
+			slot[MAXRECORDSIZE] = '\0';
+			packets[i] = recMsgPacket(myPID, "GET", slot[0] != '\0' ? slot : (char *) "FAILURE");
+		}//end for
+		
+		delivered = co_await sendBulk(commfd, &packets[0], blockSize * sizeof(recMsgPacket), wire);
+		
+		if( !delivered) {
+			perror("Error sending message to client: ");
+			break;
+		}//end if
+		
   }//end for
   
-  return numRecords;
+  co_return numRecords;
 }//end sendAllRecords
 
+//Writes a bulk transfer to the socket, compressing it a frame at a time when the connection negotiated a codec.
+Task<bool> sendBulk(int commfd, const void *buf, size_t len, const wireFormat &wire) {
+	vector<char> frame;
+	frameHeader header;
+	bool delivered = true;
+	
+	if(wire.codec == CODECNONE) {
+		delivered = co_await sendBytes(commfd, buf, len);
+		co_return delivered;
+	}//end if
+	
+	for(size_t done = 0; delivered && done < len; done += header.rawSize) {
+		header.rawSize = min<size_t>(len - done, wire.frameSize);
+		frame.resize(sizeof(header) + LzCodec::maxPackedSize(header.rawSize) );
+		header.packedSize = LzCodec::compress( (const char *) buf + done, header.rawSize, &frame[sizeof(header)]);
+		
+		//Send a frame that would not shrink as it is
+		if(header.packedSize >= header.rawSize) {
+			header.packedSize = header.rawSize;
+			memcpy(&frame[sizeof(header)], (const char *) buf + done, header.rawSize);
+		}//end if
+		
+		memcpy(&frame[0], &header, sizeof(header) );
+		delivered = co_await sendBytes(commfd, &frame[0], sizeof(header) + header.packedSize);
+	}//end for
+	
+	co_return delivered;
+}//end sendBulk
+
+//Writes exactly the provided number of bytes to the socket.
+Task<bool> sendBytes(int commfd, const void *buf, size_t len) {
+	size_t sent = 0;
+	ssize_t numWritten;
+	
+	tracer.begin(TRACESEND);
+	
+	//Continue writing until the full length is sent or an error occurs (a worker waits for room rather than blocking,
+	//and a vanished peer fails the send rather than killing the process with SIGPIPE)
+	while(sent < len) {
+		numWritten = send(commfd, (const char *) buf + sent, len - sent, (CoRuntime::current == NULL ? 0 : MSG_DONTWAIT) | MSG_NOSIGNAL);
+		
+		if(numWritten == -1 && (errno == EAGAIN || errno == EWOULDBLOCK) ) {
+			numWritten = (co_await SocketWritable(commfd) > 0) ? 0 : -1;
+		}//end if
+		
+		if(numWritten == -1) {
+			tracer.end(TRACESEND);
+			co_return false;
+		}//end if
+		
+		sent += numWritten;
+	}//end while
+	
+	tracer.end(TRACESEND);
+	serverStats.addSent(len);
+	
+	co_return true;
+}//end sendBytes
+
 //Handles client request for retrieving the contents of the server log.
-void sendLog(int commfd, FILE *logPtr, pid_t cliPID, LogBinRWSemMonitor &fileMonitor) {
+Task<> sendLog(int commfd, FILE *logPtr, pid_t cliPID, const wireFormat &wire, LogBinRWSemMonitor &fileMonitor) {
 	int numRecords;
 	intMsgPacket cntMsg;
+	vector<logMsgPacket> block;
+	bool delivered = true;
 	
 	//Get total number of records
-	fileMonitor.addLogReader();
+	co_await fileMonitor.addLogReader();
 	numRecords = getTotalLogRecords(logPtr);
-	fileMonitor.remLogReader();
+	co_await fileMonitor.remLogReader();
 	
 	//Construct log record count message packet
 	cntMsg = intMsgPacket(getpid(), "LOG", numRecords);
 	
 	//Send number of log records back to client
-	sendMsg(commfd, cntMsg);
+	co_await sendMsg(commfd, cntMsg);
 
-	rewind(logPtr);
-
-	//Send contents of the log back to client
-  for(int i = 0; i < numRecords; i++) {
-    sendLogRecord(commfd, logPtr, i, fileMonitor);
+	//Send contents of the log back to client in blocks (from this request's own offset, as other requests may move the file's)
+  for(long offset = 0, i = 0; delivered && i < numRecords; i++) {
+    block.emplace_back();
+    co_await readLogRecord(logPtr, offset, block.back(), fileMonitor);
+    
+    if(block.size() == SENDBLOCKRECORDS || i == numRecords - 1) {
+      delivered = co_await sendBulk(commfd, &block[0], block.size() * sizeof(logMsgPacket), wire);
+      block.clear();
+    }//end if
+    
   }//end for
 	
 	//Log the client request & server response
-	fileMonitor.addLogWriter();
+	co_await fileMonitor.addLogWriter();
 	logRequest(logPtr, cliPID, 'L', numRecords);
 	fileMonitor.remLogWriter();
 }//end sendLog
 
-//Retrieves and sends a single record from the server log file.
-void sendLogRecord(int commfd, FILE *logPtr, int idx, LogBinRWSemMonitor &fileMonitor) {
-  char logRecord[MAXLOGRECORDSIZE];
-  logMsgPacket logMsg;
-	
-	//Seek to desired log record
-	//fseek(logPtr, (MAXLOGRECORDSIZE + 1) * (idx - 1), SEEK_SET);
-	
-  //Get line from log
-	fileMonitor.addLogReader();
-  fgets(logRecord, sizeof(logRecord)/sizeof(char), logPtr);
-	fileMonitor.remLogReader();
-	
-	//Assemble retrieved log record message packet
-	logMsg = logMsgPacket(getpid(), "LOG", logRecord);
-  
-  //Send log record to client
-  sendMsg(commfd, logMsg);
-}//end sendLogRecord
-
-//Retrieves the record found at the provided index from the file and sends it to the requesting client.
-void sendRecord(int commfd, FILE *binPtr, int idx, LogBinRWSemMonitor &fileMonitor) {
+//Retrieves the record found at the provided index from its shard and sends it to the requesting client.
+Task<> sendRecord(int commfd, ShardedDataset &dataset, int idx) {
   string record;
-  char * recordCString = (char*) malloc(sizeof(record) + 1);
   recMsgPacket recMsg;
+  BinShard &shard = dataset.shardOf(idx);
+  int local = dataset.localIndex(idx);
+	
+	//Prepare the shard's Reader for reading, retrieve the record, and cleanup
+	co_await shard.monitor.addBinReader();
+  record = (local >= 1 && local <= getTotalRecords(shard) ) ? getRecord(shard, local) : "";
+	shard.monitor.remBinReader();
 	
-	//Prepare Reader for reading, retrieve the record, and cleanup
-	fileMonitor.addBinReader();
-  record = getRecord(binPtr, idx);
-	fileMonitor.remBinReader();
+	//Nonexistent records (and a cluster node's empty slots) are reported as failures
+	if(record.empty() ) {
+		record = "FAILURE";
+	}//end if
   
 	//Assemble retrieved record message packet
   recMsg = recMsgPacket(getpid(), "GET", &record[0]);
   
   //Send retrieved record to client
-  sendMsg(commfd, recMsg);
+  co_await sendMsg(commfd, recMsg);
 }//end sendRecord
 
 //Handles the transmission of messages to clients
-template<class MsgPacket> void sendMsg(int commfd, MsgPacket msg) {
-  if( write(commfd, &msg, sizeof(msg) ) == -1) {
+template<class MsgPacket> Task<> sendMsg(int commfd, MsgPacket msg) {
+  bool sent = co_await sendBytes(commfd, &msg, sizeof(msg) );
+  
+  if( !sent) {
     perror("Error sending message to client: ");
-  } else {
-    //cout << "Message sent to client" << endl;
   }//end if
 }//end sendMsg
 
+//Handles client request for a snapshot of the server statistics.
+Task<> sendStats(int commfd, FILE *logPtr, pid_t cliPID, LogBinRWSemMonitor &fileMonitor) {
+	vector<string> lines = serverStats.snapshot();
+	
+	//Send the number of lines followed by the lines themselves (truncated to fit a log record)
+	co_await sendMsg(commfd, intMsgPacket(getpid(), "STS", lines.size() ) );
+	
+	for(size_t i = 0; i < lines.size(); i++) {
+		lines[i].resize( min(lines[i].size(), (size_t) MAXLOGRECORDSIZE - 1) );
+		co_await sendMsg(commfd, logMsgPacket(getpid(), "STS", &lines[i][0]) );
+	}//end for
+	
+	//Log the client request & server response
+	co_await fileMonitor.addLogWriter();
+	logRequest(logPtr, cliPID, 'S', lines.size() );
+	fileMonitor.remLogWriter();
+}//end sendStats
+
+//Handles client request for a dump of this child server's trace.
+Task<> sendTrace(int commfd, FILE *logPtr, pid_t cliPID, LogBinRWSemMonitor &fileMonitor) {
+	char path[32];
+	int numEvents = tracer.dumpToFile(path);
+	
+	//Send the number of events written along with the file they were written to
+	co_await sendMsg(commfd, intRecMsgPacket(getpid(), "TRC", numEvents, path) );
+	
+	//Log the client request & server response
+	co_await fileMonitor.addLogWriter();
+	logRequest(logPtr, cliPID, 'T', numEvents);
+	fileMonitor.remLogWriter();
+}//end sendTrace
+
 //Sets up the server connection by creating the listening socket, binding it to the server address, and creating the listening queue.
-int setupConnection(int port) {
+int setupConnection(int port, bool reusePort) {
 	const int MAX_CONN = 10;
-	int listenfd;
+	int listenfd, reuse = 1;
 	struct sockaddr_in serverAddress;
 	
 	//Create listening socket
@@ -676,6 +2122,15 @@ int setupConnection(int port) {
 		exit(EXIT_FAILURE);
 	}//end if
 	
+	//Allow a restarted server to bind while old connections linger in TIME_WAIT, and workers to share the port
+	if( setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse) ) == -1 ||
+	    (reusePort && setsockopt(listenfd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse) ) == -1) ) {
+		perror("Error setting listening socket options: ");
+		cout << "Shutting down server..." << endl;
+		close(listenfd);
+		exit(EXIT_FAILURE);
+	}//end if
+	
 	//Intialize server address and port
 	serverAddress.sin_family = AF_INET;
 	serverAddress.sin_addr.s_addr = INADDR_ANY;
@@ -699,18 +2154,303 @@ int setupConnection(int port) {
 	return listenfd;
 }//end setupConnection
 
-//Updates the record at the provided index
-bool updateRecord(FILE * binPtr, int idx, char record[], int recordSize) {
-  int charsWritten;
-  
-  //Set File pointer back to beginning of file
-  rewind(binPtr);
-  
-  //Seek to desired record
-  fseek(binPtr, (MAXRECORDSIZE+1) * (idx - 1), SEEK_SET);
-  
-  //Write updated record to file
-  charsWritten = fwrite(record, sizeof(char), recordSize/sizeof(char), binPtr);
-  
-  return charsWritten != 0;
-}//end updateRecord
\ No newline at end of file
+//Creates a worker process.
+pid_t spawnWorker(int port, bool useUring, ShardedDataset &dataset, FILE *logPtr) {
+	pid_t pid;
+	
+	if((pid = fork() ) == -1) {
+		perror("Error creating worker process: ");
+		cout << "Shutting down server..." << endl;
+		exit(EXIT_FAILURE);
+	} else if(pid == 0) {
+		runWorker(port, useUring, dataset, logPtr);
+	}//end if
+	
+	return pid;
+}//end spawnWorker
+
+//Starts serving the server statistics as Prometheus text metrics from a dedicated process.
+void startMetricsExporter(int port, ShardedDataset &dataset, FILE *logPtr) {
+	MetricsExporter exporter(serverStats, dataset, logPtr);
+	pid_t pid;
+	
+	if( !exporter.listen(port) ) {
+		cout << "Error creating metrics endpoint; metrics disabled." << endl;
+		return;
+	}//end if
+	
+	//Scrapes are answered by their own process, so they never hold up clients
+	if( (pid = fork() ) == -1) {
+		perror("Error creating metrics process: ");
+		cout << "Metrics disabled." << endl;
+	} else if(pid == 0) {
+		exporter.serve();
+	} else {
+		cout << "Serving metrics on port " << port << "..." << endl;
+	}//end if
+
+}//end startMetricsExporter
+
+//Starts the process that keeps a replica's dataset following its primary.
+void startReplicator(string primary, ShardedDataset &dataset) {
+	pid_t pid;
+	
+	//A replica cannot follow its primary without it
+	if( (pid = fork() ) == -1) {
+		perror("Error creating replication process: ");
+		cout << "Shutting down server..." << endl;
+		exit(EXIT_FAILURE);
+	} else if(pid == 0) {
+		replicate(primary, dataset);
+	} else {
+		cout << "Replicating from " << primary << (maxStaleness > 0 ? ", refusing reads over " + to_string(maxStaleness) + "ms stale" : "") << "..." << endl;
+	}//end if
+	
+}//end startReplicator
+
+//Handles request for storing a record at a given index, creating it, replacing it, or (for an empty record) removing it.
+Task<> storeRecord(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, int recIdx, char record[], int recordSize, LogBinRWSemMonitor &fileMonitor) {
+	bool success = false, removing = record[0] == '\0';
+	string strSuccess;
+	
+	//A replica's dataset only changes by replaying its primary's journal, and a gap past the last record is bounded
+	if(clusterNode && !dataset.isReadOnly() && recIdx <= dataset.getNumRecords() + MAXBULKSIZE / RECORDSLOTSIZE) {
+		success = co_await putRecord(dataset, recIdx, record, recordSize);
+	}//end if
+	
+	//Insert Success or Failure message
+	if(success) {
+		strSuccess = "SUCCESS";
+	} else {
+		strSuccess = "FAILURE";
+	}//end if
+	
+	//Acknowledge the store
+	co_await sendMsg(commfd, intRecMsgPacket(getpid(), "PUT", recIdx, &strSuccess[0]) );
+	
+	//Log the client request & server response
+	if(success) {
+		co_await fileMonitor.addLogWriter();
+		logRequest(logPtr, cliPID, removing ? 'D' : 'P', -1, recIdx);
+		fileMonitor.remLogWriter();
+	}//end if
+	
+}//end storeRecord
+
+//Streams the journal to a replica from the given entry on, then each new entry as it is appended, until the replica disconnects.
+Task<> streamJournal(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, int offset, const char epoch[], LogBinRWSemMonitor &fileMonitor) {
+	WriteJournal &journal = dataset.getJournal();
+	vector<char> block(sizeof(intRecMsgPacket) + sizeof(JournalEntry) * JOURNALBLOCKENTRIES);
+	uint32_t current = journal.getEpoch();
+	long next = offset, head = journal.getNumEntries();
+	int numEntries;
+	bool delivered = true;
+	char strEpoch[16];
+	string strHead = clusterNode ? to_string(head) : "FAILURE";
+	
+	//A replica whose journal was started over on its own (or copies one since started over here) has another history
+	if(clusterNode && strtoul(string(epoch, strnlen(epoch, MAXRECORDSIZE) ).c_str(), NULL, 16) != current) {
+		snprintf(strEpoch, sizeof(strEpoch), "EPOCH,%08x", current);
+		co_await sendMsg(commfd, intRecMsgPacket(getpid(), "JRN", -1, strEpoch) );
+		co_return;
+	}//end if
+	
+	//A replica with more entries than the journal is following some other primary
+	if( !clusterNode || offset < 0 || offset > head) {
+		co_await sendMsg(commfd, intRecMsgPacket(getpid(), "JRN", -1, &strHead[0]) );
+		co_return;
+	}//end if
+	
+	//Log the start of the stream, which lasts as long as the replica stays connected
+	co_await fileMonitor.addLogWriter();
+	logRequest(logPtr, cliPID, 'J', -1, offset);
+	fileMonitor.remLogWriter();
+	
+	//An up-to-date replica is sent an empty block now and then, so it knows it still is
+	while(delivered) {
+		numEntries = co_await tailJournal(journal, next, (JournalEntry *) &block[sizeof(intRecMsgPacket)], head);
+		
+		//Send the header and its entries in one write
+		strHead = to_string(head);
+		intRecMsgPacket header(getpid(), "JRN", numEntries, &strHead[0]);
+		memcpy(&block[0], &header, sizeof(header) );
+		delivered = co_await sendBytes(commfd, &block[0], sizeof(header) + sizeof(JournalEntry) * numEntries);
+		
+		next += numEntries;
+	}//end while
+	
+}//end streamJournal
+
+//Starts a fixed pool of worker processes, then reaps any that exit and starts their replacements.
+void superviseWorkers(int numWorkers, int port, bool useUring, ShardedDataset &dataset, FILE *logPtr) {
+	vector<pid_t> workers(numWorkers);
+	vector<time_t> startTimes(numWorkers);
+	pid_t pid;
+	
+	for(int i = 0; i < numWorkers; i++) {
+		workers[i] = spawnWorker(port, useUring, dataset, logPtr);
+		startTimes[i] = time(NULL);
+	}//end for
+	
+	//Reap every exited child; only workers are replaced
+	while( (pid = waitpid(-1, NULL, 0) ) != -1) {
+		vector<pid_t>::iterator worker = find(workers.begin(), workers.end(), pid);
+		int idx = worker - workers.begin();
+		
+		if(worker == workers.end() ) {
+			continue;
+		}//end if
+		
+		cout << "Worker " << pid << " exited; restarting..." << endl;
+		
+		//Don't spin on a worker that cannot start (e.g. the port is taken)
+		if(time(NULL) - startTimes[idx] < 1) {
+			sleep(1);
+		}//end if
+		
+		workers[idx] = spawnWorker(port, useUring, dataset, logPtr);
+		startTimes[idx] = time(NULL);
+	}//end while
+	
+	perror("Error waiting for workers: ");
+	cout << "Shutting down server..." << endl;
+	exit(EXIT_FAILURE);
+}//end superviseWorkers
+
+//Handles client request for the records changed since a sequence number, reading the journal back from its end so each record is sent once.
+Task<> syncRecords(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, int since, const char epoch[], LogBinRWSemMonitor &fileMonitor) {
+	WriteJournal &journal = dataset.getJournal();
+	vector<JournalEntry> entries(JOURNALBLOCKENTRIES);
+	vector<intRecMsgPacket> changes;
+	unordered_set<int> synced;
+	intRecMsgPacket headerMsg;
+	uint32_t current = journal.getEpoch();
+	long head = journal.getNumEntries(), first;
+	int numEntries;
+	bool delivered;
+	char failure[] = "FAILURE", strEpoch[9];
+	string strHead;
+	
+	snprintf(strEpoch, sizeof(strEpoch), "%08x", current);
+	strHead = to_string(head) + "," + strEpoch;
+	
+	//A sequence number handed out before the journal was started over points into a different history
+	if(since > 0 && strtoul(string(epoch, strnlen(epoch, MAXRECORDSIZE) ).c_str(), NULL, 16) != current) {
+		strHead = "EPOCH," + strHead;
+		co_await sendMsg(commfd, intRecMsgPacket(getpid(), "SYN", -1, &strHead[0]) );
+		co_return;
+	}//end if
+	
+	//A sequence number past the journal's end was never handed out by this dataset
+	if(since < 0 || since > head) {
+		co_await sendMsg(commfd, intRecMsgPacket(getpid(), "SYN", -1, failure) );
+		co_return;
+	}//end if
+	
+	//The journal is the change index: the newest entry of each record holds its current value, and older ones are skipped
+	for(long end = head; end > since; end = first) {
+		first = max<long>(since, end - JOURNALBLOCKENTRIES);
+		numEntries = journal.read(first, end - first, &entries[0]);
+		
+		for(int i = numEntries - 1; i >= 0; i--) {
+			if( synced.insert(entries[i].idx).second) {
+				entries[i].record[MAXRECORDSIZE] = '\0';
+				changes.push_back( intRecMsgPacket(getpid(), "SYN", entries[i].idx, entries[i].record) );
+			}//end if
+		}//end for
+		
+	}//end for
+	
+	//Send the changes in index order, prefixed by their count and the new high-water mark
+	sort(changes.begin(), changes.end(), [](const intRecMsgPacket &a, const intRecMsgPacket &b) { return a.val < b.val; });
+	headerMsg = intRecMsgPacket(getpid(), "SYN", changes.size(), &strHead[0]);
+	
+	delivered = co_await sendBytes(commfd, &headerMsg, sizeof(headerMsg) );
+	
+	if(delivered && !changes.empty() ) {
+		co_await sendBytes(commfd, &changes[0], sizeof(intRecMsgPacket) * changes.size() );
+	}//end if
+	
+	//Log the client request & server response
+	co_await fileMonitor.addLogWriter();
+	logRequest(logPtr, cliPID, 'Y', changes.size(), since);
+	fileMonitor.remLogWriter();
+}//end syncRecords
+
+//Waits for entries past a position in the journal, checking it every JOURNALPOLLINTERVAL microseconds.
+Task<int> tailJournal(WriteJournal &journal, long next, JournalEntry entries[], long &head) {
+	int numEntries = 0;
+	
+	//Every process appends to the journal file itself, so new entries are found by checking its length
+	for(int polls = 0; numEntries == 0 && polls < JOURNALHEARTBEATPOLLS; polls++) {
+		
+		if(polls > 0) {
+			co_await Sleep(JOURNALPOLLINTERVAL);
+		}//end if
+		
+		head = journal.getNumEntries();
+		numEntries = journal.read(next, min<long>(head - next, JOURNALBLOCKENTRIES), entries);
+	}//end for
+	
+	co_return numEntries;
+}//end tailJournal
+
+//Handles client request for a subscription to changes, pushing every write committed to a record in the requested range until the client disconnects.
+Task<> watchChanges(int commfd, ShardedDataset &dataset, FILE *logPtr, pid_t cliPID, char range[], LogBinRWSemMonitor &fileMonitor) {
+	WriteJournal &journal = dataset.getJournal();
+	vector<JournalEntry> entries(JOURNALBLOCKENTRIES);
+	vector<intRecMsgPacket> changes;
+	intRecMsgPacket ackMsg;
+	long next = journal.getNumEntries(), head;
+	int first = 1, last = INT_MAX, numEntries;
+	bool subscribed;
+	char byte, success[] = "SUCCESS", failure[] = "FAILURE";
+	string strMissed;
+	
+	range[MAXRECORDSIZE] = '\0';
+	
+	if(range[0] != '\0' && (sscanf(range, "%d,%d", &first, &last) != 2 || first < 1 || last < first) ) {
+		co_await sendMsg(commfd, intRecMsgPacket(getpid(), "WCH", -1, failure) );
+		co_return;
+	}//end if
+	
+	//The journal is the subscribers' fan-out queue: every subscriber reads it from its own position
+	ackMsg = intRecMsgPacket(getpid(), "WCH", next, success);
+	subscribed = co_await sendBytes(commfd, &ackMsg, sizeof(ackMsg) );
+	
+	co_await fileMonitor.addLogWriter();
+	logRequest(logPtr, cliPID, 'W', last, first);
+	fileMonitor.remLogWriter();
+	
+	while(subscribed) {
+		numEntries = co_await tailJournal(journal, next, &entries[0], head);
+		changes.clear();
+		
+		//A subscriber too slow to keep up (its socket full while writes pile up) skips to the newest change rather than hold the journal's history
+		if(head - next > WATCHMAXBACKLOG) {
+			strMissed = to_string(head - next);
+			changes.push_back( intRecMsgPacket(getpid(), "WCH", -1, &strMissed[0]) );
+			next = head;
+			numEntries = 0;
+		}//end if
+		
+		//Push the block's changes within the range in one write
+		for(int i = 0; i < numEntries; i++) {
+			if(entries[i].idx >= first && entries[i].idx <= last) {
+				entries[i].record[MAXRECORDSIZE] = '\0';
+				changes.push_back( intRecMsgPacket(getpid(), "WCH", entries[i].idx, entries[i].record) );
+			}//end if
+		}//end for
+		
+		next += numEntries;
+		
+		if( !changes.empty() ) {
+			subscribed = co_await sendBytes(commfd, &changes[0], sizeof(intRecMsgPacket) * changes.size() );
+		} else if(numEntries == 0) {
+			//While nothing changes, check that the subscriber is still there
+			subscribed = recv(commfd, &byte, 1, MSG_PEEK | MSG_DONTWAIT) != 0;
+		}//end if
+		
+	}//end while
+	
+}//end watchChanges
@@ -0,0 +1,182 @@
+/**
+ * @file storageBench.cpp
+ * @author Griffin Nye
+ * @brief Microbenchmarks for the storage and codec hot paths of the server: getRecord,
+ *        getTotalRecords, updateRecord, getTotalLogRecords, DataRecord(string) parsing,
+ *        DataRecord::toString, and DataRecord::fieldToString, each measured against
+ *        generated bin and log files of 12 rows up to 10M rows. Results are written as csv
+ *        (benchmark,rows,iterations,ns/op,ops/sec) so they can be tracked per commit.
+ *        USAGE: ./storageBench [max rows]
+ */
+
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+//Benchmark the server's own storage functions rather than copies of them
+#include "DataRecord.cpp"
+#include "ServerStats.cpp"
+#include "ShardedDataset.cpp"
+#include "ShardStorage.cpp"
+#include "TraceBuffer.cpp"
+
+using namespace std;
+
+/*! Key for the benchmark's own shard, past every IPC key a server derives from its port (ports are below SHARDKEYSTRIDE). */
+#define BENCHKEY (SHARDKEYSTRIDE * (MAXSHARDS + 2) )
+/*! Minimum time each benchmark is run for. */
+#define BENCHSECONDS 0.25
+/*! Number of distinct random indexes and sample records each benchmark cycles through. */
+#define BENCHSAMPLES 4096
+
+/*! Statistics for the storage functions; never attached, so nothing is recorded. */
+ServerStats serverStats(BENCHKEY);
+/*! Trace the storage functions mark their file operations in; never dumped. */
+TraceBuffer tracer;
+
+/**
+ *@brief Writes a bin file and a log file of the provided number of rows.
+ *@param binName Filename for the bin file.
+ *@param logName Filename for the log file.
+ *@param rows The number of records (and log records) to be written.
+ */
+void buildFiles(const char * binName, const char * logName, long rows);
+
+/**
+ *@brief Runs an operation in doubling batches for at least BENCHSECONDS and reports its cost.
+ *@param name The name of the benchmark.
+ *@param rows The number of rows in the dataset.
+ *@param op The operation, called with the iteration number.
+ */
+template<class Operation> void measure(const char * name, long rows, Operation op);
+
+/**
+ *@brief Builds each dataset size up to the provided maximum and runs every benchmark against it.
+ *@param argc Number of command line arguments
+ *@param argv Array of command line arguments
+ */
+int main(int argc, char * argv[]) {
+	const long SIZES[5] = {12, 1000, 100000, 1000000, 10000000};
+	const char * BINNAME = "storageBench.bin";
+	const char * LOGNAME = "storageBench.log";
+	long maxRows = (argc == 2) ? atol(argv[1]) : SIZES[4];
+	mt19937 rng(552);
+
+	printf("benchmark,rows,iterations,ns/op,ops/sec\n");
+
+	for(int s = 0; s < 5 && SIZES[s] <= maxRows; s++) {
+		long rows = SIZES[s];
+		vector<int> indexes(BENCHSAMPLES);
+		vector<string> records(BENCHSAMPLES);
+		vector<DataRecord> parsed(BENCHSAMPLES);
+		BinShard shard(BENCHKEY);
+		volatile size_t sink = 0;
+
+		buildFiles(BINNAME, LOGNAME, rows);
+
+		shard.binPtr = fopen(BINNAME, "rb+");
+		FILE * logPtr = fopen(LOGNAME, "ab+");
+
+		if(shard.binPtr == NULL || logPtr == NULL || !shard.aggregates.init(shard.binPtr) ) {
+			perror("Error preparing benchmark files");
+			return EXIT_FAILURE;
+		}//end if
+
+		//Sample random records to cycle through
+		for(int i = 0; i < BENCHSAMPLES; i++) {
+			indexes[i] = uniform_int_distribution<int>(1, rows)(rng);
+			records[i] = getRecord(shard, indexes[i]);
+			parsed[i] = DataRecord(records[i]);
+		}//end for
+
+		measure("getRecord", rows, [&](long i) {
+			sink = sink + getRecord(shard, indexes[i % BENCHSAMPLES]).size();
+		});
+
+		measure("getTotalRecords", rows, [&](long) {
+			sink = sink + getTotalRecords(shard);
+		});
+
+		measure("updateRecord", rows, [&](long i) {
+			sink = sink + updateRecord(shard, indexes[i % BENCHSAMPLES], &records[i % BENCHSAMPLES][0], MAXRECORDSIZE + 1);
+		});
+
+		measure("getTotalLogRecords", rows, [&](long) {
+			sink = sink + getTotalLogRecords(logPtr);
+		});
+
+		measure("DataRecord(string)", rows, [&](long i) {
+			sink = sink + (DataRecord(records[i % BENCHSAMPLES]).getTotal().getUnits() > 0);
+		});
+
+		measure("DataRecord::toString", rows, [&](long i) {
+			sink = sink + parsed[i % BENCHSAMPLES].toString().size();
+		});
+
+		measure("DataRecord::fieldToString", rows, [&](long i) {
+			sink = sink + parsed[i % BENCHSAMPLES].fieldToString(parsed[i % BENCHSAMPLES].getTotal() ).size();
+		});
+
+		fclose(shard.binPtr);
+		fclose(logPtr);
+	}//end for
+
+	//Clean up the generated files and the shard's shared memory and semaphores
+	unlink(BINNAME);
+	unlink(LOGNAME);
+	shmctl(shmget(BENCHKEY, 0, 0), IPC_RMID, NULL);
+	semctl(semget(BENCHKEY, 0, 0), 0, IPC_RMID);
+
+	return EXIT_SUCCESS;
+}//end main
+
+//Writes a bin file and a log file of the provided number of rows.
+void buildFiles(const char * binName, const char * logName, long rows) {
+	const char * MONTHS[12] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+	char slot[MAXRECORDSIZE+1];
+	FILE * binPtr = fopen(binName, "wb");
+	FILE * logPtr = fopen(logName, "wb");
+	mt19937 rng(552);
+	uniform_int_distribution<int> cents(0, 333);
+
+	for(long i = 0; i < rows; i++) {
+		int hardware = cents(rng), software = cents(rng), accessories = cents(rng);
+		int total = hardware + software + accessories;
+
+		//Fixed-size record slot, as written by createBin
+		memset(slot, 0, sizeof(slot) );
+		snprintf(slot, sizeof(slot), "%s '%02ld,%d.%02d,%d.%02d,%d.%02d,%d.%02d", MONTHS[i % 12], i / 12 % 100,
+		         total / 100, total % 100, hardware / 100, hardware % 100, software / 100, software % 100, accessories / 100, accessories % 100);
+		fwrite(slot, sizeof(char), sizeof(slot), binPtr);
+
+		fprintf(logPtr, "Server responded to Client %ld with record #%ld.\n", 10000 + i % 50000, i + 1);
+	}//end for
+
+	fclose(binPtr);
+	fclose(logPtr);
+}//end buildFiles
+
+//Runs an operation in doubling batches for at least BENCHSECONDS and reports its cost.
+template<class Operation> void measure(const char * name, long rows, Operation op) {
+	long iterations = 0;
+	double seconds = 0;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	for(long batch = 1; seconds < BENCHSECONDS; batch *= 2) {
+
+		for(long i = 0; i < batch; i++) {
+			op(iterations + i);
+		}//end for
+
+		iterations += batch;
+		seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	}//end for
+
+	printf("%s,%ld,%ld,%.1f,%.0f\n", name, rows, iterations, seconds * 1e9 / iterations, iterations / seconds);
+	fflush(stdout);
+}//end measure